@@ -0,0 +1,103 @@
+#ifndef __TASK_H__
+#define __TASK_H__
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <future>
+#include <utility>
+
+namespace NomBotCore {
+	// A coroutine that produces a T. It only starts once awaited or handed to Spawn or SyncWait, and whoever
+	// awaited it continues on the thread it finishes on, which is whichever thread resumed it last, e.g. the
+	// EventSub reader, which socket waits, DNS lookups and pooled HTTP connections all resume on. A task is
+	// awaited once.
+	template<typename T>
+	class Task {
+	public:
+		struct promise_type {
+			T value{};
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+
+			struct FinalAwaiter {
+				bool await_ready() noexcept { return false; }
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					// Symmetric transfer, a long chain of tasks finishing at once doesn't grow the stack
+					std::coroutine_handle<> continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+				void await_resume() noexcept {}
+			};
+
+			Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			FinalAwaiter final_suspend() noexcept { return {}; }
+			void return_value(T result) { value = std::move(result); }
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		Task(Task&& other) noexcept : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		Task& operator=(Task&&) = delete;
+		~Task()
+		{
+			if (m_Handle)
+				m_Handle.destroy();
+		}
+
+		bool await_ready() const noexcept { return false; }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+		{
+			m_Handle.promise().continuation = awaiting;
+			return m_Handle;
+		}
+		T await_resume()
+		{
+			if (m_Handle.promise().error)
+				std::rethrow_exception(m_Handle.promise().error);
+			return std::move(m_Handle.promise().value);
+		}
+	private:
+		explicit Task(std::coroutine_handle<promise_type> handle) : m_Handle(handle) {}
+
+		std::coroutine_handle<promise_type> m_Handle;
+	};
+
+	namespace Detail {
+		// Owns itself, the frame is freed when the coroutine returns
+		struct DetachedTask {
+			struct promise_type {
+				DetachedTask get_return_object() { return {}; }
+				std::suspend_never initial_suspend() noexcept { return {}; }
+				std::suspend_never final_suspend() noexcept { return {}; }
+				void return_void() {}
+				void unhandled_exception() { std::terminate(); }
+			};
+		};
+	}
+
+	// Runs task on the calling thread until its first suspension and returns. done gets the result on
+	// whichever thread the task finishes on, anything done needs has to outlive the task.
+	template<typename T>
+	Detail::DetachedTask Spawn(Task<T> task, std::function<void(T)> done = nullptr)
+	{
+		T result = co_await task;
+		if (done)
+			done(std::move(result));
+	}
+
+	// Blocks until task finishes. Never call it from a thread the task needs to get there, such as a scheduler
+	// callback or the EventSub reader.
+	template<typename T>
+	T SyncWait(Task<T> task)
+	{
+		std::promise<T> done;
+		std::future<T> result = done.get_future();
+		Spawn(std::move(task), std::function<void(T)>([&done](T value) { done.set_value(std::move(value)); }));
+		return result.get();
+	}
+}
+
+#endif
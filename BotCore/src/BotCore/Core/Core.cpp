@@ -1,17 +1,88 @@
 #include "nompch.h"
 #include "Core.h"
 #include "Logging/ImGuiLog.h"
+#include "Tracing/Trace.h"
+#include <set>
 
 namespace NomBotCore {
 	BotCore::BotCore() 
 	{
-		m_TwitchAPI = std::make_unique<TwitchAPI>();
+		m_Services = std::make_unique<TwitchServices>();
+		m_TwitchAPI = std::make_unique<TwitchAPI>(*m_Services);
 	}
 
 	BotCore::~BotCore() 
 	{
 		StopTwitchAPI();
+		m_Channels.clear();
 		m_TwitchAPI.reset();
+		m_Services.reset();
+	}
+
+	TwitchAPI* BotCore::AddChannel(const TwitchChannelConfig& config)
+	{
+		std::lock_guard<std::mutex> lock(m_ChannelMutex);
+		if (config.name == m_TwitchAPI->GetName()) {
+			ImGuiLogManager::AddLog("BotCore", "A channel named " + config.name + " is already hosted.", LogSeverity::Error);
+			return nullptr;
+		}
+		for (const auto& channel : m_Channels) {
+			if (channel->GetName() == config.name) {
+				ImGuiLogManager::AddLog("BotCore", "A channel named " + config.name + " is already hosted.", LogSeverity::Error);
+				return nullptr;
+			}
+		}
+		m_Channels.push_back(std::make_unique<TwitchAPI>(*m_Services, config));
+		ImGuiLogManager::AddLog("BotCore", "Hosting channel " + config.name + ", " + std::to_string(m_Channels.size() + 1) + " channels in total.", LogSeverity::Info);
+		return m_Channels.back().get();
+	}
+
+	TwitchAPI* BotCore::GetChannel(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(m_ChannelMutex);
+		if (m_TwitchAPI->GetName() == name)
+			return m_TwitchAPI.get();
+		for (const auto& channel : m_Channels) {
+			if (channel->GetName() == name)
+				return channel.get();
+		}
+		return nullptr;
+	}
+
+	std::vector<TwitchAPI*> BotCore::GetChannels()
+	{
+		std::lock_guard<std::mutex> lock(m_ChannelMutex);
+		std::vector<TwitchAPI*> channels;
+		channels.push_back(m_TwitchAPI.get());
+		for (const auto& channel : m_Channels)
+			channels.push_back(channel.get());
+		return channels;
+	}
+
+	void BotCore::HostThreadFunc()
+	{
+		Trace::SetThreadName("TwitchAPI");
+		if (m_Services->Initialize() != 0) {
+			ImGuiLogManager::AddLog("BotCore", "Twitch services failed to initialize, no channel was started.", LogSeverity::Error);
+			return;
+		}
+		// A failed sign in isn't retried until the next StartTwitchAPI, the browser flow would open a tab every second
+		std::set<TwitchAPI*> attempted;
+		while (m_TwitchAPIRunning) {
+			for (TwitchAPI* channel : GetChannels()) {
+				if (!m_TwitchAPIRunning)
+					break;
+				// Started channels refresh their tokens on their own timers
+				if (!channel->IsStarted() && attempted.insert(channel).second)
+					channel->BeginStart(); // Returns at the first wait, channels sign in side by side
+			}
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+		}
+		// Lets a sign in waiting on the browser give up, Stop waits for it
+		m_Services->CancelWaits();
+		for (TwitchAPI* channel : GetChannels())
+			channel->Stop();
+		m_Services->Shutdown();
 	}
 
 	void BotCore::StartTwitchAPI()
@@ -21,11 +92,7 @@ namespace NomBotCore {
 			return;
 		}
 		m_TwitchAPIRunning = true;
-		m_TwitchAPIThread = new std::thread([this]() {
-			if (m_TwitchAPI) {
-				m_TwitchAPI->Run(m_TwitchAPIRunning);
-			}
-		});
+		m_TwitchAPIThread = new std::thread(&BotCore::HostThreadFunc, this);
 		ImGuiLogManager::AddLog("BotCore", "TwitchAPI thread started.", LogSeverity::Info);
 	}
 
@@ -54,15 +121,15 @@ namespace NomBotCore {
 		}
 	}
 
-	void BotCore::SubscrubeToEvent(TwitchAPI::SubscriptionType type, std::function<void(const ChannelPointRewardRedemption&)> callback)
+	void BotCore::SubscrubeToEvent(TwitchAPI::SubscriptionType type)
 	{
 		if (m_TwitchAPI) {
-			int result = m_TwitchAPI->AddEventSubSubscription(type, callback);
+			int result = m_TwitchAPI->AddEventSubSubscription(type);
 			if (result != 0) {
-				ImGuiLogManager::AddLog("BotCore", "Failed to add subscription to event type: " + std::to_string(type), LogSeverity::Error);
+				ImGuiLogManager::AddLog("BotCore", "Failed to add subscription to event type: " + m_TwitchAPI->SubscriptionTypeToString(type), LogSeverity::Error);
 			}
 			else {
-				ImGuiLogManager::AddLog("BotCore", "Added Subscription to event type: " + std::to_string(type), LogSeverity::Info);
+				ImGuiLogManager::AddLog("BotCore", "Added Subscription to event type: " + m_TwitchAPI->SubscriptionTypeToString(type), LogSeverity::Info);
 			}
 		}
 	}
@@ -72,10 +139,10 @@ namespace NomBotCore {
 		if (m_TwitchAPI) {
 			int result = m_TwitchAPI->RemoveEventSubSubscription(type);
 			if (result != 0) {
-				ImGuiLogManager::AddLog("BotCore", "Failed to remove subscription from event type: " + std::to_string(type), LogSeverity::Error);
+				ImGuiLogManager::AddLog("BotCore", "Failed to remove subscription from event type: " + m_TwitchAPI->SubscriptionTypeToString(type), LogSeverity::Error);
 			}
 			else {
-				ImGuiLogManager::AddLog("BotCore", "Removed Subscription from event type: " + std::to_string(type), LogSeverity::Info);
+				ImGuiLogManager::AddLog("BotCore", "Removed Subscription from event type: " + m_TwitchAPI->SubscriptionTypeToString(type), LogSeverity::Info);
 			}
 		}
 	}
@@ -91,7 +158,7 @@ namespace NomBotCore {
 				return false;
 			}
 			else {
-				ImGuiLogManager::AddLog("BotCore", "Failed to check subscription status for event type: " + std::to_string(type), LogSeverity::Error);
+				ImGuiLogManager::AddLog("BotCore", "Failed to check subscription status for event type: " + m_TwitchAPI->SubscriptionTypeToString(type), LogSeverity::Error);
 				return false;
 			}
 		}
@@ -5,8 +5,13 @@
 #include <atomic>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace NomBotCore {
+	// Hosts the bot's own channel and any number of channels added with AddChannel in one process. They
+	// share the TwitchServices, one thread keeps their tokens fresh, and the calls below that take no
+	// channel act on the bot's own one.
 	class BotCore {
 	public:
 		BotCore();
@@ -14,13 +19,37 @@ namespace NomBotCore {
 
 		void StartTwitchAPI();
 		void StopTwitchAPI();
+		// Starts with StartTwitchAPI, or within a second if that already ran. Returns nullptr when the name is taken.
+		TwitchAPI* AddChannel(const TwitchChannelConfig& config);
+		// nullptr for an unknown name
+		TwitchAPI* GetChannel(const std::string& name);
+		std::vector<TwitchAPI*> GetChannels();
 		bool IsWebSocketEnabled() const { return m_TwitchAPI->IsWebSocketEnabled(); }
 		void EnableWebSocket(bool enable);
-		void SubscrubeToEvent(TwitchAPI::SubscriptionType type, std::function<void(const ChannelPointRewardRedemption&)> callback = nullptr);
+		void SubscrubeToEvent(TwitchAPI::SubscriptionType type);
+		// Runs handler for every Event notification on every channel, whether or not its type is currently
+		// subscribed. Use TwitchAPI::AddEventHandler for a handler that only sees one channel.
+		template<typename Event>
+		int AddEventHandler(std::function<void(const Event&)> handler) { return m_Services->GetDispatcher().AddHandler<Event>(std::move(handler)); }
+		void RemoveEventHandler(int id) { m_Services->GetDispatcher().RemoveHandler(id); }
+		// Must be set before StartTwitchAPI
+		void SetEventWorkerConfig(const EventSubWorkerPoolConfig& config) { m_Services->SetEventWorkerConfig(config); }
+		void SetDedupeConfig(const EventSubDedupeConfig& config) { m_Services->SetDedupeConfig(config); }
+		// The one every channel uses, share it instead of opening another, e.g. for the metrics exporter
+		NomSocketManager& GetSocketManager() { return m_Services->OpenSocketManager(); }
+		int StartCapture(const std::string& path) { return m_TwitchAPI->StartCapture(path); }
+		void StopCapture() { m_TwitchAPI->StopCapture(); }
+		int ReplayCapture(const std::string& path, double speed, EventSubReplayStats* stats = nullptr, std::stop_token stop = {}) { return m_TwitchAPI->ReplayCapture(path, speed, stats, stop); }
 		void UnsubscribeFromEvent(TwitchAPI::SubscriptionType type);
 		bool IsSubscribedToEvent(TwitchAPI::SubscriptionType type);
 	private:
+		void HostThreadFunc();
+
+		// Declared first so it outlives every channel
+		std::unique_ptr<TwitchServices> m_Services;
 		std::unique_ptr<TwitchAPI> m_TwitchAPI;
+		std::vector<std::unique_ptr<TwitchAPI>> m_Channels; // Hosted ones, m_TwitchAPI isn't among them
+		std::mutex m_ChannelMutex;
 		std::thread* m_TwitchAPIThread = nullptr;
 		std::atomic<bool> m_TwitchAPIRunning{false};
 	};
@@ -45,6 +45,8 @@ namespace NomBotCore {
 			jsonValue->type = JsonValue::Type::Null;
 			return jsonValue;
 		}
+		ImGuiLogManager::AddLog("JsonParser", std::string("Unexpected character in JSON input: '") + jsonString[pos] + "'", LogSeverity::Error);
+		return nullptr;
 	}
 
 	std::string JsonParser::ParseJsonString(const std::string& jsonString, size_t& pos)
@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include "../Logging/ImGuiLog.h"
+#include "../Logging/StructuredLog.h"
 
 
 namespace NomBotCore {
@@ -22,37 +23,37 @@ namespace NomBotCore {
 		double numberValue;
 		bool boolValue;
 		std::vector<std::shared_ptr<JsonValue>> arrayValues;
-		std::map<std::string, std::shared_ptr<JsonValue>> objectValues;
+		std::map<std::string, std::shared_ptr<JsonValue>, std::less<>> objectValues; // Transparent, find takes a string_view
 		JsonValue() : type(Type::Null), numberValue(0), boolValue(false) {}
 
 		void DumpToLog(const std::string& prefix = "") const {
 			switch (type) {
 			case Type::Null:
-				ImGuiLogManager::AddLog("JsonParser", prefix + "null", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}null", prefix);
 				break;
 			case Type::Boolean:
-				ImGuiLogManager::AddLog("JsonParser", prefix + (boolValue ? "true" : "false"), LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}{}", prefix, boolValue);
 				break;
 			case Type::Number:
-				ImGuiLogManager::AddLog("JsonParser", prefix + std::to_string(numberValue), LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}{}", prefix, numberValue);
 				break;
 			case Type::String:
-				ImGuiLogManager::AddLog("JsonParser", prefix + "\"" + stringValue + "\"", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}\"{}\"", prefix, stringValue);
 				break;
 			case Type::Object:
-				ImGuiLogManager::AddLog("JsonParser", prefix + "{", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}{", prefix);
 				for (const auto& kv : objectValues) {
-					ImGuiLogManager::AddLog("JsonParser", prefix + "  \"" + kv.first + "\":", LogSeverity::Info);
+					NOM_LOG_INFO("JsonParser", "{}  \"{}\":", prefix, kv.first);
 					if (kv.second) kv.second->DumpToLog(prefix + "    ");
 				}
-				ImGuiLogManager::AddLog("JsonParser", prefix + "}", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}}", prefix);
 				break;
 			case Type::Array:
-				ImGuiLogManager::AddLog("JsonParser", prefix + "[", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}[", prefix);
 				for (const auto& v : arrayValues) {
 					if (v) v->DumpToLog(prefix + "  ");
 				}
-				ImGuiLogManager::AddLog("JsonParser", prefix + "]", LogSeverity::Info);
+				NOM_LOG_INFO("JsonParser", "{}]", prefix);
 				break;
 			}
 		}
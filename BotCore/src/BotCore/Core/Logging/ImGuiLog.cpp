@@ -1,56 +1,311 @@
 #include "nompch.h"
 #include "ImGuiLog.h"
-#include <fstream>
-#include <filesystem>
+#include "StructuredLog.h"
+#include "../Tracing/Trace.h"
+#include <thread>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
 
 namespace NomBotCore {
-    std::map<std::string, std::vector<ImGuiLogEntry>> ImGuiLogManager::logs;
-    std::mutex ImGuiLogManager::logMutex;
-	bool ImGuiLogManager::m_ScrollToBottom = false;
-
-    void ImGuiLogManager::AddLog(const std::string& logName, const std::string& message, LogSeverity severity) {
-        std::lock_guard<std::mutex> lock(logMutex);
-        logs[logName].push_back(ImGuiLogEntry{ message, severity });
-        m_ScrollToBottom = true;
-    }
-
-    std::vector<ImGuiLogEntry> ImGuiLogManager::GetLog(const std::string& logName) {
-        std::lock_guard<std::mutex> lock(logMutex);
-        return logs[logName];
-    }
-
-    std::vector<std::string> ImGuiLogManager::GetLogNames() {
-        std::lock_guard<std::mutex> lock(logMutex);
-        std::vector<std::string> names;
-        for (const auto& pair : logs)
-            names.push_back(pair.first);
-        return names;
-    }
-
-	void ImGuiLogManager::DumpAllLogsToFile(const std::string& Directory)
-	{
-		std::lock_guard<std::mutex> lock(logMutex);
-		std::filesystem::create_directories(Directory);
-        for (const auto& pair : logs) {
-            const std::string& logName = pair.first;
-            const std::vector<ImGuiLogEntry>& entries = pair.second;
-            std::string filePath = Directory + "/" + logName + ".log";
-            std::ofstream outFile(filePath, std::ios::app);
-            if (outFile.is_open()) {
-                for (const auto& entry : entries) {
-                    std::string severityStr;
-                    switch (entry.severity) {
-                    case LogSeverity::Info:    severityStr = "[INFO] "; break;
-                    case LogSeverity::Warning: severityStr = "[WARNING] "; break;
-                    case LogSeverity::Error:   severityStr = "[ERROR] "; break;
-                    }
-                    outFile << severityStr << entry.message << std::endl;
-                }
-                outFile.close();
-            }
-            else {
-                AddLog("ImGuiLogManager", "Failed to open log file: " + filePath, LogSeverity::Error);
-            }
-		}
-	}
-}
\ No newline at end of file
+	ImGuiLogManager::Category ImGuiLogManager::m_Categories[ImGuiLogManager::MaxCategories];
+	std::atomic<bool> ImGuiLogManager::m_ScrollToBottom{ false };
+	std::atomic<int> ImGuiLogManager::m_BackpressureMs{ 0 };
+
+	namespace {
+		// One thread's entries on their way to the rings. The owning thread is the only producer; whoever holds
+		// the lock (the owner when it fills up, or PublishStaged) is the only consumer.
+		class StagingBuffer {
+		public:
+			static constexpr uint32_t Capacity = 64;
+
+			bool TryStage(LogRing* ring, const char* message, size_t length, LogSeverity severity, bool structured)
+			{
+				uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+				if (tail - m_Head.load(std::memory_order_acquire) >= Capacity)
+					return false;
+				Entry& entry = m_Entries[tail % Capacity];
+				entry.ring = ring;
+				entry.length = static_cast<uint32_t>(std::min(length, LogRing::MaxMessageBytes));
+				entry.severity = severity;
+				entry.structured = structured;
+				entry.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+				memcpy(entry.text, message, entry.length);
+				m_Tail.store(tail + 1, std::memory_order_release);
+				return true;
+			}
+
+			bool HasStaged() const { return m_Tail.load(std::memory_order_acquire) != m_Head.load(std::memory_order_relaxed); }
+
+			void Lock()
+			{
+				while (m_Locked.exchange(true, std::memory_order_acquire))
+					std::this_thread::yield();
+			}
+			bool TryLock() { return !m_Locked.exchange(true, std::memory_order_acquire); }
+			void Unlock() { m_Locked.store(false, std::memory_order_release); }
+
+			// Caller must hold the lock
+			void Publish(bool mayBlock)
+			{
+				uint32_t head = m_Head.load(std::memory_order_relaxed);
+				uint32_t tail = m_Tail.load(std::memory_order_acquire);
+				for (; head != tail; ++head) {
+					const Entry& entry = m_Entries[head % Capacity];
+					entry.ring->Append(entry.text, entry.length, entry.severity, entry.structured, entry.timestampUs, mayBlock);
+				}
+				m_Head.store(head, std::memory_order_release);
+			}
+
+			std::atomic<bool> inUse{ false }; // Claimed by a live thread. Buffers are reused, never freed.
+		private:
+			struct Entry {
+				LogRing* ring;
+				uint32_t length;
+				LogSeverity severity;
+				bool structured;
+				int64_t timestampUs;
+				char text[LogRing::MaxMessageBytes];
+			};
+
+			std::atomic<uint32_t> m_Head{ 0 };
+			std::atomic<uint32_t> m_Tail{ 0 };
+			std::atomic<bool> m_Locked{ false };
+			Entry m_Entries[Capacity];
+		};
+
+		constexpr int MaxStagingBuffers = 64; // Threads past this log straight into the rings
+		StagingBuffer g_StagingBuffers[MaxStagingBuffers];
+		std::atomic<int> g_StagingBuffersUsed{ 0 }; // High-water mark, bounds the PublishStaged scan
+
+		struct ThreadStaging {
+			StagingBuffer* buffer = nullptr;
+			bool claimed = false;
+
+			StagingBuffer* Get()
+			{
+				if (claimed)
+					return buffer;
+				claimed = true;
+				for (int i = 0; i < MaxStagingBuffers; ++i) {
+					bool expected = false;
+					if (g_StagingBuffers[i].inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+						buffer = &g_StagingBuffers[i];
+						int used = g_StagingBuffersUsed.load(std::memory_order_relaxed);
+						while (used < i + 1 && !g_StagingBuffersUsed.compare_exchange_weak(used, i + 1, std::memory_order_relaxed)) {}
+						break;
+					}
+				}
+				return buffer;
+			}
+
+			~ThreadStaging()
+			{
+				if (!buffer)
+					return;
+				buffer->Lock();
+				buffer->Publish(true);
+				buffer->Unlock();
+				buffer->inUse.store(false, std::memory_order_release);
+			}
+		};
+		thread_local ThreadStaging t_Staging;
+	}
+
+	void LogRing::Append(const char* message, size_t length, LogSeverity severity, bool structured, int64_t timestampUs, bool mayBlock)
+	{
+		uint64_t sequence = m_Head.fetch_add(1, std::memory_order_relaxed);
+		int maxBlockMs = mayBlock ? m_MaxBlockMs.load(std::memory_order_relaxed) : 0;
+		if (maxBlockMs > 0 && sequence >= m_ConsumerCursor.load(std::memory_order_acquire) + Capacity) {
+			// Wait for the consumer to make room, past the limit the entry overwrites unread ones anyway
+			auto giveUp = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxBlockMs);
+			while (sequence >= m_ConsumerCursor.load(std::memory_order_acquire) + Capacity && std::chrono::steady_clock::now() < giveUp)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		Slot& slot = m_Slots[sequence & (Capacity - 1)];
+		uint64_t writing = sequence * 2 + 1;
+
+		// Claim the slot. It only belongs to someone else if writers lapped the whole ring.
+		uint64_t current = slot.state.load(std::memory_order_relaxed);
+		while (true) {
+			if (current > writing)
+				return; // A newer entry already took this slot, ours was overwritten before it landed
+			if (current & 1) {
+				std::this_thread::yield();
+				current = slot.state.load(std::memory_order_relaxed);
+				continue;
+			}
+			if (slot.state.compare_exchange_weak(current, writing, std::memory_order_acquire, std::memory_order_relaxed))
+				break;
+		}
+
+		if (length > MaxMessageBytes)
+			length = MaxMessageBytes;
+		slot.meta.store(static_cast<uint64_t>(length) | (static_cast<uint64_t>(severity) << 32) | (structured ? StructuredFlag : 0), std::memory_order_relaxed);
+		if (timestampUs == 0)
+			timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		slot.timestampUs.store(timestampUs, std::memory_order_relaxed);
+		for (size_t word = 0; word * sizeof(uint64_t) < length; ++word) {
+			uint64_t packed = 0;
+			size_t bytes = std::min(sizeof(uint64_t), length - word * sizeof(uint64_t));
+			memcpy(&packed, message + word * sizeof(uint64_t), bytes);
+			slot.text[word].store(packed, std::memory_order_relaxed);
+		}
+		slot.state.store(writing + 1, std::memory_order_release);
+	}
+
+	uint64_t LogRing::ReadSince(uint64_t from, std::vector<ImGuiLogEntry>& out) const
+	{
+		uint64_t head = m_Head.load(std::memory_order_acquire);
+		// Sequences claimed by writers that have not landed yet don't overwrite anything, so entries up to
+		// two laps back can still be intact. Slot states decide, the window only bounds the scan.
+		uint64_t sequence = head > Capacity * 2 ? std::max(from, head - Capacity * 2) : from;
+		for (; sequence < head; ++sequence) {
+			const Slot& slot = m_Slots[sequence & (Capacity - 1)];
+			uint64_t readable = sequence * 2 + 2;
+			uint64_t before = slot.state.load(std::memory_order_acquire);
+			if (before < readable)
+				break; // Not written yet, resume here next time
+			if (before != readable)
+				continue; // Already overwritten by a newer entry
+
+			uint64_t meta = slot.meta.load(std::memory_order_relaxed);
+			size_t length = static_cast<size_t>(meta & 0xFFFFFFFF);
+			ImGuiLogEntry entry;
+			entry.severity = static_cast<LogSeverity>((meta >> 32) & 0xFF);
+			entry.sequence = sequence;
+			entry.timestampUs = slot.timestampUs.load(std::memory_order_relaxed);
+			entry.message.resize(length);
+			for (size_t word = 0; word * sizeof(uint64_t) < length; ++word) {
+				uint64_t packed = slot.text[word].load(std::memory_order_relaxed);
+				memcpy(&entry.message[word * sizeof(uint64_t)], &packed, std::min(sizeof(uint64_t), length - word * sizeof(uint64_t)));
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.state.load(std::memory_order_relaxed) != readable)
+				continue;
+			if (meta & StructuredFlag)
+				entry.message = FormatLogRecord(entry.message.data(), entry.message.size());
+			out.push_back(std::move(entry));
+		}
+		return sequence;
+	}
+
+	LogRing* ImGuiLogManager::FindRing(const std::string& logName, bool create)
+	{
+		for (int i = 0; i < MaxCategories; ++i) {
+			Category& category = m_Categories[i];
+			int state = category.state.load(std::memory_order_acquire);
+			if (state == 0) {
+				if (!create)
+					return nullptr; // Categories fill front to back, nothing further along
+				if (category.state.compare_exchange_strong(state, 1, std::memory_order_acquire)) {
+					category.name = i == MaxCategories - 1 ? "Other" : logName;
+					category.ring = new LogRing();
+					category.ring->SetBackpressure(m_BackpressureMs.load(std::memory_order_relaxed));
+					category.state.store(2, std::memory_order_release);
+					return category.ring;
+				}
+			}
+			// Someone else is naming this slot, it may be the category we are after
+			while (state == 1) {
+				std::this_thread::yield();
+				state = category.state.load(std::memory_order_acquire);
+			}
+			if (category.name == logName)
+				return category.ring;
+		}
+		return create ? m_Categories[MaxCategories - 1].ring : nullptr;
+	}
+
+	void ImGuiLogManager::Stage(LogRing* ring, const char* message, size_t length, LogSeverity severity, bool structured)
+	{
+		StagingBuffer* buffer = t_Staging.Get();
+		if (!buffer) {
+			ring->Append(message, length, severity, structured);
+			return;
+		}
+		if (severity == LogSeverity::Error) {
+			// Errors should survive a crash right after them, earlier entries go first to keep the thread's order
+			if (buffer->HasStaged()) {
+				buffer->Lock();
+				buffer->Publish(true);
+				buffer->Unlock();
+			}
+			ring->Append(message, length, severity, structured);
+			return;
+		}
+		if (buffer->TryStage(ring, message, length, severity, structured))
+			return;
+		buffer->Lock();
+		buffer->Publish(true);
+		buffer->Unlock();
+		buffer->TryStage(ring, message, length, severity, structured);
+	}
+
+	void ImGuiLogManager::PublishStaged()
+	{
+		int used = g_StagingBuffersUsed.load(std::memory_order_relaxed);
+		for (int i = 0; i < used; ++i) {
+			StagingBuffer& buffer = g_StagingBuffers[i];
+			// A buffer already locked is being published by its owner
+			if (!buffer.HasStaged() || !buffer.TryLock())
+				continue;
+			buffer.Publish(false);
+			buffer.Unlock();
+		}
+	}
+
+	void ImGuiLogManager::AddLog(const std::string& logName, const std::string& message, LogSeverity severity) {
+		NOM_TRACE_SCOPE("Log");
+		LogRing* ring = FindRing(logName, true);
+		Stage(ring, message.data(), message.size(), severity, false);
+		// Checked first so busy producers don't keep pulling the flag's cache line away from each other
+		if (!m_ScrollToBottom.load(std::memory_order_relaxed))
+			m_ScrollToBottom.store(true, std::memory_order_relaxed);
+	}
+
+	void ImGuiLogManager::AddRecord(const LogSite& site, const char* record, size_t length)
+	{
+		NOM_TRACE_SCOPE("Log");
+		LogRing* ring = site.ring.load(std::memory_order_acquire);
+		if (!ring) {
+			ring = FindRing(site.category, true);
+			site.ring.store(ring, std::memory_order_release);
+		}
+		Stage(ring, record, length, site.severity, true);
+		if (!m_ScrollToBottom.load(std::memory_order_relaxed))
+			m_ScrollToBottom.store(true, std::memory_order_relaxed);
+	}
+
+	std::vector<ImGuiLogEntry> ImGuiLogManager::GetLog(const std::string& logName) {
+		std::vector<ImGuiLogEntry> entries;
+		LogRing* ring = FindRing(logName, false);
+		if (ring)
+			ring->ReadSince(0, entries);
+		return entries;
+	}
+
+	uint64_t ImGuiLogManager::ReadSince(const std::string& logName, uint64_t from, std::vector<ImGuiLogEntry>& out)
+	{
+		LogRing* ring = FindRing(logName, false);
+		return ring ? ring->ReadSince(from, out) : from;
+	}
+
+	void ImGuiLogManager::SetBackpressure(int maxBlockMs)
+	{
+		m_BackpressureMs.store(maxBlockMs, std::memory_order_relaxed);
+		for (auto& category : m_Categories) {
+			if (category.state.load(std::memory_order_acquire) == 2)
+				category.ring->SetBackpressure(maxBlockMs);
+		}
+	}
+
+	std::vector<std::string> ImGuiLogManager::GetLogNames() {
+		std::vector<std::string> names;
+		for (const auto& category : m_Categories) {
+			if (category.state.load(std::memory_order_acquire) == 2)
+				names.push_back(category.name);
+		}
+		return names;
+	}
+}
@@ -2,33 +2,101 @@
 #define __IMGUI_LOG_H__
 #include <string>
 #include <vector>
-#include <map>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 namespace NomBotCore {
-    enum class LogSeverity {
-        Info,
-        Warning,
-        Error
-    };
-
-    struct ImGuiLogEntry {
-        std::string message;
-        LogSeverity severity;
-    };
-
-    class ImGuiLogManager {
-    public:
-        static void AddLog(const std::string& logName, const std::string& message, LogSeverity severity = LogSeverity::Info);
-        static std::vector<ImGuiLogEntry> GetLog(const std::string& logName);
-        static std::vector<std::string> GetLogNames();
-		static bool GetScrollToBottom() { return m_ScrollToBottom; }
-		static void SetScrollToBottom(bool state) { m_ScrollToBottom = state; }
-		static void DumpAllLogsToFile(const std::string& Directory);
-    private:
-        static std::map<std::string, std::vector<ImGuiLogEntry>> logs;
-        static std::mutex logMutex;
-		static bool m_ScrollToBottom;
-    };
+	enum class LogSeverity {
+		Info,
+		Warning,
+		Error
+	};
+
+	struct ImGuiLogEntry {
+		std::string message;
+		LogSeverity severity;
+		uint64_t sequence = 0; // Position within its category, one higher for every entry appended
+		// Microseconds since the Unix epoch, taken when it was logged. Staged entries reach the ring after errors
+		// logged later, so timestamps within a category are only roughly sorted.
+		int64_t timestampUs = 0;
+	};
+
+	// Fixed-capacity ring of entries for one log category. Any number of threads append without a lock;
+	// once the ring is full the oldest entries are overwritten. Readers copy slots and use each slot's
+	// state word to throw away anything that was rewritten while they were copying it.
+	class LogRing {
+	public:
+		static constexpr uint64_t Capacity = 1024; // Must be a power of two
+		static constexpr size_t TextWords = 60;
+		static constexpr size_t MaxMessageBytes = TextWords * sizeof(uint64_t); // Longer messages are truncated
+
+		// structured entries hold a StructuredLog record and are formatted by ReadSince. A timestampUs of 0 means now.
+		// mayBlock = false skips backpressure, for threads publishing entries on behalf of others.
+		void Append(const char* message, size_t length, LogSeverity severity, bool structured = false, int64_t timestampUs = 0, bool mayBlock = true);
+		uint64_t GetHead() const { return m_Head.load(std::memory_order_acquire); }
+		// Lets a consumer such as LogFileSink hold producers back instead of losing entries: with maxBlockMs > 0,
+		// Append waits up to that long while the ring is a full lap ahead of the consumer's cursor
+		void SetBackpressure(int maxBlockMs) { m_MaxBlockMs.store(maxBlockMs, std::memory_order_relaxed); }
+		void SetConsumerCursor(uint64_t cursor) { m_ConsumerCursor.store(cursor, std::memory_order_release); }
+		// Appends entries with sequence >= from to out, oldest first. Stops at the first entry still being
+		// written so the result is always a gap-free prefix; returns the sequence to resume from.
+		uint64_t ReadSince(uint64_t from, std::vector<ImGuiLogEntry>& out) const;
+	private:
+		struct Slot {
+			std::atomic<uint64_t> state{ 0 }; // 2 * sequence + 1 while being written, 2 * sequence + 2 once readable
+			std::atomic<uint64_t> meta{ 0 }; // Message length in the low 32 bits, severity in the next 8, then StructuredFlag
+			std::atomic<int64_t> timestampUs{ 0 };
+			std::atomic<uint64_t> text[TextWords] = {};
+		};
+
+		static constexpr uint64_t StructuredFlag = 1ull << 40;
+
+		std::atomic<uint64_t> m_Head{ 0 };
+		std::atomic<uint64_t> m_ConsumerCursor{ 0 };
+		std::atomic<int> m_MaxBlockMs{ 0 };
+		Slot m_Slots[Capacity];
+	};
+
+	struct LogSite;
+
+	// Entries from AddLog and AddRecord are first staged in a buffer owned by the calling thread, which is
+	// published to the category rings in one go when it fills, when PublishStaged runs (every frame and every
+	// LogFileSink cycle) or when the thread exits. Errors publish the thread's buffer and go straight through.
+	class ImGuiLogManager {
+	public:
+		static void AddLog(const std::string& logName, const std::string& message, LogSeverity severity = LogSeverity::Info);
+		// Used by the NOM_LOG_* macros in StructuredLog.h
+		static void AddRecord(const LogSite& site, const char* record, size_t length);
+		// Copies everything the category still holds, prefer ReadSince for anything called repeatedly
+		static std::vector<ImGuiLogEntry> GetLog(const std::string& logName);
+		// Appends entries with sequence >= from and returns the cursor for the next call, so a caller
+		// polling every frame only pays for what was added since. Start with a cursor of 0.
+		static uint64_t ReadSince(const std::string& logName, uint64_t from, std::vector<ImGuiLogEntry>& out);
+		// Moves every thread's staged entries into the rings, call it before reading them
+		static void PublishStaged();
+		static std::vector<std::string> GetLogNames();
+		// Rings live for the whole process, nullptr when the category has never been logged to
+		static LogRing* GetRing(const std::string& logName) { return FindRing(logName, false); }
+		// Applies LogRing::SetBackpressure to every category, including ones created later. 0 turns it off.
+		static void SetBackpressure(int maxBlockMs);
+		static bool GetScrollToBottom() { return m_ScrollToBottom.load(std::memory_order_relaxed); }
+		static void SetScrollToBottom(bool state) { m_ScrollToBottom.store(state, std::memory_order_relaxed); }
+
+		// Memory is bounded by MaxCategories * sizeof(LogRing), about 16 MB. Categories past the limit share the last one.
+		static constexpr int MaxCategories = 32;
+	private:
+		struct Category {
+			std::atomic<int> state{ 0 }; // 0 = free, 1 = being claimed, 2 = ready
+			std::string name;
+			LogRing* ring = nullptr;
+		};
+
+		static LogRing* FindRing(const std::string& logName, bool create);
+		static void Stage(LogRing* ring, const char* message, size_t length, LogSeverity severity, bool structured);
+
+		static Category m_Categories[MaxCategories];
+		static std::atomic<bool> m_ScrollToBottom;
+		static std::atomic<int> m_BackpressureMs;
+	};
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,244 @@
+#include "nompch.h"
+#include "LogFileSink.h"
+#include "LogStore.h"
+#include "StructuredLog.h"
+#include "../Metrics/Metrics.h"
+#include <filesystem>
+#include <algorithm>
+#include <ctime>
+
+namespace NomBotCore {
+	LogFileSink::LogFileSink(const LogFileSinkConfig& config)
+		: m_Config(config)
+	{
+	}
+
+	LogFileSink::~LogFileSink()
+	{
+		Stop();
+	}
+
+	int LogFileSink::Start()
+	{
+		std::lock_guard<std::mutex> lock(m_WakeMutex);
+		if (m_Running)
+			return 0;
+		std::error_code error;
+		std::filesystem::create_directories(m_Config.directory, error);
+		if (error) {
+			ImGuiLogManager::AddLog("LogFileSink", "Failed to create log directory " + m_Config.directory + ": " + error.message(), LogSeverity::Error);
+			return -1;
+		}
+		m_Running = true;
+		if (m_Config.overflowPolicy == LogOverflowPolicy::Block)
+			ImGuiLogManager::SetBackpressure(m_Config.maxBlockMs);
+		m_Thread = std::thread(&LogFileSink::ThreadFunc, this);
+		return 0;
+	}
+
+	void LogFileSink::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			if (!m_Running)
+				return;
+			m_Running = false;
+		}
+		m_Wake.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+		if (m_Config.overflowPolicy == LogOverflowPolicy::Block)
+			ImGuiLogManager::SetBackpressure(0);
+		for (auto& [category, target] : m_Files) {
+			if (target.file)
+				std::fclose(target.file);
+			target.file = nullptr;
+		}
+	}
+
+	void LogFileSink::FlushNow()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_FlushRequested = true;
+		}
+		m_Wake.notify_all();
+	}
+
+	void LogFileSink::ThreadFunc()
+	{
+		// Blocked producers give up after maxBlockMs, so poll well inside that to release them in time.
+		// Files are still only flushed once per cycle.
+		int pollMs = m_Config.flushIntervalMs;
+		if (m_Config.overflowPolicy == LogOverflowPolicy::Block)
+			pollMs = std::max(1, std::min(pollMs, m_Config.maxBlockMs / 4));
+		while (true) {
+			bool running;
+			{
+				std::unique_lock<std::mutex> lock(m_WakeMutex);
+				m_Wake.wait_for(lock, std::chrono::milliseconds(pollMs), [this] { return !m_Running || m_FlushRequested; });
+				m_FlushRequested = false;
+				running = m_Running;
+			}
+			Drain(!running);
+			if (!running)
+				return;
+		}
+	}
+
+	void LogFileSink::Drain(bool final)
+	{
+		LogRateLimiter::ReportSuppressed();
+		ImGuiLogManager::PublishStaged();
+		std::vector<ImGuiLogEntry> entries;
+		for (const auto& category : ImGuiLogManager::GetLogNames()) {
+			CategoryFile& target = m_Files[category];
+			if (!target.ring) {
+				target.ring = ImGuiLogManager::GetRing(category);
+				if (!target.ring)
+					continue;
+			}
+			// Each pass copies at most one ring's worth, keep going while the ring is still far ahead.
+			// The final drain runs until the ring is caught up.
+			for (int pass = 0; final || pass < MaxPassesPerDrain; ++pass) {
+				entries.clear();
+				uint64_t next = target.ring->ReadSince(target.cursor, entries);
+				uint64_t expected = target.cursor;
+				for (const auto& entry : entries) {
+					if (entry.sequence > expected) {
+						m_Dropped.fetch_add(entry.sequence - expected, std::memory_order_relaxed);
+						static MetricCounter* dropped = MetricsRegistry::GetCounter("nom_log_dropped_entries_total", "Log entries overwritten before the file sink read them.");
+						dropped->Add(entry.sequence - expected);
+						target.pending += "[DROPPED] " + std::to_string(entry.sequence - expected) + " entries the sink could not keep up with\n";
+					}
+					AppendLine(target.pending, entry);
+					if (m_Config.store)
+						m_Config.store->Append(category, entry);
+					expected = entry.sequence + 1;
+					if (target.pending.size() >= WriteBufferBytes)
+						WritePending(category, target);
+				}
+				target.cursor = next;
+				target.ring->SetConsumerCursor(next);
+				if (entries.size() < LogRing::Capacity / 2)
+					break;
+			}
+			WritePending(category, target);
+			// Flushing every cycle bounds what a crash can lose to one flush interval
+			if (target.file && target.dirty) {
+				std::fflush(target.file);
+				target.dirty = false;
+			}
+		}
+		// Mapped pages survive the process dying on their own, only the last drain pushes them to disk
+		if (final && m_Config.store)
+			m_Config.store->Flush();
+	}
+
+	void LogFileSink::WritePending(const std::string& category, CategoryFile& target)
+	{
+		if (target.pending.empty())
+			return;
+		RotateIfNeeded(category, target);
+		if (!target.file && OpenFile(category, target) != 0) {
+			// Nowhere to write, count the batch as dropped rather than growing without bound
+			target.pending.clear();
+			return;
+		}
+		size_t written = std::fwrite(target.pending.data(), 1, target.pending.size(), target.file);
+		target.fileBytes += written;
+		target.dirty = true;
+		target.pending.clear();
+	}
+
+	int LogFileSink::OpenFile(const std::string& category, CategoryFile& target)
+	{
+		std::string path = m_Config.directory + "/" + category + ".log";
+		target.file = std::fopen(path.c_str(), "ab");
+		if (!target.file) {
+			ImGuiLogManager::AddLog("LogFileSink", "Failed to open log file: " + path, LogSeverity::Error);
+			return -1;
+		}
+		// One large buffer per file so a drain cycle turns into a handful of writes
+		std::setvbuf(target.file, nullptr, _IOFBF, WriteBufferBytes);
+		std::error_code error;
+		auto size = std::filesystem::file_size(path, error);
+		target.fileBytes = error ? 0 : static_cast<size_t>(size);
+		target.openedAt = std::chrono::system_clock::now();
+		return 0;
+	}
+
+	void LogFileSink::RotateIfNeeded(const std::string& category, CategoryFile& target)
+	{
+		if (!target.file)
+			return;
+		bool tooBig = m_Config.maxFileBytes > 0 && target.fileBytes + target.pending.size() > m_Config.maxFileBytes;
+		bool tooOld = m_Config.rotateIntervalMinutes > 0 && std::chrono::system_clock::now() - target.openedAt >= std::chrono::minutes(m_Config.rotateIntervalMinutes);
+		if (!tooBig && !tooOld)
+			return;
+
+		std::fclose(target.file);
+		target.file = nullptr;
+		std::time_t now = std::time(nullptr);
+		std::tm local = {};
+		localtime_s(&local, &now);
+		char stamp[32];
+		std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+		std::string current = m_Config.directory + "/" + category + ".log";
+		// Size rotation can fire several times a second, the counter keeps names unique and in age order
+		char suffix[16];
+		auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count() % 1000;
+		snprintf(suffix, sizeof(suffix), "-%03d-%04u", static_cast<int>(millis), m_Rotations++ % 10000);
+		std::string rotated = m_Config.directory + "/" + category + "." + stamp + suffix + ".log";
+		std::error_code error;
+		std::filesystem::rename(current, rotated, error);
+		if (error) {
+			ImGuiLogManager::AddLog("LogFileSink", "Failed to rotate " + current + ": " + error.message(), LogSeverity::Warning);
+		}
+		else if (m_Config.compressRotatedFile) {
+			if (m_Config.compressRotatedFile(rotated) != 0)
+				ImGuiLogManager::AddLog("LogFileSink", "Failed to compress rotated log " + rotated, LogSeverity::Warning);
+		}
+		PruneRotated(category);
+		OpenFile(category, target);
+	}
+
+	void LogFileSink::PruneRotated(const std::string& category)
+	{
+		if (m_Config.maxRotatedFiles <= 0)
+			return;
+		// Rotated names embed a sortable timestamp, so lexical order is age order
+		std::vector<std::filesystem::path> rotated;
+		std::string prefix = category + ".";
+		std::string live = category + ".log";
+		std::error_code error;
+		for (const auto& file : std::filesystem::directory_iterator(m_Config.directory, error)) {
+			std::string name = file.path().filename().string();
+			if (name != live && name.compare(0, prefix.size(), prefix) == 0)
+				rotated.push_back(file.path());
+		}
+		if (rotated.size() <= static_cast<size_t>(m_Config.maxRotatedFiles))
+			return;
+		std::sort(rotated.begin(), rotated.end());
+		for (size_t i = 0; i + m_Config.maxRotatedFiles < rotated.size(); ++i)
+			std::filesystem::remove(rotated[i], error);
+	}
+
+	void LogFileSink::AppendLine(std::string& out, const ImGuiLogEntry& entry)
+	{
+		std::time_t seconds = static_cast<std::time_t>(entry.timestampUs / 1000000);
+		std::tm local = {};
+		localtime_s(&local, &seconds);
+		char stamp[40];
+		size_t length = std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+		snprintf(stamp + length, sizeof(stamp) - length, ".%03d ", static_cast<int>((entry.timestampUs / 1000) % 1000));
+		out += stamp;
+		switch (entry.severity) {
+		case LogSeverity::Info:    out += "[INFO] "; break;
+		case LogSeverity::Warning: out += "[WARNING] "; break;
+		case LogSeverity::Error:   out += "[ERROR] "; break;
+		}
+		out += entry.message;
+		out += '\n';
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef __LOG_FILE_SINK_H__
+#define __LOG_FILE_SINK_H__
+#include "ImGuiLog.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+
+namespace NomBotCore {
+	class LogStore;
+
+	enum class LogOverflowPolicy {
+		Drop, // Producers never wait, entries the sink could not keep up with are counted and skipped
+		Block // Producers wait up to maxBlockMs for the sink before overwriting unread entries
+	};
+
+	struct LogFileSinkConfig {
+		std::string directory = "Logs";
+		size_t maxFileBytes = 8 * 1024 * 1024;
+		int rotateIntervalMinutes = 60; // 0 rotates on size only
+		int maxRotatedFiles = 10; // Per category, oldest are deleted first
+		int flushIntervalMs = 250;
+		LogOverflowPolicy overflowPolicy = LogOverflowPolicy::Drop;
+		int maxBlockMs = 20; // Block only, the sink polls at a quarter of this
+		// Runs on the sink thread for every rotated file, e.g. to gzip it. Returns 0 on success.
+		std::function<int(const std::string& path)> compressRotatedFile;
+		// Every entry written out is also appended here when set, the store must outlive the sink
+		LogStore* store = nullptr;
+	};
+
+	// Streams every log category to <directory>/<category>.log from a background thread. The thread follows
+	// each category's ring with a cursor, so producers never touch the file or a lock on the way in.
+	class LogFileSink {
+	public:
+		LogFileSink(const LogFileSinkConfig& config = LogFileSinkConfig());
+		~LogFileSink();
+
+		int Start();
+		// Writes whatever is still buffered, then stops the thread
+		void Stop();
+		void FlushNow();
+		uint64_t GetDroppedCount() const { return m_Dropped.load(std::memory_order_relaxed); }
+	private:
+		struct CategoryFile {
+			LogRing* ring = nullptr;
+			uint64_t cursor = 0;
+			std::FILE* file = nullptr;
+			size_t fileBytes = 0;
+			std::chrono::system_clock::time_point openedAt;
+			std::string pending;
+			bool dirty = false;
+		};
+
+		void ThreadFunc();
+		void Drain(bool final);
+		int OpenFile(const std::string& category, CategoryFile& target);
+		void RotateIfNeeded(const std::string& category, CategoryFile& target);
+		void PruneRotated(const std::string& category);
+		void WritePending(const std::string& category, CategoryFile& target);
+		static void AppendLine(std::string& out, const ImGuiLogEntry& entry);
+
+		LogFileSinkConfig m_Config;
+		std::map<std::string, CategoryFile> m_Files;
+		std::thread m_Thread;
+		std::mutex m_WakeMutex;
+		std::condition_variable m_Wake;
+		bool m_Running = false;
+		bool m_FlushRequested = false;
+		std::atomic<uint64_t> m_Dropped{ 0 };
+		unsigned m_Rotations = 0;
+
+		static constexpr size_t WriteBufferBytes = 256 * 1024;
+		static constexpr int MaxPassesPerDrain = 4;
+	};
+}
+#endif
@@ -0,0 +1,195 @@
+#include "nompch.h"
+#include "LogSearchIndex.h"
+#include <algorithm>
+
+namespace NomBotCore {
+	namespace {
+		// ASCII only, locale aware folding is not worth its cost per byte here
+		inline unsigned char FoldCase(unsigned char c)
+		{
+			return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+		}
+
+		bool ContainsFolded(const char* text, size_t length, const std::string& foldedQuery)
+		{
+			const char* end = text + length;
+			return std::search(text, end, foldedQuery.begin(), foldedQuery.end(), [](char a, char b) {
+				return FoldCase(static_cast<unsigned char>(a)) == static_cast<unsigned char>(b);
+			}) != end;
+		}
+	}
+
+	LogSearchIndex::LogSearchIndex(size_t maxRows)
+		: m_MaxRows(std::max<size_t>(maxRows, BlockRows))
+		, m_Postings(new Posting[PostingBuckets])
+	{
+	}
+
+	LogSearchIndex::~LogSearchIndex()
+	{
+		Clear();
+		delete[] m_Postings;
+	}
+
+	void LogSearchIndex::Clear()
+	{
+		for (Block* block : m_Blocks)
+			delete block;
+		m_Blocks.clear();
+		for (uint32_t bucket = 0; bucket < PostingBuckets; ++bucket) {
+			m_Postings[bucket].pages.clear();
+			m_Postings[bucket].head = 0;
+		}
+		m_Matches.clear();
+		m_MatchHead = 0;
+		m_FirstRow = 0;
+		m_NextRow = 0;
+		m_ScanNext = 0;
+	}
+
+	void LogSearchIndex::Add(const ImGuiLogEntry& entry, uint8_t category)
+	{
+		// Row ids are 32 bit to keep the postings small, start over rather than wrap
+		if (m_NextRow >= UINT32_MAX - BlockRows)
+			Clear();
+		if (m_NextRow % BlockRows == 0) {
+			if (static_cast<size_t>(m_NextRow - m_FirstRow) >= m_MaxRows)
+				EvictOldestBlock();
+			Block* block = new Block();
+			block->rows.reserve(BlockRows);
+			m_Blocks.push_back(block);
+		}
+
+		uint32_t row = m_NextRow++;
+		Block& block = *m_Blocks.back();
+		size_t length = std::min<size_t>(entry.message.size(), UINT16_MAX);
+		block.rows.push_back({ static_cast<uint32_t>(block.text.size()), static_cast<uint16_t>(length), static_cast<uint8_t>(entry.severity), category, entry.timestampUs });
+		block.text.append(entry.message.data(), length);
+
+		CollectTrigrams(entry.message.data(), length, m_Trigrams);
+		uint32_t page = row / PageRows;
+		uint32_t firstPage = m_FirstRow / PageRows;
+		for (uint32_t bucket : m_Trigrams) {
+			Posting& posting = m_Postings[bucket];
+			if (!posting.pages.empty() && posting.pages.back() == page)
+				continue;
+			while (posting.head < posting.pages.size() && posting.pages[posting.head] < firstPage)
+				++posting.head;
+			if (posting.head > 64 && posting.head * 2 > posting.pages.size()) {
+				posting.pages.erase(posting.pages.begin(), posting.pages.begin() + posting.head);
+				posting.head = 0;
+			}
+			posting.pages.push_back(page);
+		}
+
+		// Once the filter is caught up new rows are matched right away, otherwise Update gets to them in order
+		if (m_ScanNext == row) {
+			if (Matches(row))
+				m_Matches.push_back(row);
+			m_ScanNext = row + 1;
+		}
+	}
+
+	void LogSearchIndex::SetFilter(const std::string& query, uint8_t severityMask, uint64_t categoryMask)
+	{
+		m_Query.resize(query.size());
+		std::transform(query.begin(), query.end(), m_Query.begin(), [](char c) { return static_cast<char>(FoldCase(static_cast<unsigned char>(c))); });
+		m_SeverityMask = severityMask;
+		m_CategoryMask = categoryMask;
+		m_Matches.clear();
+		m_MatchHead = 0;
+		m_ScanNext = m_FirstRow;
+
+		// Any match contains every trigram of the query, so walking the shortest posting list is enough
+		CollectTrigrams(m_Query.data(), m_Query.size(), m_Trigrams);
+		m_UseIndex = !m_Trigrams.empty();
+		size_t rarest = SIZE_MAX;
+		for (uint32_t bucket : m_Trigrams) {
+			size_t count = m_Postings[bucket].pages.size() - m_Postings[bucket].head;
+			if (count < rarest) {
+				rarest = count;
+				m_QueryBucket = bucket;
+			}
+		}
+	}
+
+	bool LogSearchIndex::Update(size_t budget)
+	{
+		if (m_ScanNext < m_FirstRow)
+			m_ScanNext = m_FirstRow;
+		if (!m_UseIndex) {
+			uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(m_NextRow, static_cast<uint64_t>(m_ScanNext) + budget));
+			for (; m_ScanNext < end; ++m_ScanNext) {
+				if (Matches(m_ScanNext))
+					m_Matches.push_back(m_ScanNext);
+			}
+			return m_ScanNext == m_NextRow;
+		}
+
+		const Posting& posting = m_Postings[m_QueryBucket];
+		auto page = std::lower_bound(posting.pages.begin() + posting.head, posting.pages.end(), m_ScanNext / PageRows);
+		for (; page != posting.pages.end() && budget > 0; ++page) {
+			uint32_t row = std::max(*page * PageRows, m_ScanNext);
+			uint32_t end = std::min(*page * PageRows + PageRows, m_NextRow);
+			for (; row < end; ++row) {
+				if (Matches(row))
+					m_Matches.push_back(row);
+			}
+			m_ScanNext = end;
+			budget -= std::min<size_t>(budget, PageRows);
+		}
+		// Pages past the end of the list don't hold the trigram, nothing left to check up to the newest row
+		if (page == posting.pages.end())
+			m_ScanNext = m_NextRow;
+		return m_ScanNext == m_NextRow;
+	}
+
+	LogSearchIndex::RowView LogSearchIndex::GetRow(uint32_t row) const
+	{
+		const Block& block = *m_Blocks[(row - m_FirstRow) / BlockRows];
+		const Row& stored = block.rows[row % BlockRows];
+		RowView view;
+		view.text = block.text.data() + stored.textOffset;
+		view.length = stored.length;
+		view.severity = static_cast<LogSeverity>(stored.severity);
+		view.category = stored.category;
+		view.timestampUs = stored.timestampUs;
+		return view;
+	}
+
+	bool LogSearchIndex::Matches(uint32_t row) const
+	{
+		const Block& block = *m_Blocks[(row - m_FirstRow) / BlockRows];
+		const Row& stored = block.rows[row % BlockRows];
+		if (!(m_SeverityMask & (1u << stored.severity)) || !(m_CategoryMask & (1ull << stored.category)))
+			return false;
+		return m_Query.empty() || ContainsFolded(block.text.data() + stored.textOffset, stored.length, m_Query);
+	}
+
+	void LogSearchIndex::EvictOldestBlock()
+	{
+		delete m_Blocks.front();
+		m_Blocks.erase(m_Blocks.begin());
+		m_FirstRow += BlockRows;
+		// Postings are trimmed as they are next appended to, matches are ordered so only a prefix goes
+		while (m_MatchHead < m_Matches.size() && m_Matches[m_MatchHead] < m_FirstRow)
+			++m_MatchHead;
+		if (m_MatchHead * 2 > m_Matches.size()) {
+			m_Matches.erase(m_Matches.begin(), m_Matches.begin() + m_MatchHead);
+			m_MatchHead = 0;
+		}
+	}
+
+	void LogSearchIndex::CollectTrigrams(const char* text, size_t length, std::vector<uint32_t>& out)
+	{
+		out.clear();
+		for (size_t i = 0; i + 3 <= length; ++i) {
+			uint32_t trigram = static_cast<uint32_t>(FoldCase(static_cast<unsigned char>(text[i]))) << 16
+				| static_cast<uint32_t>(FoldCase(static_cast<unsigned char>(text[i + 1]))) << 8
+				| FoldCase(static_cast<unsigned char>(text[i + 2]));
+			out.push_back((trigram * 2654435761u) >> (32 - PostingBucketBits));
+		}
+		std::sort(out.begin(), out.end());
+		out.erase(std::unique(out.begin(), out.end()), out.end());
+	}
+}
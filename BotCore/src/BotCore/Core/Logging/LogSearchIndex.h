@@ -0,0 +1,89 @@
+#ifndef __LOG_SEARCH_INDEX_H__
+#define __LOG_SEARCH_INDEX_H__
+#include "ImGuiLog.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace NomBotCore {
+	// Keeps a window of log entries from every category along with a trigram index over their text, and the
+	// rows matching the current filter. New entries are matched as they arrive, so a log viewer only pays for
+	// what changed. After a filter change the old rows are rescanned a bounded amount per Update call.
+	// Not thread safe, meant to be owned by the UI thread.
+	class LogSearchIndex {
+	public:
+		struct RowView {
+			const char* text = nullptr;
+			size_t length = 0;
+			LogSeverity severity = LogSeverity::Info;
+			uint8_t category = 0;
+			int64_t timestampUs = 0;
+		};
+
+		static constexpr uint32_t BlockRows = 65536; // Rows are stored and evicted a block at a time
+		static constexpr uint8_t AllSeverities = 0x07;
+		// Trigrams are hashed into this many posting lists. Sharing a list only costs extra candidates to verify.
+		// Postings point at pages of rows rather than single rows, which keeps common trigrams cheap to store
+		static constexpr uint32_t PageRows = 32;
+		static constexpr int PostingBucketBits = 18;
+		static constexpr uint32_t PostingBuckets = 1u << PostingBucketBits;
+
+		LogSearchIndex(size_t maxRows = 1000000);
+		~LogSearchIndex();
+		LogSearchIndex(const LogSearchIndex&) = delete;
+		LogSearchIndex& operator=(const LogSearchIndex&) = delete;
+
+		// category is the caller's id for the entry's log, at most 63
+		void Add(const ImGuiLogEntry& entry, uint8_t category);
+		// query is matched as a case-insensitive substring, an empty query matches everything.
+		// severityMask has bit (1 << severity) set for every severity to keep, categoryMask likewise per category.
+		void SetFilter(const std::string& query, uint8_t severityMask = AllSeverities, uint64_t categoryMask = ~0ull);
+		// Runs the filter over up to budget rows it has not seen yet, returns true once every row has been checked
+		bool Update(size_t budget);
+		size_t GetMatchCount() const { return m_Matches.size() - m_MatchHead; }
+		// index is 0 for the oldest match still held
+		RowView GetMatch(size_t index) const { return GetRow(m_Matches[m_MatchHead + index]); }
+		size_t GetRowCount() const { return m_NextRow - m_FirstRow; }
+		void Clear();
+	private:
+		struct Row {
+			uint32_t textOffset;
+			uint16_t length;
+			uint8_t severity;
+			uint8_t category;
+			int64_t timestampUs;
+		};
+		struct Block {
+			std::vector<Row> rows;
+			std::string text;
+		};
+		// Pages (PageRows consecutive rows) holding a trigram hashed to this bucket, ascending.
+		// Entries before head were evicted and are dropped lazily.
+		struct Posting {
+			std::vector<uint32_t> pages;
+			size_t head = 0;
+		};
+
+		RowView GetRow(uint32_t row) const;
+		bool Matches(uint32_t row) const;
+		void EvictOldestBlock();
+		static void CollectTrigrams(const char* text, size_t length, std::vector<uint32_t>& out);
+
+		size_t m_MaxRows;
+		std::vector<Block*> m_Blocks;
+		uint32_t m_FirstRow = 0; // Always a multiple of BlockRows
+		uint32_t m_NextRow = 0;
+		Posting* m_Postings; // PostingBuckets of them
+		std::vector<uint32_t> m_Trigrams; // Bucket numbers, scratch for Add and SetFilter
+
+		std::string m_Query; // Case folded
+		uint8_t m_SeverityMask = AllSeverities;
+		uint64_t m_CategoryMask = ~0ull;
+		bool m_UseIndex = false;
+		uint32_t m_QueryBucket = 0; // Bucket of the query's rarest trigram, only its rows can match
+		uint32_t m_ScanNext = 0; // First row the filter has not looked at
+		std::vector<uint32_t> m_Matches;
+		size_t m_MatchHead = 0;
+	};
+}
+#endif
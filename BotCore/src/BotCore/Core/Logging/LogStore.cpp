@@ -0,0 +1,486 @@
+#include "nompch.h"
+#include "LogStore.h"
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <cctype>
+
+namespace NomBotCore {
+	namespace {
+		constexpr char SegmentMagic[8] = { 'N', 'O', 'M', 'L', 'O', 'G', '1', '\0' };
+		// Version 1 segments have no timestamp bounds, they are still read but scanned whole
+		constexpr uint32_t SegmentVersion = 2;
+
+		struct IndexEntry {
+			uint64_t sequence;
+			uint64_t offset; // From the start of the record area
+			// Bounds of every record from offset up to the next entry. Staged entries are published after errors
+			// logged later and the clock may step back, so record timestamps are only roughly in order.
+			int64_t minTimestampUs;
+			int64_t maxTimestampUs;
+		};
+
+		struct IndexEntryV1 {
+			uint64_t sequence;
+			int64_t timestampUs;
+			uint64_t offset;
+		};
+
+		struct RecordHeader {
+			uint32_t totalBytes; // Header and text, padded to 8 bytes
+			uint16_t textBytes;
+			uint8_t severity;
+			uint8_t reserved;
+			uint64_t sequence;
+			int64_t timestampUs;
+		};
+
+		inline size_t AlignRecord(size_t bytes)
+		{
+			return (bytes + 7) & ~static_cast<size_t>(7);
+		}
+
+		// Past any sequence a segment of fileBytes starting at firstSequence can hold, for segments whose header
+		// can't be trusted. Every record takes at least a RecordHeader.
+		inline uint64_t SequenceBound(uint64_t firstSequence, uint64_t fileBytes)
+		{
+			return firstSequence + fileBytes / sizeof(RecordHeader) + 1;
+		}
+
+		// CON, NUL, COM1 and the like stay devices on Windows whatever extension follows them
+		bool IsDeviceName(const std::string& name)
+		{
+			std::string upper = name;
+			std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+			if (upper == "CON" || upper == "PRN" || upper == "AUX" || upper == "NUL")
+				return true;
+			return upper.size() == 4 && (upper.compare(0, 3, "COM") == 0 || upper.compare(0, 3, "LPT") == 0) && std::isdigit(static_cast<unsigned char>(upper[3]));
+		}
+
+		// Category names become part of file names: anything but letters, digits, '_', '-' and ' ' is written as
+		// %XX, which keeps them inside the store and leaves '.' to separate the name's fields
+		std::string EscapeCategory(const std::string& category)
+		{
+			std::string escaped;
+			for (size_t i = 0; i < category.size(); ++i) {
+				unsigned char c = static_cast<unsigned char>(category[i]);
+				bool plain = (std::isalnum(c) || c == '_' || c == '-' || c == ' ') && !(i == 0 && IsDeviceName(category));
+				if (plain) {
+					escaped += static_cast<char>(c);
+				}
+				else {
+					char hex[4];
+					snprintf(hex, sizeof(hex), "%%%02X", c);
+					escaped += hex;
+				}
+			}
+			return escaped;
+		}
+
+		bool UnescapeCategory(const std::string& escaped, std::string& category)
+		{
+			category.clear();
+			for (size_t i = 0; i < escaped.size(); ++i) {
+				if (escaped[i] != '%') {
+					category += escaped[i];
+					continue;
+				}
+				if (i + 2 >= escaped.size() || !std::isxdigit(static_cast<unsigned char>(escaped[i + 1])) || !std::isxdigit(static_cast<unsigned char>(escaped[i + 2])))
+					return false;
+				category += static_cast<char>(std::stoi(escaped.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			return true;
+		}
+	}
+
+	struct LogStore::SegmentHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t headerBytes; // Records start here, past the index
+		uint64_t firstSequence;
+		int64_t firstTimestampUs;
+		uint64_t writeOffset; // Bytes of complete records, only moved after a record is fully written
+		uint64_t recordCount;
+		uint32_t indexCount;
+		uint32_t indexCapacity;
+		int64_t minTimestampUs; // Over every record, version 2 on
+		int64_t maxTimestampUs;
+		// IndexEntry[indexCapacity] follows
+
+		IndexEntry* Index() { return reinterpret_cast<IndexEntry*>(this + 1); }
+		const IndexEntry* Index() const { return reinterpret_cast<const IndexEntry*>(this + 1); }
+	};
+
+	LogStore::LogStore(const LogStoreConfig& config)
+		: m_Config(config)
+	{
+	}
+
+	LogStore::~LogStore()
+	{
+		Close();
+	}
+
+	int LogStore::Open()
+	{
+		std::lock_guard<std::mutex> lock(m_SeriesMutex);
+		if (m_Open)
+			return 0;
+		std::error_code error;
+		std::filesystem::create_directories(m_Config.directory, error);
+		if (error) {
+			ImGuiLogManager::AddLog("LogStore", "Failed to create log store directory " + m_Config.directory + ": " + error.message(), LogSeverity::Error);
+			return -1;
+		}
+		// Only names are read here, segments are mapped the first time a category is appended to or queried
+		for (const auto& file : std::filesystem::directory_iterator(m_Config.directory, error)) {
+			std::string category;
+			Segment segment;
+			if (!ParseSegmentName(file.path().filename().string(), category, segment))
+				continue;
+			segment.path = file.path().string();
+			Series*& series = m_Series[category];
+			if (!series)
+				series = new Series();
+			series->segments.push_back(segment);
+		}
+		// The first append reads the last segment's header and continues right after its records
+		for (auto& [category, series] : m_Series) {
+			std::sort(series->segments.begin(), series->segments.end(), [](const Segment& a, const Segment& b) { return a.firstSequence < b.firstSequence; });
+			const Segment& last = series->segments.back();
+			uintmax_t fileBytes = std::filesystem::file_size(last.path, error);
+			series->nextSequence = SequenceBound(last.firstSequence, error ? m_Config.segmentBytes : fileBytes);
+		}
+		m_Open = true;
+		return 0;
+	}
+
+	void LogStore::Close()
+	{
+		std::lock_guard<std::mutex> lock(m_SeriesMutex);
+		for (auto& [category, series] : m_Series) {
+			{
+				std::lock_guard<std::mutex> seriesLock(series->mutex);
+				UnmapSegment(series->live);
+			}
+			delete series;
+		}
+		m_Series.clear();
+		m_Open = false;
+	}
+
+	LogStore::Series* LogStore::GetSeries(const std::string& category, bool create)
+	{
+		std::lock_guard<std::mutex> lock(m_SeriesMutex);
+		if (!m_Open)
+			return nullptr;
+		auto found = m_Series.find(category);
+		if (found != m_Series.end())
+			return found->second;
+		if (!create)
+			return nullptr;
+		Series* series = new Series();
+		m_Series[category] = series;
+		return series;
+	}
+
+	std::vector<std::string> LogStore::GetCategories()
+	{
+		std::vector<std::string> categories;
+		std::lock_guard<std::mutex> lock(m_SeriesMutex);
+		for (const auto& [category, series] : m_Series)
+			categories.push_back(category);
+		return categories;
+	}
+
+	int LogStore::Append(const std::string& category, const ImGuiLogEntry& entry)
+	{
+		Series* series = GetSeries(category, true);
+		if (!series)
+			return -1;
+		std::lock_guard<std::mutex> lock(series->mutex);
+
+		// Pick up where the last run left off, its live segment may still have room
+		if (!series->live.view && !series->segments.empty()) {
+			const Segment& last = series->segments.back();
+			if (MapSegment(last.path, 0, true, series->live) == 0) {
+				const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(series->live.view);
+				bool readable = memcmp(header->magic, SegmentMagic, sizeof(SegmentMagic)) == 0 && (header->version == SegmentVersion || header->version == 1)
+					&& header->firstSequence == last.firstSequence && header->recordCount <= series->live.size / sizeof(RecordHeader);
+				// Otherwise nextSequence keeps the bound Open derived from the file's size
+				if (readable)
+					series->nextSequence = header->firstSequence + header->recordCount;
+				if (!readable || header->version != SegmentVersion || header->headerBytes + header->writeOffset > series->live.size)
+					UnmapSegment(series->live); // Unreadable or an older version, the next append starts a fresh segment after it
+			}
+		}
+
+		size_t textBytes = std::min<size_t>(entry.message.size(), UINT16_MAX);
+		size_t recordBytes = AlignRecord(sizeof(RecordHeader) + textBytes);
+		SegmentHeader* header = series->live.view ? reinterpret_cast<SegmentHeader*>(series->live.view) : nullptr;
+		if (!header || header->headerBytes + header->writeOffset + recordBytes > series->live.size) {
+			if (StartSegment(category, *series, entry.timestampUs) != 0)
+				return -1;
+			header = reinterpret_cast<SegmentHeader*>(series->live.view);
+			if (header->headerBytes + recordBytes > series->live.size)
+				return -1; // Larger than a whole segment
+		}
+
+		char* data = series->live.view + header->headerBytes;
+		RecordHeader record = {};
+		record.totalBytes = static_cast<uint32_t>(recordBytes);
+		record.textBytes = static_cast<uint16_t>(textBytes);
+		record.severity = static_cast<uint8_t>(entry.severity);
+		record.sequence = series->nextSequence++;
+		record.timestampUs = entry.timestampUs;
+		memcpy(data + header->writeOffset, &record, sizeof(record));
+		memcpy(data + header->writeOffset + sizeof(record), entry.message.data(), textBytes);
+
+		// One index entry per stride of record bytes, the last one also covers anything past a full index
+		if (header->indexCount == 0 || (header->writeOffset / IndexStrideBytes > header->Index()[header->indexCount - 1].offset / IndexStrideBytes && header->indexCount < header->indexCapacity)) {
+			IndexEntry& index = header->Index()[header->indexCount];
+			index.sequence = record.sequence;
+			index.offset = header->writeOffset;
+			index.minTimestampUs = record.timestampUs;
+			index.maxTimestampUs = record.timestampUs;
+			++header->indexCount;
+		}
+		IndexEntry& stride = header->Index()[header->indexCount - 1];
+		stride.minTimestampUs = std::min(stride.minTimestampUs, record.timestampUs);
+		stride.maxTimestampUs = std::max(stride.maxTimestampUs, record.timestampUs);
+		if (header->recordCount == 0)
+			header->minTimestampUs = header->maxTimestampUs = record.timestampUs;
+		header->minTimestampUs = std::min(header->minTimestampUs, record.timestampUs);
+		header->maxTimestampUs = std::max(header->maxTimestampUs, record.timestampUs);
+		// Publish the record last so a crash mid-write leaves it outside writeOffset
+		std::atomic_thread_fence(std::memory_order_release);
+		header->writeOffset += recordBytes;
+		++header->recordCount;
+		return 0;
+	}
+
+	int LogStore::StartSegment(const std::string& category, Series& series, int64_t timestampUs)
+	{
+		UnmapSegment(series.live);
+		char suffix[48];
+		snprintf(suffix, sizeof(suffix), ".%016llx.%016llx.seg", static_cast<unsigned long long>(series.nextSequence), static_cast<unsigned long long>(timestampUs));
+		Segment segment;
+		segment.path = m_Config.directory + "/" + EscapeCategory(category) + suffix;
+		segment.firstSequence = series.nextSequence;
+		segment.firstTimestampUs = timestampUs;
+
+		uint32_t indexCapacity = static_cast<uint32_t>(m_Config.segmentBytes / IndexStrideBytes + 1);
+		size_t headerBytes = sizeof(SegmentHeader) + indexCapacity * sizeof(IndexEntry);
+		headerBytes = (headerBytes + 4095) & ~static_cast<size_t>(4095);
+		if (MapSegment(segment.path, std::max(m_Config.segmentBytes, headerBytes * 2), true, series.live) != 0) {
+			ImGuiLogManager::AddLog("LogStore", "Failed to create log segment " + segment.path, LogSeverity::Error);
+			return -1;
+		}
+		SegmentHeader* header = reinterpret_cast<SegmentHeader*>(series.live.view);
+		memset(header, 0, headerBytes);
+		header->version = SegmentVersion;
+		header->headerBytes = static_cast<uint32_t>(headerBytes);
+		header->firstSequence = segment.firstSequence;
+		header->firstTimestampUs = timestampUs;
+		header->indexCapacity = indexCapacity;
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(header->magic, SegmentMagic, sizeof(SegmentMagic));
+		series.segments.push_back(segment);
+
+		// Only the live segment is held mapped, so older ones can go as long as no query is using them
+		while (m_Config.maxSegments > 0 && series.segments.size() > static_cast<size_t>(m_Config.maxSegments)) {
+			std::error_code error;
+			std::filesystem::remove(series.segments.front().path, error);
+			if (error)
+				ImGuiLogManager::AddLog("LogStore", "Failed to delete old log segment " + series.segments.front().path + ": " + error.message(), LogSeverity::Warning);
+			series.segments.erase(series.segments.begin());
+		}
+		return 0;
+	}
+
+	void LogStore::Flush()
+	{
+		std::lock_guard<std::mutex> lock(m_SeriesMutex);
+		for (auto& [category, series] : m_Series) {
+			std::lock_guard<std::mutex> seriesLock(series->mutex);
+			if (series->live.view)
+				FlushViewOfFile(series->live.view, 0);
+		}
+	}
+
+	int LogStore::QueryRange(const std::string& category, int64_t fromUs, int64_t toUs, size_t maxRecords, std::vector<LogStoreRecord>& out)
+	{
+		Series* series = GetSeries(category, false);
+		return series ? Query(*series, true, fromUs, toUs, 0, maxRecords, out) : 0;
+	}
+
+	int LogStore::QuerySequence(const std::string& category, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out)
+	{
+		Series* series = GetSeries(category, false);
+		return series ? Query(*series, false, 0, 0, fromSequence, maxRecords, out) : 0;
+	}
+
+	int LogStore::Query(Series& series, bool byTime, int64_t fromUs, int64_t toUs, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out)
+	{
+		std::lock_guard<std::mutex> lock(series.mutex);
+		// File names give every segment's first sequence, start at the last one beginning at or before the query.
+		// Timestamps are not sorted, so a time query looks at every segment's bounds instead.
+		size_t first = 0;
+		for (size_t i = 1; i < series.segments.size() && !byTime; ++i) {
+			if (series.segments[i].firstSequence <= fromSequence)
+				first = i;
+		}
+
+		size_t before = out.size();
+		bool done = false;
+		for (size_t i = first; i < series.segments.size() && !done && out.size() - before < maxRecords; ++i) {
+			bool live = i + 1 == series.segments.size() && series.live.view;
+			MappedSegment mapped;
+			if (live)
+				mapped = series.live;
+			else if (MapSegment(series.segments[i].path, 0, false, mapped) != 0)
+				continue; // Deleted or unreadable, the rest of the range may still be there
+			if (ScanSegment(mapped.view, mapped.size, byTime, fromUs, toUs, fromSequence, maxRecords - (out.size() - before), out, done) != 0)
+				ImGuiLogManager::AddLog("LogStore", "Skipped corrupt log segment " + series.segments[i].path, LogSeverity::Warning);
+			if (!live)
+				UnmapSegment(mapped);
+		}
+		return static_cast<int>(out.size() - before);
+	}
+
+	int LogStore::ScanSegment(const char* view, size_t size, bool byTime, int64_t fromUs, int64_t toUs, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out, bool& done)
+	{
+		const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(view);
+		if (memcmp(header->magic, SegmentMagic, sizeof(SegmentMagic)) != 0 || (header->version != SegmentVersion && header->version != 1))
+			return -1;
+		bool bounded = header->version == SegmentVersion;
+		size_t indexEntryBytes = bounded ? sizeof(IndexEntry) : sizeof(IndexEntryV1);
+		size_t fixedBytes = bounded ? sizeof(SegmentHeader) : offsetof(SegmentHeader, minTimestampUs);
+		if (header->headerBytes < fixedBytes + static_cast<uint64_t>(header->indexCapacity) * indexEntryBytes || header->headerBytes + header->writeOffset > size)
+			return -1;
+		uint64_t writeOffset = header->writeOffset;
+		const char* data = view + header->headerBytes;
+		uint32_t indexCount = std::min(header->indexCount, header->indexCapacity);
+		if (byTime && bounded && header->recordCount > 0 && (header->maxTimestampUs < fromUs || header->minTimestampUs > toUs))
+			return 0;
+
+		// Byte ranges to read. Sequences only grow, so a sequence query starts at the last stride beginning at or
+		// before it and reads on. A time query reads every stride whose bounds overlap the range.
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+		if (!bounded) {
+			ranges.emplace_back(0, writeOffset);
+		}
+		else if (!byTime) {
+			const IndexEntry* index = header->Index();
+			const IndexEntry* upper = std::upper_bound(index, index + indexCount, fromSequence, [](uint64_t sequence, const IndexEntry& entry) {
+				return sequence < entry.sequence;
+			});
+			ranges.emplace_back(upper == index ? 0 : (upper - 1)->offset, writeOffset);
+		}
+		else {
+			const IndexEntry* index = header->Index();
+			for (uint32_t i = 0; i < indexCount; ++i) {
+				if (index[i].maxTimestampUs < fromUs || index[i].minTimestampUs > toUs)
+					continue;
+				uint64_t end = i + 1 < indexCount ? index[i + 1].offset : writeOffset;
+				if (!ranges.empty() && ranges.back().second == index[i].offset)
+					ranges.back().second = end;
+				else
+					ranges.emplace_back(index[i].offset, end);
+			}
+		}
+
+		size_t added = 0;
+		for (const auto& [begin, end] : ranges) {
+			uint64_t offset = begin;
+			while (offset + sizeof(RecordHeader) <= end) {
+				if (added == maxRecords) {
+					done = true;
+					return 0;
+				}
+				RecordHeader record;
+				memcpy(&record, data + offset, sizeof(record));
+				if (record.totalBytes < sizeof(RecordHeader) || offset + record.totalBytes > writeOffset)
+					return -1;
+				offset += record.totalBytes;
+				if (byTime ? record.timestampUs < fromUs || record.timestampUs > toUs : record.sequence < fromSequence)
+					continue;
+				LogStoreRecord result;
+				result.sequence = record.sequence;
+				result.timestampUs = record.timestampUs;
+				result.severity = static_cast<LogSeverity>(record.severity);
+				result.message.assign(data + offset - record.totalBytes + sizeof(RecordHeader), record.textBytes);
+				out.push_back(std::move(result));
+				++added;
+			}
+		}
+		return 0;
+	}
+
+	int LogStore::MapSegment(const std::string& path, size_t size, bool writable, MappedSegment& out)
+	{
+		HANDLE file = CreateFileA(path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			NULL, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return -1;
+		if (size == 0) {
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(SegmentHeader))) {
+				CloseHandle(file);
+				return -1;
+			}
+			size = static_cast<size_t>(fileSize.QuadPart);
+		}
+		// Mapping a writable view past the end of the file grows it to size
+		HANDLE mapping = CreateFileMappingA(file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+			static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), NULL);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			return -1;
+		}
+		void* view = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+		if (view == NULL) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return -1;
+		}
+		out.file = file;
+		out.mapping = mapping;
+		out.view = static_cast<char*>(view);
+		out.size = size;
+		return 0;
+	}
+
+	void LogStore::UnmapSegment(MappedSegment& segment)
+	{
+		if (segment.view)
+			UnmapViewOfFile(segment.view);
+		if (segment.mapping)
+			CloseHandle(segment.mapping);
+		if (segment.file)
+			CloseHandle(segment.file);
+		segment = MappedSegment();
+	}
+
+	bool LogStore::ParseSegmentName(const std::string& fileName, std::string& category, Segment& out)
+	{
+		// <escaped category>.<first sequence>.<first timestamp>.seg, both numbers as 16 hex digits
+		const size_t suffixBytes = 1 + 16 + 1 + 16 + 4;
+		if (fileName.size() <= suffixBytes || fileName.compare(fileName.size() - 4, 4, ".seg") != 0)
+			return false;
+		size_t start = fileName.size() - suffixBytes;
+		if (fileName[start] != '.' || fileName[start + 17] != '.')
+			return false;
+		unsigned long long sequence = 0, timestamp = 0;
+		if (sscanf_s(fileName.c_str() + start, ".%16llx.%16llx.seg", &sequence, &timestamp) != 2)
+			return false;
+		if (!UnescapeCategory(fileName.substr(0, start), category))
+			return false;
+		out.firstSequence = sequence;
+		out.firstTimestampUs = static_cast<int64_t>(timestamp);
+		return true;
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef __LOG_STORE_H__
+#define __LOG_STORE_H__
+#include "ImGuiLog.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace NomBotCore {
+	struct LogStoreRecord {
+		uint64_t sequence = 0; // Per category, keeps counting across restarts
+		int64_t timestampUs = 0;
+		LogSeverity severity = LogSeverity::Info;
+		std::string message;
+	};
+
+	struct LogStoreConfig {
+		std::string directory = "Logs/Store";
+		size_t segmentBytes = 8 * 1024 * 1024; // Each segment file is created at this size and mapped whole
+		int maxSegments = 32; // Per category, oldest are deleted first
+	};
+
+	// Append-only binary log history, one series of memory-mapped segment files per category. File names carry
+	// each segment's first sequence and timestamp, and the live segment's header holds its write offset, so
+	// opening the store is a directory listing plus one mapping however much history there is.
+	// Every IndexStrideBytes of records the segment header gets a sparse index entry with the stride's first
+	// sequence and its lowest and highest timestamp, letting range queries skip the pages they don't return.
+	// LogFileSink appends to it from its thread, queries may come from any thread.
+	class LogStore {
+	public:
+		LogStore(const LogStoreConfig& config = LogStoreConfig());
+		~LogStore();
+		LogStore(const LogStore&) = delete;
+		LogStore& operator=(const LogStore&) = delete;
+
+		int Open();
+		void Close();
+		int Append(const std::string& category, const ImGuiLogEntry& entry);
+		// Asks the OS to write dirty pages of every live segment back to disk
+		void Flush();
+		// Appends up to maxRecords records of the category with fromUs <= timestamp <= toUs, in the order they
+		// were stored. Timestamps are when an entry was logged, which is only roughly the order they reach the
+		// store, so the range is checked against every stride's bounds rather than searched for.
+		// Returns the number appended or -1 on error.
+		int QueryRange(const std::string& category, int64_t fromUs, int64_t toUs, size_t maxRecords, std::vector<LogStoreRecord>& out);
+		// Appends up to maxRecords records starting at fromSequence
+		int QuerySequence(const std::string& category, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out);
+		std::vector<std::string> GetCategories();
+
+		static constexpr size_t IndexStrideBytes = 64 * 1024;
+	private:
+		struct SegmentHeader;
+		struct Segment {
+			std::string path;
+			uint64_t firstSequence = 0;
+			int64_t firstTimestampUs = 0;
+		};
+		struct MappedSegment {
+			void* file = nullptr;
+			void* mapping = nullptr;
+			char* view = nullptr;
+			size_t size = 0;
+		};
+		struct Series {
+			std::mutex mutex;
+			std::vector<Segment> segments; // Oldest first, the last one is live
+			MappedSegment live;
+			uint64_t nextSequence = 0;
+		};
+
+		Series* GetSeries(const std::string& category, bool create);
+		int StartSegment(const std::string& category, Series& series, int64_t timestampUs);
+		int Query(Series& series, bool byTime, int64_t fromUs, int64_t toUs, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out);
+		static int ScanSegment(const char* view, size_t size, bool byTime, int64_t fromUs, int64_t toUs, uint64_t fromSequence, size_t maxRecords, std::vector<LogStoreRecord>& out, bool& done);
+		static int MapSegment(const std::string& path, size_t size, bool writable, MappedSegment& out);
+		static void UnmapSegment(MappedSegment& segment);
+		static bool ParseSegmentName(const std::string& fileName, std::string& category, Segment& out);
+
+		LogStoreConfig m_Config;
+		std::mutex m_SeriesMutex;
+		std::map<std::string, Series*> m_Series;
+		bool m_Open = false;
+	};
+}
+#endif
@@ -0,0 +1,218 @@
+#include "nompch.h"
+#include "StructuredLog.h"
+#include "../Metrics/Metrics.h"
+#include <cstdio>
+#include <chrono>
+
+namespace NomBotCore {
+	namespace {
+		class LogRecordReader {
+		public:
+			LogRecordReader(const char* record, size_t length) : m_Record(record), m_Length(length) {}
+
+			bool Read(void* out, size_t length)
+			{
+				if (m_Offset + length > m_Length)
+					return false;
+				memcpy(out, m_Record + m_Offset, length);
+				m_Offset += length;
+				return true;
+			}
+
+			// Appends the next argument's text, returns false once the record is exhausted
+			bool AppendNext(std::string& out)
+			{
+				LogArgType type;
+				if (!Read(&type, 1))
+					return false;
+				switch (type) {
+				case LogArgType::Int: {
+					int64_t value;
+					if (!Read(&value, sizeof(value))) return false;
+					out += std::to_string(value);
+					return true;
+				}
+				case LogArgType::UInt: {
+					uint64_t value;
+					if (!Read(&value, sizeof(value))) return false;
+					out += std::to_string(value);
+					return true;
+				}
+				case LogArgType::Double: {
+					double value;
+					if (!Read(&value, sizeof(value))) return false;
+					char text[32];
+					snprintf(text, sizeof(text), "%g", value);
+					out += text;
+					return true;
+				}
+				case LogArgType::Bool: {
+					uint64_t value;
+					if (!Read(&value, sizeof(value))) return false;
+					out += value ? "true" : "false";
+					return true;
+				}
+				case LogArgType::String:
+				case LogArgType::Bytes: {
+					uint16_t length;
+					if (!Read(&length, sizeof(length)) || m_Offset + length > m_Length) return false;
+					const char* data = m_Record + m_Offset;
+					m_Offset += length;
+					if (type == LogArgType::String) {
+						out.append(data, length);
+						return true;
+					}
+					static const char digits[] = "0123456789abcdef";
+					out.reserve(out.size() + length * 3);
+					for (uint16_t i = 0; i < length; ++i) {
+						unsigned char byte = static_cast<unsigned char>(data[i]);
+						if (i != 0) out += ' ';
+						out += digits[byte >> 4];
+						out += digits[byte & 0x0F];
+					}
+					return true;
+				}
+				}
+				return false;
+			}
+		private:
+			const char* m_Record;
+			size_t m_Length;
+			size_t m_Offset = 0;
+		};
+	}
+
+	std::mutex LogRateLimiter::m_Mutex;
+	std::map<std::string, LogRateLimit> LogRateLimiter::m_Limits;
+	std::atomic<uint32_t> LogRateLimiter::m_Generation{ 1 };
+	std::atomic<const LogSite*> LogRateLimiter::m_Throttled{ nullptr };
+
+	namespace {
+		int64_t SteadyMicroseconds()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		constexpr int64_t ReportIntervalUs = 1000000;
+	}
+
+	void LogRateLimiter::SetCategoryLimit(const std::string& category, const LogRateLimit& limit)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Limits[category] = limit;
+		m_Generation.fetch_add(1, std::memory_order_release);
+	}
+
+	void LogRateLimiter::ClearCategoryLimit(const std::string& category)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Limits.erase(category);
+		m_Generation.fetch_add(1, std::memory_order_release);
+	}
+
+	void LogRateLimiter::Resolve(const LogSite& site)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		uint32_t generation = m_Generation.load(std::memory_order_relaxed);
+		int64_t interval = 0;
+		int64_t tolerance = 0;
+		uint32_t sampleEvery = 1;
+		auto found = m_Limits.find(site.category);
+		if (found != m_Limits.end()) {
+			const LogRateLimit& limit = found->second;
+			if (limit.messagesPerSecond > 0) {
+				interval = std::max<int64_t>(1, static_cast<int64_t>(1000000.0 / limit.messagesPerSecond));
+				tolerance = static_cast<int64_t>(std::max(0.0, limit.burst - 1) * interval);
+			}
+			sampleEvery = std::max<uint32_t>(1, limit.sampleEvery);
+		}
+		site.intervalUs.store(interval, std::memory_order_relaxed);
+		site.toleranceUs.store(tolerance, std::memory_order_relaxed);
+		site.sampleEvery.store(sampleEvery, std::memory_order_relaxed);
+		site.limitGeneration.store(generation, std::memory_order_relaxed);
+	}
+
+	bool LogRateLimiter::AdmitLimited(const LogSite& site)
+	{
+		uint32_t sampleEvery = site.sampleEvery.load(std::memory_order_relaxed);
+		if (sampleEvery > 1 && site.sampleCounter.fetch_add(1, std::memory_order_relaxed) % sampleEvery != 0) {
+			Suppress(site);
+			return false;
+		}
+		int64_t now = SteadyMicroseconds();
+		int64_t interval = site.intervalUs.load(std::memory_order_relaxed);
+		if (interval > 0) {
+			int64_t tolerance = site.toleranceUs.load(std::memory_order_relaxed);
+			int64_t next = site.nextAllowedUs.load(std::memory_order_relaxed);
+			while (true) {
+				int64_t start = std::max(next, now);
+				if (start - now > tolerance) {
+					Suppress(site);
+					return false;
+				}
+				if (site.nextAllowedUs.compare_exchange_weak(next, start + interval, std::memory_order_relaxed))
+					break;
+			}
+		}
+		// Summarize what was dropped ahead of this call so the log reads in order, at most once a second
+		if (site.suppressed.load(std::memory_order_relaxed) != 0 && now - site.lastReportUs.load(std::memory_order_relaxed) >= ReportIntervalUs) {
+			uint64_t suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+			if (suppressed != 0)
+				Report(site, suppressed, now);
+		}
+		return true;
+	}
+
+	void LogRateLimiter::Suppress(const LogSite& site)
+	{
+		site.suppressed.fetch_add(1, std::memory_order_relaxed);
+		// First drop at this site, add it to the list ReportSuppressed walks. Sites are static, never removed.
+		if (!site.throttled.load(std::memory_order_relaxed) && !site.throttled.exchange(true, std::memory_order_acq_rel)) {
+			const LogSite* head = m_Throttled.load(std::memory_order_relaxed);
+			do {
+				site.nextThrottled = head;
+			} while (!m_Throttled.compare_exchange_weak(head, &site, std::memory_order_release, std::memory_order_relaxed));
+		}
+	}
+
+	void LogRateLimiter::Report(const LogSite& site, uint64_t suppressed, int64_t nowUs)
+	{
+		site.lastReportUs.store(nowUs, std::memory_order_relaxed);
+		MetricsRegistry::GetCounter("nom_log_suppressed_total", "NOM_LOG calls dropped by a category rate limit.", MetricLabel("category", site.category))->Add(suppressed);
+		ImGuiLogManager::AddLog(site.category, "Suppressed " + std::to_string(suppressed) + " similar messages: " + site.format, site.severity);
+	}
+
+	void LogRateLimiter::ReportSuppressed()
+	{
+		int64_t now = SteadyMicroseconds();
+		for (const LogSite* site = m_Throttled.load(std::memory_order_acquire); site; site = site->nextThrottled) {
+			if (site->suppressed.load(std::memory_order_relaxed) == 0 || now - site->lastReportUs.load(std::memory_order_relaxed) < ReportIntervalUs)
+				continue;
+			uint64_t suppressed = site->suppressed.exchange(0, std::memory_order_relaxed);
+			if (suppressed != 0)
+				Report(*site, suppressed, now);
+		}
+	}
+
+	std::string FormatLogRecord(const char* record, size_t length)
+	{
+		LogRecordReader reader(record, length);
+		const LogSite* site = nullptr;
+		if (!reader.Read(&site, sizeof(site)) || !site)
+			return "(corrupt log record)";
+
+		std::string out;
+		const char* format = site->format;
+		bool argumentsLeft = true;
+		for (const char* c = format; *c; ++c) {
+			if (c[0] == '{' && c[1] == '}') {
+				if (!argumentsLeft || !(argumentsLeft = reader.AppendNext(out)))
+					out += "{}";
+				++c;
+				continue;
+			}
+			out += *c;
+		}
+		return out;
+	}
+}
@@ -0,0 +1,204 @@
+#ifndef __STRUCTURED_LOG_H__
+#define __STRUCTURED_LOG_H__
+#include "ImGuiLog.h"
+#include <string_view>
+#include <type_traits>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Levels below this are compiled out of NOM_LOG_* call sites entirely, arguments included
+#ifndef NOM_LOG_MIN_SEVERITY
+	#ifdef NOM_DIST
+		#define NOM_LOG_MIN_SEVERITY 1 // Warning
+	#else
+		#define NOM_LOG_MIN_SEVERITY 0 // Info
+	#endif
+#endif
+
+#define NOM_LOG_ENABLED(severity) (static_cast<int>(severity) >= NOM_LOG_MIN_SEVERITY)
+
+// Records the call site's static format and the raw arguments, text is only produced when the entry is read.
+// Placeholders are "{}", filled from the arguments in order. Calls over the category's LogRateLimit are
+// dropped before their arguments are evaluated.
+#define NOM_LOG(severity, category, format, ...) \
+	do { \
+		if constexpr (NOM_LOG_ENABLED(severity)) { \
+			static const ::NomBotCore::LogSite nomLogSite(category, format, severity); \
+			if (nomLogSite.Admit()) \
+				::NomBotCore::LogStructured(nomLogSite, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
+// True when a multi-line dump or other expensive logging at this spot should go ahead, under the category's
+// LogRateLimit. description names what was skipped in the "suppressed" summaries.
+#define NOM_LOG_SAMPLE(severity, category, description) \
+	(NOM_LOG_ENABLED(severity) && [] { \
+		static const ::NomBotCore::LogSite nomLogSite(category, description, severity); \
+		return nomLogSite.Admit(); \
+	}())
+
+#define NOM_LOG_INFO(category, format, ...) NOM_LOG(::NomBotCore::LogSeverity::Info, category, format, ##__VA_ARGS__)
+#define NOM_LOG_WARNING(category, format, ...) NOM_LOG(::NomBotCore::LogSeverity::Warning, category, format, ##__VA_ARGS__)
+#define NOM_LOG_ERROR(category, format, ...) NOM_LOG(::NomBotCore::LogSeverity::Error, category, format, ##__VA_ARGS__)
+
+namespace NomBotCore {
+	struct LogSite;
+
+	// Applies to each call site of the category separately, so one noisy line can't starve the others
+	struct LogRateLimit {
+		double messagesPerSecond = 0; // 0 = no limit
+		double burst = 1; // Calls allowed back to back before the rate applies
+		uint32_t sampleEvery = 1; // Keep one call in this many, before the rate limit
+	};
+
+	// Per-category rate limits for NOM_LOG call sites. Errors are never limited. Dropped calls are counted and
+	// reported as "Suppressed N similar messages" lines, on the site's next admitted call or by ReportSuppressed.
+	class LogRateLimiter {
+	public:
+		static void SetCategoryLimit(const std::string& category, const LogRateLimit& limit);
+		static void ClearCategoryLimit(const std::string& category);
+		// Reports sites that have dropped calls and not reported for a second, LogFileSink calls it every cycle
+		static void ReportSuppressed();
+
+		static uint32_t GetGeneration() { return m_Generation.load(std::memory_order_acquire); }
+		static void Resolve(const LogSite& site);
+		static bool AdmitLimited(const LogSite& site);
+	private:
+		static void Suppress(const LogSite& site);
+		static void Report(const LogSite& site, uint64_t suppressed, int64_t nowUs);
+
+		static std::mutex m_Mutex;
+		static std::map<std::string, LogRateLimit> m_Limits;
+		static std::atomic<uint32_t> m_Generation; // Bumped on every change, sites re-resolve when theirs is stale
+		static std::atomic<const LogSite*> m_Throttled; // Sites that have ever dropped a call, linked by nextThrottled
+	};
+
+	// One per NOM_LOG call site, its address is the format id stored in every record
+	struct LogSite {
+		const char* category;
+		const char* format;
+		LogSeverity severity;
+		mutable std::atomic<LogRing*> ring{ nullptr }; // Resolved on first use so later calls skip the category lookup
+
+		// Rate limit state, a generic cell rate algorithm: each admitted call pushes nextAllowedUs on by intervalUs
+		// and calls are dropped while it runs more than toleranceUs ahead of now
+		mutable std::atomic<uint32_t> limitGeneration{ 0 };
+		mutable std::atomic<int64_t> intervalUs{ 0 };
+		mutable std::atomic<int64_t> toleranceUs{ 0 };
+		mutable std::atomic<uint32_t> sampleEvery{ 1 };
+		mutable std::atomic<int64_t> nextAllowedUs{ 0 };
+		mutable std::atomic<uint32_t> sampleCounter{ 0 };
+		mutable std::atomic<uint64_t> suppressed{ 0 };
+		mutable std::atomic<int64_t> lastReportUs{ 0 };
+		mutable std::atomic<bool> throttled{ false };
+		mutable const LogSite* nextThrottled = nullptr;
+
+		constexpr LogSite(const char* siteCategory, const char* siteFormat, LogSeverity siteSeverity)
+			: category(siteCategory), format(siteFormat), severity(siteSeverity) {}
+
+		bool Admit() const
+		{
+			if (severity == LogSeverity::Error)
+				return true;
+			if (limitGeneration.load(std::memory_order_relaxed) != LogRateLimiter::GetGeneration())
+				LogRateLimiter::Resolve(*this);
+			if (intervalUs.load(std::memory_order_relaxed) == 0 && sampleEvery.load(std::memory_order_relaxed) <= 1)
+				return true;
+			return LogRateLimiter::AdmitLimited(*this);
+		}
+	};
+
+	// Logs raw bytes, shown as hex when formatted
+	struct LogBytes {
+		const void* data;
+		size_t length;
+	};
+
+	enum class LogArgType : uint8_t {
+		Int,
+		UInt,
+		Double,
+		Bool,
+		String,
+		Bytes
+	};
+
+	// Packs a call site pointer and typed arguments into a compact record:
+	// [LogSite*] then per argument [type byte][8 byte value] or [type byte][uint16 length][bytes]
+	class LogRecordWriter {
+	public:
+		LogRecordWriter(char* buffer, size_t capacity) : m_Buffer(buffer), m_Capacity(capacity) {}
+
+		template<typename T>
+		void Add(const T& value)
+		{
+			if constexpr (std::is_same_v<T, bool>)
+				PutFixed(LogArgType::Bool, static_cast<uint64_t>(value ? 1 : 0));
+			else if constexpr (std::is_enum_v<T>)
+				PutFixed(LogArgType::Int, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+				PutFixed(LogArgType::Int, static_cast<int64_t>(value));
+			else if constexpr (std::is_integral_v<T>)
+				PutFixed(LogArgType::UInt, static_cast<uint64_t>(value));
+			else if constexpr (std::is_floating_point_v<T>)
+				PutFixed(LogArgType::Double, static_cast<double>(value));
+			else if constexpr (std::is_same_v<T, LogBytes>)
+				PutBlob(LogArgType::Bytes, static_cast<const char*>(value.data), value.length);
+			else if constexpr (std::is_pointer_v<T>)
+				PutString(value ? std::string_view(value) : std::string_view("(null)"));
+			else
+				PutString(std::string_view(value));
+		}
+
+		void PutSite(const LogSite* site) { Put(&site, sizeof(site)); }
+		size_t GetSize() const { return m_Size; }
+	private:
+		template<typename V>
+		void PutFixed(LogArgType type, V value)
+		{
+			if (m_Size + 1 + sizeof(V) > m_Capacity)
+				return;
+			Put(&type, 1);
+			Put(&value, sizeof(V));
+		}
+		void PutString(std::string_view text) { PutBlob(LogArgType::String, text.data(), text.size()); }
+		void PutBlob(LogArgType type, const char* data, size_t length)
+		{
+			if (m_Size + 3 > m_Capacity)
+				return;
+			// Whatever does not fit in the record is cut, the record itself stays well formed
+			size_t room = m_Capacity - m_Size - 3;
+			uint16_t stored = static_cast<uint16_t>(std::min(length, std::min(room, static_cast<size_t>(0xFFFF))));
+			Put(&type, 1);
+			Put(&stored, sizeof(stored));
+			Put(data, stored);
+		}
+		void Put(const void* data, size_t length)
+		{
+			memcpy(m_Buffer + m_Size, data, length);
+			m_Size += length;
+		}
+
+		char* m_Buffer;
+		size_t m_Capacity;
+		size_t m_Size = 0;
+	};
+
+	// Turns a record written by LogRecordWriter back into text
+	std::string FormatLogRecord(const char* record, size_t length);
+
+	template<typename... Args>
+	void LogStructured(const LogSite& site, const Args&... args)
+	{
+		char record[LogRing::MaxMessageBytes];
+		LogRecordWriter writer(record, sizeof(record));
+		writer.PutSite(&site);
+		(writer.Add(args), ...);
+		ImGuiLogManager::AddRecord(site, record, writer.GetSize());
+	}
+}
+#endif
@@ -0,0 +1,217 @@
+#include "nompch.h"
+#include "Metrics.h"
+#include "../Logging/ImGuiLog.h"
+#include <cstdio>
+
+namespace NomBotCore {
+	std::mutex MetricsRegistry::m_Mutex;
+	std::map<std::string, MetricsRegistry::Family> MetricsRegistry::m_Families;
+	std::map<int, std::string> MetricsRegistry::m_GaugeNames;
+	int MetricsRegistry::m_NextGaugeId = 1;
+
+	namespace {
+		std::atomic<int> g_NextShard{ 0 };
+
+		void AppendNumber(std::string& out, double value)
+		{
+			char text[32];
+			snprintf(text, sizeof(text), "%.17g", value);
+			out += text;
+		}
+
+		void AppendSample(std::string& out, const std::string& name, const std::string& labels, const std::string& extraLabel)
+		{
+			out += name;
+			if (!labels.empty() || !extraLabel.empty()) {
+				out += '{';
+				out += labels;
+				if (!labels.empty() && !extraLabel.empty())
+					out += ',';
+				out += extraLabel;
+				out += '}';
+			}
+			out += ' ';
+		}
+	}
+
+	int NextMetricShard()
+	{
+		return g_NextShard.fetch_add(1, std::memory_order_relaxed) % MetricShards;
+	}
+
+	uint64_t MetricCounter::Read() const
+	{
+		uint64_t total = 0;
+		for (const auto& shard : m_Shards)
+			total += shard.value.load(std::memory_order_relaxed);
+		return total;
+	}
+
+	MetricHistogram::MetricHistogram(const std::vector<double>& bounds)
+	{
+		for (double bound : bounds) {
+			if (m_BoundCount == MetricMaxBuckets)
+				break;
+			m_BoundsMicros[m_BoundCount++] = static_cast<int64_t>(bound * 1000000.0);
+		}
+	}
+
+	void MetricHistogram::ObserveMicros(int64_t micros)
+	{
+		int bucket = 0;
+		while (bucket < m_BoundCount && micros > m_BoundsMicros[bucket])
+			++bucket;
+		Shard& shard = m_Shards[MetricShardIndex()];
+		shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+		shard.sumMicros.fetch_add(static_cast<uint64_t>(micros > 0 ? micros : 0), std::memory_order_relaxed);
+	}
+
+	void MetricHistogram::Read(Snapshot& out) const
+	{
+		out.bounds.clear();
+		for (int i = 0; i < m_BoundCount; ++i)
+			out.bounds.push_back(m_BoundsMicros[i] / 1000000.0);
+		out.counts.assign(m_BoundCount + 1, 0);
+		uint64_t sumMicros = 0;
+		for (const auto& shard : m_Shards) {
+			for (int i = 0; i <= m_BoundCount; ++i)
+				out.counts[i] += shard.buckets[i].load(std::memory_order_relaxed);
+			sumMicros += shard.sumMicros.load(std::memory_order_relaxed);
+		}
+		out.count = 0;
+		for (uint64_t count : out.counts)
+			out.count += count;
+		out.sumSeconds = sumMicros / 1000000.0;
+	}
+
+	std::string MetricLabel(const char* name, const std::string& value)
+	{
+		std::string label = name;
+		label += "=\"";
+		for (char c : value) {
+			if (c == '\\' || c == '"')
+				label += '\\';
+			if (c == '\n') {
+				label += "\\n";
+				continue;
+			}
+			label += c;
+		}
+		label += '"';
+		return label;
+	}
+
+	const std::vector<double>& MetricsRegistry::LatencyBounds()
+	{
+		static const std::vector<double> bounds = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+		return bounds;
+	}
+
+	MetricsRegistry::Family* MetricsRegistry::FindFamily(const std::string& name, const std::string& help, const char* type)
+	{
+		Family& family = m_Families[name];
+		if (family.type.empty()) {
+			family.type = type;
+			family.help = help;
+		}
+		if (family.type != type) {
+			ImGuiLogManager::AddLog("Metrics", "Metric " + name + " is already registered as a " + family.type, LogSeverity::Error);
+			return nullptr;
+		}
+		return &family;
+	}
+
+	MetricCounter* MetricsRegistry::GetCounter(const std::string& name, const std::string& help, const std::string& labels)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		Family* family = FindFamily(name, help, "counter");
+		if (!family)
+			return new MetricCounter(); // Still counts, just never exported
+		MetricCounter*& counter = family->counters[labels];
+		if (!counter)
+			counter = new MetricCounter();
+		return counter;
+	}
+
+	MetricHistogram* MetricsRegistry::GetHistogram(const std::string& name, const std::string& help, const std::string& labels, const std::vector<double>& bounds)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		Family* family = FindFamily(name, help, "histogram");
+		if (!family)
+			return new MetricHistogram(bounds);
+		MetricHistogram*& histogram = family->histograms[labels];
+		if (!histogram)
+			histogram = new MetricHistogram(bounds);
+		return histogram;
+	}
+
+	int MetricsRegistry::AddGauge(const std::string& name, const std::string& help, const std::string& labels, std::function<double()> read)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		Family* family = FindFamily(name, help, "gauge");
+		if (!family)
+			return -1;
+		int id = m_NextGaugeId++;
+		family->gauges[id] = { labels, std::move(read) };
+		m_GaugeNames[id] = name;
+		return id;
+	}
+
+	void MetricsRegistry::RemoveGauge(int id)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_GaugeNames.find(id);
+		if (it == m_GaugeNames.end())
+			return;
+		m_Families[it->second].gauges.erase(id);
+		m_GaugeNames.erase(it);
+	}
+
+	void MetricsRegistry::WritePrometheus(std::string& out)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		MetricHistogram::Snapshot snapshot;
+		for (const auto& [name, family] : m_Families) {
+			if (family.counters.empty() && family.histograms.empty() && family.gauges.empty())
+				continue;
+			out += "# HELP " + name + " " + family.help + "\n";
+			out += "# TYPE " + name + " " + family.type + "\n";
+			for (const auto& [labels, counter] : family.counters) {
+				AppendSample(out, name, labels, "");
+				out += std::to_string(counter->Read());
+				out += '\n';
+			}
+			for (const auto& [id, gauge] : family.gauges) {
+				AppendSample(out, name, gauge.first, "");
+				AppendNumber(out, gauge.second());
+				out += '\n';
+			}
+			for (const auto& [labels, histogram] : family.histograms) {
+				histogram->Read(snapshot);
+				uint64_t cumulative = 0;
+				for (size_t i = 0; i < snapshot.counts.size(); ++i) {
+					cumulative += snapshot.counts[i];
+					std::string le = "le=\"";
+					if (i < snapshot.bounds.size()) {
+						char bound[32];
+						snprintf(bound, sizeof(bound), "%g", snapshot.bounds[i]);
+						le += bound;
+					}
+					else {
+						le += "+Inf";
+					}
+					le += '"';
+					AppendSample(out, name + "_bucket", labels, le);
+					out += std::to_string(cumulative);
+					out += '\n';
+				}
+				AppendSample(out, name + "_sum", labels, "");
+				AppendNumber(out, snapshot.sumSeconds);
+				out += '\n';
+				AppendSample(out, name + "_count", labels, "");
+				out += std::to_string(cumulative);
+				out += '\n';
+			}
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace NomBotCore {
+	// Every metric keeps this many cache line sized shards and a thread always adds to the same one, so
+	// threads only share a line when there are more of them than shards. Reads sum all the shards.
+	constexpr int MetricShards = 16;
+	constexpr int MetricMaxBuckets = 16;
+
+	int NextMetricShard();
+	inline int MetricShardIndex()
+	{
+		thread_local int shard = NextMetricShard();
+		return shard;
+	}
+
+	class MetricCounter {
+	public:
+		void Add(uint64_t value = 1) { m_Shards[MetricShardIndex()].value.fetch_add(value, std::memory_order_relaxed); }
+		uint64_t Read() const;
+	private:
+		struct alignas(64) Shard {
+			std::atomic<uint64_t> value{ 0 };
+		};
+		Shard m_Shards[MetricShards];
+	};
+
+	// Durations only, Prometheus sees them in seconds
+	class MetricHistogram {
+	public:
+		struct Snapshot {
+			std::vector<double> bounds; // Upper bounds in seconds, the +Inf bucket is implied
+			std::vector<uint64_t> counts; // Not cumulative, one more than bounds
+			double sumSeconds = 0;
+			uint64_t count = 0;
+		};
+
+		// bounds are upper bounds in seconds, ascending, at most MetricMaxBuckets of them
+		explicit MetricHistogram(const std::vector<double>& bounds);
+		void ObserveMicros(int64_t micros);
+		void Read(Snapshot& out) const;
+	private:
+		struct alignas(64) Shard {
+			std::atomic<uint64_t> buckets[MetricMaxBuckets + 1] = {};
+			std::atomic<uint64_t> sumMicros{ 0 };
+		};
+		int64_t m_BoundsMicros[MetricMaxBuckets] = {};
+		int m_BoundCount = 0;
+		Shard m_Shards[MetricShards];
+	};
+
+	// Formats one name="value" pair, join several with commas
+	std::string MetricLabel(const char* name, const std::string& value);
+
+	// Process wide set of metrics, written out in the Prometheus text format by WritePrometheus. Counters and
+	// histograms are created on first use and never freed, so callers look one up once and keep the pointer.
+	class MetricsRegistry {
+	public:
+		static MetricCounter* GetCounter(const std::string& name, const std::string& help, const std::string& labels = "");
+		static MetricHistogram* GetHistogram(const std::string& name, const std::string& help, const std::string& labels = "",
+			const std::vector<double>& bounds = LatencyBounds());
+		// read runs on the scraping thread, under the registry lock. Returns an id for RemoveGauge.
+		static int AddGauge(const std::string& name, const std::string& help, const std::string& labels, std::function<double()> read);
+		// Once this returns the gauge's read function is not running and won't be called again
+		static void RemoveGauge(int id);
+
+		static void WritePrometheus(std::string& out);
+		// 0.5 ms to 10 s
+		static const std::vector<double>& LatencyBounds();
+	private:
+		struct Family {
+			std::string type;
+			std::string help;
+			std::map<std::string, MetricCounter*> counters;
+			std::map<std::string, MetricHistogram*> histograms;
+			std::map<int, std::pair<std::string, std::function<double()>>> gauges;
+		};
+
+		static Family* FindFamily(const std::string& name, const std::string& help, const char* type);
+
+		static std::mutex m_Mutex;
+		static std::map<std::string, Family> m_Families;
+		static std::map<int, std::string> m_GaugeNames;
+		static int m_NextGaugeId;
+	};
+}
+#endif
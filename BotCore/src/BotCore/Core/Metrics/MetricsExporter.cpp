@@ -0,0 +1,223 @@
+#include "nompch.h"
+#include "MetricsExporter.h"
+#include "../../Networking/NomSocketManager.h"
+#include "../../Networking/SocketStats.h"
+#include "../Logging/ImGuiLog.h"
+#include <algorithm>
+
+namespace NomBotCore {
+	namespace {
+		const char* ListenerName = "MetricsListener";
+
+		const char* SocketErrorName(int type)
+		{
+			switch (static_cast<SocketErrorType>(type)) {
+			case SocketErrorType::Connect:      return "connect";
+			case SocketErrorType::TlsHandshake: return "tls_handshake";
+			case SocketErrorType::Send:         return "send";
+			case SocketErrorType::Receive:      return "receive";
+			case SocketErrorType::Timeout:      return "timeout";
+			default:                            return "unknown";
+			}
+		}
+	}
+
+	MetricsExporter::MetricsExporter(NomSocketManager& socketManager, const MetricsExporterConfig& config)
+		: m_Config(config), m_SocketManager(socketManager)
+	{
+	}
+
+	MetricsExporter::~MetricsExporter()
+	{
+		Stop();
+	}
+
+	int MetricsExporter::Start()
+	{
+		if (m_Running)
+			return 0;
+		if (m_SocketManager.CreateSocket(ListenerName, 1, 1) != 0
+			|| m_SocketManager.BindSocket(ListenerName, m_Config.address.c_str(), m_Config.port) != 0
+			|| m_SocketManager.Listen(ListenerName, SOMAXCONN) != 0) {
+			ImGuiLogManager::AddLog("Metrics", "Failed to listen on " + m_Config.address + ":" + std::to_string(m_Config.port), LogSeverity::Error);
+			m_SocketManager.RemoveSocket(ListenerName);
+			return -1;
+		}
+		ImGuiLogManager::AddLog("Metrics", "Serving metrics on http://" + m_Config.address + ":" + std::to_string(m_Config.port) + "/metrics", LogSeverity::Info);
+		m_Running = true;
+		m_Thread = std::thread(&MetricsExporter::ThreadFunc, this);
+		return 0;
+	}
+
+	void MetricsExporter::Stop()
+	{
+		if (!m_Running)
+			return;
+		m_Running = false;
+		if (m_Thread.joinable())
+			m_Thread.join();
+		// Only our own sockets, the manager belongs to the bot
+		RemoveClients();
+		m_SocketManager.RemoveSocket(ListenerName);
+	}
+
+	void MetricsExporter::ThreadFunc()
+	{
+		std::vector<std::string> watched;
+		std::vector<SocketWait> writable;
+		std::vector<Client*> writers;
+		std::vector<std::string> ready;
+		std::vector<size_t> writableReady;
+		while (m_Running) {
+			watched.clear();
+			writable.clear();
+			writers.clear();
+			ready.clear();
+			writableReady.clear();
+			int timeoutMs = m_Config.pollIntervalMs;
+			auto now = std::chrono::steady_clock::now();
+			if (static_cast<int>(m_Clients.size()) < m_Config.maxClients)
+				watched.push_back(ListenerName);
+			for (auto& client : m_Clients) {
+				if (client.response.empty()) {
+					watched.push_back(client.name);
+					continue;
+				}
+				SocketWait wait;
+				wait.socket = m_SocketManager.GetConnectedSocket(client.name.c_str());
+				wait.write = true;
+				writable.push_back(wait);
+				writers.push_back(&client);
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(client.deadline - now).count();
+				timeoutMs = static_cast<int>(std::clamp<long long>(left, 0, timeoutMs));
+			}
+			if (m_SocketManager.WaitSockets(watched, writable, timeoutMs, ready, writableReady) < 0)
+				continue;
+			std::vector<std::string> done;
+			for (size_t index : writableReady) {
+				if (FlushClient(*writers[index]))
+					done.push_back(writers[index]->name);
+			}
+			// Past their deadline, whether or not select saw them
+			now = std::chrono::steady_clock::now();
+			for (Client* client : writers) {
+				if (client->deadline <= now && std::find(done.begin(), done.end(), client->name) == done.end()) {
+					m_SocketManager.RemoveSocket(client->name.c_str());
+					done.push_back(client->name);
+				}
+			}
+			for (const auto& name : ready) {
+				if (name == ListenerName) {
+					AcceptClient();
+					continue;
+				}
+				for (auto& client : m_Clients) {
+					if (client.name == name) {
+						if (ServeClient(client))
+							done.push_back(name);
+						break;
+					}
+				}
+			}
+			m_Clients.erase(std::remove_if(m_Clients.begin(), m_Clients.end(), [&done](const Client& client) {
+				return std::find(done.begin(), done.end(), client.name) != done.end();
+			}), m_Clients.end());
+		}
+	}
+
+	void MetricsExporter::AcceptClient()
+	{
+		Client client;
+		client.name = "MetricsClient" + std::to_string(m_NextClient++);
+		char clientAddress[INET6_ADDRSTRLEN];
+		int clientPort = 0;
+		if (m_SocketManager.AcceptConnection(ListenerName, client.name.c_str(), clientAddress, &clientPort) != 0)
+			return;
+		if (m_SocketManager.SetNonBlocking(client.name.c_str(), true) != 0) {
+			m_SocketManager.RemoveSocket(client.name.c_str());
+			return;
+		}
+		m_Clients.push_back(std::move(client));
+	}
+
+	bool MetricsExporter::ServeClient(Client& client)
+	{
+		char buffer[2048];
+		int bytesReceived = m_SocketManager.ReceiveData(client.name.c_str(), buffer, sizeof(buffer));
+		if (bytesReceived == NomSocketManager::WouldBlock)
+			return false;
+		if (bytesReceived <= 0) {
+			m_SocketManager.RemoveSocket(client.name.c_str());
+			return true;
+		}
+		client.request.append(buffer, bytesReceived);
+		if (client.request.find("\r\n\r\n") == std::string::npos) {
+			if (client.request.size() < MaxRequestBytes)
+				return false;
+			Respond(client, "431 Request Header Fields Too Large", "");
+			return FlushClient(client);
+		}
+
+		if (client.request.compare(0, 13, "GET /metrics ") == 0 || client.request.compare(0, 13, "GET /metrics?") == 0) {
+			std::string body;
+			body.reserve(16 * 1024);
+			MetricsRegistry::WritePrometheus(body);
+			AppendSocketStats(body);
+			Respond(client, "200 OK", body);
+		}
+		else {
+			Respond(client, "404 Not Found", "Metrics are served at /metrics\n");
+		}
+		// Most responses fit in the send buffer, the rest goes out as the socket turns writable
+		return FlushClient(client);
+	}
+
+	bool MetricsExporter::FlushClient(Client& client)
+	{
+		while (client.sent < client.response.size()) {
+			int bytesSent = m_SocketManager.SendData(client.name.c_str(), client.response.data() + client.sent, static_cast<int>(client.response.size() - client.sent));
+			if (bytesSent == NomSocketManager::WouldBlock)
+				return false;
+			if (bytesSent <= 0)
+				break;
+			client.sent += bytesSent;
+		}
+		m_SocketManager.RemoveSocket(client.name.c_str());
+		return true;
+	}
+
+	void MetricsExporter::Respond(Client& client, const char* status, const std::string& body)
+	{
+		client.response = std::string("HTTP/1.1 ") + status + "\r\n"
+			"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n"
+			"Connection: close\r\n\r\n" + body;
+		client.sent = 0;
+		client.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SendTimeoutMs);
+	}
+
+	void MetricsExporter::RemoveClients()
+	{
+		for (const auto& client : m_Clients)
+			m_SocketManager.RemoveSocket(client.name.c_str());
+		m_Clients.clear();
+	}
+
+	void MetricsExporter::AppendSocketStats(std::string& out)
+	{
+		// Totals only, per socket series would grow without bound as connections come and go
+		SocketStatsSnapshot totals;
+		SocketStatsRegistry::SnapshotTotals(totals);
+		out += "# HELP nom_socket_sent_bytes_total Bytes sent over every socket.\n# TYPE nom_socket_sent_bytes_total counter\n";
+		out += "nom_socket_sent_bytes_total " + std::to_string(totals.bytesSent) + "\n";
+		out += "# HELP nom_socket_received_bytes_total Bytes received over every socket.\n# TYPE nom_socket_received_bytes_total counter\n";
+		out += "nom_socket_received_bytes_total " + std::to_string(totals.bytesReceived) + "\n";
+		out += "# HELP nom_socket_connects_total Outgoing connections established.\n# TYPE nom_socket_connects_total counter\n";
+		out += "nom_socket_connects_total " + std::to_string(totals.connects) + "\n";
+		out += "# HELP nom_socket_tls_handshakes_total TLS handshakes completed.\n# TYPE nom_socket_tls_handshakes_total counter\n";
+		out += "nom_socket_tls_handshakes_total " + std::to_string(totals.tlsHandshakes) + "\n";
+		out += "# HELP nom_socket_errors_total Socket errors by operation.\n# TYPE nom_socket_errors_total counter\n";
+		for (int i = 0; i < static_cast<int>(SocketErrorType::Count); ++i)
+			out += "nom_socket_errors_total{" + MetricLabel("type", SocketErrorName(i)) + "} " + std::to_string(totals.errors[i]) + "\n";
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef __METRICS_EXPORTER_H__
+#define __METRICS_EXPORTER_H__
+#include "Metrics.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NomBotCore {
+	class NomSocketManager;
+
+	struct MetricsExporterConfig {
+		std::string address = "127.0.0.1"; // Keep it on loopback, the endpoint has no authentication
+		int port = 9464;
+		int maxClients = 8; // Further connections wait in the listen backlog
+		int pollIntervalMs = 200; // Also how long Stop can take
+	};
+
+	// Serves GET /metrics in the Prometheus text format from its own thread, over the socket manager the bot
+	// already has. One select loop reads requests and writes the queued responses of every open scrape
+	// without blocking, so a slow client never stalls the others.
+	class MetricsExporter {
+	public:
+		// socketManager must outlive the exporter
+		MetricsExporter(NomSocketManager& socketManager, const MetricsExporterConfig& config = MetricsExporterConfig());
+		~MetricsExporter();
+
+		int Start();
+		void Stop();
+	private:
+		struct Client {
+			std::string name;
+			std::string request;
+			std::string response; // Queued once the request is complete, the client is only read until then
+			size_t sent = 0;
+			std::chrono::steady_clock::time_point deadline;
+		};
+
+		void ThreadFunc();
+		void AcceptClient();
+		// These return true once the client is done with and removed
+		bool ServeClient(Client& client);
+		bool FlushClient(Client& client);
+		void Respond(Client& client, const char* status, const std::string& body);
+		void RemoveClients();
+		static void AppendSocketStats(std::string& out);
+
+		MetricsExporterConfig m_Config;
+		NomSocketManager& m_SocketManager;
+		std::vector<Client> m_Clients;
+		std::thread m_Thread;
+		std::atomic<bool> m_Running{ false };
+		uint64_t m_NextClient = 0;
+
+		static constexpr size_t MaxRequestBytes = 8192;
+		static constexpr int SendTimeoutMs = 2000; // A scraper that stops reading is cut off after this
+	};
+}
+#endif
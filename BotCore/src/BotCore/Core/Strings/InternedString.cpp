@@ -0,0 +1,70 @@
+#include "nompch.h"
+#include "InternedString.h"
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace NomBotCore {
+	namespace {
+		struct InternTable {
+			std::shared_mutex mutex;
+			// A deque never moves what it holds, so the keys and every handed out pointer stay valid
+			std::deque<std::string> storage;
+			std::unordered_map<std::string_view, const std::string*> index;
+			size_t bytes = 0;
+		};
+
+		InternTable& GetTable()
+		{
+			static InternTable* table = new InternTable(); // Never destroyed, events may outlive static destructors
+			return *table;
+		}
+	}
+
+	InternedString::InternedString(std::string_view text)
+	{
+		if (text.empty())
+			return;
+		InternTable& table = GetTable();
+		{
+			// Almost every value has been seen before
+			std::shared_lock<std::shared_mutex> lock(table.mutex);
+			auto it = table.index.find(text);
+			if (it != table.index.end()) {
+				m_Value = it->second;
+				return;
+			}
+		}
+		std::unique_lock<std::shared_mutex> lock(table.mutex);
+		auto it = table.index.find(text);
+		if (it != table.index.end()) {
+			m_Value = it->second;
+			return;
+		}
+		const std::string& stored = table.storage.emplace_back(text);
+		table.index.emplace(std::string_view(stored), &stored);
+		table.bytes += stored.size();
+		m_Value = &stored;
+	}
+
+	const std::string& InternedString::EmptyString()
+	{
+		static const std::string empty;
+		return empty;
+	}
+
+	size_t InternedString::GetInternedCount()
+	{
+		InternTable& table = GetTable();
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		return table.storage.size();
+	}
+
+	size_t InternedString::GetInternedBytes()
+	{
+		InternTable& table = GetTable();
+		std::shared_lock<std::shared_mutex> lock(table.mutex);
+		return table.bytes;
+	}
+}
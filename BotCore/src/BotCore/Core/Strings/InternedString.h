@@ -0,0 +1,54 @@
+#ifndef __INTERNEDSTRING_H__
+#define __INTERNEDSTRING_H__
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <functional>
+#include <cstddef>
+
+namespace NomBotCore {
+	// One pointer into a process wide table that keeps a single copy of every distinct string interned. Meant for
+	// values with few distinct ones that repeat across events, channel ids and logins, reward ids and titles,
+	// statuses, tiers. Copies and comparisons cost a pointer, interning costs a hash lookup. Nothing is ever
+	// removed from the table, so never intern anything that keeps growing with the audience, such as viewer
+	// ids and names, or anything unique per event such as message ids or chat text.
+	class InternedString {
+	public:
+		InternedString() = default;
+		explicit InternedString(std::string_view text);
+
+		std::string_view View() const { return m_Value ? std::string_view(*m_Value) : std::string_view(); }
+		// Valid for the life of the process
+		const std::string& Str() const { return m_Value ? *m_Value : EmptyString(); }
+		const char* c_str() const { return Str().c_str(); }
+		size_t size() const { return m_Value ? m_Value->size() : 0; }
+		bool empty() const { return m_Value == nullptr; }
+
+		// Equal text is the same entry
+		bool operator==(const InternedString& other) const { return m_Value == other.m_Value; }
+		bool operator!=(const InternedString& other) const { return m_Value != other.m_Value; }
+		bool operator==(std::string_view text) const { return View() == text; }
+		bool operator!=(std::string_view text) const { return View() != text; }
+
+		size_t Hash() const { return std::hash<const void*>()(m_Value); }
+
+		// Strings in the table and the bytes they hold
+		static size_t GetInternedCount();
+		static size_t GetInternedBytes();
+	private:
+		static const std::string& EmptyString();
+
+		const std::string* m_Value = nullptr; // Null for the empty string
+	};
+
+	inline std::ostream& operator<<(std::ostream& out, const InternedString& text) { return out << text.View(); }
+}
+
+namespace std {
+	template<>
+	struct hash<NomBotCore::InternedString> {
+		size_t operator()(const NomBotCore::InternedString& text) const { return text.Hash(); }
+	};
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __SMALLSTRING_H__
+#define __SMALLSTRING_H__
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+namespace NomBotCore {
+	// Read only text kept inline up to Capacity - 1 characters and on the heap past that, always null terminated.
+	// Sized for per event values such as message ids, a UUID fits inline in SmallString<44> and copying one is a
+	// memcpy instead of an allocation. Longer text pays one exact size allocation.
+	template<size_t Capacity>
+	class SmallString {
+		static_assert(Capacity > sizeof(char*), "The heap pointer lives in the inline buffer");
+	public:
+		SmallString() { m_Data[0] = '\0'; }
+		explicit SmallString(std::string_view text) { Assign(text); }
+		SmallString(const SmallString& other) { Assign(other.View()); }
+		SmallString(SmallString&& other) noexcept { Steal(other); }
+		~SmallString() { Release(); }
+
+		SmallString& operator=(const SmallString& other)
+		{
+			if (this != &other) {
+				Release();
+				Assign(other.View());
+			}
+			return *this;
+		}
+		SmallString& operator=(SmallString&& other) noexcept
+		{
+			if (this != &other) {
+				Release();
+				Steal(other);
+			}
+			return *this;
+		}
+		SmallString& operator=(std::string_view text)
+		{
+			// text may point into this string
+			SmallString copy(text);
+			return *this = std::move(copy);
+		}
+
+		const char* c_str() const { return IsInline() ? m_Data : HeapData(); }
+		std::string_view View() const { return std::string_view(c_str(), m_Size); }
+		std::string Str() const { return std::string(View()); }
+		size_t size() const { return m_Size; }
+		bool empty() const { return m_Size == 0; }
+		bool IsInline() const { return IsInlineSize(m_Size); }
+
+		bool operator==(const SmallString& other) const { return View() == other.View(); }
+		bool operator!=(const SmallString& other) const { return View() != other.View(); }
+		bool operator==(std::string_view text) const { return View() == text; }
+		bool operator!=(std::string_view text) const { return View() != text; }
+	private:
+		char* HeapData() const
+		{
+			char* data;
+			memcpy(&data, m_Data, sizeof(data));
+			return data;
+		}
+
+		void Assign(std::string_view text)
+		{
+			m_Size = static_cast<uint32_t>(text.size());
+			char* target = m_Data;
+			if (!IsInline()) {
+				target = new char[m_Size + 1];
+				memcpy(m_Data, &target, sizeof(target));
+			}
+			memcpy(target, text.data(), m_Size);
+			target[m_Size] = '\0';
+		}
+
+		void Steal(SmallString& other)
+		{
+			memcpy(m_Data, other.m_Data, IsInlineSize(other.m_Size) ? other.m_Size + 1 : sizeof(char*));
+			m_Size = other.m_Size;
+			other.m_Data[0] = '\0';
+			other.m_Size = 0;
+		}
+
+		void Release()
+		{
+			if (!IsInline())
+				delete[] HeapData();
+			m_Data[0] = '\0';
+			m_Size = 0;
+		}
+
+		static bool IsInlineSize(uint32_t size) { return size < Capacity; }
+
+		alignas(char*) char m_Data[Capacity]; // The text, or a pointer to it once it doesn't fit
+		uint32_t m_Size = 0;
+	};
+
+	template<size_t Capacity>
+	std::ostream& operator<<(std::ostream& out, const SmallString<Capacity>& text) { return out << text.View(); }
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include "nompch.h"
+#include "TimerWheel.h"
+#include "../Tracing/Trace.h"
+
+namespace NomBotCore {
+	TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slotCount)
+		: m_Tick(tick), m_Slots(slotCount > 0 ? slotCount : 1)
+	{
+		m_Fired = MetricsRegistry::GetCounter("nom_timers_fired_total", "Timers that ran their callback.");
+		m_PendingGauge = MetricsRegistry::AddGauge("nom_timers_pending", "Timers scheduled and not yet fired or cancelled.", "", [this] {
+			return static_cast<double>(GetPendingCount());
+		});
+	}
+
+	TimerWheel::~TimerWheel()
+	{
+		MetricsRegistry::RemoveGauge(m_PendingGauge);
+		Stop();
+	}
+
+	void TimerWheel::Start()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Running)
+			return;
+		m_Running = true;
+		m_Thread = std::thread(&TimerWheel::ThreadFunc, this);
+	}
+
+	void TimerWheel::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Running)
+				return;
+			m_Running = false;
+		}
+		m_Wake.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+
+	uint64_t TimerWheel::TickAt(std::chrono::steady_clock::time_point time) const
+	{
+		if (time <= m_Epoch)
+			return 0;
+		return static_cast<uint64_t>((time - m_Epoch) / m_Tick);
+	}
+
+	TimerWheel::TimerId TimerWheel::Schedule(std::chrono::milliseconds delay, std::function<void()> callback)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		// Rounded up, a timer never fires early
+		uint64_t tick = TickAt(std::chrono::steady_clock::now() + delay) + 1;
+		if (tick <= m_DoneTick)
+			tick = m_DoneTick + 1;
+		TimerId id = m_NextId++;
+		m_Timers[id] = { tick, std::move(callback) };
+		m_Slots[tick % m_Slots.size()].push_back(id);
+		// The thread only sleeps without a deadline while nothing is scheduled
+		if (m_Timers.size() == 1)
+			m_Wake.notify_all();
+		return id;
+	}
+
+	bool TimerWheel::Cancel(TimerId id)
+	{
+		if (id == 0)
+			return false;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_Timers.erase(id) > 0)
+			return true;
+		if (m_Firing == id && std::this_thread::get_id() != m_ThreadId)
+			m_FireDone.wait(lock, [this, id] { return m_Firing != id; });
+		return false;
+	}
+
+	size_t TimerWheel::GetPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Timers.size();
+	}
+
+	void TimerWheel::ThreadFunc()
+	{
+		Trace::SetThreadName("Timers");
+		std::vector<TimerId> due;
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_ThreadId = std::this_thread::get_id();
+		while (m_Running) {
+			uint64_t nowTick = TickAt(std::chrono::steady_clock::now());
+			if (m_Timers.empty()) {
+				m_DoneTick = std::max(m_DoneTick, nowTick);
+				m_Wake.wait(lock);
+				continue;
+			}
+			if (m_DoneTick >= nowTick) {
+				m_Wake.wait_until(lock, m_Epoch + m_Tick * (m_DoneTick + 1));
+				continue;
+			}
+			// One tick at a time after a late wakeup, a timer is only found on the tick its slot comes up
+			while (m_DoneTick < nowTick) {
+				++m_DoneTick;
+				std::vector<TimerId>& slot = m_Slots[m_DoneTick % m_Slots.size()];
+				for (size_t i = 0; i < slot.size();) {
+					auto it = m_Timers.find(slot[i]);
+					if (it != m_Timers.end() && it->second.tick > m_DoneTick) {
+						++i; // A later rotation
+						continue;
+					}
+					if (it != m_Timers.end())
+						due.push_back(it->first);
+					slot[i] = slot.back();
+					slot.pop_back();
+				}
+			}
+			for (TimerId id : due) {
+				// Stays cancellable until it runs, an earlier callback may cancel it
+				auto it = m_Timers.find(id);
+				if (it == m_Timers.end())
+					continue;
+				std::function<void()> callback = std::move(it->second.callback);
+				m_Timers.erase(it);
+				m_Firing = id;
+				lock.unlock();
+				callback();
+				m_Fired->Add();
+				lock.lock();
+				m_Firing = 0;
+				m_FireDone.notify_all();
+			}
+			due.clear();
+		}
+		m_ThreadId = std::thread::id();
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+#include "../Metrics/Metrics.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+namespace NomBotCore {
+	// One thread for every deadline in the process: token refreshes, keepalive deadlines, retries. Timers hash
+	// into SlotCount slots by the tick they are due on, so Schedule and Cancel cost the same with ten timers or
+	// ten thousand, and a slot is only looked at once per tick. Delays longer than a rotation wait in their slot
+	// until their tick comes around. Callbacks run one after another on the wheel thread and must be short,
+	// anything that blocks belongs on a worker or in a Spawn.
+	class TimerWheel {
+	public:
+		using TimerId = uint64_t; // 0 is never a timer
+
+		TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(50), size_t slotCount = 512);
+		~TimerWheel();
+
+		void Start();
+		// Waits for a running callback, pending timers fire after the next Start
+		void Stop();
+		// Fires callback once, no earlier than delay from now and at most a tick later while the wheel keeps up
+		TimerId Schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+		// False when the timer already fired or never existed. Waits while its callback runs, unless called from it.
+		bool Cancel(TimerId id);
+		size_t GetPendingCount();
+	private:
+		struct Timer {
+			uint64_t tick = 0; // Due on this tick, counted from m_Epoch
+			std::function<void()> callback;
+		};
+
+		void ThreadFunc();
+		uint64_t TickAt(std::chrono::steady_clock::time_point time) const;
+
+		const std::chrono::steady_clock::duration m_Tick;
+		std::thread m_Thread;
+		std::thread::id m_ThreadId;
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_FireDone;
+		bool m_Running = false;
+		std::chrono::steady_clock::time_point m_Epoch = std::chrono::steady_clock::now();
+		uint64_t m_DoneTick = 0; // Every slot up to this tick has been looked at
+		std::vector<std::vector<TimerId>> m_Slots; // Cancelled ids stay until their slot comes up
+		std::unordered_map<TimerId, Timer> m_Timers;
+		TimerId m_NextId = 1;
+		TimerId m_Firing = 0;
+		MetricCounter* m_Fired = nullptr;
+		int m_PendingGauge = 0;
+	};
+}
+
+#endif
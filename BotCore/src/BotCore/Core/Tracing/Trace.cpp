@@ -0,0 +1,205 @@
+#include "nompch.h"
+#include "Trace.h"
+#include "../Logging/ImGuiLog.h"
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <algorithm>
+
+namespace NomBotCore {
+	std::atomic<bool> Trace::m_Enabled{ false };
+
+	namespace {
+		struct TraceBuffer {
+			struct Slot {
+				std::atomic<const char*> name{ nullptr };
+				std::atomic<int64_t> startNs{ 0 };
+				std::atomic<int64_t> durationNs{ 0 };
+				std::atomic<uint32_t> depth{ 0 };
+			};
+
+			std::atomic<bool> inUse{ false };
+			std::atomic<int> id{ 0 };
+			std::atomic<uint64_t> first{ 0 }; // Spans before this belong to a thread that has exited
+			std::atomic<uint64_t> head{ 0 };
+			std::string name; // Guarded by g_NameMutex
+			Slot slots[Trace::RingCapacity];
+		};
+
+		// Allocated the first time a thread needs one and reused after it exits, never freed
+		std::atomic<TraceBuffer*> g_Buffers[Trace::MaxThreads];
+		std::atomic<int> g_NextThreadId{ 1 };
+		std::mutex g_NameMutex;
+
+		struct ThreadTrace {
+			TraceBuffer* buffer = nullptr;
+			bool claimed = false;
+			uint32_t depth = 0;
+			std::string name; // Kept until a buffer is claimed, threads that never trace don't take one
+
+			TraceBuffer* Get()
+			{
+				if (claimed)
+					return buffer;
+				claimed = true;
+				for (auto& slot : g_Buffers) {
+					TraceBuffer* candidate = slot.load(std::memory_order_acquire);
+					if (!candidate) {
+						TraceBuffer* created = new TraceBuffer();
+						if (slot.compare_exchange_strong(candidate, created, std::memory_order_acq_rel))
+							candidate = created;
+						else
+							delete created;
+					}
+					bool expected = false;
+					if (candidate->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+						buffer = candidate;
+						int id = g_NextThreadId.fetch_add(1, std::memory_order_relaxed);
+						{
+							std::lock_guard<std::mutex> lock(g_NameMutex);
+							buffer->name = name.empty() ? "Thread " + std::to_string(id) : name;
+						}
+						buffer->first.store(buffer->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+						buffer->id.store(id, std::memory_order_release);
+						break;
+					}
+				}
+				return buffer;
+			}
+
+			~ThreadTrace()
+			{
+				if (buffer)
+					buffer->inUse.store(false, std::memory_order_release);
+			}
+		};
+		thread_local ThreadTrace t_Trace;
+
+		void AppendJsonString(std::string& out, const std::string& text)
+		{
+			out += '"';
+			for (char c : text) {
+				if (c == '"' || c == '\\')
+					out += '\\';
+				if (static_cast<unsigned char>(c) >= 0x20)
+					out += c;
+			}
+			out += '"';
+		}
+	}
+
+	int64_t Trace::Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Trace::SetThreadName(const char* name)
+	{
+		t_Trace.name = name;
+		if (!t_Trace.buffer)
+			return;
+		std::lock_guard<std::mutex> lock(g_NameMutex);
+		t_Trace.buffer->name = name;
+	}
+
+	uint32_t Trace::EnterScope()
+	{
+		return t_Trace.depth++;
+	}
+
+	void Trace::Record(const char* name, int64_t startNs, int64_t endNs, uint32_t depth)
+	{
+		t_Trace.depth = depth;
+		TraceBuffer* buffer = t_Trace.Get();
+		if (!buffer)
+			return;
+		uint64_t head = buffer->head.load(std::memory_order_relaxed);
+		TraceBuffer::Slot& slot = buffer->slots[head & (RingCapacity - 1)];
+		slot.name.store(name, std::memory_order_relaxed);
+		slot.startNs.store(startNs, std::memory_order_relaxed);
+		slot.durationNs.store(endNs - startNs, std::memory_order_relaxed);
+		slot.depth.store(depth, std::memory_order_relaxed);
+		buffer->head.store(head + 1, std::memory_order_release);
+	}
+
+	void Trace::Snapshot(std::vector<TraceThreadSnapshot>& out)
+	{
+		for (auto& slot : g_Buffers) {
+			TraceBuffer* buffer = slot.load(std::memory_order_acquire);
+			if (!buffer || buffer->id.load(std::memory_order_acquire) == 0)
+				continue;
+			TraceThreadSnapshot thread;
+			thread.id = buffer->id.load(std::memory_order_relaxed);
+			{
+				std::lock_guard<std::mutex> lock(g_NameMutex);
+				thread.name = buffer->name;
+			}
+			uint64_t head = buffer->head.load(std::memory_order_acquire);
+			uint64_t from = std::max(buffer->first.load(std::memory_order_relaxed), head > RingCapacity ? head - RingCapacity : 0);
+			thread.events.reserve(static_cast<size_t>(head - from));
+			for (uint64_t i = from; i < head; ++i) {
+				const TraceBuffer::Slot& source = buffer->slots[i & (RingCapacity - 1)];
+				TraceEvent event;
+				event.name = source.name.load(std::memory_order_relaxed);
+				event.startNs = source.startNs.load(std::memory_order_relaxed);
+				event.durationNs = source.durationNs.load(std::memory_order_relaxed);
+				event.depth = source.depth.load(std::memory_order_relaxed);
+				thread.events.push_back(event);
+			}
+			// The owner may have lapped the oldest slots while they were copied, anything at or behind the slot
+			// it is writing now can't be trusted
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t headAfter = buffer->head.load(std::memory_order_relaxed);
+			if (headAfter >= RingCapacity && headAfter - RingCapacity + 1 > from) {
+				size_t stale = static_cast<size_t>(std::min<uint64_t>(headAfter - RingCapacity + 1 - from, thread.events.size()));
+				thread.events.erase(thread.events.begin(), thread.events.begin() + stale);
+			}
+			out.push_back(std::move(thread));
+		}
+	}
+
+	int Trace::ExportChromeJson(const std::string& path)
+	{
+		std::vector<TraceThreadSnapshot> threads;
+		Snapshot(threads);
+		int64_t origin = INT64_MAX;
+		for (const auto& thread : threads) {
+			for (const auto& event : thread.events)
+				origin = std::min(origin, event.startNs);
+		}
+
+		std::string json = "{\"traceEvents\":[\n";
+		bool first = true;
+		char number[96];
+		for (const auto& thread : threads) {
+			if (!first) json += ",\n";
+			first = false;
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread.id) + ",\"args\":{\"name\":";
+			AppendJsonString(json, thread.name);
+			json += "}}";
+			for (const auto& event : thread.events) {
+				json += ",\n{\"name\":";
+				AppendJsonString(json, event.name ? event.name : "");
+				// Chrome wants microseconds, keep the nanoseconds as fractions
+				snprintf(number, sizeof(number), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+					(event.startNs - origin) / 1000.0, event.durationNs / 1000.0, thread.id);
+				json += number;
+			}
+		}
+		json += "\n]}\n";
+
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file) {
+			ImGuiLogManager::AddLog("Trace", "Failed to open trace file: " + path, LogSeverity::Error);
+			return -1;
+		}
+		size_t written = std::fwrite(json.data(), 1, json.size(), file);
+		std::fclose(file);
+		if (written != json.size()) {
+			ImGuiLogManager::AddLog("Trace", "Failed to write trace file: " + path, LogSeverity::Error);
+			return -1;
+		}
+		ImGuiLogManager::AddLog("Trace", "Wrote trace to " + path, LogSeverity::Info);
+		return 0;
+	}
+}
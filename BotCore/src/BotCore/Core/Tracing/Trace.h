@@ -0,0 +1,74 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define NOM_TRACE_CONCAT_INNER(a, b) a##b
+#define NOM_TRACE_CONCAT(a, b) NOM_TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing block as a span named name, which must be a string literal.
+// While tracing is off this is one relaxed load.
+#define NOM_TRACE_SCOPE(name) ::NomBotCore::TraceScope NOM_TRACE_CONCAT(nomTraceScope, __LINE__)(name)
+
+namespace NomBotCore {
+	struct TraceEvent {
+		const char* name = nullptr;
+		int64_t startNs = 0; // steady_clock
+		int64_t durationNs = 0;
+		uint32_t depth = 0; // Spans open around it on the same thread
+	};
+
+	struct TraceThreadSnapshot {
+		std::string name;
+		int id = 0;
+		std::vector<TraceEvent> events; // In the order spans ended
+	};
+
+	// Spans are recorded into a fixed ring per thread, so recording never takes a lock or allocates and only the
+	// last RingCapacity spans of each thread are kept. Readers copy the rings and drop whatever was overwritten.
+	class Trace {
+	public:
+		static constexpr uint64_t RingCapacity = 16384; // Must be a power of two
+		static constexpr int MaxThreads = 64; // Threads past this are not traced
+
+		static bool IsEnabled() { return m_Enabled.load(std::memory_order_relaxed); }
+		static void SetEnabled(bool enabled) { m_Enabled.store(enabled, std::memory_order_relaxed); }
+		// Names the calling thread in exports and the timeline
+		static void SetThreadName(const char* name);
+		static int64_t Now();
+
+		static uint32_t EnterScope();
+		static void Record(const char* name, int64_t startNs, int64_t endNs, uint32_t depth);
+
+		static void Snapshot(std::vector<TraceThreadSnapshot>& out);
+		// Writes every buffered span as Chrome trace event JSON, which chrome://tracing and Perfetto open
+		static int ExportChromeJson(const std::string& path);
+	private:
+		static std::atomic<bool> m_Enabled;
+	};
+
+	class TraceScope {
+	public:
+		explicit TraceScope(const char* name)
+		{
+			if (Trace::IsEnabled()) {
+				m_Name = name;
+				m_Depth = Trace::EnterScope();
+				m_Start = Trace::Now();
+			}
+		}
+		~TraceScope()
+		{
+			if (m_Name)
+				Trace::Record(m_Name, m_Start, Trace::Now(), m_Depth);
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+	private:
+		const char* m_Name = nullptr;
+		int64_t m_Start = 0;
+		uint32_t m_Depth = 0;
+	};
+}
+#endif
@@ -0,0 +1,311 @@
+#include "nompch.h"
+#include "DnsResolver.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <algorithm>
+
+namespace NomBotCore {
+	namespace {
+		std::string LowerHost(const std::string& host)
+		{
+			std::string lower = host;
+			std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return lower;
+		}
+
+		bool FamilyMatches(const SocketAddress& address, int family)
+		{
+			if (family == 1)
+				return address.storage.ss_family == AF_INET;
+			if (family == 2)
+				return address.storage.ss_family == AF_INET6;
+			return true;
+		}
+	}
+
+	DnsResolver::DnsResolver(int workerCount)
+		: m_Lookup(&DnsResolver::SystemLookup)
+	{
+		for (int i = 0; i < (workerCount > 0 ? workerCount : 1); ++i)
+			m_Workers.emplace_back(&DnsResolver::WorkerLoop, this);
+	}
+
+	DnsResolver::~DnsResolver()
+	{
+		Stop();
+	}
+
+	void DnsResolver::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Running)
+				return;
+			m_Running = false;
+		}
+		m_Condition.notify_all();
+		for (auto& worker : m_Workers) {
+			if (worker.joinable())
+				worker.join();
+		}
+		m_Workers.clear();
+		std::vector<Callback> waiters;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (auto& entry : m_Cache) {
+				for (auto& waiter : entry.second.waiters)
+					waiters.push_back(std::move(waiter));
+				entry.second.waiters.clear();
+				entry.second.resolving = false;
+			}
+			m_Queue.clear();
+		}
+		std::vector<SocketAddress> none;
+		for (auto& waiter : waiters)
+			waiter(-1, none);
+	}
+
+	std::string DnsResolver::CacheKey(const std::string& host, int family)
+	{
+		return LowerHost(host) + "/" + std::to_string(family);
+	}
+
+	void DnsResolver::ResolveAsync(const std::string& host, int family, Callback callback)
+	{
+		std::vector<SocketAddress> addresses;
+		if (FindOverride(host, family, addresses)) {
+			if (callback)
+				callback(0, addresses);
+			return;
+		}
+
+		int result = -1;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Running) {
+				CacheEntry& entry = m_Cache[CacheKey(host, family)];
+				auto now = std::chrono::steady_clock::now();
+				if (entry.expires > now) {
+					// Fresh enough to answer; refresh ahead of expiry so callers never wait on a hot name
+					if (entry.result == 0 && !entry.resolving && entry.expires - now < std::chrono::milliseconds(PrefetchWindowMs)) {
+						entry.resolving = true;
+						m_Queue.emplace_back(host, family);
+						m_Condition.notify_one();
+					}
+					result = entry.result;
+					addresses = entry.addresses;
+				}
+				else {
+					if (callback)
+						entry.waiters.push_back(std::move(callback));
+					if (!entry.resolving) {
+						entry.resolving = true;
+						m_Queue.emplace_back(host, family);
+						m_Condition.notify_one();
+					}
+					return;
+				}
+			}
+		}
+		if (callback)
+			callback(result, addresses);
+	}
+
+	int DnsResolver::Resolve(const std::string& host, int family, std::vector<SocketAddress>& addresses, int timeoutMs)
+	{
+		// Shared so an abandoned wait can't leave the callback writing to a dead frame
+		auto done = std::make_shared<std::promise<std::pair<int, std::vector<SocketAddress>>>>();
+		auto result = done->get_future();
+		ResolveAsync(host, family, [done](int status, const std::vector<SocketAddress>& resolved) {
+			done->set_value({ status, resolved });
+		});
+		if (result.wait_for(std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0)) != std::future_status::ready) {
+			ImGuiLogManager::AddLog("Dns", "Timed out resolving " + host, LogSeverity::Warning);
+			return -1;
+		}
+		auto answer = result.get();
+		addresses = std::move(answer.second);
+		return answer.first;
+	}
+
+	void DnsResolver::Prefetch(const std::string& host, int family)
+	{
+		ResolveAsync(host, family, nullptr);
+	}
+
+	void DnsResolver::WorkerLoop()
+	{
+		while (true) {
+			std::pair<std::string, int> job;
+			LookupFunction lookup;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this] { return !m_Running || !m_Queue.empty(); });
+				if (!m_Running)
+					return;
+				job = std::move(m_Queue.front());
+				m_Queue.pop_front();
+				lookup = m_Lookup;
+			}
+
+			std::vector<SocketAddress> addresses;
+			int result = lookup(job.first, job.second, addresses);
+			if (result == 0 && addresses.empty())
+				result = -1;
+
+			std::vector<Callback> waiters;
+			std::vector<SocketAddress> answer;
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				CacheEntry& entry = m_Cache[CacheKey(job.first, job.second)];
+				auto now = std::chrono::steady_clock::now();
+				entry.resolving = false;
+				if (result == 0) {
+					entry.result = 0;
+					entry.addresses = std::move(addresses);
+					entry.expires = now + std::chrono::milliseconds(PositiveTtlMs);
+				}
+				else if (entry.result == 0 && entry.expires > now) {
+					// A failed prefetch keeps the answer we already have until it really expires
+					ImGuiLogManager::AddLog("Dns", "Refresh of " + job.first + " failed, keeping cached addresses.", LogSeverity::Warning);
+				}
+				else {
+					entry.result = -1;
+					entry.addresses.clear();
+					entry.expires = now + std::chrono::milliseconds(NegativeTtlMs);
+					ImGuiLogManager::AddLog("Dns", "Failed to resolve " + job.first, LogSeverity::Error);
+				}
+				waiters.swap(entry.waiters);
+				result = entry.result;
+				answer = entry.addresses;
+			}
+			for (auto& waiter : waiters)
+				waiter(result, answer);
+		}
+	}
+
+	void DnsResolver::SetHostOverride(const std::string& host, const std::vector<std::string>& addresses)
+	{
+		std::vector<SocketAddress> parsed;
+		for (const auto& text : addresses) {
+			SocketAddress address;
+			if (ParseAddress(text, address) == 0)
+				parsed.push_back(address);
+			else
+				ImGuiLogManager::AddLog("Dns", "Ignoring invalid override address " + text + " for " + host, LogSeverity::Warning);
+		}
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (parsed.empty())
+			m_Overrides.erase(LowerHost(host));
+		else
+			m_Overrides[LowerHost(host)] = std::move(parsed);
+	}
+
+	void DnsResolver::ClearHostOverrides()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Overrides.clear();
+	}
+
+	int DnsResolver::LoadHostsFile(const char* path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			ImGuiLogManager::AddLog("Dns", std::string("Could not open hosts file ") + path, LogSeverity::Error);
+			return -1;
+		}
+		std::map<std::string, std::vector<SocketAddress>> loaded;
+		std::string line;
+		while (std::getline(file, line)) {
+			size_t comment = line.find('#');
+			if (comment != std::string::npos)
+				line.erase(comment);
+			std::istringstream fields(line);
+			std::string addressText;
+			SocketAddress address;
+			if (!(fields >> addressText) || ParseAddress(addressText, address) != 0)
+				continue;
+			std::string host;
+			while (fields >> host)
+				loaded[LowerHost(host)].push_back(address);
+		}
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& entry : loaded)
+			m_Overrides[entry.first] = std::move(entry.second);
+		ImGuiLogManager::AddLog("Dns", "Loaded " + std::to_string(loaded.size()) + " host overrides from " + path, LogSeverity::Info);
+		return 0;
+	}
+
+	void DnsResolver::SetLookupFunction(LookupFunction lookup)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Lookup = lookup ? std::move(lookup) : LookupFunction(&DnsResolver::SystemLookup);
+	}
+
+	void DnsResolver::FlushCache()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto it = m_Cache.begin(); it != m_Cache.end();) {
+			// Entries with waiters are finished by the worker that owns them
+			if (it->second.resolving)
+				++it;
+			else
+				it = m_Cache.erase(it);
+		}
+	}
+
+	bool DnsResolver::FindOverride(const std::string& host, int family, std::vector<SocketAddress>& addresses)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto it = m_Overrides.find(LowerHost(host));
+		if (it == m_Overrides.end())
+			return false;
+		addresses.clear();
+		for (const auto& address : it->second) {
+			if (FamilyMatches(address, family))
+				addresses.push_back(address);
+		}
+		return !addresses.empty();
+	}
+
+	int DnsResolver::SystemLookup(const std::string& host, int family, std::vector<SocketAddress>& addresses)
+	{
+		struct addrinfo hints = { 0 }, * res = nullptr;
+		hints.ai_family = family == 1 ? AF_INET : (family == 2 ? AF_INET6 : AF_UNSPEC);
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || res == nullptr)
+			return -1;
+		addresses.clear();
+		for (addrinfo* ai = res; ai != nullptr; ai = ai->ai_next) {
+			if (ai->ai_addrlen > sizeof(sockaddr_storage) || (ai->ai_family != AF_INET && ai->ai_family != AF_INET6))
+				continue;
+			SocketAddress address;
+			memcpy(&address.storage, ai->ai_addr, ai->ai_addrlen);
+			address.length = static_cast<int>(ai->ai_addrlen);
+			addresses.push_back(address);
+		}
+		freeaddrinfo(res);
+		return addresses.empty() ? -1 : 0;
+	}
+
+	int DnsResolver::ParseAddress(const std::string& text, SocketAddress& address)
+	{
+		address = SocketAddress();
+		sockaddr_in* in4 = (sockaddr_in*)&address.storage;
+		if (inet_pton(AF_INET, text.c_str(), &in4->sin_addr) == 1) {
+			in4->sin_family = AF_INET;
+			address.length = sizeof(sockaddr_in);
+			return 0;
+		}
+		sockaddr_in6* in6 = (sockaddr_in6*)&address.storage;
+		if (inet_pton(AF_INET6, text.c_str(), &in6->sin6_addr) == 1) {
+			in6->sin6_family = AF_INET6;
+			address.length = sizeof(sockaddr_in6);
+			return 0;
+		}
+		return -1;
+	}
+}
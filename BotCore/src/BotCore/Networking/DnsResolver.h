@@ -0,0 +1,73 @@
+#ifndef __DNSRESOLVER_H__
+#define __DNSRESOLVER_H__
+
+#include "NomSocketManager.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+
+namespace NomBotCore {
+	// Resolves host names on a small worker pool so socket threads never sit in getaddrinfo.
+	// Answers are cached per host and family: successes for PositiveTtlMs, failures for NegativeTtlMs.
+	// A hit inside the last PrefetchWindowMs of its lifetime is served and refreshed in the background.
+	// Returned addresses carry port 0, the caller fills in the port it connects to.
+	class DnsResolver {
+	public:
+		// family: 0 = any, 1 = IPv4, 2 = IPv6 (same values as NomSocket::protocol). Returns 0 on success.
+		using LookupFunction = std::function<int(const std::string& host, int family, std::vector<SocketAddress>& addresses)>;
+		using Callback = std::function<void(int result, const std::vector<SocketAddress>& addresses)>;
+
+		DnsResolver(int workerCount = 2);
+		~DnsResolver();
+
+		void ResolveAsync(const std::string& host, int family, Callback callback);
+		int Resolve(const std::string& host, int family, std::vector<SocketAddress>& addresses, int timeoutMs);
+		void Prefetch(const std::string& host, int family = 0);
+		void Stop();
+
+		// Overrides bypass the cache and the lookup function, like entries in a hosts file
+		void SetHostOverride(const std::string& host, const std::vector<std::string>& addresses);
+		void ClearHostOverrides();
+		int LoadHostsFile(const char* path);
+		// Replaces getaddrinfo, e.g. with a local stub resolver
+		void SetLookupFunction(LookupFunction lookup);
+		void FlushCache();
+
+		static int SystemLookup(const std::string& host, int family, std::vector<SocketAddress>& addresses);
+		static int ParseAddress(const std::string& text, SocketAddress& address);
+	private:
+		struct CacheEntry {
+			int result = -1;
+			std::vector<SocketAddress> addresses;
+			std::chrono::steady_clock::time_point expires;
+			bool resolving = false;
+			std::vector<Callback> waiters;
+		};
+
+		void WorkerLoop();
+		bool FindOverride(const std::string& host, int family, std::vector<SocketAddress>& addresses);
+		static std::string CacheKey(const std::string& host, int family);
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		std::vector<std::thread> m_Workers;
+		std::atomic<bool> m_Running{ true };
+		std::deque<std::pair<std::string, int>> m_Queue;
+		std::map<std::string, CacheEntry> m_Cache;
+		std::map<std::string, std::vector<SocketAddress>> m_Overrides;
+		LookupFunction m_Lookup;
+
+		static constexpr int PositiveTtlMs = 300000;
+		static constexpr int NegativeTtlMs = 5000;
+		static constexpr int PrefetchWindowMs = 30000;
+	};
+}
+
+#endif
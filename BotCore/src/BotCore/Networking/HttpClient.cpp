@@ -0,0 +1,396 @@
+#include "nompch.h"
+#include "HttpClient.h"
+#include "../Core/Logging/ImGuiLog.h"
+
+namespace NomBotCore {
+	namespace {
+		int MillisecondsUntil(std::chrono::steady_clock::time_point deadline)
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			return remaining > 0 ? static_cast<int>(remaining) : 0;
+		}
+
+		// Safe to send twice, RFC 9110 section 9.2.2. A POST such as a token exchange or a subscription create is not.
+		bool IsIdempotent(const std::string& method)
+		{
+			return method == "GET" || method == "HEAD" || method == "PUT" || method == "DELETE" || method == "OPTIONS" || method == "TRACE";
+		}
+
+		bool AllIdempotent(const std::vector<const HttpRequest*>& requests, size_t from)
+		{
+			for (size_t i = from; i < requests.size(); ++i) {
+				if (!IsIdempotent(requests[i]->method))
+					return false;
+			}
+			return true;
+		}
+	}
+
+	HttpClient::HttpClient(NomSocketManager& socketManager, int maxConnectionsPerHost)
+		: m_SocketManager(socketManager), m_MaxConnectionsPerHost(maxConnectionsPerHost > 0 ? maxConnectionsPerHost : 1)
+	{
+	}
+
+	HttpClient::~HttpClient()
+	{
+		std::lock_guard<std::mutex> lock(m_PoolMutex);
+		for (auto& connection : m_Connections) {
+			Disconnect(connection.get());
+			m_SocketManager.RemoveSocket(connection->socketName.c_str());
+		}
+		m_Connections.clear();
+	}
+
+	int HttpClient::Send(const HttpRequest& request, HttpResponse& response)
+	{
+		std::vector<HttpResponse> responses;
+		if (Execute({ &request }, responses) != 1)
+			return -1;
+		response = std::move(responses[0]);
+		return 0;
+	}
+
+	int HttpClient::SendPipelined(const std::vector<HttpRequest>& requests, std::vector<HttpResponse>& responses)
+	{
+		std::vector<const HttpRequest*> pending;
+		pending.reserve(requests.size());
+		for (const auto& request : requests) {
+			if (request.host != requests[0].host || request.port != requests[0].port || request.useTls != requests[0].useTls) {
+				ImGuiLogManager::AddLog("Http", "Pipelined requests must share host, port and scheme.", LogSeverity::Error);
+				responses.clear();
+				return 0;
+			}
+			pending.push_back(&request);
+		}
+		return Execute(pending, responses);
+	}
+
+	int HttpClient::Execute(const std::vector<const HttpRequest*>& requests, std::vector<HttpResponse>& responses)
+	{
+		responses.clear();
+		responses.resize(requests.size());
+		size_t completed = 0;
+		bool retried = false;
+		while (completed < requests.size()) {
+			const HttpRequest& first = *requests[completed];
+			PooledConnection* connection = Acquire(first, std::chrono::steady_clock::now() + std::chrono::milliseconds(first.timeoutMs));
+			if (!connection) {
+				ImGuiLogManager::AddLog("Http", "Timed out waiting for a pooled connection to " + first.host, LogSeverity::Error);
+				break;
+			}
+			bool reused = connection->connected;
+			if (EnsureConnected(connection) != 0 || SetNonBlocking(connection, false) != 0) {
+				Release(connection, false);
+				break;
+			}
+
+			std::string wire;
+			for (size_t i = completed; i < requests.size(); ++i)
+				wire += SerializeRequest(*requests[i]);
+			auto sendTime = std::chrono::steady_clock::now();
+			m_SocketManager.SetSocketTimeout(connection->socketName.c_str(), first.timeoutMs);
+			int bytesSent = m_SocketManager.SendData(connection->socketName.c_str(), wire.data(), static_cast<int>(wire.size()), connection->useTls);
+			if (bytesSent != static_cast<int>(wire.size())) {
+				Release(connection, false);
+				if (reused && !retried && AllIdempotent(requests, completed)) {
+					retried = true;
+					continue;
+				}
+				ImGuiLogManager::AddLog("Http", "Failed to send request to " + first.host, LogSeverity::Error);
+				break;
+			}
+
+			size_t startCompleted = completed;
+			int readResult = 0;
+			bool reusable = true;
+			for (size_t i = completed; i < requests.size(); ++i) {
+				auto deadline = sendTime + std::chrono::milliseconds(requests[i]->timeoutMs);
+				readResult = ReadResponse(connection, *requests[i], deadline, responses[i]);
+				if (readResult != 0)
+					break;
+				completed++;
+				if (!responses[i].IsKeepAlive()) {
+					// Anything pipelined after this response was dropped by the server, resend it on a new connection
+					reusable = false;
+					break;
+				}
+			}
+			Release(connection, reusable && readResult == 0);
+			if (readResult == 0)
+				continue;
+			// A keep-alive connection the server already closed fails before any response byte arrives. The server
+			// may still have acted on the request, so only requests that are safe to repeat are sent again.
+			if (readResult == -1 && reused && completed == startCompleted && !retried && AllIdempotent(requests, completed)) {
+				retried = true;
+				continue;
+			}
+			break;
+		}
+		return static_cast<int>(completed);
+	}
+
+	Task<int> HttpClient::SendAsync(SocketEventLoop& loop, HttpRequest request, HttpResponse& response)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(request.timeoutMs);
+		bool retried = false;
+		while (true) {
+			PooledConnection* connection = co_await AcquireAwaiter(*this, loop, request);
+			if (!connection) {
+				ImGuiLogManager::AddLog("Http", "No pooled connection to " + request.host + " available.", LogSeverity::Error);
+				co_return -1;
+			}
+			if (MillisecondsUntil(deadline) <= 0) {
+				Release(connection, true);
+				ImGuiLogManager::AddLog("Http", "Timed out waiting for a pooled connection to " + request.host, LogSeverity::Error);
+				co_return -1;
+			}
+			bool reused = connection->connected;
+			if (!connection->connected) {
+				connection->parser.Reset();
+				if (co_await m_SocketManager.ConnectSocketAsync(loop, connection->socketName, connection->host, connection->port, connection->useTls) != 0) {
+					ImGuiLogManager::AddLog("Http", "Failed to connect to " + connection->host + ":" + std::to_string(connection->port), LogSeverity::Error);
+					Release(connection, false);
+					co_return -1;
+				}
+				connection->connected = true;
+				connection->nonBlocking = true;
+			}
+			else if (SetNonBlocking(connection, true) != 0) {
+				Release(connection, false);
+				co_return -1;
+			}
+
+			if (co_await m_SocketManager.SendAllAsync(loop, connection->socketName, SerializeRequest(request), connection->useTls, deadline) != 0) {
+				Release(connection, false);
+				if (reused && !retried && IsIdempotent(request.method)) {
+					retried = true;
+					continue;
+				}
+				ImGuiLogManager::AddLog("Http", "Failed to send request to " + request.host, LogSeverity::Error);
+				co_return -1;
+			}
+			int readResult = co_await ReadResponseAsync(loop, connection, request, deadline, response);
+			Release(connection, readResult == 0 && response.IsKeepAlive());
+			if (readResult == 0)
+				co_return 0;
+			// As in Execute, a closed keep-alive connection only gets a request that is safe to repeat again
+			if (readResult == -1 && reused && !retried && IsIdempotent(request.method)) {
+				retried = true;
+				continue;
+			}
+			co_return -1;
+		}
+	}
+
+	bool HttpClient::AcquireAwaiter::await_suspend(std::coroutine_handle<> handle)
+	{
+		std::lock_guard<std::mutex> lock(m_Client.m_PoolMutex);
+		bool full = false;
+		m_Connection = m_Client.TryAcquire(m_Request, full);
+		if (m_Connection || !full)
+			return false;
+		m_Client.m_PoolWaiters.push_back({ &m_Request, handle, &m_Connection, &m_Loop, &m_Posted });
+		return true;
+	}
+
+	HttpClient::PooledConnection* HttpClient::Acquire(const HttpRequest& request, std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock<std::mutex> lock(m_PoolMutex);
+		while (true) {
+			bool full = false;
+			PooledConnection* connection = TryAcquire(request, full);
+			if (connection || !full)
+				return connection;
+			if (m_PoolCondition.wait_until(lock, deadline) == std::cv_status::timeout)
+				return nullptr;
+		}
+	}
+
+	HttpClient::PooledConnection* HttpClient::TryAcquire(const HttpRequest& request, bool& full)
+	{
+		full = false;
+		PooledConnection* idle = nullptr;
+		int hostConnections = 0;
+		for (auto& connection : m_Connections) {
+			if (connection->host != request.host || connection->port != request.port || connection->useTls != request.useTls)
+				continue;
+			hostConnections++;
+			if (!connection->inUse && (!idle || (connection->connected && !idle->connected)))
+				idle = connection.get();
+		}
+		if (idle) {
+			auto idleFor = std::chrono::steady_clock::now() - idle->lastUsed;
+			if (idle->connected && idleFor > std::chrono::milliseconds(IdleTimeoutMs))
+				Disconnect(idle);
+			idle->inUse = true;
+			return idle;
+		}
+		if (hostConnections < m_MaxConnectionsPerHost) {
+			auto connection = std::make_unique<PooledConnection>();
+			connection->socketName = "HttpClient/" + std::to_string(m_NextConnectionId++);
+			connection->host = request.host;
+			connection->port = request.port;
+			connection->useTls = request.useTls;
+			if (m_SocketManager.CreateSocket(connection->socketName.c_str(), 1, 0) != 0)
+				return nullptr;
+			connection->inUse = true;
+			m_Connections.push_back(std::move(connection));
+			return m_Connections.back().get();
+		}
+		full = true;
+		return nullptr;
+	}
+
+	void HttpClient::Release(PooledConnection* connection, bool reusable)
+	{
+		PoolWaiter handover = {};
+		{
+			std::lock_guard<std::mutex> lock(m_PoolMutex);
+			if (!reusable)
+				Disconnect(connection);
+			connection->inUse = false;
+			connection->lastUsed = std::chrono::steady_clock::now();
+			// A waiting SendAsync takes it over before a blocking Send wakes up, it never holds a thread
+			for (auto it = m_PoolWaiters.begin(); it != m_PoolWaiters.end(); ++it) {
+				bool full = false;
+				PooledConnection* next = TryAcquire(*it->request, full);
+				if (next || !full) {
+					*it->connection = next;
+					handover = *it;
+					m_PoolWaiters.erase(it);
+					break;
+				}
+			}
+		}
+		m_PoolCondition.notify_all();
+		// Release may run on a blocking Send's thread, which must not carry on with someone else's coroutine
+		if (handover.handle && !handover.loop->AddSocketWait({}, 0, handover.handle, handover.posted))
+			handover.handle.resume();
+	}
+
+	int HttpClient::SetNonBlocking(PooledConnection* connection, bool nonBlocking)
+	{
+		if (connection->nonBlocking == nonBlocking)
+			return 0;
+		if (m_SocketManager.SetNonBlocking(connection->socketName.c_str(), nonBlocking) != 0)
+			return -1;
+		connection->nonBlocking = nonBlocking;
+		return 0;
+	}
+
+	void HttpClient::Disconnect(PooledConnection* connection)
+	{
+		if (connection->connected) {
+			m_SocketManager.CloseSocket(connection->socketName.c_str());
+			connection->connected = false;
+		}
+		connection->parser.Reset();
+	}
+
+	void HttpClient::CloseIdleConnections(int idleMs)
+	{
+		std::lock_guard<std::mutex> lock(m_PoolMutex);
+		auto now = std::chrono::steady_clock::now();
+		for (auto& connection : m_Connections) {
+			if (!connection->inUse && connection->connected && now - connection->lastUsed >= std::chrono::milliseconds(idleMs))
+				Disconnect(connection.get());
+		}
+	}
+
+	int HttpClient::EnsureConnected(PooledConnection* connection)
+	{
+		if (connection->connected)
+			return 0;
+		connection->parser.Reset();
+		if (m_SocketManager.ConnectSocket(connection->socketName.c_str(), connection->host.c_str(), connection->port, connection->useTls) != 0) {
+			ImGuiLogManager::AddLog("Http", "Failed to connect to " + connection->host + ":" + std::to_string(connection->port), LogSeverity::Error);
+			return -1;
+		}
+		connection->connected = true;
+		connection->nonBlocking = false;
+		return 0;
+	}
+
+	int HttpClient::ReadResponse(PooledConnection* connection, const HttpRequest& request, std::chrono::steady_clock::time_point deadline, HttpResponse& response)
+	{
+		HttpResponseParser& parser = connection->parser;
+		parser.SetExpectNoBody(request.method == "HEAD");
+		while (true) {
+			int result = parser.Parse();
+			if (result == 1)
+				return parser.TakeResponse(response);
+			if (result < 0) {
+				ImGuiLogManager::AddLog("Http", "Malformed response from " + request.host + ": " + parser.GetError(), LogSeverity::Error);
+				return -1;
+			}
+			int remainingMs = MillisecondsUntil(deadline);
+			if (remainingMs <= 0) {
+				ImGuiLogManager::AddLog("Http", "Request " + request.method + " " + request.path + " timed out.", LogSeverity::Error);
+				return -2;
+			}
+			m_SocketManager.SetSocketTimeout(connection->socketName.c_str(), remainingMs);
+			char* buffer = parser.PrepareWrite(ReadChunkSize);
+			int bytesReceived = m_SocketManager.ReceiveData(connection->socketName.c_str(), buffer, static_cast<int>(ReadChunkSize), connection->useTls);
+			if (bytesReceived == 0) {
+				if (parser.MarkEndOfStream() == 1)
+					continue;
+				return -1;
+			}
+			if (bytesReceived < 0)
+				return MillisecondsUntil(deadline) <= 0 ? -2 : -1;
+			parser.CommitWrite(bytesReceived);
+		}
+	}
+
+	Task<int> HttpClient::ReadResponseAsync(SocketEventLoop& loop, PooledConnection* connection, const HttpRequest& request, std::chrono::steady_clock::time_point deadline, HttpResponse& response)
+	{
+		HttpResponseParser& parser = connection->parser;
+		parser.SetExpectNoBody(request.method == "HEAD");
+		while (true) {
+			int result = parser.Parse();
+			if (result == 1)
+				co_return parser.TakeResponse(response);
+			if (result < 0) {
+				ImGuiLogManager::AddLog("Http", "Malformed response from " + request.host + ": " + parser.GetError(), LogSeverity::Error);
+				co_return -1;
+			}
+			if (MillisecondsUntil(deadline) <= 0) {
+				ImGuiLogManager::AddLog("Http", "Request " + request.method + " " + request.path + " timed out.", LogSeverity::Error);
+				co_return -2;
+			}
+			char* buffer = parser.PrepareWrite(ReadChunkSize);
+			int bytesReceived = co_await m_SocketManager.ReceiveAsync(loop, connection->socketName, buffer, static_cast<int>(ReadChunkSize), connection->useTls, deadline);
+			if (bytesReceived == 0) {
+				if (parser.MarkEndOfStream() == 1)
+					continue;
+				co_return -1;
+			}
+			if (bytesReceived < 0)
+				co_return MillisecondsUntil(deadline) <= 0 ? -2 : -1;
+			parser.CommitWrite(bytesReceived);
+		}
+	}
+
+	std::string HttpClient::SerializeRequest(const HttpRequest& request)
+	{
+		std::string wire;
+		wire.reserve(256 + request.body.size());
+		wire += request.method + " " + request.path + " HTTP/1.1\r\n";
+		// The port is part of Host unless it is the scheme's default, RFC 9112 section 3.2
+		wire += "Host: " + request.host;
+		if (request.port != (request.useTls ? 443 : 80))
+			wire += ":" + std::to_string(request.port);
+		wire += "\r\n";
+		bool hasContentLength = false;
+		for (const auto& header : request.headers) {
+			if (HttpHeaderEquals(header.first, "Content-Length"))
+				hasContentLength = true;
+			wire += header.first + ": " + header.second + "\r\n";
+		}
+		if (!hasContentLength && (!request.body.empty() || request.method == "POST" || request.method == "PUT" || request.method == "PATCH"))
+			wire += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+		wire += "\r\n";
+		wire += request.body;
+		return wire;
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef __HTTPCLIENT_H__
+#define __HTTPCLIENT_H__
+
+#include "NomSocketManager.h"
+#include "HttpParser.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <coroutine>
+
+namespace NomBotCore {
+	struct HttpRequest {
+		std::string method = "GET";
+		std::string host;
+		int port = 443;
+		bool useTls = true;
+		std::string path = "/";
+		std::vector<std::pair<std::string, std::string>> headers;
+		std::string body;
+		int timeoutMs = 10000; // Covers waiting for a pooled connection, sending and receiving the whole response
+	};
+
+	class HttpClient {
+	public:
+		HttpClient(NomSocketManager& socketManager, int maxConnectionsPerHost = 2);
+		~HttpClient();
+
+		// Returns 0 when a complete response was received, whatever its status code. When a reused keep-alive
+		// connection turns out to be closed, idempotent requests are sent again on a new one, others fail.
+		int Send(const HttpRequest& request, HttpResponse& response);
+		// Writes all requests back to back on one pooled connection, then reads the responses in order.
+		// All requests must target the same host, port and scheme. Returns the number of completed responses.
+		int SendPipelined(const std::vector<HttpRequest>& requests, std::vector<HttpResponse>& responses);
+		// Send for coroutines, it never blocks the calling thread. Connecting, sending and reading wait on loop,
+		// so the coroutine resumes on the loop's thread. With the host's pool full it takes over the next
+		// connection released, also resumed on loop whichever thread released it, and the timeout is checked
+		// once it has one.
+		Task<int> SendAsync(SocketEventLoop& loop, HttpRequest request, HttpResponse& response);
+		void CloseIdleConnections(int idleMs = 0);
+	private:
+		struct PooledConnection {
+			std::string socketName;
+			std::string host;
+			int port = 0;
+			bool useTls = true;
+			bool connected = false;
+			bool inUse = false;
+			bool nonBlocking = false; // Connected by SendAsync, or switched for it
+			HttpResponseParser parser;
+			std::chrono::steady_clock::time_point lastUsed;
+		};
+
+		// A SendAsync waiting for a connection to request's host, Release hands it one and resumes it on loop
+		struct PoolWaiter {
+			const HttpRequest* request;
+			std::coroutine_handle<> handle;
+			PooledConnection** connection;
+			SocketEventLoop* loop;
+			int* posted;
+		};
+
+		class AcquireAwaiter {
+		public:
+			AcquireAwaiter(HttpClient& client, SocketEventLoop& loop, const HttpRequest& request) : m_Client(client), m_Loop(loop), m_Request(request) {}
+			bool await_ready() const noexcept { return false; }
+			bool await_suspend(std::coroutine_handle<> handle);
+			PooledConnection* await_resume() const { return m_Connection; }
+		private:
+			HttpClient& m_Client;
+			SocketEventLoop& m_Loop;
+			const HttpRequest& m_Request;
+			PooledConnection* m_Connection = nullptr;
+			int m_Posted = 0;
+		};
+
+		int Execute(const std::vector<const HttpRequest*>& requests, std::vector<HttpResponse>& responses);
+		PooledConnection* Acquire(const HttpRequest& request, std::chrono::steady_clock::time_point deadline);
+		// Under m_PoolMutex. Null with full set when the host already has all its connections in use.
+		PooledConnection* TryAcquire(const HttpRequest& request, bool& full);
+		int SetNonBlocking(PooledConnection* connection, bool nonBlocking);
+		void Release(PooledConnection* connection, bool reusable);
+		void Disconnect(PooledConnection* connection);
+		int EnsureConnected(PooledConnection* connection);
+		int ReadResponse(PooledConnection* connection, const HttpRequest& request, std::chrono::steady_clock::time_point deadline, HttpResponse& response);
+		Task<int> ReadResponseAsync(SocketEventLoop& loop, PooledConnection* connection, const HttpRequest& request, std::chrono::steady_clock::time_point deadline, HttpResponse& response);
+		static std::string SerializeRequest(const HttpRequest& request);
+
+		NomSocketManager& m_SocketManager;
+		int m_MaxConnectionsPerHost;
+		std::mutex m_PoolMutex;
+		std::condition_variable m_PoolCondition;
+		std::vector<std::unique_ptr<PooledConnection>> m_Connections;
+		std::deque<PoolWaiter> m_PoolWaiters;
+		int m_NextConnectionId = 0;
+
+		static constexpr int IdleTimeoutMs = 30000;
+		static constexpr size_t ReadChunkSize = 16 * 1024;
+	};
+}
+
+#endif
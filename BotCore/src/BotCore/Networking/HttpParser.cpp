@@ -0,0 +1,362 @@
+#include "nompch.h"
+#include "HttpParser.h"
+#include <algorithm>
+#include <cstring>
+
+namespace NomBotCore {
+	namespace {
+		char ToLower(char c)
+		{
+			return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+
+		std::string_view Trim(std::string_view value)
+		{
+			while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+			while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+			return value;
+		}
+
+		// Case-insensitive search for a comma separated token such as "chunked" or "close"
+		bool ContainsToken(std::string_view value, std::string_view token)
+		{
+			while (!value.empty()) {
+				size_t comma = value.find(',');
+				std::string_view item = Trim(value.substr(0, comma));
+				if (HttpHeaderEquals(item, token))
+					return true;
+				if (comma == std::string_view::npos)
+					break;
+				value.remove_prefix(comma + 1);
+			}
+			return false;
+		}
+	}
+
+	bool HttpHeaderEquals(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); ++i) {
+			if (ToLower(a[i]) != ToLower(b[i]))
+				return false;
+		}
+		return true;
+	}
+
+	std::string_view HttpResponse::GetHeader(std::string_view name) const
+	{
+		for (const auto& header : m_Headers) {
+			if (HttpHeaderEquals(View(header.nameOffset, header.nameLength), name))
+				return View(header.valueOffset, header.valueLength);
+		}
+		return std::string_view();
+	}
+
+	HttpResponseParser::HttpResponseParser()
+	{
+		m_Buffer.resize(4096);
+	}
+
+	char* HttpResponseParser::PrepareWrite(size_t minSpace)
+	{
+		if (m_Buffer.size() < m_Size + minSpace)
+			m_Buffer.resize(std::max(m_Size + minSpace, m_Buffer.size() * 2));
+		return m_Buffer.data() + m_Size;
+	}
+
+	void HttpResponseParser::CommitWrite(size_t length)
+	{
+		m_Size = std::min(m_Size + length, m_Buffer.size());
+	}
+
+	int HttpResponseParser::Feed(const char* data, size_t length)
+	{
+		memcpy(PrepareWrite(length), data, length);
+		CommitWrite(length);
+		return Parse();
+	}
+
+	int HttpResponseParser::Fail(const char* reason)
+	{
+		m_State = State::Error;
+		m_Error = reason;
+		return -1;
+	}
+
+	bool HttpResponseParser::ReadLine(size_t& lineStart, size_t& lineLength)
+	{
+		const char* begin = m_Buffer.data() + m_Pos;
+		const char* newline = static_cast<const char*>(memchr(begin, '\n', m_Size - m_Pos));
+		if (!newline)
+			return false;
+		lineStart = m_Pos;
+		lineLength = newline - begin;
+		if (lineLength > 0 && begin[lineLength - 1] == '\r')
+			--lineLength;
+		m_Pos += (newline - begin) + 1;
+		return true;
+	}
+
+	int HttpResponseParser::ParseStatusLine(size_t lineStart, size_t lineLength)
+	{
+		std::string_view line = View(lineStart, lineLength);
+		// "HTTP/1.x SSS Reason"
+		if (line.size() < 12 || line.compare(0, 7, "HTTP/1.") != 0 || line[8] != ' ')
+			return Fail("Malformed HTTP status line.");
+		if (line[7] < '0' || line[7] > '9')
+			return Fail("Malformed HTTP version.");
+		m_VersionMinor = line[7] - '0';
+		int status = 0;
+		for (size_t i = 9; i < 12; ++i) {
+			if (line[i] < '0' || line[i] > '9')
+				return Fail("Malformed HTTP status code.");
+			status = status * 10 + (line[i] - '0');
+		}
+		m_StatusCode = status;
+		m_ReasonOffset = lineStart + std::min<size_t>(13, lineLength);
+		m_ReasonLength = lineLength > 13 ? lineLength - 13 : 0;
+		return 0;
+	}
+
+	int HttpResponseParser::ParseHeaderLine(size_t lineStart, size_t lineLength)
+	{
+		std::string_view line = View(lineStart, lineLength);
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos || colon == 0 || line[0] == ' ' || line[0] == '\t')
+			return Fail("Malformed HTTP header line.");
+		std::string_view name = Trim(line.substr(0, colon));
+		std::string_view value = Trim(line.substr(colon + 1));
+		HttpHeaderRef ref;
+		ref.nameOffset = name.data() - m_Buffer.data();
+		ref.nameLength = name.size();
+		ref.valueOffset = value.empty() ? lineStart + lineLength : value.data() - m_Buffer.data();
+		ref.valueLength = value.size();
+		m_Headers.push_back(ref);
+		return 0;
+	}
+
+	int HttpResponseParser::BeginBody()
+	{
+		// Interim responses (100 Continue, 103 Early Hints) are dropped and parsing restarts on the real one
+		if (m_StatusCode >= 100 && m_StatusCode < 200 && m_StatusCode != 101) {
+			size_t leftover = m_Size - m_Pos;
+			memmove(m_Buffer.data(), m_Buffer.data() + m_Pos, leftover);
+			m_Size = leftover;
+			m_Pos = 0;
+			m_Headers.clear();
+			m_StatusCode = 0;
+			m_State = State::StatusLine;
+			return 0;
+		}
+
+		std::string_view connection;
+		std::string_view transferEncoding;
+		std::string_view contentLength;
+		for (const auto& header : m_Headers) {
+			std::string_view name = View(header.nameOffset, header.nameLength);
+			std::string_view value = View(header.valueOffset, header.valueLength);
+			if (HttpHeaderEquals(name, "Connection")) connection = value;
+			else if (HttpHeaderEquals(name, "Transfer-Encoding")) transferEncoding = value;
+			else if (HttpHeaderEquals(name, "Content-Length")) contentLength = value;
+		}
+		if (m_VersionMinor == 0)
+			m_KeepAlive = ContainsToken(connection, "keep-alive");
+		else
+			m_KeepAlive = !ContainsToken(connection, "close");
+
+		m_BodyOffset = m_Pos;
+		m_BodyLength = 0;
+		if (m_ExpectNoBody || m_StatusCode == 101 || m_StatusCode == 204 || m_StatusCode == 304) {
+			m_MessageEnd = m_Pos;
+			m_State = State::Complete;
+			return 0;
+		}
+		if (ContainsToken(transferEncoding, "chunked")) {
+			m_State = State::ChunkSize;
+			return 0;
+		}
+		if (!contentLength.empty()) {
+			size_t length = 0;
+			for (char c : contentLength) {
+				if (c < '0' || c > '9')
+					return Fail("Malformed Content-Length header.");
+				length = length * 10 + (c - '0');
+				if (length > MaxBodyBytes)
+					return Fail("HTTP response body exceeds the size limit.");
+			}
+			m_Remaining = length;
+			m_State = State::Body;
+			return 0;
+		}
+		// No framing information, the body runs until the server closes the connection
+		m_KeepAlive = false;
+		m_State = State::UntilClose;
+		return 0;
+	}
+
+	int HttpResponseParser::Parse()
+	{
+		size_t lineStart = 0;
+		size_t lineLength = 0;
+		while (true) {
+			switch (m_State) {
+			case State::StatusLine:
+				if (!ReadLine(lineStart, lineLength))
+					return (m_Size - m_Pos > MaxHeaderBytes) ? Fail("HTTP status line too long.") : 0;
+				if (lineLength == 0)
+					break; // Tolerate stray CRLF between pipelined responses
+				if (ParseStatusLine(lineStart, lineLength) < 0)
+					return -1;
+				m_State = State::Headers;
+				break;
+			case State::Headers:
+				if (!ReadLine(lineStart, lineLength))
+					return (m_Size > MaxHeaderBytes) ? Fail("HTTP headers too large.") : 0;
+				if (lineLength == 0) {
+					if (BeginBody() < 0)
+						return -1;
+				}
+				else if (ParseHeaderLine(lineStart, lineLength) < 0) {
+					return -1;
+				}
+				break;
+			case State::Body:
+				if (m_Size - m_Pos < m_Remaining)
+					return 0;
+				m_Pos += m_Remaining;
+				m_BodyLength = m_Remaining;
+				m_Remaining = 0;
+				m_MessageEnd = m_Pos;
+				m_State = State::Complete;
+				break;
+			case State::ChunkSize: {
+				if (!ReadLine(lineStart, lineLength))
+					return (m_Size - m_Pos > 1024) ? Fail("HTTP chunk size line too long.") : 0;
+				std::string_view line = View(lineStart, lineLength);
+				line = Trim(line.substr(0, line.find(';')));
+				if (line.empty())
+					return Fail("Missing HTTP chunk size.");
+				size_t chunkSize = 0;
+				for (char c : line) {
+					int digit;
+					if (c >= '0' && c <= '9') digit = c - '0';
+					else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+					else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+					else return Fail("Malformed HTTP chunk size.");
+					chunkSize = chunkSize * 16 + digit;
+					if (m_BodyLength + chunkSize > MaxBodyBytes)
+						return Fail("HTTP response body exceeds the size limit.");
+				}
+				m_Remaining = chunkSize;
+				m_State = chunkSize == 0 ? State::Trailers : State::ChunkData;
+				break;
+			}
+			case State::ChunkData: {
+				size_t available = std::min(m_Size - m_Pos, m_Remaining);
+				if (available == 0)
+					return 0;
+				// Decode in place: slide chunk payload down so the body stays contiguous
+				size_t bodyEnd = m_BodyOffset + m_BodyLength;
+				if (bodyEnd != m_Pos)
+					memmove(m_Buffer.data() + bodyEnd, m_Buffer.data() + m_Pos, available);
+				m_BodyLength += available;
+				m_Pos += available;
+				m_Remaining -= available;
+				if (m_Remaining > 0)
+					return 0;
+				m_State = State::ChunkDataEnd;
+				break;
+			}
+			case State::ChunkDataEnd:
+				if (!ReadLine(lineStart, lineLength))
+					return (m_Size - m_Pos > 2) ? Fail("Missing CRLF after HTTP chunk.") : 0;
+				if (lineLength != 0)
+					return Fail("Missing CRLF after HTTP chunk.");
+				m_State = State::ChunkSize;
+				break;
+			case State::Trailers:
+				if (!ReadLine(lineStart, lineLength))
+					return 0;
+				if (lineLength == 0) {
+					m_MessageEnd = m_Pos;
+					m_State = State::Complete;
+				}
+				break;
+			case State::UntilClose:
+				if (m_Size - m_BodyOffset > MaxBodyBytes)
+					return Fail("HTTP response body exceeds the size limit.");
+				m_Pos = m_Size;
+				m_BodyLength = m_Size - m_BodyOffset;
+				return 0;
+			case State::Complete:
+				return 1;
+			case State::Error:
+				return -1;
+			}
+		}
+	}
+
+	int HttpResponseParser::MarkEndOfStream()
+	{
+		if (m_State == State::UntilClose) {
+			m_BodyLength = m_Size - m_BodyOffset;
+			m_MessageEnd = m_Size;
+			m_State = State::Complete;
+			return 1;
+		}
+		if (m_State == State::Complete)
+			return 1;
+		if (m_State == State::StatusLine && m_Size == m_Pos)
+			return 0;
+		return Fail("Connection closed before the HTTP response was complete.");
+	}
+
+	int HttpResponseParser::TakeResponse(HttpResponse& response)
+	{
+		if (m_State != State::Complete)
+			return -1;
+		std::vector<char> leftover(m_Buffer.begin() + m_MessageEnd, m_Buffer.begin() + m_Size);
+		response.m_Raw = std::move(m_Buffer);
+		response.m_Raw.resize(m_MessageEnd);
+		response.m_Headers = std::move(m_Headers);
+		response.m_StatusCode = m_StatusCode;
+		response.m_ReasonOffset = m_ReasonOffset;
+		response.m_ReasonLength = m_ReasonLength;
+		response.m_BodyOffset = m_BodyOffset;
+		response.m_BodyLength = m_BodyLength;
+		response.m_KeepAlive = m_KeepAlive;
+
+		m_Buffer = std::move(leftover);
+		m_Size = m_Buffer.size();
+		if (m_Buffer.size() < 4096)
+			m_Buffer.resize(4096);
+		m_Pos = 0;
+		m_Headers.clear();
+		m_StatusCode = 0;
+		m_BodyOffset = 0;
+		m_BodyLength = 0;
+		m_Remaining = 0;
+		m_MessageEnd = 0;
+		m_KeepAlive = true;
+		m_ExpectNoBody = false;
+		m_State = State::StatusLine;
+		return 0;
+	}
+
+	void HttpResponseParser::Reset()
+	{
+		m_Size = 0;
+		m_Pos = 0;
+		m_Headers.clear();
+		m_StatusCode = 0;
+		m_BodyOffset = 0;
+		m_BodyLength = 0;
+		m_Remaining = 0;
+		m_MessageEnd = 0;
+		m_KeepAlive = true;
+		m_ExpectNoBody = false;
+		m_Error.clear();
+		m_State = State::StatusLine;
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef __HTTPPARSER_H__
+#define __HTTPPARSER_H__
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NomBotCore {
+	// Offsets into the raw response buffer, resolved to views on demand so they survive buffer growth
+	struct HttpHeaderRef {
+		size_t nameOffset;
+		size_t nameLength;
+		size_t valueOffset;
+		size_t valueLength;
+	};
+
+	class HttpResponse {
+	public:
+		int GetStatusCode() const { return m_StatusCode; }
+		std::string_view GetReason() const { return View(m_ReasonOffset, m_ReasonLength); }
+		std::string_view GetHeader(std::string_view name) const;
+		size_t GetHeaderCount() const { return m_Headers.size(); }
+		std::string_view GetHeaderName(size_t index) const { return View(m_Headers[index].nameOffset, m_Headers[index].nameLength); }
+		std::string_view GetHeaderValue(size_t index) const { return View(m_Headers[index].valueOffset, m_Headers[index].valueLength); }
+		std::string_view GetBody() const { return View(m_BodyOffset, m_BodyLength); }
+		bool IsKeepAlive() const { return m_KeepAlive; }
+		bool IsValid() const { return m_StatusCode != 0; }
+	private:
+		friend class HttpResponseParser;
+		std::string_view View(size_t offset, size_t length) const { return std::string_view(m_Raw.data() + offset, length); }
+
+		std::vector<char> m_Raw;
+		std::vector<HttpHeaderRef> m_Headers;
+		int m_StatusCode = 0;
+		size_t m_ReasonOffset = 0;
+		size_t m_ReasonLength = 0;
+		size_t m_BodyOffset = 0;
+		size_t m_BodyLength = 0;
+		bool m_KeepAlive = true;
+	};
+
+	// Incremental HTTP/1.1 response parser. Callers receive straight into the parser's buffer
+	// (PrepareWrite/CommitWrite), chunked bodies are decoded in place and a finished response
+	// takes ownership of the buffer, so a response body is never copied on the common path.
+	// Bytes past the end of a response are kept for the next one, which makes pipelining work.
+	class HttpResponseParser {
+	public:
+		enum class State {
+			StatusLine,
+			Headers,
+			Body,
+			ChunkSize,
+			ChunkData,
+			ChunkDataEnd,
+			Trailers,
+			UntilClose,
+			Complete,
+			Error
+		};
+
+		HttpResponseParser();
+
+		char* PrepareWrite(size_t minSpace);
+		void CommitWrite(size_t length);
+		int Feed(const char* data, size_t length);
+		// Returns 1 when a full response is available, 0 when more data is needed and -1 on malformed input
+		int Parse();
+		// Signals the peer closed the connection; completes responses delimited by connection close
+		int MarkEndOfStream();
+		int TakeResponse(HttpResponse& response);
+		void SetExpectNoBody(bool noBody) { m_ExpectNoBody = noBody; }
+		void Reset();
+
+		State GetState() const { return m_State; }
+		bool HasBufferedData() const { return m_Size > 0; }
+		const std::string& GetError() const { return m_Error; }
+	private:
+		int Fail(const char* reason);
+		bool ReadLine(size_t& lineStart, size_t& lineLength);
+		int ParseStatusLine(size_t lineStart, size_t lineLength);
+		int ParseHeaderLine(size_t lineStart, size_t lineLength);
+		int BeginBody();
+		std::string_view View(size_t offset, size_t length) const { return std::string_view(m_Buffer.data() + offset, length); }
+
+		std::vector<char> m_Buffer;
+		size_t m_Size = 0;
+		size_t m_Pos = 0;
+		State m_State = State::StatusLine;
+		std::string m_Error;
+
+		std::vector<HttpHeaderRef> m_Headers;
+		int m_StatusCode = 0;
+		int m_VersionMinor = 1;
+		size_t m_ReasonOffset = 0;
+		size_t m_ReasonLength = 0;
+		size_t m_BodyOffset = 0;
+		size_t m_BodyLength = 0;
+		size_t m_Remaining = 0;
+		size_t m_MessageEnd = 0;
+		bool m_KeepAlive = true;
+		bool m_ExpectNoBody = false;
+
+		static constexpr size_t MaxHeaderBytes = 64 * 1024;
+		static constexpr size_t MaxBodyBytes = 16 * 1024 * 1024;
+	};
+
+	bool HttpHeaderEquals(std::string_view a, std::string_view b);
+}
+
+#endif
@@ -1,19 +1,62 @@
 #include "nompch.h"
 #include "NomSocketManager.h"
+#include "DnsResolver.h"
 #include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Logging/StructuredLog.h"
+#include "../Core/Tracing/Trace.h"
+#include <algorithm>
+#include <thread>
 
 namespace NomBotCore {
-	NomSocketManager::NomSocketManager()
+	namespace {
+		int MillisecondsUntil(std::chrono::steady_clock::time_point deadline)
+		{
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			return remaining > 0 ? static_cast<int>(remaining) : 0;
+		}
+
+		// Resumes the connect once the resolver answers, right away from the cache or later on a resolver worker
+		class ResolveAwaiter {
+		public:
+			ResolveAwaiter(SocketEventLoop& loop, DnsResolver& resolver, std::string host, int family)
+				: m_Loop(loop), m_Resolver(resolver), m_Host(std::move(host)), m_Family(family) {}
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				// The callback may run before ResolveAsync returns, nothing here is touched after it. A lookup that
+				// missed the cache calls back on a resolver worker, so the coroutine is handed back to the loop with
+				// a wait on no sockets rather than resumed there.
+				m_Resolver.ResolveAsync(m_Host, m_Family, [this, handle](int result, const std::vector<SocketAddress>& addresses) {
+					m_Result = result;
+					m_Addresses = addresses;
+					if (!m_Loop.AddSocketWait({}, 0, handle, &m_Posted))
+						handle.resume();
+				});
+			}
+			std::pair<int, std::vector<SocketAddress>> await_resume() { return { m_Result, std::move(m_Addresses) }; }
+		private:
+			SocketEventLoop& m_Loop;
+			DnsResolver& m_Resolver;
+			std::string m_Host;
+			int m_Family;
+			int m_Result = -1;
+			int m_Posted = 0;
+			std::vector<SocketAddress> m_Addresses;
+		};
+	}
+
+	NomSocketManager::NomSocketManager(int socketLimit)
 	{
 		socketCount = 0;
-		maxSockets = 16;
+		maxSockets = socketLimit > 0 ? socketLimit : 64;
 		sockets.resize(maxSockets, nullptr);
 		Initialize();
+		resolver = new DnsResolver();
 	}
 
 	NomSocketManager::~NomSocketManager()
 	{
-		for (int i = 0; i < socketCount; i++) {
+		for (int i = 0; i < maxSockets; i++) {
 			if (sockets[i] != nullptr) {
 				if (sockets[i]->getStatus() == 1) {
 					CloseSocket(sockets[i]->name);
@@ -24,6 +67,8 @@ namespace NomBotCore {
 		}
 		sockets.clear();
 		socketCount = 0;
+		delete resolver;
+		resolver = nullptr;
 		SSL_CTX_free(sslCtx);
 		WSACleanup();
 	}
@@ -53,22 +98,28 @@ namespace NomBotCore {
 
 	int NomSocketManager::CreateSocket(const char* name, int type, int protocol)
 	{	
+		std::lock_guard<std::mutex> lock(socketTableMutex);
 		if (socketCount >= maxSockets) {
 			ImGuiLogManager::AddLog("Socket", "Maximum socket limit reached!", LogSeverity::Error);
 			return -1;
 		}
-		NomSocket* newSocket = new NomSocket(socketCount, type, protocol);
+		// Reuse the first free slot so removed sockets don't leave holes that later ids collide with
+		int slot = 0;
+		while (slot < maxSockets && sockets[slot] != nullptr) slot++;
+		NomSocket* newSocket = new NomSocket(slot, type, protocol);
 		newSocket->name = new char[strlen(name) + 1];
 		strcpy(newSocket->name, name);
-		sockets[socketCount] = newSocket;
-		ImGuiLogManager::AddLog("Socket", std::string("Created socket '") + name + "' with ID: " + std::to_string(socketCount), LogSeverity::Info);
+		newSocket->stats = SocketStatsRegistry::Acquire(name);
+		sockets[slot] = newSocket;
+		ImGuiLogManager::AddLog("Socket", std::string("Created socket '") + name + "' with ID: " + std::to_string(slot), LogSeverity::Info);
 		socketCount++;
 		return 0;
 	}
 
 	int NomSocketManager::SocketNameToId(const char* name)
 	{
-		for (int i = 0; i < socketCount; i++) {
+		std::lock_guard<std::mutex> lock(socketTableMutex);
+		for (int i = 0; i < maxSockets; i++) {
 			if (sockets[i] != nullptr && strcmp(sockets[i]->name, name) == 0) {
 				return sockets[i]->getId();
 			}
@@ -88,7 +139,7 @@ namespace NomBotCore {
 
 	int NomSocketManager::BindSocket(int socketId, const char* address, int port)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -97,37 +148,21 @@ namespace NomBotCore {
 			ImGuiLogManager::AddLog("Socket", "Socket is already connected!", LogSeverity::Error);
 			return -1;
 		}
-		// Create a socket based on type and protocol
-		int af = (nomSocket->getProtocol() == 1) ? AF_INET : AF_INET6;
 		int sockType = (nomSocket->getType() == 1) ? SOCK_STREAM : SOCK_DGRAM;
 		int proto = (nomSocket->getType() == 1) ? IPPROTO_TCP : IPPROTO_UDP;
-		SOCKET serverSocket = socket(af, sockType, proto);
-		if (serverSocket == INVALID_SOCKET) {
-			ImGuiLogManager::AddLog("Socket", "Socket creation failed.", LogSeverity::Error);
+		std::vector<SocketAddress> candidates;
+		if (ResolveAddress(address, port, nomSocket->getProtocol(), sockType, proto, true, candidates) != 0) {
+			ImGuiLogManager::AddLog("Socket", std::string("getaddrinfo failed for ") + address, LogSeverity::Error);
 			return -1;
 		}
-		sockaddr_in serverAddr;
-		serverAddr.sin_family = af;
-		serverAddr.sin_port = htons(port);
-		struct addrinfo hints = { 0 }, * res = nullptr;
-		hints.ai_family = af;
-		hints.ai_socktype = sockType;
-		hints.ai_protocol = proto;
-		int ret = getaddrinfo(address, NULL, &hints, &res);
-		if (ret == 0 && res != nullptr) {
-			sockaddr_in* addr_in = (sockaddr_in*)res->ai_addr;
-			serverAddr.sin_addr = addr_in->sin_addr;
-			if (nomSocket->address == nullptr)
-				nomSocket->address = new char[INET_ADDRSTRLEN];
-			inet_ntop(af, &serverAddr.sin_addr, nomSocket->address, INET_ADDRSTRLEN);
-			freeaddrinfo(res);
-		}
-		else {
-			ImGuiLogManager::AddLog("Socket", "getaddrinfo failed: ", LogSeverity::Error);
-			closesocket(serverSocket);
+		const SocketAddress& local = candidates.front();
+		SOCKET serverSocket = socket(local.storage.ss_family, sockType, proto);
+		if (serverSocket == INVALID_SOCKET) {
+			ImGuiLogManager::AddLog("Socket", "Socket creation failed.", LogSeverity::Error);
 			return -1;
 		}
-		if (bind(serverSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+		SetSocketAddress(nomSocket, local);
+		if (bind(serverSocket, (const sockaddr*)&local.storage, local.length) == SOCKET_ERROR) {
 			ImGuiLogManager::AddLog("Socket", "Bind failed!", LogSeverity::Error);
 			closesocket(serverSocket);
 			return -1;
@@ -146,12 +181,21 @@ namespace NomBotCore {
 		if (socketId == -1) {
 			return -1;
 		}
-		return AcceptConnection(socketId, clientAddress, clientPort);
+		return AcceptConnection(socketId, ACCEPTED_CONNECTION, clientAddress, clientPort);
 	}
 
-	int NomSocketManager::AcceptConnection(int socketId, char* clientAddress, int* clientPort)
+	int NomSocketManager::AcceptConnection(const char* socketName, const char* acceptedName, char* clientAddress, int* clientPort)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		int socketId = SocketNameToId(socketName);
+		if (socketId == -1) {
+			return -1;
+		}
+		return AcceptConnection(socketId, acceptedName, clientAddress, clientPort);
+	}
+
+	int NomSocketManager::AcceptConnection(int socketId, const char* acceptedName, char* clientAddress, int* clientPort)
+	{
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -160,21 +204,23 @@ namespace NomBotCore {
 			ImGuiLogManager::AddLog("Socket", "Socket is not in listening state!", LogSeverity::Error);
 			return -1;
 		}
-		sockaddr_in clientAddr;
-		int addrLen = sizeof(clientAddr);
-		SOCKET clientSocket = accept(*nomSocket->socket, (sockaddr*)&clientAddr, &addrLen);
+		SocketAddress clientAddr;
+		clientAddr.length = sizeof(clientAddr.storage);
+		SOCKET clientSocket = accept(*nomSocket->socket, (sockaddr*)&clientAddr.storage, &clientAddr.length);
 		if (clientSocket == INVALID_SOCKET) {
 			ImGuiLogManager::AddLog("Socket", "Accept failed!", LogSeverity::Error);
 			return -1;
 		}
-		inet_ntop(AF_INET, &clientAddr.sin_addr, clientAddress, INET_ADDRSTRLEN);
-		*clientPort = ntohs(clientAddr.sin_port);
-		ImGuiLogManager::AddLog("Socket", std::string("Accepted connection from ") + clientAddress + ":" + std::to_string(*clientPort), LogSeverity::Info);
+		FormatSocketAddress(clientAddr, clientAddress, INET6_ADDRSTRLEN, clientPort);
+		NOM_LOG_INFO("Socket", "Accepted connection from {}:{}", clientAddress, *clientPort);
 		// receve data from accepted connection
 
 
-		CreateSocket(ACCEPTED_CONNECTION, 1, 1);
-		int id = SocketNameToId(ACCEPTED_CONNECTION);
+		if (CreateSocket(acceptedName, 1, 1) != 0) {
+			closesocket(clientSocket);
+			return -1;
+		}
+		int id = SocketNameToId(acceptedName);
 		if (sockets[id]->address) delete[] sockets[id]->address;
 		sockets[id]->address = new char[strlen(clientAddress) + 1];
 		strcpy(sockets[id]->address, clientAddress);
@@ -186,78 +232,59 @@ namespace NomBotCore {
 
 	int NomSocketManager::ConnectSocket(int socketId, const char* address, int port, bool sslData)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
 		NomSocket* nomSocket = sockets[socketId];
+		if (nomSocket->host) delete[] nomSocket->host;
 		nomSocket->host = new char[strlen(address) + 1];
 		strcpy(nomSocket->host, address);
 		if (nomSocket->getStatus() == 1) {
 			ImGuiLogManager::AddLog("Socket", "Socket is already connected!", LogSeverity::Error);
 			return -1;
 		}
-		// Create a socket based on type and protocol
-		int af = (nomSocket->getProtocol() == 1) ? AF_INET : AF_INET6;
 		int sockType = (nomSocket->getType() == 1) ? SOCK_STREAM : SOCK_DGRAM;
 		int proto = (nomSocket->getType() == 1) ? IPPROTO_TCP : IPPROTO_UDP;
-		SOCKET clientSocket = socket(af, sockType, proto);
-		if (clientSocket == INVALID_SOCKET) {
-			ImGuiLogManager::AddLog("Socket", "Socket creation failed.", LogSeverity::Error);
-			return -1;
-		}
-		sockaddr_in serverAddr;
-		serverAddr.sin_family = af;
-		serverAddr.sin_port = htons(port);
-		struct addrinfo hints = {0}, *res = nullptr;
-		hints.ai_family = af;
-		hints.ai_socktype = sockType;
-		hints.ai_protocol = proto;
-		int ret = getaddrinfo(address, NULL, &hints, &res);
-		if (ret == 0 && res != nullptr) {
-			sockaddr_in* addr_in = (sockaddr_in*)res->ai_addr;
-			serverAddr.sin_addr = addr_in->sin_addr;
-			if (nomSocket->address == nullptr)
-				nomSocket->address = new char[INET_ADDRSTRLEN];
-			inet_ntop(af, &serverAddr.sin_addr, nomSocket->address, INET_ADDRSTRLEN);
-			freeaddrinfo(res);
-		} else {
-			ImGuiLogManager::AddLog("Socket", "getaddrinfo failed: ", LogSeverity::Error);
-			closesocket(clientSocket);
+		std::vector<SocketAddress> candidates;
+		if (ResolveAddress(address, port, nomSocket->getProtocol(), sockType, proto, false, candidates) != 0) {
+			ImGuiLogManager::AddLog("Socket", std::string("getaddrinfo failed for ") + address, LogSeverity::Error);
 			return -1;
 		}
-		if (connect(clientSocket, (sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-			ImGuiLogManager::AddLog("Socket", "Connection failed!", LogSeverity::Error);
-			closesocket(clientSocket);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connectTimeoutMs);
+		size_t winner = 0;
+		SOCKET clientSocket = RaceConnect(candidates, sockType, proto, deadline, winner);
+		if (clientSocket == INVALID_SOCKET) {
+			if (nomSocket->stats) nomSocket->stats->RecordError(std::chrono::steady_clock::now() >= deadline ? SocketErrorType::Timeout : SocketErrorType::Connect);
+			ImGuiLogManager::AddLog("Socket", std::string("Connection to ") + address + " failed!", LogSeverity::Error);
 			return -1;
-		} else {
-			ImGuiLogManager::AddLog("Socket", std::string("Socket '") + nomSocket->name + "' connected to " + nomSocket->address + " on port " + std::to_string(port) + "!", LogSeverity::Info);
 		}
+		if (nomSocket->stats) nomSocket->stats->RecordConnect();
+		SetSocketAddress(nomSocket, candidates[winner]);
+		ImGuiLogManager::AddLog("Socket", std::string("Socket '") + nomSocket->name + "' connected to " + nomSocket->address + " on port " + std::to_string(port) + "!", LogSeverity::Info);
 		// handle ssl connection here if needed
+		SSL* ssl = nullptr;
 		if (sslData) {
-			SSL* ssl = SSL_new(sslCtx);
-			SSL_set_fd(ssl, (int)clientSocket);
-			SSL_set_tlsext_host_name(ssl, address);
-			// Optionally, set default verify paths
-			SSL_CTX_set_default_verify_paths(sslCtx);
+			ssl = NewClientSsl(clientSocket, address);
+			// The handshake shares the connect deadline, a stalled edge must not hang the caller
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			SetRawSocketTimeout(clientSocket, remaining > 0 ? static_cast<int>(remaining) : 1);
 			int ret = SSL_connect(ssl);
+			SetRawSocketTimeout(clientSocket, 0);
 			if (ret <= 0) {
 				int sslErr = SSL_get_error(ssl, ret);
 				unsigned long errCode = ERR_get_error();
 				ImGuiLogManager::AddLog("Socket", std::string("SSL connection failed! ") + ERR_error_string(errCode, nullptr) + " (SSL Error code: " + std::to_string(sslErr) + ")", LogSeverity::Error);
 				SSL_free(ssl);
 				closesocket(clientSocket);
+				if (nomSocket->stats) nomSocket->stats->RecordError(SocketErrorType::TlsHandshake);
 				return -1;
 			} else {
+				if (nomSocket->stats) nomSocket->stats->RecordTlsHandshake();
 				ImGuiLogManager::AddLog("Socket", std::string("SSL connection established on socket '") + nomSocket->name + "'!", LogSeverity::Info);
 			}
-			nomSocket->ssl = ssl;
-		} else {
-			nomSocket->ssl = nullptr;
 		}
-
-		nomSocket->socket = new SOCKET(clientSocket);
-		nomSocket->setStatus(1); // Mark as connected
+		FinishConnect(nomSocket, clientSocket, ssl, false);
 		return 0;
 	}
 
@@ -272,7 +299,7 @@ namespace NomBotCore {
 
 	int NomSocketManager::SendData(int socketId, const char* data, int length, bool sslData)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -283,14 +310,18 @@ namespace NomBotCore {
 		}
 		// Send data through the socket
 		int bytesSent = 0;
+		auto started = std::chrono::steady_clock::now();
 		if (sslData) {
 			// TODO: Handle SNI if needed
 			SSL_set_tlsext_host_name(nomSocket->ssl, nomSocket->host);
 			bytesSent = SSL_write(nomSocket->ssl, data, length);
 			if (bytesSent <= 0) {
 				int sslErr = SSL_get_error(nomSocket->ssl, bytesSent);
+				if (nomSocket->nonBlocking && (sslErr == SSL_ERROR_WANT_READ || sslErr == SSL_ERROR_WANT_WRITE))
+					return WouldBlock;
 				unsigned long errCode = ERR_get_error();
 				ImGuiLogManager::AddLog("Socket", std::string("SSL Send failed! ") + ERR_error_string(errCode, nullptr) + " (SSL Error code: " + std::to_string(sslErr) + ")", LogSeverity::Error);
+				RecordIoError(nomSocket, SocketErrorType::Send);
 				return -1;
 			}
 		} else {
@@ -300,13 +331,19 @@ namespace NomBotCore {
 			} else {
 				bytesSent = send(*nomSocket->socket, data, length, 0);
 				if (bytesSent == SOCKET_ERROR) {
+					if (nomSocket->nonBlocking && WSAGetLastError() == WSAEWOULDBLOCK)
+						return WouldBlock;
 					ImGuiLogManager::AddLog("Socket", "Send failed!", LogSeverity::Error);
+					RecordIoError(nomSocket, SocketErrorType::Send);
 					return -1;
 				}
 			}
 		}
-		ImGuiLogManager::AddLog("Socket", std::string("Sent ") + std::to_string(bytesSent) + " bytes on socket '" + nomSocket->name + "'", LogSeverity::Info);
-		ImGuiLogManager::AddLog("Socket", std::string("Data: ") + std::string(data, bytesSent), LogSeverity::Info);
+		if (nomSocket->stats) nomSocket->stats->RecordSend(bytesSent, MicrosecondsSince(started));
+		if (logPayloads) {
+			NOM_LOG_INFO("Socket", "Sent {} bytes on socket '{}'", bytesSent, nomSocket->name);
+			NOM_LOG_INFO("Socket", "Data: {}", RedactPayload(data, bytesSent));
+		}
 		return bytesSent;
 	}
 
@@ -321,7 +358,7 @@ namespace NomBotCore {
 
 	int NomSocketManager::ReceiveData(int socketId, char* buffer, int length, bool sslData)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -332,20 +369,32 @@ namespace NomBotCore {
 		}
 		// Receive data from the socket
 		int bytesReceived = 0;
+		auto started = std::chrono::steady_clock::now();
 		if (sslData) {
 			if (nomSocket->ssl == nullptr) {
 				ImGuiLogManager::AddLog("Socket", "Socket is not using SSL, but sslData is true!", LogSeverity::Error);
 				return -1;
 			}
 			SSL_set_tlsext_host_name(nomSocket->ssl, nomSocket->host);
-			bytesReceived = SSL_read(nomSocket->ssl, buffer, length);
+			{
+				NOM_TRACE_SCOPE("TLS read");
+				bytesReceived = SSL_read(nomSocket->ssl, buffer, length);
+			}
 			if (bytesReceived <= 0) {
 				int sslErr = SSL_get_error(nomSocket->ssl, bytesReceived);
+				// A TLS read may need to write too, e.g. during renegotiation, either way it waits on the socket
+				if (nomSocket->nonBlocking && (sslErr == SSL_ERROR_WANT_READ || sslErr == SSL_ERROR_WANT_WRITE))
+					return WouldBlock;
+				if (sslErr == SSL_ERROR_ZERO_RETURN) {
+					// Peer sent close_notify, report it like a plain recv() end of stream
+					if (nomSocket->stats) nomSocket->stats->RecordClosedByPeer();
+					return 0;
+				}
 				unsigned long errCode = ERR_get_error();
 				ImGuiLogManager::AddLog("Socket", std::string("SSL Receive failed! ") + ERR_error_string(errCode, nullptr) + " (SSL Error code: " + std::to_string(sslErr) + ")", LogSeverity::Error);
+				RecordIoError(nomSocket, SocketErrorType::Receive);
 				return -1;
 			}
-			return bytesReceived;
 		} else {
 			if (nomSocket->ssl != nullptr) {
 				ImGuiLogManager::AddLog("Socket", "Socket is using SSL, but sslData is false!", LogSeverity::Error);
@@ -353,11 +402,20 @@ namespace NomBotCore {
 			} else {
 				bytesReceived = recv(*nomSocket->socket, buffer, length, 0);
 				if (bytesReceived == SOCKET_ERROR) {
+					if (nomSocket->nonBlocking && WSAGetLastError() == WSAEWOULDBLOCK)
+						return WouldBlock;
 					ImGuiLogManager::AddLog("Socket", "Receive failed!", LogSeverity::Error);
+					RecordIoError(nomSocket, SocketErrorType::Receive);
 					return -1;
 				}
 			}
 		}
+		if (nomSocket->stats) {
+			if (bytesReceived == 0)
+				nomSocket->stats->RecordClosedByPeer();
+			else
+				nomSocket->stats->RecordReceive(bytesReceived, MicrosecondsSince(started));
+		}
 		return bytesReceived;
 	}
 
@@ -372,7 +430,7 @@ namespace NomBotCore {
 
 	int NomSocketManager::Listen(int socketId, int backlog)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -403,7 +461,7 @@ namespace NomBotCore {
 
 	int NomSocketManager::CloseSocket(int socketId)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
@@ -416,6 +474,7 @@ namespace NomBotCore {
 		closesocket(*nomSocket->socket);
 		SSL_free(nomSocket->ssl);
 		nomSocket->ssl = nullptr;
+		nomSocket->nonBlocking = false;
 		nomSocket->setStatus(0); // Mark as disconnected
 		return 0;
 	}
@@ -440,13 +499,14 @@ namespace NomBotCore {
 
 	int NomSocketManager::RemoveSocket(int socketId)
 	{
-		if (socketId < 0 || socketId >= socketCount || sockets[socketId] == nullptr) {
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
 			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
 			return -1;
 		}
 		if (sockets[socketId]->getStatus() == 1) {
 			CloseSocket(socketId);
 		}
+		std::lock_guard<std::mutex> lock(socketTableMutex);
 		delete sockets[socketId];
 		sockets[socketId] = nullptr;
 		socketCount--;
@@ -465,9 +525,647 @@ namespace NomBotCore {
 		return -1;
 	}
 
+	int64_t NomSocketManager::MicrosecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void NomSocketManager::RecordIoError(NomSocket* nomSocket, SocketErrorType type)
+	{
+		if (!nomSocket->stats)
+			return;
+		// Sockets with SO_RCVTIMEO/SO_SNDTIMEO report an expired timeout as a failed call
+		int err = WSAGetLastError();
+		nomSocket->stats->RecordError((err == WSAETIMEDOUT || err == WSAEWOULDBLOCK) ? SocketErrorType::Timeout : type);
+	}
+
+	std::string NomSocketManager::RedactPayload(const char* data, int length)
+	{
+		static const char* secretHeaders[] = { "authorization:", "cookie:" };
+		static const char* secretKeys[] = { "access_token", "refresh_token", "client_secret", "code", "token", "password" };
+		constexpr int MaxLoggedBytes = 2048;
+
+		std::string payload(data, length > MaxLoggedBytes ? MaxLoggedBytes : (length > 0 ? length : 0));
+		std::string lower = payload;
+		std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		std::vector<std::pair<size_t, size_t>> ranges;
+
+		// Header values up to the end of the line
+		for (const char* header : secretHeaders) {
+			for (size_t pos = lower.find(header); pos != std::string::npos; pos = lower.find(header, pos + 1)) {
+				if (pos != 0 && lower[pos - 1] != '\n')
+					continue;
+				size_t start = pos + strlen(header);
+				size_t end = lower.find('\r', start);
+				ranges.push_back({ start, end == std::string::npos ? lower.size() : end });
+			}
+		}
+		// key=value form fields and "key":"value" JSON members
+		for (const char* key : secretKeys) {
+			size_t keyLength = strlen(key);
+			for (size_t pos = lower.find(key); pos != std::string::npos; pos = lower.find(key, pos + 1)) {
+				bool boundary = pos == 0 || !(std::isalnum(static_cast<unsigned char>(lower[pos - 1])) || lower[pos - 1] == '_');
+				size_t after = pos + keyLength;
+				if (!boundary || after >= lower.size())
+					continue;
+				size_t start = std::string::npos;
+				if (lower[after] == '=')
+					start = after + 1;
+				else if (lower.compare(after, 2, "\":") == 0)
+					start = lower.find_first_not_of(" \"", after + 2);
+				if (start == std::string::npos)
+					continue;
+				size_t end = lower.find_first_of("&\",} \r\n", start);
+				ranges.push_back({ start, end == std::string::npos ? lower.size() : end });
+			}
+		}
+
+		std::sort(ranges.begin(), ranges.end());
+		std::string redacted;
+		size_t copied = 0;
+		for (const auto& range : ranges) {
+			if (range.first < copied)
+				continue;
+			redacted.append(payload, copied, range.first - copied);
+			redacted += "[redacted]";
+			copied = range.second;
+		}
+		redacted.append(payload, copied, std::string::npos);
+		if (length > MaxLoggedBytes)
+			redacted += "... (" + std::to_string(length - MaxLoggedBytes) + " more bytes)";
+		return redacted;
+	}
+
+	void NomSocketManager::SetConnectTimeouts(int attemptTimeoutMs, int totalTimeoutMs)
+	{
+		connectAttemptTimeoutMs = attemptTimeoutMs;
+		connectTimeoutMs = totalTimeoutMs;
+	}
+
+	int NomSocketManager::ResolveAddress(const char* address, int port, int protocol, int sockType, int proto, bool passive, std::vector<SocketAddress>& candidates)
+	{
+		std::vector<SocketAddress> resolved;
+		if (passive) {
+			// Binding happens once at startup on a literal or localhost, resolve it in place
+			struct addrinfo hints = { 0 }, * res = nullptr;
+			hints.ai_family = protocol == 1 ? AF_INET : (protocol == 2 ? AF_INET6 : AF_UNSPEC);
+			hints.ai_socktype = sockType;
+			hints.ai_protocol = proto;
+			hints.ai_flags = AI_PASSIVE;
+			std::string service = std::to_string(port);
+			if (getaddrinfo(address, service.c_str(), &hints, &res) != 0 || res == nullptr)
+				return -1;
+			for (addrinfo* ai = res; ai != nullptr; ai = ai->ai_next) {
+				if (ai->ai_addrlen > sizeof(sockaddr_storage) || (ai->ai_family != AF_INET && ai->ai_family != AF_INET6))
+					continue;
+				SocketAddress candidate;
+				memcpy(&candidate.storage, ai->ai_addr, ai->ai_addrlen);
+				candidate.length = static_cast<int>(ai->ai_addrlen);
+				resolved.push_back(candidate);
+			}
+			freeaddrinfo(res);
+		}
+		else if (resolver->Resolve(address, protocol, resolved, connectTimeoutMs) != 0) {
+			return -1;
+		}
+
+		OrderCandidates(resolved, port, candidates);
+		return candidates.empty() ? -1 : 0;
+	}
+
+	void NomSocketManager::OrderCandidates(std::vector<SocketAddress>& resolved, int port, std::vector<SocketAddress>& candidates)
+	{
+		// RFC 8305 section 4: prefer IPv6, then alternate families so one broken stack can't stall the race
+		std::vector<SocketAddress> v6;
+		std::vector<SocketAddress> v4;
+		for (auto& candidate : resolved) {
+			if (candidate.storage.ss_family == AF_INET6) {
+				((sockaddr_in6*)&candidate.storage)->sin6_port = htons(static_cast<u_short>(port));
+				v6.push_back(candidate);
+			}
+			else {
+				((sockaddr_in*)&candidate.storage)->sin_port = htons(static_cast<u_short>(port));
+				v4.push_back(candidate);
+			}
+		}
+		candidates.clear();
+		for (size_t i = 0; i < v6.size() || i < v4.size(); ++i) {
+			if (i < v6.size()) candidates.push_back(v6[i]);
+			if (i < v4.size()) candidates.push_back(v4[i]);
+		}
+	}
+
+	SOCKET NomSocketManager::RaceConnect(const std::vector<SocketAddress>& candidates, int sockType, int proto, std::chrono::steady_clock::time_point deadline, size_t& winner)
+	{
+		struct Attempt {
+			SOCKET socket;
+			size_t index;
+			std::chrono::steady_clock::time_point deadline;
+		};
+		std::vector<Attempt> attempts;
+		size_t next = 0;
+		auto nextStart = std::chrono::steady_clock::now();
+		SOCKET connected = INVALID_SOCKET;
+
+		while (connected == INVALID_SOCKET) {
+			auto now = std::chrono::steady_clock::now();
+			if (now >= deadline)
+				break;
+			// Start the next candidate once the attempt delay has passed or nothing is in flight
+			if (next < candidates.size() && (attempts.empty() || now >= nextStart)) {
+				bool done = false;
+				SOCKET s = StartConnectAttempt(candidates[next], sockType, proto, done);
+				if (done) {
+					connected = s;
+					winner = next;
+					break;
+				}
+				if (s != INVALID_SOCKET) {
+					attempts.push_back({ s, next, std::min(deadline, now + std::chrono::milliseconds(connectAttemptTimeoutMs)) });
+					nextStart = now + std::chrono::milliseconds(ConnectionAttemptDelayMs);
+				}
+				else {
+					nextStart = now;
+				}
+				next++;
+				continue;
+			}
+			if (attempts.empty())
+				break;
+
+			auto wake = deadline;
+			if (next < candidates.size())
+				wake = std::min(wake, nextStart);
+			fd_set writeSet;
+			fd_set exceptSet;
+			FD_ZERO(&writeSet);
+			FD_ZERO(&exceptSet);
+			int maxFd = 0;
+			for (const auto& attempt : attempts) {
+				FD_SET(attempt.socket, &writeSet);
+				FD_SET(attempt.socket, &exceptSet);
+				maxFd = std::max(maxFd, static_cast<int>(attempt.socket));
+				wake = std::min(wake, attempt.deadline);
+			}
+			auto waitUs = std::chrono::duration_cast<std::chrono::microseconds>(wake - now).count();
+			timeval tv;
+			tv.tv_sec = static_cast<long>(std::max<long long>(0, waitUs) / 1000000);
+			tv.tv_usec = static_cast<long>(std::max<long long>(0, waitUs) % 1000000);
+			if (select(maxFd + 1, nullptr, &writeSet, &exceptSet, &tv) == SOCKET_ERROR)
+				break;
+
+			now = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < attempts.size();) {
+				Attempt& attempt = attempts[i];
+				bool writable = FD_ISSET(attempt.socket, &writeSet) != 0;
+				bool failed = FD_ISSET(attempt.socket, &exceptSet) != 0;
+				if (writable || failed) {
+					int soError = 0;
+					socklen_t errLen = sizeof(soError);
+					getsockopt(attempt.socket, SOL_SOCKET, SO_ERROR, (char*)&soError, &errLen);
+					if (writable && soError == 0) {
+						connected = attempt.socket;
+						winner = attempt.index;
+						attempts.erase(attempts.begin() + i);
+						break;
+					}
+				}
+				else if (now < attempt.deadline) {
+					++i;
+					continue;
+				}
+				LogAttemptFailure(candidates[attempt.index], writable || failed);
+				closesocket(attempt.socket);
+				attempts.erase(attempts.begin() + i);
+				nextStart = now; // A failed attempt hands over to the next candidate immediately
+			}
+		}
+
+		for (const auto& attempt : attempts)
+			closesocket(attempt.socket);
+		if (connected != INVALID_SOCKET) {
+			u_long blocking = 0;
+			ioctlsocket(connected, FIONBIO, &blocking);
+		}
+		return connected;
+	}
+
+	SOCKET NomSocketManager::StartConnectAttempt(const SocketAddress& candidate, int sockType, int proto, bool& connected)
+	{
+		connected = false;
+		SOCKET s = socket(candidate.storage.ss_family, sockType, proto);
+		if (s == INVALID_SOCKET)
+			return INVALID_SOCKET;
+		u_long nonBlocking = 1;
+		ioctlsocket(s, FIONBIO, &nonBlocking);
+		if (connect(s, (const sockaddr*)&candidate.storage, candidate.length) == 0) {
+			connected = true;
+			return s;
+		}
+		int err = WSAGetLastError();
+		if (err == WSAEWOULDBLOCK || err == WSAEINPROGRESS)
+			return s;
+		closesocket(s);
+		return INVALID_SOCKET;
+	}
+
+	void NomSocketManager::LogAttemptFailure(const SocketAddress& candidate, bool failed)
+	{
+		char text[INET6_ADDRSTRLEN] = { 0 };
+		FormatSocketAddress(candidate, text, sizeof(text), nullptr);
+		ImGuiLogManager::AddLog("Socket", std::string("Connection attempt to ") + text + (failed ? " failed." : " timed out."), LogSeverity::Warning);
+	}
+
+	SSL* NomSocketManager::NewClientSsl(SOCKET s, const char* host)
+	{
+		SSL* ssl = SSL_new(sslCtx);
+		SSL_set_fd(ssl, (int)s);
+		SSL_set_tlsext_host_name(ssl, host);
+		// Optionally, set default verify paths
+		SSL_CTX_set_default_verify_paths(sslCtx);
+		return ssl;
+	}
+
+	void NomSocketManager::FinishConnect(NomSocket* nomSocket, SOCKET s, SSL* ssl, bool nonBlocking)
+	{
+		nomSocket->ssl = ssl;
+		if (nomSocket->socket) delete nomSocket->socket;
+		nomSocket->socket = new SOCKET(s);
+		nomSocket->nonBlocking = nonBlocking;
+		nomSocket->setStatus(1); // Mark as connected
+	}
+
+	void NomSocketManager::FormatSocketAddress(const SocketAddress& address, char* text, size_t textLength, int* port)
+	{
+		if (address.storage.ss_family == AF_INET6) {
+			const sockaddr_in6* in6 = (const sockaddr_in6*)&address.storage;
+			inet_ntop(AF_INET6, &in6->sin6_addr, text, textLength);
+			if (port) *port = ntohs(in6->sin6_port);
+		}
+		else {
+			const sockaddr_in* in4 = (const sockaddr_in*)&address.storage;
+			inet_ntop(AF_INET, &in4->sin_addr, text, textLength);
+			if (port) *port = ntohs(in4->sin_port);
+		}
+	}
+
+	void NomSocketManager::SetSocketAddress(NomSocket* nomSocket, const SocketAddress& address)
+	{
+		if (nomSocket->address) delete[] nomSocket->address;
+		nomSocket->address = new char[INET6_ADDRSTRLEN];
+		nomSocket->address[0] = '\0';
+		FormatSocketAddress(address, nomSocket->address, INET6_ADDRSTRLEN, &nomSocket->port);
+	}
+
+	int NomSocketManager::SetRawSocketTimeout(SOCKET s, int timeoutMs)
+	{
+		// Winsock takes the timeout as a DWORD in milliseconds, 0 means block forever
+		DWORD timeout = timeoutMs > 0 ? static_cast<DWORD>(timeoutMs) : 0;
+		if (setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == SOCKET_ERROR ||
+			setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout)) == SOCKET_ERROR) {
+			return -1;
+		}
+		return 0;
+	}
+
+	int NomSocketManager::SetSocketTimeout(const char* socketName, int timeoutMs)
+	{
+		int socketId = SocketNameToId(socketName);
+		if (socketId == -1) {
+			return -1;
+		}
+		return SetSocketTimeout(socketId, timeoutMs);
+	}
+
+	int NomSocketManager::SetSocketTimeout(int socketId, int timeoutMs)
+	{
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
+			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
+			return -1;
+		}
+		NomSocket* nomSocket = sockets[socketId];
+		if (nomSocket->getStatus() == 0) {
+			ImGuiLogManager::AddLog("Socket", "Socket is not connected!", LogSeverity::Error);
+			return -1;
+		}
+		if (SetRawSocketTimeout(*nomSocket->socket, timeoutMs) != 0) {
+			ImGuiLogManager::AddLog("Socket", std::string("Failed to set timeout on socket '") + nomSocket->name + "'", LogSeverity::Error);
+			return -1;
+		}
+		return 0;
+	}
+
+	int NomSocketManager::SetNonBlocking(const char* socketName, bool nonBlocking)
+	{
+		int socketId = SocketNameToId(socketName);
+		if (socketId == -1) {
+			return -1;
+		}
+		return SetNonBlocking(socketId, nonBlocking);
+	}
+
+	int NomSocketManager::SetNonBlocking(int socketId, bool nonBlocking)
+	{
+		if (socketId < 0 || socketId >= maxSockets || sockets[socketId] == nullptr) {
+			ImGuiLogManager::AddLog("Socket", "Invalid socket ID!", LogSeverity::Error);
+			return -1;
+		}
+		NomSocket* nomSocket = sockets[socketId];
+		if (nomSocket->getStatus() == 0) {
+			ImGuiLogManager::AddLog("Socket", "Socket is not connected!", LogSeverity::Error);
+			return -1;
+		}
+		u_long mode = nonBlocking ? 1 : 0;
+		if (ioctlsocket(*nomSocket->socket, FIONBIO, &mode) == SOCKET_ERROR) {
+			ImGuiLogManager::AddLog("Socket", std::string("Failed to change blocking mode of socket '") + nomSocket->name + "'", LogSeverity::Error);
+			return -1;
+		}
+		nomSocket->nonBlocking = nonBlocking;
+		return 0;
+	}
+
+	int NomSocketManager::WaitReadable(const std::vector<std::string>& socketNames, int timeoutMs, std::vector<std::string>& ready)
+	{
+		std::vector<size_t> rawReady;
+		return WaitSockets(socketNames, {}, timeoutMs, ready, rawReady);
+	}
+
+	int NomSocketManager::WaitSockets(const std::vector<std::string>& socketNames, const std::vector<SocketWait>& raw, int timeoutMs, std::vector<std::string>& ready, std::vector<size_t>& rawReady)
+	{
+		fd_set readSet;
+		fd_set writeSet;
+		fd_set exceptSet;
+		FD_ZERO(&readSet);
+		FD_ZERO(&writeSet);
+		FD_ZERO(&exceptSet);
+		int maxFd = 0;
+		size_t watchedCount = 0;
+		std::vector<std::pair<SOCKET, const std::string*>> watched;
+		std::vector<const std::string*> buffered;
+		{
+			std::lock_guard<std::mutex> lock(socketTableMutex);
+			for (const auto& name : socketNames) {
+				for (int i = 0; i < maxSockets; i++) {
+					NomSocket* nomSocket = sockets[i];
+					if (nomSocket == nullptr || strcmp(nomSocket->name, name.c_str()) != 0)
+						continue;
+					if (nomSocket->getStatus() == 1 && nomSocket->ssl != nullptr && SSL_pending(nomSocket->ssl) > 0) {
+						buffered.push_back(&name);
+					}
+					else if (nomSocket->getStatus() == 1 && nomSocket->socket != nullptr && watchedCount < FD_SETSIZE) {
+						FD_SET(*nomSocket->socket, &readSet);
+						maxFd = std::max(maxFd, static_cast<int>(*nomSocket->socket));
+						watched.push_back({ *nomSocket->socket, &name });
+						watchedCount++;
+					}
+					break;
+				}
+			}
+		}
+		for (const auto& wait : raw) {
+			if (wait.socket == INVALID_SOCKET || watchedCount >= FD_SETSIZE)
+				continue;
+			if (wait.write) {
+				// Winsock reports a failed connect in the except set only
+				FD_SET(wait.socket, &writeSet);
+				FD_SET(wait.socket, &exceptSet);
+			}
+			else {
+				FD_SET(wait.socket, &readSet);
+			}
+			maxFd = std::max(maxFd, static_cast<int>(wait.socket));
+			watchedCount++;
+		}
+		for (const std::string* name : buffered)
+			ready.push_back(*name);
+		// Something is ready already, only poll the rest
+		if (!buffered.empty())
+			timeoutMs = 0;
+		if (watchedCount == 0) {
+			// Winsock rejects a select with no sockets in it
+			if (timeoutMs > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+			return static_cast<int>(buffered.size());
+		}
+		timeval timeout;
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_usec = (timeoutMs % 1000) * 1000;
+		int result = select(maxFd + 1, &readSet, &writeSet, &exceptSet, &timeout);
+		if (result == SOCKET_ERROR) {
+			ImGuiLogManager::AddLog("Socket", "select failed with error: " + std::to_string(WSAGetLastError()), LogSeverity::Error);
+			return -1;
+		}
+		int readyCount = static_cast<int>(buffered.size());
+		for (const auto& [s, name] : watched) {
+			if (FD_ISSET(s, &readSet)) {
+				ready.push_back(*name);
+				readyCount++;
+			}
+		}
+		for (size_t i = 0; i < raw.size(); ++i) {
+			const SocketWait& wait = raw[i];
+			if (wait.socket == INVALID_SOCKET)
+				continue;
+			bool isReady = wait.write ? (FD_ISSET(wait.socket, &writeSet) || FD_ISSET(wait.socket, &exceptSet)) : FD_ISSET(wait.socket, &readSet);
+			if (isReady) {
+				rawReady.push_back(i);
+				readyCount++;
+			}
+		}
+		return readyCount;
+	}
+
+	SOCKET NomSocketManager::GetConnectedSocket(const char* socketName)
+	{
+		std::lock_guard<std::mutex> lock(socketTableMutex);
+		for (int i = 0; i < maxSockets; i++) {
+			NomSocket* nomSocket = sockets[i];
+			if (nomSocket != nullptr && strcmp(nomSocket->name, socketName) == 0)
+				return nomSocket->getStatus() == 1 && nomSocket->socket != nullptr ? *nomSocket->socket : INVALID_SOCKET;
+		}
+		return INVALID_SOCKET;
+	}
+
+	Task<int> NomSocketManager::ConnectSocketAsync(SocketEventLoop& loop, std::string socketName, std::string address, int port, bool sslData)
+	{
+		int socketId = SocketNameToId(socketName.c_str());
+		if (socketId == -1)
+			co_return -1;
+		NomSocket* nomSocket = sockets[socketId];
+		if (nomSocket->getStatus() == 1) {
+			ImGuiLogManager::AddLog("Socket", "Socket is already connected!", LogSeverity::Error);
+			co_return -1;
+		}
+		if (nomSocket->host) delete[] nomSocket->host;
+		nomSocket->host = new char[address.size() + 1];
+		strcpy(nomSocket->host, address.c_str());
+		int sockType = (nomSocket->getType() == 1) ? SOCK_STREAM : SOCK_DGRAM;
+		int proto = (nomSocket->getType() == 1) ? IPPROTO_TCP : IPPROTO_UDP;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connectTimeoutMs);
+
+		auto [resolveResult, resolved] = co_await ResolveAwaiter(loop, *resolver, address, nomSocket->getProtocol());
+		std::vector<SocketAddress> candidates;
+		if (resolveResult == 0)
+			OrderCandidates(resolved, port, candidates);
+		if (candidates.empty()) {
+			ImGuiLogManager::AddLog("Socket", "getaddrinfo failed for " + address, LogSeverity::Error);
+			co_return -1;
+		}
+
+		// The race of RaceConnect, waiting on the loop instead of in select
+		struct Attempt {
+			SOCKET socket;
+			size_t index;
+			std::chrono::steady_clock::time_point deadline;
+		};
+		std::vector<Attempt> attempts;
+		size_t next = 0;
+		auto nextStart = std::chrono::steady_clock::now();
+		SOCKET connected = INVALID_SOCKET;
+		size_t winner = 0;
+		while (connected == INVALID_SOCKET) {
+			auto now = std::chrono::steady_clock::now();
+			if (now >= deadline)
+				break;
+			if (next < candidates.size() && (attempts.empty() || now >= nextStart)) {
+				bool done = false;
+				SOCKET s = StartConnectAttempt(candidates[next], sockType, proto, done);
+				if (done) {
+					connected = s;
+					winner = next;
+					break;
+				}
+				if (s != INVALID_SOCKET) {
+					attempts.push_back({ s, next, std::min(deadline, now + std::chrono::milliseconds(connectAttemptTimeoutMs)) });
+					nextStart = now + std::chrono::milliseconds(ConnectionAttemptDelayMs);
+				}
+				else {
+					nextStart = now;
+				}
+				next++;
+				continue;
+			}
+			if (attempts.empty())
+				break;
+
+			auto wake = deadline;
+			if (next < candidates.size())
+				wake = std::min(wake, nextStart);
+			std::vector<SocketWait> waits;
+			for (const auto& attempt : attempts) {
+				waits.push_back({ attempt.socket, true });
+				wake = std::min(wake, attempt.deadline);
+			}
+			int ready = co_await WaitForSockets(loop, std::move(waits), MillisecondsUntil(wake));
+			if (ready < 0)
+				break; // The loop stopped
+			now = std::chrono::steady_clock::now();
+			if (ready > 0) {
+				Attempt attempt = attempts[ready - 1];
+				attempts.erase(attempts.begin() + (ready - 1));
+				int soError = 0;
+				socklen_t errLen = sizeof(soError);
+				getsockopt(attempt.socket, SOL_SOCKET, SO_ERROR, (char*)&soError, &errLen);
+				if (soError == 0) {
+					connected = attempt.socket;
+					winner = attempt.index;
+					break;
+				}
+				LogAttemptFailure(candidates[attempt.index], true);
+				closesocket(attempt.socket);
+				nextStart = now; // A failed attempt hands over to the next candidate immediately
+			}
+			for (size_t i = 0; i < attempts.size();) {
+				if (now < attempts[i].deadline) {
+					++i;
+					continue;
+				}
+				LogAttemptFailure(candidates[attempts[i].index], false);
+				closesocket(attempts[i].socket);
+				attempts.erase(attempts.begin() + i);
+				nextStart = now;
+			}
+		}
+		for (const auto& attempt : attempts)
+			closesocket(attempt.socket);
+		if (connected == INVALID_SOCKET) {
+			if (nomSocket->stats) nomSocket->stats->RecordError(std::chrono::steady_clock::now() >= deadline ? SocketErrorType::Timeout : SocketErrorType::Connect);
+			ImGuiLogManager::AddLog("Socket", "Connection to " + address + " failed!", LogSeverity::Error);
+			co_return -1;
+		}
+
+		SSL* ssl = nullptr;
+		if (sslData) {
+			ssl = NewClientSsl(connected, address.c_str());
+			while (true) {
+				int ret = SSL_connect(ssl);
+				if (ret == 1)
+					break;
+				int sslErr = SSL_get_error(ssl, ret);
+				// The handshake shares the connect deadline
+				int remainingMs = MillisecondsUntil(deadline);
+				if ((sslErr == SSL_ERROR_WANT_READ || sslErr == SSL_ERROR_WANT_WRITE) && remainingMs > 0) {
+					if (co_await WaitForSocket(loop, connected, sslErr == SSL_ERROR_WANT_WRITE, remainingMs) > 0)
+						continue;
+				}
+				unsigned long errCode = ERR_get_error();
+				ImGuiLogManager::AddLog("Socket", std::string("SSL connection failed! ") + ERR_error_string(errCode, nullptr) + " (SSL Error code: " + std::to_string(sslErr) + ")", LogSeverity::Error);
+				SSL_free(ssl);
+				closesocket(connected);
+				if (nomSocket->stats) nomSocket->stats->RecordError(SocketErrorType::TlsHandshake);
+				co_return -1;
+			}
+		}
+
+		if (nomSocket->stats) {
+			nomSocket->stats->RecordConnect();
+			if (ssl) nomSocket->stats->RecordTlsHandshake();
+		}
+		SetSocketAddress(nomSocket, candidates[winner]);
+		ImGuiLogManager::AddLog("Socket", std::string("Socket '") + nomSocket->name + "' connected to " + nomSocket->address + " on port " + std::to_string(port) + (ssl ? " over TLS!" : "!"), LogSeverity::Info);
+		FinishConnect(nomSocket, connected, ssl, true);
+		co_return 0;
+	}
+
+	Task<int> NomSocketManager::SendAllAsync(SocketEventLoop& loop, std::string socketName, std::string data, bool sslData, std::chrono::steady_clock::time_point deadline)
+	{
+		size_t sent = 0;
+		while (sent < data.size()) {
+			// A TLS write that wants the socket again has to be repeated with the same bytes, which it is
+			int result = SendData(socketName.c_str(), data.data() + sent, static_cast<int>(data.size() - sent), sslData);
+			if (result > 0) {
+				sent += result;
+				continue;
+			}
+			SOCKET s = GetConnectedSocket(socketName.c_str());
+			int remainingMs = MillisecondsUntil(deadline);
+			if (result != WouldBlock || s == INVALID_SOCKET || remainingMs <= 0)
+				co_return -1;
+			if (co_await WaitForSocket(loop, s, true, remainingMs) <= 0)
+				co_return -1;
+		}
+		co_return 0;
+	}
+
+	Task<int> NomSocketManager::ReceiveAsync(SocketEventLoop& loop, std::string socketName, char* buffer, int length, bool sslData, std::chrono::steady_clock::time_point deadline)
+	{
+		while (true) {
+			int result = ReceiveData(socketName.c_str(), buffer, length, sslData);
+			if (result != WouldBlock)
+				co_return result;
+			// A TLS read only wants to write during a renegotiation, which TLS 1.3 dropped, so it waits to read
+			SOCKET s = GetConnectedSocket(socketName.c_str());
+			int remainingMs = MillisecondsUntil(deadline);
+			if (s == INVALID_SOCKET || remainingMs <= 0)
+				co_return -1;
+			if (co_await WaitForSocket(loop, s, false, remainingMs) <= 0)
+				co_return -1;
+		}
+	}
+
 	int NomSocketManager::CloseAllSockets()
 	{
-		for (int i = 0; i < socketCount; i++) {
+		for (int i = 0; i < maxSockets; i++) {
 			if (sockets[i] != nullptr && sockets[i]->getStatus() == 1) {
 				CloseSocket(sockets[i]->name);
 			}
@@ -1,9 +1,16 @@
 #ifndef __NOMSOCKETMANAGER_H__
 #define __NOMSOCKETMANAGER_H__
 #include <vector>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include "SocketStats.h"
+#include "SocketEventLoop.h"
+#include "../Core/Async/Task.h"
 #define WIN32_LEAN_AND_MEAN
 #include <WinSock2.h>
-#include <winsock.h>
+#include <ws2tcpip.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
@@ -14,26 +21,30 @@ namespace NomBotCore {
 		char* name;
 		int id;
 		int type; // 1 = TCP, 2 = UDP
-		int protocol; // 1 = IPv4, 2 = IPv6
+		int protocol; // 0 = Any (IPv6 and IPv4 raced), 1 = IPv4, 2 = IPv6
 		int status; // 1 = connected, 0 = disconnected
+		bool nonBlocking = false; // Until the next connect or close
 		char* host;
 		char* address;
 		int port;
 		SOCKET* socket;
 		SSL* ssl;
+		SocketStats* stats;
 
 		NomSocket(int socketId, int socketType, int socketProtocol, const char* socketAddress, int socketPort)
-			: id(socketId), type(socketType), protocol(socketProtocol), status(0), port(socketPort), socket(nullptr), address(nullptr), ssl(nullptr) {
+			: name(nullptr), id(socketId), type(socketType), protocol(socketProtocol), status(0), host(nullptr), address(nullptr), port(socketPort), socket(nullptr), ssl(nullptr), stats(nullptr) {
 			address = new char[strlen(socketAddress) + 1];
 			strcpy_s(address, strlen(socketAddress) + 1, socketAddress);
 		}
 		NomSocket(int socketId, int socketType, int socketProtocol)
-			: id(socketId), type(socketType), protocol(socketProtocol), status(0), socket(nullptr), address(nullptr), ssl(nullptr) {}
+			: name(nullptr), id(socketId), type(socketType), protocol(socketProtocol), status(0), host(nullptr), address(nullptr), port(0), socket(nullptr), ssl(nullptr), stats(nullptr) {}
 		~NomSocket() {
 			if (address) delete[] address;
+			if (host) delete[] host;
 			if (name) delete[] name;
 			if (socket) delete socket;
 			if (ssl) SSL_free(ssl);
+			SocketStatsRegistry::Release(stats);
 		}
 		//Get socket by id
 		int getId() const { return id; }
@@ -45,13 +56,24 @@ namespace NomBotCore {
 		void setStatus(int socketStatus) { status = socketStatus; }
 	};
 
+	struct SocketAddress {
+		sockaddr_storage storage = {};
+		int length = 0;
+	};
+
+	class DnsResolver;
+
 	class NomSocketManager {
 	public:
-		NomSocketManager();
+		// Every channel context holds a WebSocket and pooled Helix connections in the same manager
+		NomSocketManager(int socketLimit = 64);
 		~NomSocketManager();
 		int Initialize();
 		int BindSocket(const char* socketName, const char* address, int port);
+		// clientAddress must hold at least INET6_ADDRSTRLEN characters
 		int AcceptConnection(const char* socketName, char* clientAddress, int* clientPort);
+		// Same, but the accepted socket is created as acceptedName so several can be open at once
+		int AcceptConnection(const char* socketName, const char* acceptedName, char* clientAddress, int* clientPort);
 		int CreateSocket(const char* name, int type, int protocol);
 		int ConnectSocket(const char* socketName, const char* address, int port, bool sslData = false);
 		int SendData(const char* socketName, const char* data, int length, bool sslData = false);
@@ -61,6 +83,33 @@ namespace NomBotCore {
 		int CloseAllSockets();
 		int RemoveSocket(const char* socketName);
 		int GetSocketStatus(const char* socketName);
+		int SetSocketTimeout(const char* socketName, int timeoutMs);
+		// On a non-blocking socket SendData and ReceiveData return WouldBlock instead of waiting, a TLS
+		// socket included. A connect makes the socket blocking again.
+		int SetNonBlocking(const char* socketName, bool nonBlocking);
+		static constexpr int WouldBlock = -2;
+		// Waits up to timeoutMs for any of the sockets to become readable, a listening socket is readable once
+		// a connection is waiting to be accepted, and a TLS socket as long as OpenSSL holds decrypted bytes
+		// select can't see. Returns how many are ready (their names go to ready) or -1.
+		int WaitReadable(const std::vector<std::string>& socketNames, int timeoutMs, std::vector<std::string>& ready);
+		// Same, and also waits on raw sockets, the indices of the ready ones go to rawReady
+		int WaitSockets(const std::vector<std::string>& socketNames, const std::vector<SocketWait>& raw, int timeoutMs, std::vector<std::string>& ready, std::vector<size_t>& rawReady);
+		// The socket under a connected name for a raw wait, e.g. for it to be writable. INVALID_SOCKET otherwise.
+		SOCKET GetConnectedSocket(const char* socketName);
+		// Counterparts for coroutines that never block the calling thread, every wait, the DNS lookup included, goes
+		// through loop and the coroutine resumes on its thread. A socket connected this way stays non-blocking.
+		Task<int> ConnectSocketAsync(SocketEventLoop& loop, std::string socketName, std::string address, int port, bool sslData = false);
+		// Returns 0 once all of data is sent, -1 on an error or at the deadline
+		Task<int> SendAllAsync(SocketEventLoop& loop, std::string socketName, std::string data, bool sslData, std::chrono::steady_clock::time_point deadline);
+		// Waits for at least one byte, returns like ReceiveData and -1 at the deadline
+		Task<int> ReceiveAsync(SocketEventLoop& loop, std::string socketName, char* buffer, int length, bool sslData, std::chrono::steady_clock::time_point deadline);
+		void SetConnectTimeouts(int attemptTimeoutMs, int totalTimeoutMs);
+		// Connects resolve through this, use it for prefetching and host overrides
+		DnsResolver& GetResolver() { return *resolver; }
+		// Off by default, payloads carry OAuth tokens. Logged payloads go through RedactPayload.
+		void SetPayloadLogging(bool enable) { logPayloads = enable; }
+		bool IsPayloadLoggingEnabled() const { return logPayloads; }
+		static std::string RedactPayload(const char* data, int length);
 		int SendPongFrame();
 	private:
 		int socketCount;
@@ -68,15 +117,40 @@ namespace NomBotCore {
 		std::vector<NomSocket*> sockets;
 
 		int BindSocket(int socketId, const char* address, int port);
-		int AcceptConnection(int socketId, char* clientAddress, int* clientPort);
+		int AcceptConnection(int socketId, const char* acceptedName, char* clientAddress, int* clientPort);
 		int ConnectSocket(int socketId, const char* address, int port, bool sslData = false);
 		int SendData(int socketId, const char* data, int length, bool sslData = false);
 		int ReceiveData(int socketId, char* buffer, int length, bool sslData = false);
 		int Listen(int socketId, int backlog);
 		int CloseSocket(int socketId);
 		int RemoveSocket(int socketId);
+		int SetSocketTimeout(int socketId, int timeoutMs);
+		int SetNonBlocking(int socketId, bool nonBlocking);
 
 		int SocketNameToId(const char* name);
+		std::mutex socketTableMutex;
+
+		int ResolveAddress(const char* address, int port, int protocol, int sockType, int proto, bool passive, std::vector<SocketAddress>& candidates);
+		static void OrderCandidates(std::vector<SocketAddress>& resolved, int port, std::vector<SocketAddress>& candidates);
+		SOCKET RaceConnect(const std::vector<SocketAddress>& candidates, int sockType, int proto, std::chrono::steady_clock::time_point deadline, size_t& winner);
+		// A non-blocking socket with its connect started, connected is set if it finished right away
+		static SOCKET StartConnectAttempt(const SocketAddress& candidate, int sockType, int proto, bool& connected);
+		static void LogAttemptFailure(const SocketAddress& candidate, bool failed);
+		SSL* NewClientSsl(SOCKET s, const char* host);
+		// Hands a connected socket to nomSocket
+		static void FinishConnect(NomSocket* nomSocket, SOCKET s, SSL* ssl, bool nonBlocking);
+		static void FormatSocketAddress(const SocketAddress& address, char* text, size_t textLength, int* port);
+		static void SetSocketAddress(NomSocket* nomSocket, const SocketAddress& address);
+		static int SetRawSocketTimeout(SOCKET s, int timeoutMs);
+		static int64_t MicrosecondsSince(std::chrono::steady_clock::time_point start);
+		static void RecordIoError(NomSocket* nomSocket, SocketErrorType type);
+
+		DnsResolver* resolver = nullptr;
+		std::atomic<bool> logPayloads{ false };
+		int connectAttemptTimeoutMs = 5000;
+		int connectTimeoutMs = 15000;
+		// RFC 8305 recommends 250 ms between starting connection attempts
+		static constexpr int ConnectionAttemptDelayMs = 250;
 	protected:
 		SSL_CTX* sslCtx;
 	};
@@ -1,11 +1,10 @@
 #include "nompch.h"
 #include "NomWebSocket.h"
 #include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Logging/StructuredLog.h"
+#include "../Core/Tracing/Trace.h"
 
 namespace NomBotCore {
-	std::map<std::string, std::string> m_HandshakeHeaders;
-	std::mutex socketMutex;
-
 	std::string base64_encode(const unsigned char* input, int length) {
 		BIO* bmem = nullptr;
 		BIO* b64 = nullptr;
@@ -30,56 +29,69 @@ namespace NomBotCore {
 		return base64_encode(sha1Hash, SHA_DIGEST_LENGTH);
 	}
 
-	NomWebSocket::NomWebSocket(NomSocketManager& socketManager)
-		: m_SocketManager(socketManager) // Use member initializer list
+	NomWebSocket::NomWebSocket(NomSocketManager& socketManager, const std::string& socketName)
+		: m_SocketManager(socketManager), m_SocketName(socketName) // Use member initializer list
 	{
-		m_SocketManager.CreateSocket(WEBOCKETNAME, 1, 1); // TCP, IPv4
+		m_SocketManager.CreateSocket(m_SocketName.c_str(), 1, 0); // TCP, IPv6 and IPv4 raced
 	}
 
 	NomWebSocket::~NomWebSocket()
 	{
-		m_SocketManager.CloseSocket(WEBOCKETNAME);
-		m_SocketManager.RemoveSocket(WEBOCKETNAME);
+		m_SocketManager.CloseSocket(m_SocketName.c_str());
+		m_SocketManager.RemoveSocket(m_SocketName.c_str());
 	}
 
 	int NomWebSocket::HandleWebSocketHandshake(bool sslData)
 	{
-		char buffer[4096] = { 0 };
+		char buffer[4096];
+		std::string response;
+		int result = 0;
 		ImGuiLogManager::AddLog("WebSocket", "Waiting to receive WebSocket handshake request...", LogSeverity::Info);
-		int bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, buffer, sizeof(buffer) - 1, sslData);
-		if (bytesReceived <= 0) {
-			ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket handshake request. Socket may not be connected or client did not send data.", LogSeverity::Error);
+		while (result == 0) {
+			int bytesReceived = m_SocketManager.ReceiveData(m_SocketName.c_str(), buffer, sizeof(buffer), sslData);
+			if (bytesReceived <= 0) {
+				ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket handshake request. Socket may not be connected or client did not send data.", LogSeverity::Error);
+				return -1;
+			}
+			response.append(buffer, bytesReceived);
+			result = TakeHandshakeResponse(response);
+		}
+		return result == 1 ? 0 : -1;
+	}
+
+	int NomWebSocket::TakeHandshakeResponse(std::string& response)
+	{
+		// The server may send its first frames right behind the headers, in the same read
+		size_t headerEnd = response.find("\r\n\r\n");
+		if (headerEnd == std::string::npos) {
+			if (response.size() <= MaxHandshakeBytes)
+				return 0;
+			ImGuiLogManager::AddLog("WebSocket", "WebSocket handshake response headers are too long.", LogSeverity::Error);
 			return -1;
 		}
-		std::string request(buffer, bytesReceived);
-		ImGuiLogManager::AddLog("WebSocket", "Received WebSocket handshake request:\n" + request, LogSeverity::Info);
+		m_ReadBuffer.assign(response, headerEnd + 4, std::string::npos);
+		response.resize(headerEnd + 4);
+		ImGuiLogManager::AddLog("WebSocket", "Received WebSocket handshake request:\n" + response, LogSeverity::Info);
 
-		size_t keyPos = request.find("Sec-WebSocket-Accept: ");
+		size_t keyPos = response.find("Sec-WebSocket-Accept: ");
 		if (keyPos == std::string::npos) {
 			ImGuiLogManager::AddLog("WebSocket", "Sec-WebSocket-Accept header not found.", LogSeverity::Error);
 			return -1;
 		}
-		size_t keyEnd = request.find("\r\n", keyPos);
+		size_t keyEnd = response.find("\r\n", keyPos);
 		if (keyEnd == std::string::npos) {
 			ImGuiLogManager::AddLog("WebSocket", "Malformed Sec-WebSocket-Accept header.", LogSeverity::Error);
 			return -1;
 		}
-		return 0;
+		return 1;
 	}
 
-	int NomWebSocket::ConnectWebSocket(const char* address, int port, bool sslData)
+	std::string NomWebSocket::BuildHandshakeRequest(const std::string& address, const std::string& path)
 	{
-		int result = m_SocketManager.ConnectSocket(WEBOCKETNAME, address, port, sslData);
-		if (result < 0) {
-			ImGuiLogManager::AddLog("WebSocket", "Failed to connect to " + std::string(address) + ":" + std::to_string(port), LogSeverity::Error);
-			m_SocketManager.CloseSocket(WEBOCKETNAME);
-			m_SocketManager.RemoveSocket(WEBOCKETNAME);
-			return -1;
-		}
 		std::string generatedKey = "x3JJHMbDL1EzLkh9GBhXDw=="; // TODO: In a real implementation, generate a random base64-encoded key
 		std::string handshakeRequest =
-			"GET /ws HTTP/1.1\r\n"
-			"Host: " + std::string(address) + "\r\n"
+			"GET " + path + " HTTP/1.1\r\n"
+			"Host: " + address + "\r\n"
 			"Upgrade: websocket\r\n"
 			"Connection: Upgrade\r\n"
 			"Sec-WebSocket-Key: " + generatedKey + "\r\n"
@@ -89,21 +101,80 @@ namespace NomBotCore {
 			ImGuiLogManager::AddLog("WebSocket", "Added custom header: " + std::string(header.first) + ": " + std::string(header.second), LogSeverity::Info);
 		}
 		handshakeRequest += "\r\n";
-		m_SocketManager.SendData(WEBOCKETNAME, handshakeRequest.c_str(), handshakeRequest.length(), sslData);
+		return handshakeRequest;
+	}
+
+	int NomWebSocket::ConnectWebSocket(const char* address, int port, bool sslData)
+	{
+		m_SslData = sslData;
+		m_ReadBuffer.clear();
+		m_PeerGone = false;
+		int result = m_SocketManager.ConnectSocket(m_SocketName.c_str(), address, port, sslData);
+		if (result < 0) {
+			ImGuiLogManager::AddLog("WebSocket", "Failed to connect to " + std::string(address) + ":" + std::to_string(port), LogSeverity::Error);
+			return -1;
+		}
+		std::string handshakeRequest = BuildHandshakeRequest(address);
+		m_SocketManager.SendData(m_SocketName.c_str(), handshakeRequest.c_str(), handshakeRequest.length(), sslData);
 		result = HandleWebSocketHandshake(sslData);
 		if (result < 0) {
 			ImGuiLogManager::AddLog("WebSocket", "WebSocket handshake failed with " + std::string(address) + ":" + std::to_string(port), LogSeverity::Error);
-			m_SocketManager.CloseSocket(WEBOCKETNAME);
-			m_SocketManager.RemoveSocket(WEBOCKETNAME);
+			Close();
 			return -1;
 		}
 		ImGuiLogManager::AddLog("WebSocket", "WebSocket connection established with " + std::string(address) + ":" + std::to_string(port), LogSeverity::Info);
+		m_Open = true;
 		return 0;
 	}
 
+	Task<int> NomWebSocket::ConnectWebSocketAsync(SocketEventLoop& loop, std::string address, int port, bool sslData, std::string path)
+	{
+		m_SslData = sslData;
+		m_ReadBuffer.clear();
+		m_PeerGone = false;
+		std::string endpoint = address + ":" + std::to_string(port);
+		if (co_await m_SocketManager.ConnectSocketAsync(loop, m_SocketName, address, port, sslData) < 0) {
+			ImGuiLogManager::AddLog("WebSocket", "Failed to connect to " + endpoint, LogSeverity::Error);
+			co_return -1;
+		}
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HandshakeTimeoutMs);
+		int result = co_await m_SocketManager.SendAllAsync(loop, m_SocketName, BuildHandshakeRequest(address, path), sslData, deadline);
+		std::string response;
+		char buffer[4096];
+		while (result == 0) {
+			int bytesReceived = co_await m_SocketManager.ReceiveAsync(loop, m_SocketName, buffer, sizeof(buffer), sslData, deadline);
+			if (bytesReceived <= 0) {
+				ImGuiLogManager::AddLog("WebSocket", "No WebSocket handshake response from " + endpoint, LogSeverity::Error);
+				result = -1;
+				break;
+			}
+			response.append(buffer, bytesReceived);
+			result = TakeHandshakeResponse(response);
+		}
+		if (result != 1) {
+			ImGuiLogManager::AddLog("WebSocket", "WebSocket handshake failed with " + endpoint, LogSeverity::Error);
+			Close();
+			co_return -1;
+		}
+		ImGuiLogManager::AddLog("WebSocket", "WebSocket connection established with " + endpoint, LogSeverity::Info);
+		m_Open = true;
+		co_return 0;
+	}
+
+	void NomWebSocket::Close()
+	{
+		m_Open = false;
+		m_ReadBuffer.clear();
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_WriteBuffer.clear();
+		}
+		if (m_SocketManager.GetSocketStatus(m_SocketName.c_str()) == 1)
+			m_SocketManager.CloseSocket(m_SocketName.c_str());
+	}
+
 	int NomWebSocket::SendWebSocketFrame(const char* data, int length, bool sslData)
 	{
-		std::lock_guard<std::mutex> lock(socketMutex);
 		std::vector<unsigned char> frame;
 		frame.push_back(0x81); // FIN + text frame
 
@@ -131,91 +202,165 @@ namespace NomBotCore {
 			frame.push_back(data[i] ^ maskingKey[i % 4]);
 		}
 
-		int bytesSent = m_SocketManager.SendData(WEBOCKETNAME, reinterpret_cast<const char*>(frame.data()), frame.size(), sslData);
-		if (bytesSent <= 0) {
+		if (QueueWrite(reinterpret_cast<const char*>(frame.data()), frame.size()) != 0) {
 			ImGuiLogManager::AddLog("WebSocket", "Failed to send WebSocket frame. Socket may not be connected.", LogSeverity::Error);
 			return -1;
 		}
-		ImGuiLogManager::AddLog("WebSocket", "Sent WebSocket frame with " + std::to_string(bytesSent) + " bytes.", LogSeverity::Info);
-		ImGuiLogManager::AddLog("WebSocket", std::string("Data: ") + std::string(data, bytesSent), LogSeverity::Info);
+		int bytesSent = static_cast<int>(frame.size());
+		NOM_LOG_INFO("WebSocket", "Sent WebSocket frame with {} bytes.", bytesSent);
+		if (m_SocketManager.IsPayloadLoggingEnabled())
+			NOM_LOG_INFO("WebSocket", "Data: {}", NomSocketManager::RedactPayload(data, length));
 		return bytesSent;
 	}
 
-	const char* NomWebSocket::ReceiveWebSocketFrame(bool sslData)
+	int NomWebSocket::ReadAvailable()
 	{
-		std::lock_guard<std::mutex> lock(socketMutex);
-		unsigned char header[2];
-		int bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, reinterpret_cast<char*>(header), 2, sslData);
-		if (bytesReceived <= 0) {
-			ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket frame header.", LogSeverity::Error);
-			return nullptr;
-		}
-		bool fin = (header[0] & 0x80) != 0;
-		unsigned char opcode = header[0] & 0x0F;
-		bool masked = (header[1] & 0x80) != 0;
-		uint64_t payloadLength = header[1] & 0x7F;
-		if (payloadLength == 126) {
-			unsigned char extended[2];
-			bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, reinterpret_cast<char*>(extended), 2, sslData);
+		char buffer[4096];
+		int total = 0;
+		while (total < MaxReadPerCall) {
+			int bytesReceived = m_SocketManager.ReceiveData(m_SocketName.c_str(), buffer, sizeof(buffer), m_SslData);
+			if (bytesReceived == NomSocketManager::WouldBlock)
+				break;
 			if (bytesReceived <= 0) {
-				ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket frame extended payload length.", LogSeverity::Error);
-				return nullptr;
+				// Frames already buffered still go out through NextFrame first
+				m_PeerGone = true;
+				return total > 0 ? total : -1;
 			}
-			payloadLength = (extended[0] << 8) | extended[1];
+			m_ReadBuffer.append(buffer, bytesReceived);
+			total += bytesReceived;
+		}
+		return total;
+	}
+
+	size_t NomWebSocket::BufferedFrameLength(uint64_t& payloadLength, size_t& headerLength) const
+	{
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(m_ReadBuffer.data());
+		size_t available = m_ReadBuffer.size();
+		if (available < 2)
+			return 0;
+		bool masked = (data[1] & 0x80) != 0;
+		payloadLength = data[1] & 0x7F;
+		headerLength = 2;
+		if (payloadLength == 126) {
+			if (available < 4)
+				return 0;
+			payloadLength = (data[2] << 8) | data[3];
+			headerLength = 4;
 		} else if (payloadLength == 127) {
-			unsigned char extended[8];
-			bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, reinterpret_cast<char*>(extended), 8, sslData);
-			if (bytesReceived <= 0) {
-				ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket frame extended payload length.", LogSeverity::Error);
-				return nullptr;
-			}
+			if (available < 10)
+				return 0;
 			payloadLength = 0;
 			for (int i = 0; i < 8; ++i) {
-				payloadLength = (payloadLength << 8) | extended[i];
+				payloadLength = (payloadLength << 8) | data[2 + i];
 			}
+			headerLength = 10;
 		}
-		unsigned char maskingKey[4];
-		if (masked) {
-			bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, reinterpret_cast<char*>(maskingKey), 4, sslData);
-			if (bytesReceived <= 0) {
-				ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket frame masking key.", LogSeverity::Error);
-				return nullptr;
+		if (masked)
+			headerLength += 4;
+		// Too big to wait for, NextFrame closes the connection
+		if (payloadLength > MaxFrameBytes)
+			return SIZE_MAX;
+		if (available < headerLength + payloadLength)
+			return 0;
+		return headerLength + static_cast<size_t>(payloadLength);
+	}
+
+	bool NomWebSocket::HasBufferedFrame() const
+	{
+		uint64_t payloadLength = 0;
+		size_t headerLength = 0;
+		return BufferedFrameLength(payloadLength, headerLength) != 0;
+	}
+
+	int NomWebSocket::NextFrame(std::string& message)
+	{
+		for (;;) {
+			uint64_t payloadLength = 0;
+			size_t headerLength = 0;
+			size_t frameLength = BufferedFrameLength(payloadLength, headerLength);
+			if (frameLength == SIZE_MAX) {
+				NOM_LOG_ERROR("WebSocket", "WebSocket frame of {} bytes is over the {} byte limit, closing the connection.", payloadLength, MaxFrameBytes);
+				Close();
+				return -1;
 			}
-		}
-		std::vector<unsigned char> payload(payloadLength);
-		size_t totalReceived = 0;
-		while (totalReceived < payloadLength) {
-			bytesReceived = m_SocketManager.ReceiveData(WEBOCKETNAME, reinterpret_cast<char*>(payload.data() + totalReceived), payloadLength - totalReceived, sslData);
-			if (bytesReceived <= 0) {
-				ImGuiLogManager::AddLog("WebSocket", "Failed to receive WebSocket frame payload data.", LogSeverity::Error);
-				return nullptr;
+			if (frameLength == 0) {
+				// A partial frame stays buffered until the rest arrives, unless nothing more will
+				if (m_PeerGone || !m_Open) {
+					if (!m_ReadBuffer.empty())
+						NOM_LOG_ERROR("WebSocket", "WebSocket connection ended with {} bytes of an unfinished frame.", m_ReadBuffer.size());
+					m_Open = false;
+					return -1;
+				}
+				return 0;
 			}
-			totalReceived += bytesReceived;
-		}
-		if (masked) {
-			for (size_t i = 0; i < payloadLength; ++i) {
-				payload[i] ^= maskingKey[i % 4];
+			// Starts once the whole frame is in so the idle wait for it is left out
+			NOM_TRACE_SCOPE("WebSocket frame");
+			const unsigned char* data = reinterpret_cast<const unsigned char*>(m_ReadBuffer.data());
+			unsigned char opcode = data[0] & 0x0F;
+			bool masked = (data[1] & 0x80) != 0;
+			message.assign(m_ReadBuffer, headerLength, static_cast<size_t>(payloadLength));
+			if (masked) {
+				const unsigned char* maskingKey = data + headerLength - 4;
+				for (size_t i = 0; i < message.size(); ++i) {
+					message[i] ^= maskingKey[i % 4];
+				}
+			}
+			m_ReadBuffer.erase(0, frameLength);
+			if ((opcode & 0x8) != 0 && message.size() > 125) {
+				NOM_LOG_ERROR("WebSocket", "Control frame with a {} byte payload, closing the connection.", message.size());
+				Close();
+				return -1;
 			}
+
+			if (opcode == 0x9) { // Ping frame
+				NOM_LOG_INFO("WebSocket", "Received PING frame. Sending PONG response.");
+				SendPongFrame(message.data(), message.size());
+				continue; // No application data to return
+			} else if (opcode == 0xA) { // Pong frame
+				NOM_LOG_INFO("WebSocket", "Received PONG frame.");
+				continue; // No application data to return
+			} else if (opcode == 0x8) { // Connection close frame
+				NOM_LOG_INFO("WebSocket", "Received CLOSE frame. Closing connection.");
+				Close();
+				return -1;
+			}
+			return 1;
 		}
+	}
 
-		if (opcode == 0x9) { // Ping frame
-			ImGuiLogManager::AddLog("WebSocket", "Received PING frame. Sending PONG response.", LogSeverity::Info);
-			SendPongFrame(reinterpret_cast<const char*>(payload.data()), payloadLength);
-			return nullptr; // No application data to return
-		} else if (opcode == 0xA) { // Pong frame
-			ImGuiLogManager::AddLog("WebSocket", "Received PONG frame.", LogSeverity::Info);
-			return nullptr; // No application data to return
-		} else if (opcode == 0x8) { // Connection close frame
-			ImGuiLogManager::AddLog("WebSocket", "Received CLOSE frame. Closing connection.", LogSeverity::Info);
-			m_SocketManager.CloseSocket(WEBOCKETNAME);
-			m_SocketManager.RemoveSocket(WEBOCKETNAME);
-			return nullptr;
+	int NomWebSocket::QueueWrite(const char* data, size_t length)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		// Behind whatever is still waiting, frames must not interleave
+		m_WriteBuffer.append(data, length);
+		return FlushWritesLocked();
+	}
+
+	int NomWebSocket::FlushWrites()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return FlushWritesLocked();
+	}
+
+	int NomWebSocket::FlushWritesLocked()
+	{
+		while (!m_WriteBuffer.empty()) {
+			int bytesSent = m_SocketManager.SendData(m_SocketName.c_str(), m_WriteBuffer.data(), static_cast<int>(m_WriteBuffer.size()), m_SslData);
+			if (bytesSent == NomSocketManager::WouldBlock)
+				return 0; // The next flush picks it up
+			if (bytesSent <= 0) {
+				m_WriteBuffer.clear();
+				return -1;
+			}
+			m_WriteBuffer.erase(0, bytesSent);
 		}
+		return 0;
+	}
 
-		char* message = new char[payloadLength + 1];
-		memcpy(message, payload.data(), payloadLength);
-		message[payloadLength] = '\0';
-		return message;
+	bool NomWebSocket::HasPendingWrites()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return !m_WriteBuffer.empty();
 	}
 
 	int NomWebSocket::SetHandshakeHeader(const std::string& key, const std::string& value) {
@@ -242,12 +387,11 @@ namespace NomBotCore {
 			pongFrame[frameSize++] = pingPayload[i] ^ maskingKey[i % 4];
 		}
 
-		int bytesSent = m_SocketManager.SendData(WEBOCKETNAME, reinterpret_cast<const char*>(pongFrame), frameSize, true);
-		if (bytesSent <= 0) {
+		if (QueueWrite(reinterpret_cast<const char*>(pongFrame), frameSize) != 0) {
 			ImGuiLogManager::AddLog("WebSocket", "Failed to send PONG frame. Socket may not be connected.", LogSeverity::Error);
 			return -1;
 		}
-		ImGuiLogManager::AddLog("WebSocket", "Sent PONG frame with " + std::to_string(bytesSent) + " bytes.", LogSeverity::Info);
-		return bytesSent;
+		NOM_LOG_INFO("WebSocket", "Sent PONG frame with {} bytes.", frameSize);
+		return static_cast<int>(frameSize);
 	}
 }
\ No newline at end of file
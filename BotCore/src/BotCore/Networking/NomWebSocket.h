@@ -6,6 +6,10 @@
 #include <openssl/bio.h>
 #include <openssl/evp.h>
 #include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #define WEBOCKETNAME "WebSocket"
 
@@ -15,16 +19,60 @@ namespace NomBotCore {
 
 	class NomWebSocket {
 	public:
-		NomWebSocket(NomSocketManager& socketManager);
+		// socketName must be unique within the manager, one per connection
+		NomWebSocket(NomSocketManager& socketManager, const std::string& socketName = WEBOCKETNAME);
 		~NomWebSocket();
 		int HandleWebSocketHandshake(bool sslData = false);
+		// Blocks until the handshake is done, switch the socket to non-blocking before reading frames
 		int ConnectWebSocket(const char* address, int port, bool sslData = false);
+		// Connects and shakes hands waiting on loop only, the socket is left non-blocking for ReadAvailable.
+		// path is what the handshake asks for, query included, e.g. from a session_reconnect's reconnect_url.
+		Task<int> ConnectWebSocketAsync(SocketEventLoop& loop, std::string address, int port, bool sslData = false, std::string path = "/ws");
+		// Frames go out in order through a write buffer, whatever a non-blocking socket doesn't take waits
+		// for FlushWrites. TLS follows the last ConnectWebSocket, sslData is only kept for callers.
 		int SendWebSocketFrame(const char* data, int length, bool sslData = false);
-		const char* ReceiveWebSocketFrame(bool sslData = false);
+		// Reads what the socket holds without waiting, up to MaxReadPerCall bytes. Returns the bytes read,
+		// 0 if nothing was waiting, -1 once the connection is gone and nothing came in.
+		int ReadAvailable();
+		// Takes the next complete data frame out of the read buffer, answering pings on the way. Returns 1
+		// with message set, 0 while the next frame is incomplete, -1 once the connection is closed.
+		int NextFrame(std::string& message);
+		// A complete frame is buffered, select won't report the socket for it
+		bool HasBufferedFrame() const;
+		int FlushWrites();
+		bool HasPendingWrites();
 		int SetHandshakeHeader(const std::string& key, const std::string& value);
 		int SendPongFrame(const char* pingPayload, size_t payloadLen);
+		const std::string& GetSocketName() const { return m_SocketName; }
+		// False once the peer closed the connection or a read failed, until the next ConnectWebSocket
+		bool IsOpen() const { return m_Open.load(); }
+		// Closes the connection but keeps the socket registered, ConnectWebSocket can use it again
+		void Close();
 	private:
+		// Length of the first buffered frame once all of it is in, 0 before that and SIZE_MAX past MaxFrameBytes
+		size_t BufferedFrameLength(uint64_t& payloadLength, size_t& headerLength) const;
+		std::string BuildHandshakeRequest(const std::string& address, const std::string& path = "/ws");
+		// 1 once response holds the whole answer, which checks out, 0 while it doesn't yet and -1 if it is bad.
+		// Whatever came in behind the headers stays in m_ReadBuffer.
+		int TakeHandshakeResponse(std::string& response);
+		int QueueWrite(const char* data, size_t length);
+		int FlushWritesLocked();
+
 		NomSocketManager& m_SocketManager;
+		std::string m_SocketName;
+		std::map<std::string, std::string> m_HandshakeHeaders;
+		std::mutex m_Mutex; // Guards m_WriteBuffer, frames are sent from the reader and from callers
+		std::atomic<bool> m_Open{ false };
+		bool m_SslData = true; // From the last ConnectWebSocket
+		// Read side, only touched by one thread at a time: whichever runs the connect, then the reader
+		std::string m_ReadBuffer; // Received bytes not yet taken as frames, the handshake's leftovers first
+		bool m_PeerGone = false; // The socket reported the end, what is buffered is all that will come
+		std::string m_WriteBuffer;
+
+		static constexpr size_t MaxHandshakeBytes = 16 * 1024;
+		static constexpr int HandshakeTimeoutMs = 10000;
+		static constexpr int MaxReadPerCall = 64 * 1024; // Per channel and reader round, a busy channel can't hold up the rest
+		static constexpr uint64_t MaxFrameBytes = 4 * 1024 * 1024; // EventSub messages stay far below this
 	};
 }
 
@@ -0,0 +1,55 @@
+#ifndef __SOCKETEVENTLOOP_H__
+#define __SOCKETEVENTLOOP_H__
+#define WIN32_LEAN_AND_MEAN
+#include <WinSock2.h>
+#include <vector>
+#include <coroutine>
+#include <utility>
+
+namespace NomBotCore {
+	// A raw socket to wait on, e.g. a connect still in flight. A socket waiting to write is also ready once
+	// its connect failed, check SO_ERROR.
+	struct SocketWait {
+		SOCKET socket = INVALID_SOCKET;
+		bool write = false;
+	};
+
+	// Whatever runs the select loop that non-blocking socket calls wait on, TwitchServices' reader in the bot
+	class SocketEventLoop {
+	public:
+		virtual ~SocketEventLoop() = default;
+		// Resumes handle on the loop's thread with *result set to 1 + the index of the first ready socket, 0 once
+		// timeoutMs passed or -1 when the loop stops. Returns false with *result -1 if the loop takes no waits.
+		virtual bool AddSocketWait(std::vector<SocketWait> sockets, int timeoutMs, std::coroutine_handle<> handle, int* result) = 0;
+	};
+
+	// co_await WaitForSocket(loop, socket, false, timeoutMs) gives 1 once it is readable
+	class SocketWaitAwaiter {
+	public:
+		SocketWaitAwaiter(SocketEventLoop& loop, std::vector<SocketWait> sockets, int timeoutMs)
+			: m_Loop(loop), m_Sockets(std::move(sockets)), m_TimeoutMs(timeoutMs) {}
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> handle) { return m_Loop.AddSocketWait(std::move(m_Sockets), m_TimeoutMs, handle, &m_Result); }
+		int await_resume() const { return m_Result; }
+	private:
+		SocketEventLoop& m_Loop;
+		std::vector<SocketWait> m_Sockets;
+		int m_TimeoutMs;
+		int m_Result = -1;
+	};
+
+	inline SocketWaitAwaiter WaitForSockets(SocketEventLoop& loop, std::vector<SocketWait> sockets, int timeoutMs)
+	{
+		return SocketWaitAwaiter(loop, std::move(sockets), timeoutMs);
+	}
+
+	inline SocketWaitAwaiter WaitForSocket(SocketEventLoop& loop, SOCKET socket, bool write, int timeoutMs)
+	{
+		std::vector<SocketWait> sockets(1);
+		sockets[0].socket = socket;
+		sockets[0].write = write;
+		return SocketWaitAwaiter(loop, std::move(sockets), timeoutMs);
+	}
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "nompch.h"
+#include "SocketStats.h"
+
+namespace NomBotCore {
+	SocketStats SocketStatsRegistry::s_Slots[SocketStatsRegistry::MaxSlots];
+	SocketStats SocketStatsRegistry::s_Overflow;
+	SocketStats SocketStatsRegistry::s_Totals;
+
+	namespace {
+		int BucketFor(uint64_t value, int bucketCount)
+		{
+			int bucket = 0;
+			while (value > 1 && bucket < bucketCount - 1) {
+				value >>= 1;
+				bucket++;
+			}
+			return bucket;
+		}
+	}
+
+	void SocketStats::Add(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	void SocketStats::RecordSend(int bytes, int64_t micros)
+	{
+		Add(m_SendCalls, 1);
+		Add(m_BytesSent, bytes > 0 ? static_cast<uint64_t>(bytes) : 0);
+		Add(m_SendLatencyUs[BucketFor(micros > 0 ? static_cast<uint64_t>(micros) : 0, SocketLatencyBuckets)], 1);
+		if (m_Totals)
+			m_Totals->RecordSend(bytes, micros);
+	}
+
+	void SocketStats::RecordReceive(int bytes, int64_t micros)
+	{
+		Add(m_ReceiveCalls, 1);
+		Add(m_BytesReceived, bytes > 0 ? static_cast<uint64_t>(bytes) : 0);
+		Add(m_ReadSizes[BucketFor(bytes > 0 ? static_cast<uint64_t>(bytes) : 0, SocketReadSizeBuckets)], 1);
+		Add(m_ReceiveLatencyUs[BucketFor(micros > 0 ? static_cast<uint64_t>(micros) : 0, SocketLatencyBuckets)], 1);
+		if (m_Totals)
+			m_Totals->RecordReceive(bytes, micros);
+	}
+
+	void SocketStats::RecordConnect()
+	{
+		Add(m_Connects, 1);
+		if (m_Totals)
+			m_Totals->RecordConnect();
+	}
+
+	void SocketStats::RecordTlsHandshake()
+	{
+		Add(m_TlsHandshakes, 1);
+		if (m_Totals)
+			m_Totals->RecordTlsHandshake();
+	}
+
+	void SocketStats::RecordClosedByPeer()
+	{
+		Add(m_ClosedByPeer, 1);
+		if (m_Totals)
+			m_Totals->RecordClosedByPeer();
+	}
+
+	void SocketStats::RecordError(SocketErrorType type)
+	{
+		Add(m_Errors[static_cast<int>(type)], 1);
+		if (m_Totals)
+			m_Totals->RecordError(type);
+	}
+
+	void SocketStats::Reset()
+	{
+		auto zero = [](std::atomic<uint64_t>& counter) { counter.store(0, std::memory_order_relaxed); };
+		zero(m_BytesSent);
+		zero(m_BytesReceived);
+		zero(m_SendCalls);
+		zero(m_ReceiveCalls);
+		zero(m_Connects);
+		zero(m_TlsHandshakes);
+		zero(m_ClosedByPeer);
+		for (auto& counter : m_Errors) zero(counter);
+		for (auto& counter : m_ReadSizes) zero(counter);
+		for (auto& counter : m_SendLatencyUs) zero(counter);
+		for (auto& counter : m_ReceiveLatencyUs) zero(counter);
+	}
+
+	void SocketStats::CopyCounters(SocketStatsSnapshot& snapshot) const
+	{
+		auto load = [](const std::atomic<uint64_t>& counter) { return counter.load(std::memory_order_relaxed); };
+		snapshot.bytesSent = load(m_BytesSent);
+		snapshot.bytesReceived = load(m_BytesReceived);
+		snapshot.sendCalls = load(m_SendCalls);
+		snapshot.receiveCalls = load(m_ReceiveCalls);
+		snapshot.connects = load(m_Connects);
+		snapshot.tlsHandshakes = load(m_TlsHandshakes);
+		snapshot.closedByPeer = load(m_ClosedByPeer);
+		for (int i = 0; i < static_cast<int>(SocketErrorType::Count); ++i) snapshot.errors[i] = load(m_Errors[i]);
+		for (int i = 0; i < SocketReadSizeBuckets; ++i) snapshot.readSizes[i] = load(m_ReadSizes[i]);
+		for (int i = 0; i < SocketLatencyBuckets; ++i) snapshot.sendLatencyUs[i] = load(m_SendLatencyUs[i]);
+		for (int i = 0; i < SocketLatencyBuckets; ++i) snapshot.receiveLatencyUs[i] = load(m_ReceiveLatencyUs[i]);
+	}
+
+	SocketStats* SocketStatsRegistry::Acquire(const char* name)
+	{
+		for (auto& slot : s_Slots) {
+			bool expected = false;
+			if (!slot.m_InUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+				continue;
+			slot.m_Sequence.fetch_add(1, std::memory_order_acq_rel);
+			slot.Reset();
+			size_t i = 0;
+			for (; name && name[i] != '\0' && i < sizeof(slot.m_Name) - 1; ++i)
+				slot.m_Name[i].store(name[i], std::memory_order_relaxed);
+			slot.m_Name[i].store('\0', std::memory_order_relaxed);
+			slot.m_Totals = &s_Totals;
+			slot.m_Sequence.fetch_add(1, std::memory_order_release);
+			return &slot;
+		}
+		return AcquireOverflow();
+	}
+
+	SocketStats* SocketStatsRegistry::AcquireOverflow()
+	{
+		// Set up by the first socket that finds the table full, never released
+		static SocketStats* overflow = [] {
+			const char name[] = "other";
+			for (size_t i = 0; i < sizeof(name); ++i)
+				s_Overflow.m_Name[i].store(name[i], std::memory_order_relaxed);
+			s_Overflow.m_Totals = &s_Totals;
+			s_Overflow.m_InUse.store(true, std::memory_order_release);
+			return &s_Overflow;
+		}();
+		return overflow;
+	}
+
+	void SocketStatsRegistry::Release(SocketStats* stats)
+	{
+		if (stats && stats != &s_Overflow)
+			stats->m_InUse.store(false, std::memory_order_release);
+	}
+
+	void SocketStatsRegistry::Snapshot(std::vector<SocketStatsSnapshot>& sockets)
+	{
+		sockets.clear();
+		auto copySlot = [&sockets](const SocketStats& slot) {
+			// A slot being reassigned mid-copy is retried a few times, then skipped for this frame
+			for (int attempt = 0; attempt < 4; ++attempt) {
+				uint32_t before = slot.m_Sequence.load(std::memory_order_acquire);
+				if (before & 1)
+					continue;
+				SocketStatsSnapshot snapshot;
+				for (const auto& c : slot.m_Name) {
+					char value = c.load(std::memory_order_relaxed);
+					if (value == '\0')
+						break;
+					snapshot.name.push_back(value);
+				}
+				slot.CopyCounters(snapshot);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.m_Sequence.load(std::memory_order_relaxed) == before) {
+					sockets.push_back(std::move(snapshot));
+					break;
+				}
+			}
+		};
+		for (const auto& slot : s_Slots) {
+			if (slot.m_InUse.load(std::memory_order_acquire))
+				copySlot(slot);
+		}
+		if (s_Overflow.m_InUse.load(std::memory_order_acquire))
+			copySlot(s_Overflow);
+	}
+
+	void SocketStatsRegistry::SnapshotTotals(SocketStatsSnapshot& totals)
+	{
+		totals = SocketStatsSnapshot();
+		totals.name = "total";
+		s_Totals.CopyCounters(totals);
+	}
+}
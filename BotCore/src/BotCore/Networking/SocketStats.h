@@ -0,0 +1,97 @@
+#ifndef __SOCKETSTATS_H__
+#define __SOCKETSTATS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NomBotCore {
+	enum class SocketErrorType {
+		Connect = 0,
+		TlsHandshake,
+		Send,
+		Receive,
+		Timeout,
+		Count
+	};
+
+	// Read sizes and call latencies are bucketed by powers of two: bucket i counts values in [2^i, 2^(i+1)),
+	// bucket 0 also takes 0 and the last bucket takes everything above its lower bound
+	constexpr int SocketReadSizeBuckets = 17; // bytes, last bucket is 64 KB and up
+	constexpr int SocketLatencyBuckets = 24; // microseconds, last bucket is ~8 s and up
+
+	struct SocketStatsSnapshot {
+		std::string name;
+		uint64_t bytesSent = 0;
+		uint64_t bytesReceived = 0;
+		uint64_t sendCalls = 0;
+		uint64_t receiveCalls = 0;
+		uint64_t connects = 0;
+		uint64_t tlsHandshakes = 0;
+		uint64_t closedByPeer = 0;
+		uint64_t errors[static_cast<int>(SocketErrorType::Count)] = {};
+		uint64_t readSizes[SocketReadSizeBuckets] = {};
+		uint64_t sendLatencyUs[SocketLatencyBuckets] = {};
+		uint64_t receiveLatencyUs[SocketLatencyBuckets] = {};
+	};
+
+	// Counters for one socket. Writers only use relaxed atomic adds, readers copy them through
+	// SocketStatsRegistry without taking any lock the I/O threads could be holding.
+	class SocketStats {
+	public:
+		void RecordSend(int bytes, int64_t micros);
+		void RecordReceive(int bytes, int64_t micros);
+		void RecordConnect();
+		void RecordTlsHandshake();
+		void RecordClosedByPeer();
+		void RecordError(SocketErrorType type);
+	private:
+		friend class SocketStatsRegistry;
+
+		void Add(std::atomic<uint64_t>& counter, uint64_t value);
+		void Reset();
+		void CopyCounters(SocketStatsSnapshot& snapshot) const;
+
+		std::atomic<bool> m_InUse{ false };
+		// Odd while the slot is being handed to a new socket, readers retry when it changes under them
+		std::atomic<uint32_t> m_Sequence{ 0 };
+		std::atomic<char> m_Name[64] = {};
+		SocketStats* m_Totals = nullptr;
+
+		std::atomic<uint64_t> m_BytesSent{ 0 };
+		std::atomic<uint64_t> m_BytesReceived{ 0 };
+		std::atomic<uint64_t> m_SendCalls{ 0 };
+		std::atomic<uint64_t> m_ReceiveCalls{ 0 };
+		std::atomic<uint64_t> m_Connects{ 0 };
+		std::atomic<uint64_t> m_TlsHandshakes{ 0 };
+		std::atomic<uint64_t> m_ClosedByPeer{ 0 };
+		std::atomic<uint64_t> m_Errors[static_cast<int>(SocketErrorType::Count)] = {};
+		std::atomic<uint64_t> m_ReadSizes[SocketReadSizeBuckets] = {};
+		std::atomic<uint64_t> m_SendLatencyUs[SocketLatencyBuckets] = {};
+		std::atomic<uint64_t> m_ReceiveLatencyUs[SocketLatencyBuckets] = {};
+	};
+
+	// Fixed table of stats slots shared by every NomSocketManager. Slots are never freed, so a reader
+	// can snapshot while sockets are created and removed on other threads.
+	class SocketStatsRegistry {
+	public:
+		// Once every slot is taken the rest share one named "other", which still counts toward the totals
+		static SocketStats* Acquire(const char* name);
+		static void Release(SocketStats* stats);
+
+		static void Snapshot(std::vector<SocketStatsSnapshot>& sockets);
+		// Totals over every socket that ever existed, including removed ones
+		static void SnapshotTotals(SocketStatsSnapshot& totals);
+
+		static constexpr int MaxSlots = 128;
+	private:
+		static SocketStats* AcquireOverflow();
+
+		static SocketStats s_Slots[MaxSlots];
+		static SocketStats s_Overflow;
+		static SocketStats s_Totals;
+	};
+}
+
+#endif
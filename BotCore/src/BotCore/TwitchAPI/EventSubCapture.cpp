@@ -0,0 +1,140 @@
+#include "nompch.h"
+#include "EventSubCapture.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include <cstring>
+
+namespace NomBotCore {
+	namespace {
+		const char CaptureMagic[8] = { 'N', 'O', 'M', 'C', 'A', 'P', '1', '\n' };
+		// A frame larger than this is a corrupt length, not a real message
+		constexpr uint64_t MaxFrameBytes = 16 * 1024 * 1024;
+
+		size_t PutVarint(unsigned char* out, uint64_t value)
+		{
+			size_t length = 0;
+			while (value >= 0x80) {
+				out[length++] = static_cast<unsigned char>(value | 0x80);
+				value >>= 7;
+			}
+			out[length++] = static_cast<unsigned char>(value);
+			return length;
+		}
+	}
+
+	EventSubCaptureWriter::~EventSubCaptureWriter()
+	{
+		Close();
+	}
+
+	int EventSubCaptureWriter::Open(const std::string& path)
+	{
+		Close();
+		m_File = std::fopen(path.c_str(), "wb");
+		if (!m_File) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to open capture file " + path, LogSeverity::Error);
+			return -1;
+		}
+		int64_t startedAt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		unsigned char header[16];
+		std::memcpy(header, CaptureMagic, 8);
+		for (int i = 0; i < 8; ++i)
+			header[8 + i] = static_cast<unsigned char>(static_cast<uint64_t>(startedAt) >> (i * 8));
+		std::fwrite(header, 1, sizeof(header), m_File);
+		m_Last = std::chrono::steady_clock::now();
+		ImGuiLogManager::AddLog("TwitchAPI", "Capturing EventSub frames to " + path, LogSeverity::Info);
+		return 0;
+	}
+
+	void EventSubCaptureWriter::Close()
+	{
+		if (!m_File)
+			return;
+		std::fclose(m_File);
+		m_File = nullptr;
+	}
+
+	int EventSubCaptureWriter::Write(const char* data, size_t length, std::chrono::steady_clock::time_point receivedAt)
+	{
+		if (!m_File)
+			return -1;
+		int64_t gap = std::chrono::duration_cast<std::chrono::microseconds>(receivedAt - m_Last).count();
+		m_Last = receivedAt;
+		unsigned char prefix[20];
+		size_t prefixLength = PutVarint(prefix, gap > 0 ? static_cast<uint64_t>(gap) : 0);
+		prefixLength += PutVarint(prefix + prefixLength, length);
+		if (std::fwrite(prefix, 1, prefixLength, m_File) != prefixLength || std::fwrite(data, 1, length, m_File) != length) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to write capture frame, stopping capture.", LogSeverity::Error);
+			Close();
+			return -1;
+		}
+		return 0;
+	}
+
+	EventSubCaptureReader::~EventSubCaptureReader()
+	{
+		Close();
+	}
+
+	int EventSubCaptureReader::Open(const std::string& path)
+	{
+		Close();
+		m_File = std::fopen(path.c_str(), "rb");
+		if (!m_File) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to open capture file " + path, LogSeverity::Error);
+			return -1;
+		}
+		unsigned char header[16];
+		if (std::fread(header, 1, sizeof(header), m_File) != sizeof(header) || std::memcmp(header, CaptureMagic, 8) != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", path + " is not an EventSub capture file.", LogSeverity::Error);
+			Close();
+			return -1;
+		}
+		uint64_t startedAt = 0;
+		for (int i = 0; i < 8; ++i)
+			startedAt |= static_cast<uint64_t>(header[8 + i]) << (i * 8);
+		m_StartedAtMicros = static_cast<int64_t>(startedAt);
+		m_OffsetMicros = 0;
+		return 0;
+	}
+
+	void EventSubCaptureReader::Close()
+	{
+		if (!m_File)
+			return;
+		std::fclose(m_File);
+		m_File = nullptr;
+	}
+
+	int EventSubCaptureReader::ReadVarint(uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			int c = std::fgetc(m_File);
+			if (c == EOF)
+				return shift == 0 ? 1 : -1;
+			value |= static_cast<uint64_t>(c & 0x7F) << shift;
+			if (!(c & 0x80))
+				return 0;
+		}
+		return -1;
+	}
+
+	int EventSubCaptureReader::Next(EventSubCaptureFrame& frame)
+	{
+		if (!m_File)
+			return -1;
+		uint64_t gap = 0;
+		uint64_t length = 0;
+		int result = ReadVarint(gap);
+		if (result != 0)
+			return result;
+		if (ReadVarint(length) != 0 || length > MaxFrameBytes)
+			return -1;
+		frame.payload.resize(static_cast<size_t>(length));
+		if (length > 0 && std::fread(&frame.payload[0], 1, static_cast<size_t>(length), m_File) != length)
+			return -1;
+		m_OffsetMicros += static_cast<int64_t>(gap);
+		frame.offsetMicros = m_OffsetMicros;
+		return 0;
+	}
+}
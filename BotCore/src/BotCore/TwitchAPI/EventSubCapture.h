@@ -0,0 +1,55 @@
+#ifndef __EVENTSUBCAPTURE_H__
+#define __EVENTSUBCAPTURE_H__
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+namespace NomBotCore {
+	// Capture files are the 8 byte magic "NOMCAP1\n", the capture's wall clock start as 8 bytes of little
+	// endian microseconds since the epoch, then one record per frame:
+	//   varint microseconds since the previous frame (since the start for the first one)
+	//   varint payload length, followed by the payload
+	class EventSubCaptureWriter {
+	public:
+		~EventSubCaptureWriter();
+
+		int Open(const std::string& path);
+		void Close();
+		bool IsOpen() const { return m_File != nullptr; }
+		int Write(const char* data, size_t length, std::chrono::steady_clock::time_point receivedAt);
+	private:
+		std::FILE* m_File = nullptr;
+		std::chrono::steady_clock::time_point m_Last;
+	};
+
+	struct EventSubReplayStats {
+		size_t frames = 0;
+		double seconds = 0; // Until the last handler finished
+		bool stopped = false; // Ended by a stop request before the end of the file
+	};
+
+	struct EventSubCaptureFrame {
+		int64_t offsetMicros = 0; // From the start of the capture
+		std::string payload;
+	};
+
+	class EventSubCaptureReader {
+	public:
+		~EventSubCaptureReader();
+
+		int Open(const std::string& path);
+		void Close();
+		// Returns 0 for a frame, 1 at the end of the file, -1 for a truncated or corrupt record
+		int Next(EventSubCaptureFrame& frame);
+		int64_t GetStartedAtMicros() const { return m_StartedAtMicros; }
+	private:
+		int ReadVarint(uint64_t& value);
+
+		std::FILE* m_File = nullptr;
+		int64_t m_StartedAtMicros = 0;
+		int64_t m_OffsetMicros = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,89 @@
+#include "nompch.h"
+#include "EventSubDedupe.h"
+#include "EventSubEvents.h"
+#include "../Core/Logging/StructuredLog.h"
+#include "../Core/Metrics/Metrics.h"
+#include <algorithm>
+#include <cmath>
+
+namespace NomBotCore {
+	EventSubDedupe::EventSubDedupe(const EventSubDedupeConfig& config)
+		: EventSubDedupe(config.window, static_cast<size_t>(std::ceil(std::max(config.peakPerSecond, 1.0) * config.window.count())))
+	{
+	}
+
+	EventSubDedupe::EventSubDedupe(std::chrono::seconds window, size_t capacity)
+		: m_Window(window)
+	{
+		// The load limit is 3/4, so a set holds capacity ids once it has 4/3 as many slots
+		size_t slots = 16;
+		int bits = 4;
+		while (slots / 4 * 3 < capacity) {
+			slots <<= 1;
+			++bits;
+		}
+		m_Mask = slots - 1;
+		m_MaxCount = slots / 4 * 3;
+		m_EarlyRotationCounter = MetricsRegistry::GetCounter("nom_eventsub_dedupe_early_rotations_total",
+			"Message id sets rotated before the redelivery window passed because they were full.");
+		m_Shift = 64 - bits;
+		auto now = std::chrono::steady_clock::now();
+		for (Set& set : m_Sets) {
+			set.slots = std::make_unique<uint64_t[]>(slots);
+			set.startedAt = now;
+		}
+	}
+
+	bool EventSubDedupe::Insert(std::string_view messageId, std::chrono::steady_clock::time_point now)
+	{
+		uint64_t hash = EventSubHash(messageId);
+		if (hash == 0)
+			hash = 1;
+		// Either set may hold it, the previous one covers the window just before the current started
+		if (Contains(m_Sets[m_Current], hash) || Contains(m_Sets[m_Current ^ 1], hash))
+			return false;
+		Set& current = m_Sets[m_Current];
+		if (now - current.startedAt >= m_Window) {
+			Rotate(now);
+		}
+		else if (current.count >= m_MaxCount) {
+			++m_EarlyRotations;
+			m_EarlyRotationCounter->Add();
+			NOM_LOG_WARNING("TwitchAPI", "Message id set filled after {}s, redeliveries older than that may run twice.",
+				std::chrono::duration_cast<std::chrono::seconds>(now - current.startedAt).count());
+			Rotate(now);
+		}
+		Add(m_Sets[m_Current], hash);
+		return true;
+	}
+
+	bool EventSubDedupe::Contains(const Set& set, uint64_t hash) const
+	{
+		// Fibonacci hashing spreads FNV's weak low bits over the table
+		size_t slot = static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> m_Shift);
+		while (set.slots[slot] != 0) {
+			if (set.slots[slot] == hash)
+				return true;
+			slot = (slot + 1) & m_Mask;
+		}
+		return false;
+	}
+
+	void EventSubDedupe::Add(Set& set, uint64_t hash)
+	{
+		size_t slot = static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> m_Shift);
+		while (set.slots[slot] != 0)
+			slot = (slot + 1) & m_Mask;
+		set.slots[slot] = hash;
+		++set.count;
+	}
+
+	void EventSubDedupe::Rotate(std::chrono::steady_clock::time_point now)
+	{
+		m_Current ^= 1;
+		Set& next = m_Sets[m_Current];
+		std::fill(next.slots.get(), next.slots.get() + m_Mask + 1, 0);
+		next.count = 0;
+		next.startedAt = now;
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef __EVENTSUBDEDUPE_H__
+#define __EVENTSUBDEDUPE_H__
+#include <string_view>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+namespace NomBotCore {
+	class MetricCounter;
+
+	struct EventSubDedupeConfig {
+		std::chrono::seconds window = std::chrono::minutes(10); // Twitch's redelivery window
+		// Notifications per second across every channel at the busiest, each set holds a window of them
+		double peakPerSecond = 200;
+	};
+
+	// Remembers EventSub message ids for at least the redelivery window in fixed memory. Ids are kept as
+	// 64-bit hashes in two open-addressing sets: new ids go into the current one, and once it is a window
+	// old, or too full to probe quickly, the previous one is cleared and the two swap roles. Each set is
+	// sized for peakPerSecond over the whole window, 200/s takes 2 MB per set.
+	// Not thread safe, the EventSub reader is the only caller.
+	class EventSubDedupe {
+	public:
+		EventSubDedupe(const EventSubDedupeConfig& config = EventSubDedupeConfig());
+		// capacity is per set, rounded up to a power of two so it holds that many ids below the load limit
+		EventSubDedupe(std::chrono::seconds window, size_t capacity);
+
+		// Returns true the first time messageId is seen, false for a redelivery
+		bool Insert(std::string_view messageId) { return Insert(messageId, std::chrono::steady_clock::now()); }
+		bool Insert(std::string_view messageId, std::chrono::steady_clock::time_point now);
+
+		// Rotations forced by a full set, each one shortens the window below the configured length. Also
+		// exported as nom_eventsub_dedupe_early_rotations_total, raise peakPerSecond when it moves.
+		uint64_t GetEarlyRotations() const { return m_EarlyRotations; }
+		// Ids a set takes before it rotates early
+		size_t GetCapacity() const { return m_MaxCount; }
+	private:
+		struct Set {
+			std::unique_ptr<uint64_t[]> slots; // 0 marks an empty slot
+			size_t count = 0;
+			std::chrono::steady_clock::time_point startedAt;
+		};
+
+		bool Contains(const Set& set, uint64_t hash) const;
+		void Add(Set& set, uint64_t hash);
+		void Rotate(std::chrono::steady_clock::time_point now);
+
+		std::chrono::steady_clock::duration m_Window;
+		size_t m_Mask = 0;
+		size_t m_MaxCount = 0; // Keeps probe chains short
+		int m_Shift = 0;
+		Set m_Sets[2];
+		int m_Current = 0;
+		uint64_t m_EarlyRotations = 0;
+		MetricCounter* m_EarlyRotationCounter = nullptr;
+	};
+}
+
+#endif
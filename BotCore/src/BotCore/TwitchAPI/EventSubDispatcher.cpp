@@ -0,0 +1,77 @@
+#include "nompch.h"
+#include "EventSubDispatcher.h"
+
+namespace NomBotCore {
+	int EventSubDispatcher::AddErasedHandler(EventSubType type, ErasedHandler handler)
+	{
+		int index = static_cast<int>(type);
+		if (index < 0 || index >= EventSubTypeCount)
+			return -1;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto handlers = m_Handlers[index] ? std::make_shared<HandlerList>(*m_Handlers[index]) : std::make_shared<HandlerList>();
+		int id = m_NextId++;
+		handlers->emplace_back(id, std::move(handler));
+		m_Handlers[index] = std::move(handlers);
+		return id;
+	}
+
+	void EventSubDispatcher::RemoveHandler(int id)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto& list : m_Handlers) {
+			if (!list)
+				continue;
+			for (size_t i = 0; i < list->size(); ++i) {
+				if ((*list)[i].first != id)
+					continue;
+				auto handlers = std::make_shared<HandlerList>(*list);
+				handlers->erase(handlers->begin() + i);
+				list = handlers->empty() ? nullptr : std::move(handlers);
+				return;
+			}
+		}
+	}
+
+	bool EventSubDispatcher::HasHandlers(EventSubType type)
+	{
+		int index = static_cast<int>(type);
+		if (index < 0 || index >= EventSubTypeCount)
+			return false;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Handlers[index] != nullptr;
+	}
+
+	int EventSubDispatcher::Dispatch(EventSubType type, const std::shared_ptr<JsonValue>& event)
+	{
+		int index = static_cast<int>(type);
+		if (index < 0 || index >= EventSubTypeCount)
+			return 0;
+		std::shared_ptr<const HandlerList> handlers;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			handlers = m_Handlers[index];
+		}
+		if (!handlers)
+			return 0;
+
+		switch (type) {
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) \
+		case EventSubType::Id: { \
+			Struct decoded; \
+			DecodeEventSub(event, decoded); \
+			for (const auto& [id, handler] : *handlers) \
+				handler(&decoded); \
+			break; \
+		}
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+		default:
+			return 0;
+		}
+		return static_cast<int>(handlers->size());
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef __EVENTSUBDISPATCHER_H__
+#define __EVENTSUBDISPATCHER_H__
+#include "EventSubEvents.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace NomBotCore {
+	// Routes notifications by EventSubType, an array index, to the handlers registered for that type.
+	// Each event is decoded once into its struct, and only when at least one handler wants it.
+	class EventSubDispatcher {
+	public:
+		// Returns an id for RemoveHandler. Handlers run on the EventSub workers, so handlers for events with
+		// different ordering keys may run at the same time.
+		template<typename Event>
+		int AddHandler(std::function<void(const Event&)> handler)
+		{
+			return AddErasedHandler(Event::Kind, [handler = std::move(handler)](const void* event) {
+				handler(*static_cast<const Event*>(event));
+			});
+		}
+		void RemoveHandler(int id);
+		bool HasHandlers(EventSubType type);
+
+		// Returns how many handlers ran
+		int Dispatch(EventSubType type, const std::shared_ptr<JsonValue>& event);
+	private:
+		using ErasedHandler = std::function<void(const void*)>;
+		using HandlerList = std::vector<std::pair<int, ErasedHandler>>;
+
+		int AddErasedHandler(EventSubType type, ErasedHandler handler);
+
+		// Lists are replaced, never changed in place, so Dispatch only holds the lock to copy the pointer
+		std::mutex m_Mutex;
+		std::shared_ptr<const HandlerList> m_Handlers[EventSubTypeCount];
+		int m_NextId = 1;
+	};
+}
+
+#endif
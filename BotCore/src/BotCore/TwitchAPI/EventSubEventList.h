@@ -0,0 +1,255 @@
+// Every EventSub type the bot understands, included several times with different definitions of the
+// NOM_EVENTSUB_* macros to build the type enum, the event structs, their decoders and the lookup table.
+// Adding a type only takes a new entry here. No include guard on purpose.
+//
+// NOM_EVENTSUB_EVENT(Id, Struct, "type", "version", EventSubCondition, "scope")
+//   scope is the OAuth scope the subscription needs, empty when it needs none. The sign in asks for all of them.
+//   NOM_EVENTSUB_FIELD(C++ type, member, "path.in.event") - InternedString only for values with few distinct
+//   ones over the life of the process (channel and reward ids, statuses, tiers), the table never shrinks.
+//   EventSubText for everything else, viewer identities, titles and per event ids and text. EventSubTime for
+//   _at fields, int64_t, double or bool. std::string still works but costs an allocation per copy.
+//   Paths use dots for nested objects, numbers read into strings as integers.
+// NOM_EVENTSUB_END(Struct)
+// Anything without a field, such as poll choices, is still reachable through the event's raw member.
+
+// The broadcaster and its moderators, a handful per channel
+#ifndef NOM_EVENTSUB_USER_FIELDS
+#define NOM_EVENTSUB_USER_FIELDS(prefix) \
+	NOM_EVENTSUB_FIELD(InternedString, prefix##_id, #prefix "_id") \
+	NOM_EVENTSUB_FIELD(InternedString, prefix##_login, #prefix "_login") \
+	NOM_EVENTSUB_FIELD(InternedString, prefix##_name, #prefix "_name")
+#endif
+
+// Chatters, followers, subscribers, raiders, any number of them
+#ifndef NOM_EVENTSUB_VIEWER_FIELDS
+#define NOM_EVENTSUB_VIEWER_FIELDS(prefix) \
+	NOM_EVENTSUB_FIELD(EventSubText, prefix##_id, #prefix "_id") \
+	NOM_EVENTSUB_FIELD(EventSubText, prefix##_login, #prefix "_login") \
+	NOM_EVENTSUB_FIELD(EventSubText, prefix##_name, #prefix "_name")
+#endif
+
+NOM_EVENTSUB_EVENT(AutomodMessageHold, AutomodMessageHoldEvent, "automod.message.hold", "1", EventSubCondition::BroadcasterAndModerator, "moderator:manage:automod")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_FIELD(EventSubText, message_id, "message_id")
+	NOM_EVENTSUB_FIELD(EventSubText, message_text, "message.text")
+	NOM_EVENTSUB_FIELD(InternedString, category, "category")
+	NOM_EVENTSUB_FIELD(int64_t, level, "level")
+	NOM_EVENTSUB_FIELD(EventSubTime, held_at, "held_at")
+NOM_EVENTSUB_END(AutomodMessageHoldEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPointsCustomRewardRedemptionAdd, ChannelPointRewardRedemption, "channel.channel_points_custom_reward_redemption.add", "1", EventSubCondition::Broadcaster, "channel:read:redemptions")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_FIELD(EventSubText, user_id, "user_id")
+	NOM_EVENTSUB_FIELD(EventSubText, user_login, "user_login")
+	NOM_EVENTSUB_FIELD(EventSubText, user_name, "user_name")
+	NOM_EVENTSUB_FIELD(InternedString, channel_id, "broadcaster_user_id")
+	NOM_EVENTSUB_FIELD(InternedString, channel_login, "broadcaster_user_login")
+	NOM_EVENTSUB_FIELD(InternedString, channel_name, "broadcaster_user_name")
+	NOM_EVENTSUB_FIELD(EventSubTime, redeemed_at, "redeemed_at")
+	NOM_EVENTSUB_FIELD(InternedString, reward_id, "reward.id")
+	NOM_EVENTSUB_FIELD(InternedString, reward_title, "reward.title")
+	NOM_EVENTSUB_FIELD(int64_t, reward_cost, "reward.cost")
+	NOM_EVENTSUB_FIELD(InternedString, prompt, "reward.prompt")
+	NOM_EVENTSUB_FIELD(InternedString, status, "status") // "UNFULFILLED", "FULFILLED", "CANCELED"
+	NOM_EVENTSUB_FIELD(EventSubText, user_input, "user_input") // Optional, may be empty
+NOM_EVENTSUB_END(ChannelPointRewardRedemption)
+
+NOM_EVENTSUB_EVENT(ChannelUpdate, ChannelUpdateEvent, "channel.update", "2", EventSubCondition::Broadcaster, "")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(InternedString, language, "language")
+	NOM_EVENTSUB_FIELD(InternedString, category_id, "category_id")
+	NOM_EVENTSUB_FIELD(InternedString, category_name, "category_name")
+NOM_EVENTSUB_END(ChannelUpdateEvent)
+
+NOM_EVENTSUB_EVENT(ChannelFollow, ChannelFollowEvent, "channel.follow", "2", EventSubCondition::BroadcasterAndModerator, "moderator:read:followers")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubTime, followed_at, "followed_at")
+NOM_EVENTSUB_END(ChannelFollowEvent)
+
+NOM_EVENTSUB_EVENT(ChannelSubscribe, ChannelSubscribeEvent, "channel.subscribe", "1", EventSubCondition::Broadcaster, "channel:read:subscriptions")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(InternedString, tier, "tier")
+	NOM_EVENTSUB_FIELD(bool, is_gift, "is_gift")
+NOM_EVENTSUB_END(ChannelSubscribeEvent)
+
+NOM_EVENTSUB_EVENT(ChannelSubscriptionEnd, ChannelSubscriptionEndEvent, "channel.subscription.end", "1", EventSubCondition::Broadcaster, "channel:read:subscriptions")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(InternedString, tier, "tier")
+	NOM_EVENTSUB_FIELD(bool, is_gift, "is_gift")
+NOM_EVENTSUB_END(ChannelSubscriptionEndEvent)
+
+NOM_EVENTSUB_EVENT(ChannelSubscriptionGift, ChannelSubscriptionGiftEvent, "channel.subscription.gift", "1", EventSubCondition::Broadcaster, "channel:read:subscriptions")
+	NOM_EVENTSUB_VIEWER_FIELDS(user) // Empty when is_anonymous
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(int64_t, total, "total")
+	NOM_EVENTSUB_FIELD(InternedString, tier, "tier")
+	NOM_EVENTSUB_FIELD(int64_t, cumulative_total, "cumulative_total")
+	NOM_EVENTSUB_FIELD(bool, is_anonymous, "is_anonymous")
+NOM_EVENTSUB_END(ChannelSubscriptionGiftEvent)
+
+NOM_EVENTSUB_EVENT(ChannelSubscriptionMessage, ChannelSubscriptionMessageEvent, "channel.subscription.message", "1", EventSubCondition::Broadcaster, "channel:read:subscriptions")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(InternedString, tier, "tier")
+	NOM_EVENTSUB_FIELD(EventSubText, message_text, "message.text")
+	NOM_EVENTSUB_FIELD(int64_t, cumulative_months, "cumulative_months")
+	NOM_EVENTSUB_FIELD(int64_t, streak_months, "streak_months")
+	NOM_EVENTSUB_FIELD(int64_t, duration_months, "duration_months")
+NOM_EVENTSUB_END(ChannelSubscriptionMessageEvent)
+
+NOM_EVENTSUB_EVENT(ChannelCheer, ChannelCheerEvent, "channel.cheer", "1", EventSubCondition::Broadcaster, "bits:read")
+	NOM_EVENTSUB_FIELD(bool, is_anonymous, "is_anonymous")
+	NOM_EVENTSUB_VIEWER_FIELDS(user) // Empty when is_anonymous
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, message, "message")
+	NOM_EVENTSUB_FIELD(int64_t, bits, "bits")
+NOM_EVENTSUB_END(ChannelCheerEvent)
+
+NOM_EVENTSUB_EVENT(ChannelRaid, ChannelRaidEvent, "channel.raid", "1", EventSubCondition::ToBroadcaster, "")
+	NOM_EVENTSUB_VIEWER_FIELDS(from_broadcaster_user)
+	NOM_EVENTSUB_USER_FIELDS(to_broadcaster_user)
+	NOM_EVENTSUB_FIELD(int64_t, viewers, "viewers")
+NOM_EVENTSUB_END(ChannelRaidEvent)
+
+NOM_EVENTSUB_EVENT(ChannelBan, ChannelBanEvent, "channel.ban", "1", EventSubCondition::Broadcaster, "channel:moderate")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_USER_FIELDS(moderator_user)
+	NOM_EVENTSUB_FIELD(EventSubText, reason, "reason")
+	NOM_EVENTSUB_FIELD(EventSubTime, banned_at, "banned_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ends_at, "ends_at") // Unset when is_permanent
+	NOM_EVENTSUB_FIELD(bool, is_permanent, "is_permanent")
+NOM_EVENTSUB_END(ChannelBanEvent)
+
+NOM_EVENTSUB_EVENT(ChannelUnban, ChannelUnbanEvent, "channel.unban", "1", EventSubCondition::Broadcaster, "channel:moderate")
+	NOM_EVENTSUB_VIEWER_FIELDS(user)
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_USER_FIELDS(moderator_user)
+NOM_EVENTSUB_END(ChannelUnbanEvent)
+
+NOM_EVENTSUB_EVENT(ChannelChatMessage, ChannelChatMessageEvent, "channel.chat.message", "1", EventSubCondition::BroadcasterAndUser, "user:read:chat")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_VIEWER_FIELDS(chatter_user)
+	NOM_EVENTSUB_FIELD(EventSubText, message_id, "message_id")
+	NOM_EVENTSUB_FIELD(EventSubText, message_text, "message.text")
+	NOM_EVENTSUB_FIELD(InternedString, message_type, "message_type")
+	NOM_EVENTSUB_FIELD(EventSubText, color, "color")
+	NOM_EVENTSUB_FIELD(int64_t, cheer_bits, "cheer.bits")
+	NOM_EVENTSUB_FIELD(EventSubText, reply_parent_message_id, "reply.parent_message_id")
+	NOM_EVENTSUB_FIELD(InternedString, channel_points_custom_reward_id, "channel_points_custom_reward_id")
+NOM_EVENTSUB_END(ChannelChatMessageEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPollBegin, ChannelPollBeginEvent, "channel.poll.begin", "1", EventSubCondition::Broadcaster, "channel:read:polls")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ends_at, "ends_at")
+NOM_EVENTSUB_END(ChannelPollBeginEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPollProgress, ChannelPollProgressEvent, "channel.poll.progress", "1", EventSubCondition::Broadcaster, "channel:read:polls")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ends_at, "ends_at")
+NOM_EVENTSUB_END(ChannelPollProgressEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPollEnd, ChannelPollEndEvent, "channel.poll.end", "1", EventSubCondition::Broadcaster, "channel:read:polls")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(InternedString, status, "status") // "completed", "archived" or "terminated"
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ended_at, "ended_at")
+NOM_EVENTSUB_END(ChannelPollEndEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPredictionBegin, ChannelPredictionBeginEvent, "channel.prediction.begin", "1", EventSubCondition::Broadcaster, "channel:read:predictions")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, locks_at, "locks_at")
+NOM_EVENTSUB_END(ChannelPredictionBeginEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPredictionProgress, ChannelPredictionProgressEvent, "channel.prediction.progress", "1", EventSubCondition::Broadcaster, "channel:read:predictions")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, locks_at, "locks_at")
+NOM_EVENTSUB_END(ChannelPredictionProgressEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPredictionLock, ChannelPredictionLockEvent, "channel.prediction.lock", "1", EventSubCondition::Broadcaster, "channel:read:predictions")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, locked_at, "locked_at")
+NOM_EVENTSUB_END(ChannelPredictionLockEvent)
+
+NOM_EVENTSUB_EVENT(ChannelPredictionEnd, ChannelPredictionEndEvent, "channel.prediction.end", "1", EventSubCondition::Broadcaster, "channel:read:predictions")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(EventSubText, title, "title")
+	NOM_EVENTSUB_FIELD(EventSubText, winning_outcome_id, "winning_outcome_id")
+	NOM_EVENTSUB_FIELD(InternedString, status, "status") // "resolved" or "canceled"
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ended_at, "ended_at")
+NOM_EVENTSUB_END(ChannelPredictionEndEvent)
+
+NOM_EVENTSUB_EVENT(HypeTrainBegin, HypeTrainBeginEvent, "channel.hype_train.begin", "1", EventSubCondition::Broadcaster, "channel:read:hype_train")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(int64_t, total, "total")
+	NOM_EVENTSUB_FIELD(int64_t, progress, "progress")
+	NOM_EVENTSUB_FIELD(int64_t, goal, "goal")
+	NOM_EVENTSUB_FIELD(int64_t, level, "level")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, expires_at, "expires_at")
+NOM_EVENTSUB_END(HypeTrainBeginEvent)
+
+NOM_EVENTSUB_EVENT(HypeTrainProgress, HypeTrainProgressEvent, "channel.hype_train.progress", "1", EventSubCondition::Broadcaster, "channel:read:hype_train")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(int64_t, total, "total")
+	NOM_EVENTSUB_FIELD(int64_t, progress, "progress")
+	NOM_EVENTSUB_FIELD(int64_t, goal, "goal")
+	NOM_EVENTSUB_FIELD(int64_t, level, "level")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, expires_at, "expires_at")
+NOM_EVENTSUB_END(HypeTrainProgressEvent)
+
+NOM_EVENTSUB_EVENT(HypeTrainEnd, HypeTrainEndEvent, "channel.hype_train.end", "1", EventSubCondition::Broadcaster, "channel:read:hype_train")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(int64_t, total, "total")
+	NOM_EVENTSUB_FIELD(int64_t, level, "level")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, ended_at, "ended_at")
+	NOM_EVENTSUB_FIELD(EventSubTime, cooldown_ends_at, "cooldown_ends_at")
+NOM_EVENTSUB_END(HypeTrainEndEvent)
+
+NOM_EVENTSUB_EVENT(ChannelAdBreakBegin, ChannelAdBreakBeginEvent, "channel.ad_break.begin", "1", EventSubCondition::Broadcaster, "channel:read:ads")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_USER_FIELDS(requester_user)
+	NOM_EVENTSUB_FIELD(int64_t, duration_seconds, "duration_seconds")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+	NOM_EVENTSUB_FIELD(bool, is_automatic, "is_automatic")
+NOM_EVENTSUB_END(ChannelAdBreakBeginEvent)
+
+NOM_EVENTSUB_EVENT(StreamOnline, StreamOnlineEvent, "stream.online", "1", EventSubCondition::Broadcaster, "")
+	NOM_EVENTSUB_FIELD(EventSubText, id, "id")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+	NOM_EVENTSUB_FIELD(InternedString, type, "type")
+	NOM_EVENTSUB_FIELD(EventSubTime, started_at, "started_at")
+NOM_EVENTSUB_END(StreamOnlineEvent)
+
+NOM_EVENTSUB_EVENT(StreamOffline, StreamOfflineEvent, "stream.offline", "1", EventSubCondition::Broadcaster, "")
+	NOM_EVENTSUB_USER_FIELDS(broadcaster_user)
+NOM_EVENTSUB_END(StreamOfflineEvent)
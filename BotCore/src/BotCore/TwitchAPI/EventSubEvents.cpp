@@ -0,0 +1,247 @@
+#include "nompch.h"
+#include "EventSubEvents.h"
+#include <set>
+
+namespace NomBotCore {
+	namespace {
+		const JsonValue* FindPath(const JsonValue* object, const char* path)
+		{
+			const char* segment = path;
+			while (object && object->type == JsonValue::Type::Object) {
+				const char* dot = strchr(segment, '.');
+				auto it = object->objectValues.find(dot ? std::string_view(segment, dot - segment) : std::string_view(segment));
+				if (it == object->objectValues.end())
+					return nullptr;
+				if (!dot)
+					return it->second.get();
+				object = it->second.get();
+				segment = dot + 1;
+			}
+			return nullptr;
+		}
+
+		// Numbers read as integers, false when there is nothing to read
+		bool ReadText(const JsonValue* event, const char* path, std::string_view& out, std::string& scratch)
+		{
+			const JsonValue* value = FindPath(event, path);
+			if (!value)
+				return false;
+			if (value->type == JsonValue::Type::String) {
+				out = value->stringValue;
+				return true;
+			}
+			if (value->type == JsonValue::Type::Number) {
+				scratch = std::to_string(static_cast<int64_t>(value->numberValue));
+				out = scratch;
+				return true;
+			}
+			return false;
+		}
+
+		void ReadField(const JsonValue* event, const char* path, std::string& out)
+		{
+			std::string_view text;
+			std::string scratch;
+			if (ReadText(event, path, text, scratch))
+				out = text;
+		}
+
+		void ReadField(const JsonValue* event, const char* path, InternedString& out)
+		{
+			std::string_view text;
+			std::string scratch;
+			if (ReadText(event, path, text, scratch))
+				out = InternedString(text);
+		}
+
+		void ReadField(const JsonValue* event, const char* path, EventSubText& out)
+		{
+			std::string_view text;
+			std::string scratch;
+			if (ReadText(event, path, text, scratch))
+				out = text;
+		}
+
+		void ReadField(const JsonValue* event, const char* path, EventSubTime& out)
+		{
+			const JsonValue* value = FindPath(event, path);
+			if (value && value->type == JsonValue::Type::String)
+				ParseEventSubTime(value->stringValue, out.epochMicros);
+		}
+
+		void ReadField(const JsonValue* event, const char* path, int64_t& out)
+		{
+			const JsonValue* value = FindPath(event, path);
+			if (value && value->type == JsonValue::Type::Number)
+				out = static_cast<int64_t>(value->numberValue);
+		}
+
+		void ReadField(const JsonValue* event, const char* path, double& out)
+		{
+			const JsonValue* value = FindPath(event, path);
+			if (value && value->type == JsonValue::Type::Number)
+				out = value->numberValue;
+		}
+
+		void ReadField(const JsonValue* event, const char* path, bool& out)
+		{
+			const JsonValue* value = FindPath(event, path);
+			if (value && value->type == JsonValue::Type::Boolean)
+				out = value->boolValue;
+		}
+
+		bool ReadDigits(std::string_view text, size_t& pos, int count, int& out)
+		{
+			if (pos + count > text.size())
+				return false;
+			out = 0;
+			for (int i = 0; i < count; ++i, ++pos) {
+				char c = text[pos];
+				if (c < '0' || c > '9')
+					return false;
+				out = out * 10 + (c - '0');
+			}
+			return true;
+		}
+
+		bool Expect(std::string_view text, size_t& pos, char c)
+		{
+			if (pos >= text.size() || text[pos] != c)
+				return false;
+			++pos;
+			return true;
+		}
+
+		// Days from 1970-01-01 to a proleptic Gregorian date
+		int64_t DaysFromCivil(int year, int month, int day)
+		{
+			year -= month <= 2;
+			int64_t era = (year >= 0 ? year : year - 399) / 400;
+			int64_t yearOfEra = year - era * 400;
+			int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+			int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			return era * 146097 + dayOfEra - 719468;
+		}
+
+		const EventSubTypeInfo g_TypeInfo[EventSubTypeCount + 1] = {
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) { Type, Version, Condition, Scope, EventSubHash(Type) },
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+			{ "unknown", "1", EventSubCondition::Broadcaster, "", 0 }
+		};
+
+		// Open addressing on the low bits of the hash, at most a quarter full
+		constexpr int LookupSlots = 256;
+		static_assert(EventSubTypeCount * 4 <= LookupSlots, "Grow LookupSlots with the event list");
+
+		struct LookupTable {
+			uint64_t hashes[LookupSlots] = {};
+			EventSubType types[LookupSlots] = {};
+
+			LookupTable()
+			{
+				for (int i = 0; i < EventSubTypeCount; ++i) {
+					uint64_t hash = g_TypeInfo[i].hash;
+					int slot = static_cast<int>(hash & (LookupSlots - 1));
+					while (hashes[slot] != 0)
+						slot = (slot + 1) & (LookupSlots - 1);
+					hashes[slot] = hash;
+					types[slot] = static_cast<EventSubType>(i);
+				}
+			}
+		};
+		const LookupTable g_Lookup;
+	}
+
+	bool ParseEventSubTime(std::string_view text, int64_t& epochMicros)
+	{
+		size_t pos = 0;
+		int year, month, day, hour, minute, second;
+		if (!ReadDigits(text, pos, 4, year) || !Expect(text, pos, '-') || !ReadDigits(text, pos, 2, month) || !Expect(text, pos, '-') || !ReadDigits(text, pos, 2, day))
+			return false;
+		if (!Expect(text, pos, 'T') && !Expect(text, pos, 't') && !Expect(text, pos, ' '))
+			return false;
+		if (!ReadDigits(text, pos, 2, hour) || !Expect(text, pos, ':') || !ReadDigits(text, pos, 2, minute) || !Expect(text, pos, ':') || !ReadDigits(text, pos, 2, second))
+			return false;
+		if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+			return false;
+		int64_t micros = 0;
+		if (Expect(text, pos, '.')) {
+			int digits = 0;
+			while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+				if (digits++ < 6)
+					micros = micros * 10 + (text[pos] - '0');
+				++pos;
+			}
+			if (digits == 0)
+				return false;
+			for (; digits < 6; ++digits)
+				micros *= 10;
+		}
+		int64_t offsetSeconds = 0;
+		if (!Expect(text, pos, 'Z') && !Expect(text, pos, 'z')) {
+			if (pos >= text.size() || (text[pos] != '+' && text[pos] != '-'))
+				return false;
+			int sign = text[pos++] == '-' ? -1 : 1;
+			int offsetHours, offsetMinutes;
+			if (!ReadDigits(text, pos, 2, offsetHours) || !Expect(text, pos, ':') || !ReadDigits(text, pos, 2, offsetMinutes))
+				return false;
+			offsetSeconds = sign * (offsetHours * 3600 + offsetMinutes * 60);
+		}
+		if (pos != text.size())
+			return false;
+		int64_t seconds = DaysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offsetSeconds;
+		epochMicros = seconds * 1000000 + micros;
+		return true;
+	}
+
+	const EventSubTypeInfo& GetEventSubTypeInfo(EventSubType type)
+	{
+		int index = static_cast<int>(type);
+		return g_TypeInfo[index >= 0 && index < EventSubTypeCount ? index : EventSubTypeCount];
+	}
+
+	const std::string& GetEventSubScopes()
+	{
+		static const std::string scopes = [] {
+			std::set<std::string_view> seen;
+			std::string joined;
+			for (int i = 0; i < EventSubTypeCount; ++i) {
+				std::string_view scope = g_TypeInfo[i].scope;
+				if (scope.empty() || !seen.insert(scope).second)
+					continue;
+				if (!joined.empty())
+					joined += '+';
+				joined += scope;
+			}
+			return joined;
+		}();
+		return scopes;
+	}
+
+	EventSubType FindEventSubType(uint64_t hash)
+	{
+		int slot = static_cast<int>(hash & (LookupSlots - 1));
+		while (g_Lookup.hashes[slot] != 0) {
+			if (g_Lookup.hashes[slot] == hash)
+				return g_Lookup.types[slot];
+			slot = (slot + 1) & (LookupSlots - 1);
+		}
+		return EventSubType::Unknown;
+	}
+
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) \
+	void DecodeEventSub(const std::shared_ptr<JsonValue>& event, Struct& out) \
+	{ \
+		out.raw = event;
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path) ReadField(event.get(), Path, out.Member);
+#define NOM_EVENTSUB_END(Struct) }
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+}
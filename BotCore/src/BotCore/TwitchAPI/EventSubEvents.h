@@ -0,0 +1,95 @@
+#ifndef __EVENTSUBEVENTS_H__
+#define __EVENTSUBEVENTS_H__
+#include "../Core/JSONParser/JsonValue.h"
+#include "../Core/Strings/InternedString.h"
+#include "../Core/Strings/SmallString.h"
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+#include <chrono>
+
+namespace NomBotCore {
+	// 64-bit FNV-1a, usable in case labels
+	constexpr uint64_t EventSubHash(std::string_view text)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : text) {
+			hash ^= static_cast<unsigned char>(c);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Per event and per viewer text, message ids, chat messages, user names. Only values with few distinct ones are an InternedString.
+	using EventSubText = SmallString<44>;
+
+	// An _at field, parsed from ISO 8601 once when the event is decoded
+	struct EventSubTime {
+		int64_t epochMicros = 0; // 0 when missing, null or malformed
+
+		bool IsSet() const { return epochMicros != 0; }
+		std::chrono::system_clock::time_point ToTimePoint() const { return std::chrono::system_clock::time_point(std::chrono::microseconds(epochMicros)); }
+	};
+	// Accepts Twitch's "2020-07-15T17:16:03.17106713Z" as well as numeric offsets, fractions past microseconds are dropped
+	bool ParseEventSubTime(std::string_view text, int64_t& epochMicros);
+
+	// Which ids the subscription's condition object needs, all of them are the bot's channel
+	enum class EventSubCondition {
+		Broadcaster, // broadcaster_user_id
+		BroadcasterAndModerator, // broadcaster_user_id, moderator_user_id
+		BroadcasterAndUser, // broadcaster_user_id, user_id
+		ToBroadcaster // to_broadcaster_user_id
+	};
+
+	enum class EventSubType : uint16_t {
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) Id,
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+		Count,
+		Unknown = Count
+	};
+	constexpr int EventSubTypeCount = static_cast<int>(EventSubType::Count);
+
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) \
+	struct Struct { \
+		static constexpr EventSubType Kind = EventSubType::Id;
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path) FieldType Member{};
+#define NOM_EVENTSUB_END(Struct) \
+		std::shared_ptr<JsonValue> raw; /* The whole event object, reset it before keeping the event around */ \
+	};
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+
+	struct EventSubTypeInfo {
+		const char* type;
+		const char* version;
+		EventSubCondition condition;
+		const char* scope; // Empty when the subscription needs no scope
+		uint64_t hash;
+	};
+
+	const EventSubTypeInfo& GetEventSubTypeInfo(EventSubType type);
+	// Every scope in EventSubEventList.h once, joined with '+' for the authorize URL
+	const std::string& GetEventSubScopes();
+	// Returns EventSubType::Unknown for types missing from EventSubEventList.h
+	EventSubType FindEventSubType(uint64_t hash);
+	inline EventSubType FindEventSubType(std::string_view type) { return FindEventSubType(EventSubHash(type)); }
+
+	// Fills out from the notification's payload.event object. Missing or mistyped fields keep their defaults.
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) void DecodeEventSub(const std::shared_ptr<JsonValue>& event, Struct& out);
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include "EventSubEventList.h"
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+}
+
+#endif
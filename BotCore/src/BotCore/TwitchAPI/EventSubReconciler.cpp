@@ -0,0 +1,197 @@
+#include "nompch.h"
+#include "EventSubReconciler.h"
+#include "../Core/JSONParser/JsonParser.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Tracing/Trace.h"
+#include <utility>
+
+namespace NomBotCore {
+	namespace {
+		const JsonValue* FindField(const JsonValue* object, const char* key, JsonValue::Type type)
+		{
+			if (!object || object->type != JsonValue::Type::Object)
+				return nullptr;
+			auto it = object->objectValues.find(key);
+			if (it == object->objectValues.end() || !it->second || it->second->type != type)
+				return nullptr;
+			return it->second.get();
+		}
+
+		std::string StringField(const JsonValue* object, const char* key)
+		{
+			const JsonValue* value = FindField(object, key, JsonValue::Type::String);
+			return value ? value->stringValue : "";
+		}
+	}
+
+	EventSubReconcilePlan PlanEventSubReconcile(const std::set<std::string>& desired, const std::vector<EventSubRemoteSubscription>& actual, const std::string& sessionId)
+	{
+		EventSubReconcilePlan plan;
+		for (const auto& remote : actual) {
+			if (remote.status != "enabled") {
+				plan.deletes.push_back(remote.id);
+				continue;
+			}
+			if (remote.sessionId != sessionId)
+				continue;
+			if (desired.count(remote.type) == 0 || plan.kept.count(remote.type) != 0)
+				plan.deletes.push_back(remote.id);
+			else
+				plan.kept[remote.type] = remote.id;
+		}
+		for (const auto& type : desired) {
+			if (plan.kept.count(type) == 0)
+				plan.creates.push_back(type);
+		}
+		return plan;
+	}
+
+	int ParseEventSubSubscriptionList(const std::string& body, std::vector<EventSubRemoteSubscription>& out, std::string& cursor)
+	{
+		size_t pos = 0;
+		std::shared_ptr<JsonValue> json = JsonParser::Parse(body, pos);
+		const JsonValue* data = FindField(json.get(), "data", JsonValue::Type::Array);
+		if (!data)
+			return -1;
+		for (const auto& entry : data->arrayValues) {
+			EventSubRemoteSubscription remote;
+			remote.id = StringField(entry.get(), "id");
+			remote.type = StringField(entry.get(), "type");
+			remote.status = StringField(entry.get(), "status");
+			remote.sessionId = StringField(FindField(entry.get(), "transport", JsonValue::Type::Object), "session_id");
+			if (!remote.id.empty())
+				out.push_back(std::move(remote));
+		}
+		cursor = StringField(FindField(json.get(), "pagination", JsonValue::Type::Object), "cursor");
+		return 0;
+	}
+
+	EventSubReconciler::EventSubReconciler(TimerWheel& timers)
+		: m_Timers(timers)
+	{
+		m_Converged = MetricsRegistry::GetCounter("nom_eventsub_reconcile_passes_total", "EventSub subscription reconcile passes, by outcome.", MetricLabel("result", "converged"));
+		m_Retried = MetricsRegistry::GetCounter("nom_eventsub_reconcile_passes_total", "EventSub subscription reconcile passes, by outcome.", MetricLabel("result", "retry"));
+		m_PassTime = MetricsRegistry::GetHistogram("nom_eventsub_reconcile_seconds", "Time for one reconcile pass, from listing subscriptions to the last create or delete answering.");
+	}
+
+	EventSubReconciler::~EventSubReconciler()
+	{
+		Stop();
+		std::vector<TimerWheel::TimerId> retries;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (const auto& [id, entry] : m_Entries)
+				retries.push_back(entry.retryTimer);
+		}
+		for (TimerWheel::TimerId retry : retries)
+			m_Timers.Cancel(retry);
+	}
+
+	void EventSubReconciler::Start()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Running)
+			return;
+		m_Running = true;
+		m_Thread = std::thread(&EventSubReconciler::ThreadFunc, this);
+	}
+
+	void EventSubReconciler::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Running)
+				return;
+			m_Running = false;
+		}
+		m_Wake.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+
+	int EventSubReconciler::Add(const std::string& name, Pass pass)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		int id = m_NextId++;
+		Entry& entry = m_Entries[id];
+		entry.name = name;
+		entry.pass = std::move(pass);
+		return id;
+	}
+
+	void EventSubReconciler::Remove(int id)
+	{
+		TimerWheel::TimerId retry = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			auto it = m_Entries.find(id);
+			if (it == m_Entries.end())
+				return;
+			m_PassDone.wait(lock, [&it] { return !it->second.running; });
+			retry = it->second.retryTimer;
+			m_Entries.erase(it);
+		}
+		// Outside the lock, a retry firing right now needs it for Trigger, which then finds nothing
+		m_Timers.Cancel(retry);
+	}
+
+	void EventSubReconciler::Trigger(int id)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto it = m_Entries.find(id);
+			if (it == m_Entries.end())
+				return;
+			it->second.dirty = true;
+		}
+		m_Wake.notify_all();
+	}
+
+	void EventSubReconciler::ThreadFunc()
+	{
+		Trace::SetThreadName("EventSub reconciler");
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		while (m_Running) {
+			auto due = m_Entries.end();
+			// Starts after the last pass that ran and wraps around
+			auto start = m_Entries.upper_bound(m_LastId);
+			for (size_t i = 0; i < m_Entries.size(); ++i, ++start) {
+				if (start == m_Entries.end())
+					start = m_Entries.begin();
+				if (start->second.dirty) {
+					due = start;
+					break;
+				}
+			}
+			if (due == m_Entries.end()) {
+				m_Wake.wait(lock);
+				continue;
+			}
+			// A trigger during the pass sets dirty again and gets a pass of its own
+			Entry& entry = due->second;
+			int id = due->first;
+			m_LastId = id;
+			entry.dirty = false;
+			entry.running = true;
+			// This pass replaces a pending retry
+			TimerWheel::TimerId retry = std::exchange(entry.retryTimer, 0);
+			lock.unlock();
+			m_Timers.Cancel(retry);
+			auto started = std::chrono::steady_clock::now();
+			int result = entry.pass();
+			m_PassTime->ObserveMicros(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+			lock.lock();
+			entry.running = false;
+			m_PassDone.notify_all();
+			if (result == 0) {
+				m_Converged->Add();
+				entry.backoff = InitialBackoff;
+				continue;
+			}
+			m_Retried->Add();
+			ImGuiLogManager::AddLog("TwitchAPI", "EventSub subscriptions for " + entry.name + " not reconciled, retrying in " + std::to_string(entry.backoff.count()) + " ms.", LogSeverity::Warning);
+			entry.retryTimer = m_Timers.Schedule(entry.backoff, [this, id] { Trigger(id); });
+			entry.backoff = std::min(entry.backoff * 2, MaxBackoff);
+		}
+	}
+}
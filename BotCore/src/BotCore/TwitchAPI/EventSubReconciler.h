@@ -0,0 +1,88 @@
+#ifndef __EVENTSUBRECONCILER_H__
+#define __EVENTSUBRECONCILER_H__
+#include "../Core/Metrics/Metrics.h"
+#include "../Core/Timers/TimerWheel.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <chrono>
+
+namespace NomBotCore {
+	// One entry of GET /helix/eventsub/subscriptions
+	struct EventSubRemoteSubscription {
+		std::string id;
+		std::string type;
+		std::string status;
+		std::string sessionId; // Empty for webhook and conduit transports
+	};
+
+	struct EventSubReconcilePlan {
+		std::vector<std::string> creates; // Types
+		std::vector<std::string> deletes; // Subscription ids
+		std::map<std::string, std::string> kept; // Type to the id of its enabled subscription on this session
+	};
+
+	// Diffs the wanted types against what Helix reports. Enabled subscriptions on sessionId are kept once per
+	// type, extra copies and types nobody wants any more are deleted, and so is anything no longer enabled
+	// (disconnected sessions, revoked authorization). Enabled subscriptions of other sessions are left alone.
+	EventSubReconcilePlan PlanEventSubReconcile(const std::set<std::string>& desired, const std::vector<EventSubRemoteSubscription>& actual, const std::string& sessionId);
+	// Appends the data array of a subscription list page, cursor is empty on the last page. Returns 0 on success.
+	int ParseEventSubSubscriptionList(const std::string& body, std::vector<EventSubRemoteSubscription>& out, std::string& cursor);
+
+	// Runs reconcile passes on its own thread whenever Trigger is called for them. Every channel adds its own
+	// pass, they run one at a time and in turn so a channel that keeps failing can't starve the others.
+	// Triggers that arrive during a pass fold into one more pass, and a pass that returns non-zero is
+	// retried with exponential backoff through a timer that triggers it again.
+	class EventSubReconciler {
+	public:
+		// Returns 0 once the remote state matches, anything else schedules a retry
+		using Pass = std::function<int()>;
+
+		EventSubReconciler(TimerWheel& timers);
+		~EventSubReconciler();
+
+		void Start();
+		// Waits for a running pass to finish
+		void Stop();
+		// name is for the log. Returns an id for Trigger and Remove.
+		int Add(const std::string& name, Pass pass);
+		// Waits for the pass to finish if it is running
+		void Remove(int id);
+		void Trigger(int id);
+	private:
+		struct Entry {
+			std::string name;
+			Pass pass;
+			bool dirty = false;
+			bool running = false;
+			TimerWheel::TimerId retryTimer = 0;
+			std::chrono::milliseconds backoff = InitialBackoff;
+		};
+
+		void ThreadFunc();
+
+		TimerWheel& m_Timers;
+		std::thread m_Thread;
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_PassDone;
+		bool m_Running = false;
+		std::map<int, Entry> m_Entries;
+		int m_NextId = 1;
+		int m_LastId = 0; // Where the round robin continues
+		MetricCounter* m_Converged = nullptr;
+		MetricCounter* m_Retried = nullptr;
+		MetricHistogram* m_PassTime = nullptr;
+
+		static constexpr std::chrono::milliseconds InitialBackoff{ 1000 };
+		static constexpr std::chrono::milliseconds MaxBackoff{ 60000 };
+	};
+}
+
+#endif
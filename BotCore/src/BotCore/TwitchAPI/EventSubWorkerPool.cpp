@@ -0,0 +1,177 @@
+#include "nompch.h"
+#include "EventSubWorkerPool.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Logging/StructuredLog.h"
+#include "../Core/Tracing/Trace.h"
+
+namespace NomBotCore {
+	namespace {
+		const std::string* FindString(const JsonValue* object, const char* key)
+		{
+			if (!object || object->type != JsonValue::Type::Object)
+				return nullptr;
+			auto it = object->objectValues.find(key);
+			if (it == object->objectValues.end() || !it->second || it->second->type != JsonValue::Type::String)
+				return nullptr;
+			return &it->second->stringValue;
+		}
+	}
+
+	EventSubWorkerPool::EventSubWorkerPool(Handler handler, const EventSubWorkerPoolConfig& config)
+		: m_Handler(std::move(handler)), m_Config(config)
+	{
+		if (m_Config.workerCount < 1)
+			m_Config.workerCount = 1;
+		size_t capacity = 2;
+		while (capacity < m_Config.queueCapacity)
+			capacity <<= 1;
+		for (int i = 0; i < m_Config.workerCount; ++i) {
+			auto worker = std::make_unique<Worker>();
+			worker->slots = std::make_unique<Job[]>(capacity);
+			worker->mask = capacity - 1;
+			m_Workers.push_back(std::move(worker));
+		}
+		m_DroppedCounter = MetricsRegistry::GetCounter("nom_eventsub_events_dropped_total", "EventSub notifications dropped because their worker queue was full.");
+		static const std::vector<double> waitBounds = { 0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 };
+		m_QueueWait = MetricsRegistry::GetHistogram("nom_eventsub_queue_wait_seconds", "Time EventSub notifications spend queued before a worker picks them up.", "", waitBounds);
+		m_QueueDepthGauge = MetricsRegistry::AddGauge("nom_eventsub_queue_depth", "EventSub notifications waiting for a worker.", "", [this] {
+			return static_cast<double>(GetQueueDepth());
+		});
+	}
+
+	EventSubWorkerPool::~EventSubWorkerPool()
+	{
+		MetricsRegistry::RemoveGauge(m_QueueDepthGauge);
+		Stop();
+	}
+
+	int EventSubWorkerPool::Start()
+	{
+		if (m_Running.exchange(true))
+			return 0;
+		for (int i = 0; i < static_cast<int>(m_Workers.size()); ++i)
+			m_Workers[i]->thread = std::thread(&EventSubWorkerPool::WorkerLoop, this, std::ref(*m_Workers[i]), i);
+		ImGuiLogManager::AddLog("TwitchAPI", "Started " + std::to_string(m_Workers.size()) + " EventSub workers.", LogSeverity::Info);
+		return 0;
+	}
+
+	void EventSubWorkerPool::Stop()
+	{
+		if (!m_Running.exchange(false))
+			return;
+		// A Push that still saw m_Running lands in its ring before the workers drain and exit
+		while (m_Pushing.load() != 0)
+			std::this_thread::yield();
+		for (auto& worker : m_Workers) {
+			// Taking the lock means the worker is either waiting or will see m_Running before it waits
+			{
+				std::lock_guard<std::mutex> lock(worker->mutex);
+			}
+			worker->wake.notify_one();
+		}
+		for (auto& worker : m_Workers) {
+			if (worker->thread.joinable())
+				worker->thread.join();
+		}
+	}
+
+	uint64_t EventSubWorkerPool::OrderingKey(EventSubOrdering ordering, EventSubType type, const JsonValue* event)
+	{
+		const std::string* key = nullptr;
+		if (ordering == EventSubOrdering::Reward && event && event->type == JsonValue::Type::Object) {
+			auto reward = event->objectValues.find("reward");
+			if (reward != event->objectValues.end() && reward->second)
+				key = FindString(reward->second.get(), "id");
+		}
+		if (!key && ordering != EventSubOrdering::Type)
+			key = FindString(event, "user_id");
+		return key ? EventSubHash(*key) : GetEventSubTypeInfo(type).hash;
+	}
+
+	int EventSubWorkerPool::Push(void* context, EventSubType type, const std::shared_ptr<JsonValue>& event)
+	{
+		// Counted before m_Running is read, pairs with Stop clearing m_Running before it reads m_Pushing
+		m_Pushing.fetch_add(1);
+		int result = m_Running.load() ? Enqueue(context, type, event) : -1;
+		m_Pushing.fetch_sub(1);
+		if (result == 0)
+			return 0;
+		m_Dropped.fetch_add(1, std::memory_order_relaxed);
+		m_DroppedCounter->Add();
+		NOM_LOG_WARNING("TwitchAPI", "EventSub worker queue full, dropped {} event.", GetEventSubTypeInfo(type).type);
+		return -1;
+	}
+
+	int EventSubWorkerPool::Enqueue(void* context, EventSubType type, const std::shared_ptr<JsonValue>& event)
+	{
+		uint64_t key = OrderingKey(m_Config.ordering, type, event.get()) ^ (reinterpret_cast<uintptr_t>(context) * 0x9E3779B97F4A7C15ull);
+		Worker& worker = *m_Workers[(key ^ (key >> 32)) % m_Workers.size()];
+		Job job;
+		job.context = context;
+		job.type = type;
+		job.event = event;
+		job.queuedAt = std::chrono::steady_clock::now();
+		if (TryPush(worker, job))
+			return 0;
+		if (m_Config.overflowPolicy == EventSubOverflowPolicy::Block) {
+			NOM_TRACE_SCOPE("Queue full");
+			auto deadline = job.queuedAt + std::chrono::milliseconds(m_Config.maxBlockMs);
+			while (std::chrono::steady_clock::now() < deadline) {
+				// Sleeping would round up to the OS timer resolution, far longer than a handler takes
+				std::this_thread::yield();
+				if (TryPush(worker, job))
+					return 0;
+			}
+		}
+		return -1;
+	}
+
+	bool EventSubWorkerPool::TryPush(Worker& worker, Job& job)
+	{
+		size_t tail = worker.tail.load(std::memory_order_relaxed);
+		if (tail - worker.head.load(std::memory_order_acquire) > worker.mask)
+			return false;
+		worker.slots[tail & worker.mask] = std::move(job);
+		// seq_cst pairs with the worker storing sleeping before it rechecks tail
+		worker.tail.store(tail + 1, std::memory_order_seq_cst);
+		if (worker.sleeping.load(std::memory_order_seq_cst)) {
+			{
+				std::lock_guard<std::mutex> lock(worker.mutex);
+			}
+			worker.wake.notify_one();
+		}
+		return true;
+	}
+
+	size_t EventSubWorkerPool::GetQueueDepth() const
+	{
+		size_t depth = 0;
+		for (const auto& worker : m_Workers)
+			depth += worker->Depth();
+		return depth;
+	}
+
+	void EventSubWorkerPool::WorkerLoop(Worker& worker, int index)
+	{
+		Trace::SetThreadName(("EventSub worker " + std::to_string(index)).c_str());
+		while (true) {
+			size_t head = worker.head.load(std::memory_order_relaxed);
+			if (head != worker.tail.load(std::memory_order_acquire)) {
+				Job job = std::move(worker.slots[head & worker.mask]);
+				worker.head.store(head + 1, std::memory_order_release);
+				m_QueueWait->ObserveMicros(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - job.queuedAt).count());
+				m_Handler(job.context, job.type, job.event);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(worker.mutex);
+			worker.sleeping.store(true, std::memory_order_seq_cst);
+			worker.wake.wait(lock, [&] {
+				return worker.tail.load(std::memory_order_seq_cst) != worker.head.load(std::memory_order_relaxed) || !m_Running.load();
+			});
+			worker.sleeping.store(false, std::memory_order_relaxed);
+			// Stop drains the queue before the worker exits
+			if (!m_Running.load() && worker.tail.load(std::memory_order_acquire) == worker.head.load(std::memory_order_relaxed))
+				return;
+		}
+	}
+}
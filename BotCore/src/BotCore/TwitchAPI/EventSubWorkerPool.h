@@ -0,0 +1,95 @@
+#ifndef __EVENTSUBWORKERPOOL_H__
+#define __EVENTSUBWORKERPOOL_H__
+#include "EventSubEvents.h"
+#include "../Core/Metrics/Metrics.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <chrono>
+
+namespace NomBotCore {
+	// Events with the same key always run on the same worker, in the order they were received
+	enum class EventSubOrdering {
+		User, // payload.event.user_id
+		Reward, // payload.event.reward.id, then user_id
+		Type // Only events of one subscription type are kept in order
+	};
+
+	enum class EventSubOverflowPolicy {
+		Drop, // The reader never waits, events a full worker can't take are counted and skipped
+		Block // The reader waits up to maxBlockMs for the worker before dropping
+	};
+
+	struct EventSubWorkerPoolConfig {
+		int workerCount = 2;
+		size_t queueCapacity = 1024; // Per worker, rounded up to a power of two
+		EventSubOrdering ordering = EventSubOrdering::User;
+		EventSubOverflowPolicy overflowPolicy = EventSubOverflowPolicy::Drop;
+		int maxBlockMs = 50; // Keep well under the session keepalive, or Twitch closes the connection
+	};
+
+	// Moves EventSub handlers off the WebSocket reader thread. Every worker owns a single producer,
+	// single consumer ring, so Push never takes a lock. Events without the ordering key fall back
+	// to their subscription type, so nothing is ever reordered against events like it. Keys are
+	// per context, the channel an event arrived on, so one pool serves every channel.
+	class EventSubWorkerPool {
+	public:
+		using Handler = std::function<void(void* context, EventSubType type, const std::shared_ptr<JsonValue>& event)>;
+
+		EventSubWorkerPool(Handler handler, const EventSubWorkerPoolConfig& config = EventSubWorkerPoolConfig());
+		~EventSubWorkerPool();
+
+		int Start();
+		// Runs everything already queued, then joins the workers
+		void Stop();
+
+		// Only one thread may push, the EventSub reader. context goes to the handler untouched.
+		// Returns 0 when queued, -1 when dropped.
+		int Push(void* context, EventSubType type, const std::shared_ptr<JsonValue>& event);
+
+		bool IsRunning() const { return m_Running.load(); }
+		size_t GetQueueDepth() const;
+		uint64_t GetDroppedCount() const { return m_Dropped.load(std::memory_order_relaxed); }
+		static uint64_t OrderingKey(EventSubOrdering ordering, EventSubType type, const JsonValue* event);
+	private:
+		struct Job {
+			void* context = nullptr;
+			EventSubType type = EventSubType::Unknown;
+			std::shared_ptr<JsonValue> event;
+			std::chrono::steady_clock::time_point queuedAt;
+		};
+
+		struct Worker {
+			std::unique_ptr<Job[]> slots;
+			size_t mask = 0;
+			alignas(64) std::atomic<size_t> head{ 0 }; // Next slot the worker reads
+			alignas(64) std::atomic<size_t> tail{ 0 }; // Next slot the reader writes
+			std::atomic<bool> sleeping{ false };
+			std::mutex mutex; // Only for sleeping and waking, never held while handling
+			std::condition_variable wake;
+			std::thread thread;
+
+			size_t Depth() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+		};
+
+		void WorkerLoop(Worker& worker, int index);
+		int Enqueue(void* context, EventSubType type, const std::shared_ptr<JsonValue>& event);
+		bool TryPush(Worker& worker, Job& job);
+
+		Handler m_Handler;
+		EventSubWorkerPoolConfig m_Config;
+		std::vector<std::unique_ptr<Worker>> m_Workers;
+		std::atomic<bool> m_Running{ false };
+		std::atomic<int> m_Pushing{ 0 }; // Pushes past the m_Running check, Stop waits for them
+		std::atomic<uint64_t> m_Dropped{ 0 };
+		MetricCounter* m_DroppedCounter = nullptr;
+		MetricHistogram* m_QueueWait = nullptr;
+		int m_QueueDepthGauge = 0;
+	};
+}
+
+#endif
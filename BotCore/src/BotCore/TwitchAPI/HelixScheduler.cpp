@@ -0,0 +1,308 @@
+#include "nompch.h"
+#include "HelixScheduler.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include <future>
+#include <ctime>
+
+namespace NomBotCore {
+	namespace {
+		bool ParseHeaderInt(std::string_view value, long long& out)
+		{
+			if (value.empty())
+				return false;
+			long long result = 0;
+			for (char c : value) {
+				if (c < '0' || c > '9')
+					return false;
+				result = result * 10 + (c - '0');
+			}
+			out = result;
+			return true;
+		}
+	}
+
+	void HelixScheduler::TokenBucket::Refill(std::chrono::steady_clock::time_point now)
+	{
+		double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+		lastRefill = now;
+		if (learned)
+			tokens = std::min(limit, tokens + elapsed * refillPerSecond);
+	}
+
+	HelixScheduler::HelixScheduler(HttpClient& httpClient, SocketEventLoop& loop, int maxInFlight)
+		: m_HttpClient(httpClient), m_Loop(loop), m_MaxInFlight(maxInFlight > 0 ? maxInFlight : 1)
+	{
+		for (int p = 0; p < 3; ++p) {
+			std::string label = MetricLabel("priority", PriorityName(static_cast<HelixPriority>(p)));
+			m_Latency[p] = MetricsRegistry::GetHistogram("nom_helix_request_duration_seconds", "Helix request time from send to response, retries counted separately.", label);
+			m_QueueDepthGauges[p] = MetricsRegistry::AddGauge("nom_helix_queue_depth", "Helix requests waiting for their turn or rate limit tokens.", label, [this, p] {
+				std::lock_guard<std::mutex> lock(m_QueueMutex);
+				return static_cast<double>(m_Queues[p].size());
+			});
+		}
+		m_Dispatcher = std::thread(&HelixScheduler::DispatchLoop, this);
+	}
+
+	HelixScheduler::~HelixScheduler()
+	{
+		for (int id : m_QueueDepthGauges)
+			MetricsRegistry::RemoveGauge(id);
+		Stop();
+	}
+
+	void HelixScheduler::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			if (!m_Running)
+				return;
+			m_Running = false;
+		}
+		m_QueueCondition.notify_all();
+		if (m_Dispatcher.joinable())
+			m_Dispatcher.join();
+		{
+			// A request in flight ends at its deadline at the latest, right away once the socket loop stopped
+			std::unique_lock<std::mutex> lock(m_QueueMutex);
+			m_IdleCondition.wait(lock, [this] { return m_InFlight == 0; });
+		}
+		// Fail whatever never got to run so waiters in SendAndWait are released
+		for (auto& queue : m_Queues) {
+			for (auto& queued : queue) {
+				if (queued.callback) {
+					HttpResponse empty;
+					queued.callback(-1, empty);
+				}
+			}
+			queue.clear();
+		}
+	}
+
+	void HelixScheduler::Submit(HttpRequest request, HelixPriority priority, Callback callback)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			if (m_Running) {
+				QueuedRequest queued;
+				queued.bucket = BucketKey(request);
+				queued.request = std::move(request);
+				queued.priority = priority;
+				queued.callback = std::move(callback);
+				m_Queues[static_cast<int>(priority)].push_back(std::move(queued));
+				m_QueueCondition.notify_one();
+				return;
+			}
+		}
+		ImGuiLogManager::AddLog("Helix", "Scheduler is stopped, dropping request " + request.method + " " + request.path, LogSeverity::Warning);
+		if (callback) {
+			HttpResponse empty;
+			callback(-1, empty);
+		}
+	}
+
+	int HelixScheduler::SendAndWait(const HttpRequest& request, HelixPriority priority, HttpResponse& response)
+	{
+		std::promise<int> done;
+		std::future<int> result = done.get_future();
+		Submit(request, priority, [&done, &response](int status, HttpResponse& received) {
+			response = std::move(received);
+			done.set_value(status);
+		});
+		return result.get();
+	}
+
+	size_t HelixScheduler::GetQueueDepth()
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		size_t depth = 0;
+		for (const auto& queue : m_Queues)
+			depth += queue.size();
+		return depth;
+	}
+
+	std::string HelixScheduler::BucketKey(const HttpRequest& request)
+	{
+		for (const auto& [name, value] : request.headers) {
+			// Only a hash of the token ends up in the key, it shows up in logs
+			if (name == "Authorization") {
+				char hash[17];
+				snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(std::hash<std::string>()(value)));
+				return request.host + " token " + std::string(hash, 8);
+			}
+		}
+		return request.host;
+	}
+
+	HelixScheduler::BucketState HelixScheduler::GetBucketState(const std::string& bucket)
+	{
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		BucketState state;
+		auto it = m_Buckets.find(bucket);
+		if (it == m_Buckets.end())
+			return state;
+		auto now = std::chrono::steady_clock::now();
+		it->second.Refill(now);
+		state.limit = static_cast<int>(it->second.limit);
+		state.tokens = it->second.tokens;
+		state.learned = it->second.learned;
+		if (it->second.blockedUntil > now)
+			state.blockedForMs = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(it->second.blockedUntil - now).count());
+		return state;
+	}
+
+	bool HelixScheduler::TryTake(HelixPriority priority, const QueuedRequest& queued, std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& retryAt)
+	{
+		TokenBucket& bucket = m_Buckets[queued.bucket];
+		bucket.Refill(now);
+		if (now < bucket.blockedUntil) {
+			retryAt = std::min(retryAt, bucket.blockedUntil);
+			return false;
+		}
+		if (!bucket.learned)
+			return true; // Nothing known about this bucket yet, the first response will teach us
+		double floor = priority == HelixPriority::BulkLookup ? bucket.limit * BulkReserveFraction : 0.0;
+		if (bucket.tokens - 1.0 < floor) {
+			double missing = floor + 1.0 - bucket.tokens;
+			auto wait = std::chrono::duration<double>(bucket.refillPerSecond > 0 ? missing / bucket.refillPerSecond : 1.0);
+			retryAt = std::min(retryAt, now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(wait));
+			return false;
+		}
+		bucket.tokens -= 1.0;
+		return true;
+	}
+
+	void HelixScheduler::UpdateBucket(const std::string& key, const HttpResponse& response)
+	{
+		long long limit = 0;
+		long long remaining = 0;
+		long long reset = 0;
+		bool hasLimit = ParseHeaderInt(response.GetHeader("Ratelimit-Limit"), limit);
+		bool hasRemaining = ParseHeaderInt(response.GetHeader("Ratelimit-Remaining"), remaining);
+		bool hasReset = ParseHeaderInt(response.GetHeader("Ratelimit-Reset"), reset);
+		if (!hasLimit && !hasRemaining && response.GetStatusCode() != 429)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_QueueMutex);
+		TokenBucket& bucket = m_Buckets[key];
+		auto now = std::chrono::steady_clock::now();
+		bucket.Refill(now);
+		if (hasLimit && limit > 0) {
+			bucket.limit = static_cast<double>(limit);
+			bucket.learned = true;
+		}
+		if (hasRemaining)
+			bucket.tokens = static_cast<double>(remaining);
+		// Ratelimit-Reset is when the bucket is full again, pace the refill to land there
+		long long secondsToReset = hasReset ? std::max(1LL, reset - static_cast<long long>(std::time(nullptr))) : 60;
+		bucket.refillPerSecond = bucket.limit > bucket.tokens ? (bucket.limit - bucket.tokens) / secondsToReset : bucket.limit / 60.0;
+		if (response.GetStatusCode() == 429) {
+			bucket.tokens = 0;
+			long long waitSeconds = hasReset ? reset - static_cast<long long>(std::time(nullptr)) : 1;
+			waitSeconds = std::max(1LL, std::min(60LL, waitSeconds));
+			bucket.blockedUntil = now + std::chrono::seconds(waitSeconds);
+			ImGuiLogManager::AddLog("Helix", "Rate limited by " + key + ", pausing for " + std::to_string(waitSeconds) + "s", LogSeverity::Warning);
+		}
+		m_QueueCondition.notify_all();
+	}
+
+	void HelixScheduler::DispatchLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_QueueMutex);
+		while (m_Running) {
+			QueuedRequest queued;
+			bool found = false;
+			bool anyQueued = false;
+			auto now = std::chrono::steady_clock::now();
+			auto retryAt = std::chrono::steady_clock::time_point::max();
+			if (m_InFlight < m_MaxInFlight) {
+				for (int p = 0; p < 3 && !found; ++p) {
+					if (m_Queues[p].empty())
+						continue;
+					anyQueued = true;
+					// The first request whose bucket has room, requests sharing a bucket still go in order
+					for (auto it = m_Queues[p].begin(); it != m_Queues[p].end(); ++it) {
+						if (TryTake(static_cast<HelixPriority>(p), *it, now, retryAt)) {
+							queued = std::move(*it);
+							m_Queues[p].erase(it);
+							found = true;
+							break;
+						}
+					}
+				}
+			}
+			if (!found) {
+				// A finished request, a new one or a bucket update wakes it
+				if (!anyQueued || retryAt == std::chrono::steady_clock::time_point::max())
+					m_QueueCondition.wait(lock);
+				else
+					m_QueueCondition.wait_until(lock, retryAt);
+				continue;
+			}
+
+			++m_InFlight;
+			lock.unlock();
+			// Runs here until its first wait on the socket loop, connecting and sending get there without blocking
+			Spawn(RunRequest(std::move(queued)), std::function<void(int)>([this](int) {
+				std::lock_guard<std::mutex> doneLock(m_QueueMutex);
+				--m_InFlight;
+				m_QueueCondition.notify_all();
+				m_IdleCondition.notify_all();
+			}));
+			lock.lock();
+		}
+	}
+
+	Task<int> HelixScheduler::RunRequest(QueuedRequest queued)
+	{
+		HttpResponse response;
+		auto started = std::chrono::steady_clock::now();
+		int result = co_await m_HttpClient.SendAsync(m_Loop, queued.request, response);
+		m_Latency[static_cast<int>(queued.priority)]->ObserveMicros(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+		CountResponse(queued.priority, result, result == 0 ? response.GetStatusCode() : 0);
+		if (result == 0)
+			UpdateBucket(queued.bucket, response);
+		if (result == 0 && response.GetStatusCode() == 429 && ++queued.attempts < MaxAttempts) {
+			// Requeue at the front of its class so it keeps its place once the bucket resets
+			std::lock_guard<std::mutex> lock(m_QueueMutex);
+			if (m_Running) {
+				m_Queues[static_cast<int>(queued.priority)].push_front(std::move(queued));
+				m_QueueCondition.notify_all();
+				co_return result;
+			}
+		}
+		if (queued.callback)
+			queued.callback(result, response);
+		co_return result;
+	}
+
+	const char* HelixScheduler::PriorityName(HelixPriority priority)
+	{
+		switch (priority) {
+		case HelixPriority::TokenRefresh:           return "token_refresh";
+		case HelixPriority::SubscriptionManagement: return "subscription_management";
+		case HelixPriority::BulkLookup:             return "bulk_lookup";
+		default:                                    return "unknown";
+		}
+	}
+
+	void HelixScheduler::CountResponse(HelixPriority priority, int result, int statusCode)
+	{
+		// 429 gets its own series, the rest are grouped by class to keep the label set small
+		static const char* statusNames[] = { "error", "1xx", "2xx", "3xx", "4xx", "5xx", "429" };
+		static MetricCounter* counters[3][7] = {};
+		static std::once_flag created;
+		std::call_once(created, [] {
+			for (int p = 0; p < 3; ++p) {
+				for (int s = 0; s < 7; ++s)
+					counters[p][s] = MetricsRegistry::GetCounter("nom_helix_requests_total", "Helix requests sent, by priority and response status.",
+						MetricLabel("priority", PriorityName(static_cast<HelixPriority>(p))) + "," + MetricLabel("status", statusNames[s]));
+			}
+		});
+		int status = 0;
+		if (result == 0 && statusCode == 429)
+			status = 6;
+		else if (result == 0 && statusCode >= 100 && statusCode < 600)
+			status = statusCode / 100;
+		counters[static_cast<int>(priority)][status]->Add();
+	}
+}
@@ -0,0 +1,130 @@
+#ifndef __HELIXSCHEDULER_H__
+#define __HELIXSCHEDULER_H__
+
+#include "../Networking/HttpClient.h"
+#include "../Networking/SocketEventLoop.h"
+#include "../Core/Async/Task.h"
+#include "../Core/Metrics/Metrics.h"
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <map>
+#include <functional>
+#include <coroutine>
+
+namespace NomBotCore {
+	// Lower value runs first
+	enum class HelixPriority {
+		TokenRefresh = 0,
+		SubscriptionManagement = 1,
+		BulkLookup = 2
+	};
+
+	// Queues Helix requests by priority and only releases them while their token bucket, learned from the
+	// Ratelimit-Limit/Remaining/Reset response headers, still has tokens. Twitch counts every access token
+	// separately, so there is one bucket per host and Authorization header, and a channel that ran its bucket
+	// dry doesn't hold up requests made with other tokens. A dispatcher thread releases requests, which then run
+	// as coroutines on the socket loop without holding a thread. At most maxInFlight run at once, so a request
+	// waiting for tokens or a pooled connection doesn't lose its place to one of lower priority.
+	class HelixScheduler {
+	public:
+		// result is 0 when a response was received (check its status code), -1 otherwise
+		using Callback = std::function<void(int result, HttpResponse& response)>;
+
+		struct BucketState {
+			int limit = 0;
+			double tokens = 0;
+			bool learned = false;
+			int blockedForMs = 0;
+		};
+
+		struct SendResult {
+			int result = -1; // As for Callback
+			HttpResponse response;
+		};
+
+		// co_await SendAsync(...) queues the request like Submit and resumes the coroutine on the socket loop that
+		// got the response, so what follows must not block the loop, e.g. with SendAndWait
+		class SendAwaiter {
+		public:
+			SendAwaiter(HelixScheduler& scheduler, HttpRequest request, HelixPriority priority)
+				: m_Scheduler(scheduler), m_Request(std::move(request)), m_Priority(priority) {}
+			bool await_ready() const noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> handle)
+			{
+				// Submit may call back before it returns, nothing here is touched after it
+				m_Scheduler.Submit(std::move(m_Request), m_Priority, [this, handle](int result, HttpResponse& response) {
+					m_Result.result = result;
+					m_Result.response = std::move(response);
+					handle.resume();
+				});
+			}
+			SendResult await_resume() { return std::move(m_Result); }
+		private:
+			HelixScheduler& m_Scheduler;
+			HttpRequest m_Request;
+			HelixPriority m_Priority;
+			SendResult m_Result;
+		};
+
+		HelixScheduler(HttpClient& httpClient, SocketEventLoop& loop, int maxInFlight = 2);
+		~HelixScheduler();
+
+		void Submit(HttpRequest request, HelixPriority priority, Callback callback = nullptr);
+		SendAwaiter SendAsync(HttpRequest request, HelixPriority priority) { return SendAwaiter(*this, std::move(request), priority); }
+		// Blocking helper for sequential flows; must not be called from a scheduler callback or the socket loop
+		int SendAndWait(const HttpRequest& request, HelixPriority priority, HttpResponse& response);
+		void Stop();
+
+		size_t GetQueueDepth();
+		BucketState GetBucketState(const std::string& bucket);
+		// The bucket a request is counted against
+		static std::string BucketKey(const HttpRequest& request);
+	private:
+		struct QueuedRequest {
+			HttpRequest request;
+			std::string bucket;
+			HelixPriority priority = HelixPriority::BulkLookup;
+			Callback callback;
+			int attempts = 0;
+		};
+
+		struct TokenBucket {
+			double limit = 0;
+			double tokens = 0;
+			double refillPerSecond = 0;
+			bool learned = false;
+			std::chrono::steady_clock::time_point lastRefill = std::chrono::steady_clock::now();
+			std::chrono::steady_clock::time_point blockedUntil = std::chrono::steady_clock::now();
+
+			void Refill(std::chrono::steady_clock::time_point now);
+		};
+
+		void DispatchLoop();
+		Task<int> RunRequest(QueuedRequest queued);
+		bool TryTake(HelixPriority priority, const QueuedRequest& queued, std::chrono::steady_clock::time_point now, std::chrono::steady_clock::time_point& retryAt);
+		void UpdateBucket(const std::string& bucket, const HttpResponse& response);
+		static const char* PriorityName(HelixPriority priority);
+		static void CountResponse(HelixPriority priority, int result, int statusCode);
+
+		HttpClient& m_HttpClient;
+		SocketEventLoop& m_Loop;
+		int m_MaxInFlight;
+		std::thread m_Dispatcher;
+		std::atomic<bool> m_Running{ true };
+		std::mutex m_QueueMutex;
+		std::condition_variable m_QueueCondition;
+		int m_InFlight = 0; // Under m_QueueMutex
+		std::condition_variable m_IdleCondition;
+		std::deque<QueuedRequest> m_Queues[3];
+		std::map<std::string, TokenBucket> m_Buckets;
+		MetricHistogram* m_Latency[3] = {}; // By priority
+		int m_QueueDepthGauges[3] = {};
+
+		static constexpr int MaxAttempts = 3;
+		// Share of the bucket kept back for token refresh and subscription management
+		static constexpr double BulkReserveFraction = 0.1;
+	};
+}
+
+#endif
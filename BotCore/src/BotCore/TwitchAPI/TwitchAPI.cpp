@@ -1,358 +1,960 @@
 #include "nompch.h"
 #include "TwitchAPI.h"
 #include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Logging/StructuredLog.h"
 #include "../Core/JSONParser/JsonParser.h"
-#include "ChannelPointRewardRedemption.h"
+#include "../Core/Tracing/Trace.h"
+#include "../Core/Metrics/Metrics.h"
+#include <random>
+#include <condition_variable>
 
 namespace NomBotCore {
-	TwitchAPI::TwitchAPI()
+	namespace {
+		void SetEndpoint(HttpRequest& request, const TwitchEndpoint& endpoint)
+		{
+			request.host = endpoint.host;
+			request.port = endpoint.port;
+			request.useTls = endpoint.useTls;
+		}
+
+		void AssignCString(char*& target, const std::string& value)
+		{
+			if (target != nullptr)
+				delete[] target;
+			target = new char[value.length() + 1];
+			strcpy_s(target, value.length() + 1, value.c_str());
+		}
+
+		const JsonValue* FindJsonField(const JsonValue* object, const char* key, JsonValue::Type type)
+		{
+			if (!object || object->type != JsonValue::Type::Object)
+				return nullptr;
+			auto it = object->objectValues.find(key);
+			if (it == object->objectValues.end() || !it->second || it->second->type != type)
+				return nullptr;
+			return it->second.get();
+		}
+
+		// ws:// or wss://host[:port]/path, as in a session_reconnect's reconnect_url. path keeps the query.
+		bool ParseWebSocketUrl(const std::string& url, TwitchEndpoint& endpoint, std::string& path)
+		{
+			size_t hostStart = 0;
+			if (url.rfind("wss://", 0) == 0) {
+				endpoint.useTls = true;
+				endpoint.port = 443;
+				hostStart = 6;
+			}
+			else if (url.rfind("ws://", 0) == 0) {
+				endpoint.useTls = false;
+				endpoint.port = 80;
+				hostStart = 5;
+			}
+			else
+				return false;
+			size_t pathStart = url.find('/', hostStart);
+			std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+			path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+			size_t colon = authority.rfind(':');
+			if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+				int port = atoi(authority.c_str() + colon + 1);
+				if (port <= 0 || port > 65535)
+					return false;
+				endpoint.port = port;
+				authority.resize(colon);
+			}
+			if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']')
+				authority = authority.substr(1, authority.size() - 2);
+			endpoint.host = authority;
+			return !endpoint.host.empty();
+		}
+
+		enum EventSubMessageKind {
+			MessageWelcome,
+			MessageNotification,
+			MessageKeepalive,
+			MessageReconnect,
+			MessageRevocation,
+			MessageUnknown,
+			MessageKindCount
+		};
+
+		// Every series is created up front, so the reader only indexes arrays
+		struct EventSubMetrics {
+			MetricHistogram* parseTime;
+			MetricCounter* parseErrors;
+			MetricCounter* duplicates;
+			MetricCounter* messages[MessageKindCount];
+			MetricCounter* received[EventSubTypeCount + 1]; // Last one is EventSubType::Unknown
+			MetricCounter* dispatched[EventSubTypeCount + 1];
+
+			EventSubMetrics()
+			{
+				static const std::vector<double> parseBounds = { 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025 };
+				parseTime = MetricsRegistry::GetHistogram("nom_eventsub_parse_seconds", "Time to parse one EventSub message.", "", parseBounds);
+				parseErrors = MetricsRegistry::GetCounter("nom_eventsub_parse_errors_total", "EventSub messages that failed to parse.");
+				duplicates = MetricsRegistry::GetCounter("nom_eventsub_duplicates_total", "EventSub notifications skipped because their message_id was already handled.");
+				static const char* messageNames[MessageKindCount] = { "session_welcome", "notification", "session_keepalive", "session_reconnect", "revocation", "unknown" };
+				for (int i = 0; i < MessageKindCount; ++i)
+					messages[i] = MetricsRegistry::GetCounter("nom_eventsub_messages_received_total", "EventSub messages received, by message type.", MetricLabel("message_type", messageNames[i]));
+				for (int i = 0; i <= EventSubTypeCount; ++i) {
+					std::string label = MetricLabel("event_type", GetEventSubTypeInfo(static_cast<EventSubType>(i)).type);
+					received[i] = MetricsRegistry::GetCounter("nom_eventsub_events_received_total", "EventSub notifications received, by subscription type.", label);
+					dispatched[i] = MetricsRegistry::GetCounter("nom_eventsub_events_dispatched_total", "EventSub notifications handed to at least one handler, by subscription type.", label);
+				}
+			}
+		};
+
+		const EventSubMetrics& GetEventSubMetrics()
+		{
+			static const EventSubMetrics metrics;
+			return metrics;
+		}
+	}
+
+	TwitchAPI::TwitchAPI(TwitchServices& services, const TwitchChannelConfig& config)
+		: m_Services(services), m_Config(config)
 	{
-		m_ScopesString = "chat:read+moderator:manage:automod+channel:read:redemptions";
-		AddEventSubSubscription(SubscriptionType::AutomodMessageHold, nullptr);
+		// Every type a channel may subscribe to later, a token without the scope gets 403 on create
+		m_ScopesString = GetEventSubScopes();
+		m_WebSocketName = "WebSocket " + m_Config.name;
+		std::string label = MetricLabel("channel", m_Config.name);
+		m_NotificationCounter = MetricsRegistry::GetCounter("nom_channel_notifications_total", "EventSub notifications received per channel, duplicates left out.", label);
+		m_HandledCounter = MetricsRegistry::GetCounter("nom_channel_events_handled_total", "EventSub notifications per channel that reached at least one handler.", label);
+		m_ConnectCounter = MetricsRegistry::GetCounter("nom_channel_connects_total", "EventSub WebSocket connections opened per channel.", label);
+		m_DisconnectCounter = MetricsRegistry::GetCounter("nom_channel_disconnects_total", "EventSub WebSocket connections per channel that were lost.", label);
+		m_ReconcileId = m_Services.GetReconciler().Add(m_Config.name, [this] { return RunReconcilePass(); });
+		AddEventSubSubscription(SubscriptionType::AutomodMessageHold);
 	}
 
 	TwitchAPI::~TwitchAPI()
 	{
-		if (m_SocketManager) {
-			m_SocketManager->CloseAllSockets();
-			delete m_SocketManager;
-			m_SocketManager = nullptr;
-		}
+		Stop();
+		// A pass reads the subscriptions and the token, it has to be done before they go
+		m_Services.GetReconciler().Remove(m_ReconcileId);
 		if (m_WebSocket) {
 			delete m_WebSocket;
 			m_WebSocket = nullptr;
 		}
-		if (m_ClientID) {
-			delete[] m_ClientID;
-			m_ClientID = nullptr;
+		if (m_NextWebSocket) {
+			delete m_NextWebSocket;
+			m_NextWebSocket = nullptr;
 		}
-		if (m_ClientSecret) {
-			delete[] m_ClientSecret;
-			m_ClientSecret = nullptr;
+	}
+
+	Task<int> TwitchAPI::StartAsync()
+	{
+		if (m_Started)
+			co_return 0;
+		if (!m_Services.IsInitialized()) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Cannot start channel " + m_Config.name + " before the Twitch services are initialized.", LogSeverity::Error);
+			co_return 1;
+		}
+		if (!m_WebSocket) {
+			m_WebSocket = new NomWebSocket(m_Services.GetSocketManager(), m_WebSocketName);
+			m_NextWebSocket = new NomWebSocket(m_Services.GetSocketManager(), m_WebSocketName + " reconnect");
+		}
+		// Raw frames for ReplayCapture, e.g. to reproduce a raid followed by a burst of redemptions
+		char* captureFile = nullptr;
+		size_t captureFileLen = 0;
+		if (m_Config.refreshToken.empty() && _dupenv_s(&captureFile, &captureFileLen, "NOM_CAPTURE_FILE") == 0 && captureFile != nullptr) {
+			StartCapture(captureFile);
+			free(captureFile);
+		}
+		if (co_await AuthenticateAsync() != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Channel " + m_Config.name + " failed to sign in.", LogSeverity::Error);
+			co_return 1;
 		}
+		m_Started = true;
+		ScheduleTokenRefresh(NextRefreshDelay(*GetToken()));
+		co_return 0;
 	}
 
-	void TwitchAPI::Run(std::atomic<bool>& running)
+	void TwitchAPI::BeginStart()
 	{
-		Initialize();
-		Authenticate();
-		while (running) {
-			CheckIfRefreshNeeded();
-			std::this_thread::sleep_for(std::chrono::seconds(1));
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			if (m_Starting || m_Started)
+				return;
+			m_Starting = true;
+			m_TimersClosed = false;
+			m_RefreshBackoff = InitialRefreshBackoff;
 		}
-		m_IsWebSocketEnabled = false;
+		SpawnTracked(StartAsync(), [this](int) {
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			m_Starting = false;
+		});
+	}
 
-		for (auto& t : internalThreads) {
+	void TwitchAPI::Stop()
+	{
+		EnableWebSocket(false);
+		TimerWheel::TimerId refresh = 0;
+		TimerWheel::TimerId keepalive = 0;
+		TimerWheel::TimerId reconnect = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			m_TimersClosed = true;
+			refresh = std::exchange(m_RefreshTimer, 0);
+			keepalive = std::exchange(m_KeepaliveTimer, 0);
+			reconnect = std::exchange(m_ReconnectTimer, 0);
+		}
+		// Waits for a callback that is running, whatever it spawned is counted by the time it returns
+		m_Services.GetTimers().Cancel(refresh);
+		m_Services.GetTimers().Cancel(keepalive);
+		m_Services.GetTimers().Cancel(reconnect);
+		std::vector<std::thread> threads;
+		{
+			// A browser sign in only ends here once TwitchServices::CancelWaits ran or the redirect came
+			std::unique_lock<std::mutex> lock(m_ThreadMutex);
+			m_TasksDone.wait(lock, [this] { return m_RunningTasks == 0; });
+			threads.swap(internalThreads);
+		}
+		for (auto& t : threads) {
 			if (t.joinable()) {
 				t.join();
 			}
 		}
+		m_Started = false;
+	}
+
+	void TwitchAPI::SpawnTracked(Task<int> task, std::function<void(int)> done)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			++m_RunningTasks;
+		}
+		Spawn(std::move(task), std::function<void(int)>([this, done](int result) {
+			if (done)
+				done(result);
+			EndTrackedTask();
+		}));
+	}
+
+	void TwitchAPI::EndTrackedTask()
+	{
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		--m_RunningTasks;
+		m_TasksDone.notify_all();
+	}
+
+	std::chrono::milliseconds TwitchAPI::NextRefreshDelay(const TwitchToken& token)
+	{
+		static thread_local std::mt19937 random(std::random_device{}());
+		std::uniform_real_distribution<double> share(0.75, 0.85);
+		auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(token.lifetime * share(random));
+		// A token that claims to expire right away would otherwise be refreshed in a tight loop
+		return std::max(delay, std::chrono::milliseconds(1000));
+	}
+
+	void TwitchAPI::ScheduleTokenRefresh(std::chrono::milliseconds delay)
+	{
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		// One chain per channel, the sign in starts it and every refresh schedules the next
+		if (m_TimersClosed || m_RefreshTimer != 0)
+			return;
+		m_RefreshTimer = m_Services.GetTimers().Schedule(delay, [this] {
+			{
+				std::lock_guard<std::mutex> timerLock(m_ThreadMutex);
+				m_RefreshTimer = 0;
+			}
+			// The request goes through the Helix scheduler, the timer thread only starts it
+			SpawnTracked(RefreshAccessTokenAsync(), [this](int result) { OnTokenRefreshed(result); });
+		});
+	}
+
+	void TwitchAPI::OnTokenRefreshed(int result)
+	{
+		MetricsRegistry::GetCounter("nom_token_refreshes_total", "Scheduled access token refreshes, by outcome.", MetricLabel("result", result == 0 ? "ok" : "failed"))->Add();
+		std::shared_ptr<const TwitchToken> token = GetToken();
+		if (result == 0 && token) {
+			{
+				std::lock_guard<std::mutex> lock(m_ThreadMutex);
+				m_RefreshBackoff = InitialRefreshBackoff;
+			}
+			ScheduleTokenRefresh(NextRefreshDelay(*token));
+			return;
+		}
+		std::chrono::milliseconds delay;
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			delay = m_RefreshBackoff;
+			m_RefreshBackoff = std::min(m_RefreshBackoff * 2, MaxRefreshBackoff);
+		}
+		bool expired = token && token->expiresAt <= std::chrono::steady_clock::now();
+		ImGuiLogManager::AddLog("TwitchAPI", "Token refresh of channel " + m_Config.name + " failed" + (expired ? " and the token has expired" : "") +
+			", retrying in " + std::to_string(delay.count()) + " ms.", expired ? LogSeverity::Error : LogSeverity::Warning);
+		ScheduleTokenRefresh(delay);
+	}
+
+	void TwitchAPI::ArmKeepalive(std::chrono::milliseconds delay)
+	{
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		if (m_TimersClosed || m_KeepaliveTimer != 0)
+			return;
+		m_KeepaliveTimer = m_Services.GetTimers().Schedule(delay, [this] { CheckKeepalive(); });
 	}
 
-	void TwitchAPI::WebSocketThreadFunc(std::atomic<bool>& running)
+	void TwitchAPI::CheckKeepalive()
 	{
-		if (m_AccessToken) {
-			std::string authHeader = std::string("Bearer ") + m_AccessToken;
-			ImGuiLogManager::AddLog("TwitchAPI", "Setting WebSocket Authorization header: " + authHeader, LogSeverity::Info);
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			m_KeepaliveTimer = 0;
+		}
+		int timeoutMs = m_KeepaliveTimeoutMs.load();
+		if (!m_IsWebSocketEnabled || timeoutMs <= 0)
+			return; // Closed meanwhile, or reconnecting and waiting for the next welcome
+		auto lastFrameAt = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_LastFrameAt.load(std::memory_order_relaxed)));
+		auto quietMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lastFrameAt).count();
+		if (quietMs < timeoutMs) {
+			ArmKeepalive(std::chrono::milliseconds(timeoutMs - quietMs));
+			return;
+		}
+		// Twitch would have sent a keepalive by now, the connection is gone without a FIN reaching us
+		MetricsRegistry::GetCounter("nom_eventsub_keepalive_timeouts_total", "EventSub sessions closed because nothing arrived within the keepalive timeout.")->Add();
+		ImGuiLogManager::AddLog("TwitchAPI", "EventSub session of channel " + m_Config.name + " was quiet for " + std::to_string(quietMs) + " ms, closing it.", LogSeverity::Warning);
+		DropWebSocket();
+		m_DisconnectCounter->Add();
+		ScheduleReconnect();
+	}
+
+	void TwitchAPI::DropWebSocket()
+	{
+		m_IsWebSocketEnabled = false;
+		// Returns once the shared reader is done with this channel. A connect still running closes the socket
+		// itself once AddReader refuses, and a reader that saw the close already did.
+		if (m_Services.RemoveReader(this))
+			m_WebSocket->Close();
+	}
+
+	void TwitchAPI::ScheduleReconnect()
+	{
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		if (m_TimersClosed || !m_WebSocketWanted || m_ReconnectTimer != 0)
+			return;
+		std::chrono::milliseconds delay = m_ReconnectBackoff;
+		m_ReconnectBackoff = std::min(m_ReconnectBackoff * 2, MaxReconnectBackoff);
+		ImGuiLogManager::AddLog("TwitchAPI", "Reconnecting the EventSub WebSocket of channel " + m_Config.name + " in " + std::to_string(delay.count()) + " ms.", LogSeverity::Info);
+		m_ReconnectTimer = m_Services.GetTimers().Schedule(delay, [this] {
+			{
+				std::lock_guard<std::mutex> timerLock(m_ThreadMutex);
+				m_ReconnectTimer = 0;
+			}
+			OpenWebSocket();
+		});
+	}
+
+	TwitchChannelStats TwitchAPI::GetStats() const
+	{
+		TwitchChannelStats stats;
+		stats.notifications = m_NotificationCounter->Read();
+		stats.handled = m_HandledCounter->Read();
+		stats.connects = m_ConnectCounter->Read();
+		stats.disconnects = m_DisconnectCounter->Read();
+		return stats;
+	}
+
+	Task<int> TwitchAPI::ConnectEventSubAsync()
+	{
+		// A reconnect after a refresh picks up the new token here
+		std::shared_ptr<const TwitchToken> token = GetToken();
+		if (token) {
+			std::string authHeader = "Bearer " + token->accessToken;
+			NOM_LOG_INFO("TwitchAPI", "Setting WebSocket Authorization header.");
 			m_WebSocket->SetHandshakeHeader("Authorization", authHeader.c_str());
 		}
 		else {
 			ImGuiLogManager::AddLog("TwitchAPI", "Access token is not available. Cannot set Authorization header for WebSocket.", LogSeverity::Error);
 		}
-		int result = m_WebSocket->ConnectWebSocket("eventsub.wss.twitch.tv", 443, true);
+		const TwitchEndpoint& eventSub = m_Services.GetEndpoints().eventSub;
+		// The socket is left non-blocking, the reader never waits on it and a frame that arrives in pieces stays
+		// buffered until it is complete
+		int result = co_await m_WebSocket->ConnectWebSocketAsync(m_Services, eventSub.host, eventSub.port, eventSub.useTls);
+		MetricsRegistry::GetCounter("nom_eventsub_connects_total", "EventSub WebSocket connection attempts, every one after the first is a reconnect.",
+			MetricLabel("result", result < 0 ? "failed" : "ok"))->Add();
 		if (result < 0) {
 			m_IsWebSocketEnabled = false;
+			ScheduleReconnect();
+			co_return -1;
+		}
+		m_ConnectCounter->Add();
+		if (m_Services.AddReader(this) != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Channel " + m_Config.name + " was disabled or a replay started while its WebSocket connected.", LogSeverity::Warning);
+			m_IsWebSocketEnabled = false;
+			m_WebSocket->Close();
+			co_return -1;
+		}
+		co_return 0;
+	}
+
+	int TwitchAPI::ReadWebSocketFrames()
+	{
+		m_WebSocket->ReadAvailable();
+		std::string& message = m_FrameBuffer;
+		int result = 0;
+		while ((result = m_WebSocket->NextFrame(message)) == 1) {
+			RecordFrame(message);
+			HandleWebSocketMessage(message.c_str());
+		}
+		// Pongs the socket couldn't take right away
+		m_WebSocket->FlushWrites();
+		if (result == 0 && m_WebSocket->IsOpen())
+			return 0;
+		// On the reader, which drops the channel on -1
+		if (m_FollowingReconnect) {
+			// Twitch closes the old session once the new one is up, FollowReconnectAsync hands the reader over
+			m_WebSocket->Close();
+			ImGuiLogManager::AddLog("TwitchAPI", "Old EventSub session of channel " + m_Config.name + " closed during a reconnect.", LogSeverity::Info);
+			return -1;
+		}
+		m_DisconnectCounter->Add();
+		m_IsWebSocketEnabled = false;
+		m_WebSocket->Close();
+		ImGuiLogManager::AddLog("TwitchAPI", "EventSub WebSocket of channel " + m_Config.name + " closed.", LogSeverity::Warning);
+		ScheduleReconnect();
+		return -1;
+	}
+
+	void TwitchAPI::RecordFrame(const std::string& message)
+	{
+		auto receivedAt = std::chrono::steady_clock::now();
+		m_LastFrameAt.store(receivedAt.time_since_epoch().count(), std::memory_order_relaxed);
+		if (m_Capturing.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(m_CaptureMutex);
+			m_Capture.Write(message.data(), message.size(), receivedAt);
+		}
+	}
+
+	void TwitchAPI::FollowReconnect(const std::string& url)
+	{
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		// Shares the reconnect timer, a session already being replaced isn't replaced twice
+		if (m_TimersClosed || !m_WebSocketWanted || m_ReconnectTimer != 0 || m_FollowingReconnect)
 			return;
+		// Off the reader, which holds its lock while it handles this message and every connect wait needs it
+		m_ReconnectTimer = m_Services.GetTimers().Schedule(std::chrono::milliseconds(0), [this, url] {
+			{
+				std::lock_guard<std::mutex> timerLock(m_ThreadMutex);
+				m_ReconnectTimer = 0;
+			}
+			SpawnTracked(FollowReconnectAsync(url));
+		});
+	}
+
+	Task<int> TwitchAPI::FollowReconnectAsync(std::string url)
+	{
+		TwitchEndpoint endpoint;
+		std::string path;
+		if (!ParseWebSocketUrl(url, endpoint, path)) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Cannot follow reconnect_url " + url + ", channel " + m_Config.name + " reconnects once its session closes.", LogSeverity::Error);
+			co_return -1;
 		}
-		while (running && m_IsWebSocketEnabled) {
-			const char* message = m_WebSocket->ReceiveWebSocketFrame(true);
-			if (message) {
-				ImGuiLogManager::AddLog("WebSocket", std::string("Received WebSocket message: ") + message, LogSeverity::Info);
-				size_t pos = 0;
-				std::shared_ptr<JsonValue> json = JsonParser::Parse(message, pos);
-				if (json) {
-					json->DumpToLog();
-					if (json->type == JsonValue::Type::Object) {
-						auto metadatait = json->objectValues.find("metadata");
-						if (metadatait != json->objectValues.end() && metadatait->second->type == JsonValue::Type::Object) {
-							auto msgIt = metadatait->second->objectValues.find("message_type");
-							if (msgIt != metadatait->second->objectValues.end() && msgIt->second->type == JsonValue::Type::String) {
-								std::string messageType = msgIt->second->stringValue;
-								ImGuiLogManager::AddLog("TwitchAPI", "WebSocket message type: " + messageType, LogSeverity::Info);
-								if (messageType == "session_welcome") {
-									ImGuiLogManager::AddLog("TwitchAPI", "WebSocket session welcome received.", LogSeverity::Info);
-									auto payloadit = json->objectValues.find("payload");
-									if (payloadit != json->objectValues.end() && payloadit->second->type == JsonValue::Type::Object) {
-										auto sessionIt = payloadit->second->objectValues.find("session");
-										if (sessionIt != payloadit->second->objectValues.end() && sessionIt->second->type == JsonValue::Type::Object) {
-											auto idIt = sessionIt->second->objectValues.find("id");
-											if (idIt != sessionIt->second->objectValues.end() && idIt->second->type == JsonValue::Type::String) {
-												m_WebSocketSessionID = new char[idIt->second->stringValue.length() + 1];
-												strcpy(m_WebSocketSessionID, idIt->second->stringValue.c_str());
-												ImGuiLogManager::AddLog("TwitchAPI", "WebSocket session ID: " + std::string(m_WebSocketSessionID), LogSeverity::Info);
-											}
-											else {
-												ImGuiLogManager::AddLog("TwitchAPI", "Session ID field missing or not a string in WebSocket welcome message.", LogSeverity::Error);
-											}
-										}
-										else {
-											ImGuiLogManager::AddLog("TwitchAPI", "Session field missing or not an object in WebSocket welcome message.", LogSeverity::Error);
-										}
-									}
-									else {
-										ImGuiLogManager::AddLog("TwitchAPI", "Payload field missing or not an object in WebSocket message.", LogSeverity::Error);
-									}
-									// Subscribes to the AutomodMessageHold to keep the session alive
-									SubscribetoUnSubscribedEvents();
-								}
-								else if (messageType == "notification") {
-									// Handle notification
-									ImGuiLogManager::AddLog("TwitchAPI", "WebSocket notification received.", LogSeverity::Info);
-									auto payloadit = json->objectValues.find("payload");
-									if (payloadit != json->objectValues.end() && payloadit->second->type == JsonValue::Type::Object) {
-										auto eventIt = payloadit->second->objectValues.find("event");
-										if (eventIt != payloadit->second->objectValues.end() && eventIt->second->type == JsonValue::Type::Object) {
-											auto typeIt = payloadit->second->objectValues.find("subscription");
-											if (typeIt != payloadit->second->objectValues.end() && typeIt->second->type == JsonValue::Type::Object) {
-												auto typeFieldIt = typeIt->second->objectValues.find("type");
-												if (typeFieldIt != typeIt->second->objectValues.end() && typeFieldIt->second->type == JsonValue::Type::String) {
-													std::string eventType = typeFieldIt->second->stringValue;
-													ImGuiLogManager::AddLog("TwitchAPI", "Event type: " + eventType, LogSeverity::Info);
-													auto subIt = m_Subscriptions.find(eventType);
-													if (subIt != m_Subscriptions.end() && subIt->second->callback) {
-														// Call the registered callback with the event data as a JSON string
-														auto eventData = eventIt->second;
-														ChannelPointRewardRedemption redemption;
-														if (eventType == "channel.channel_points_custom_reward_redemption.add") {
-															auto obj = eventData->objectValues;
-															auto idIt = obj.find("id");
-															if (idIt != obj.end() && idIt->second->type == JsonValue::Type::String) {
-																redemption.id = idIt->second->stringValue;
-															}
-															auto userIdIt = obj.find("user_id");
-															if (userIdIt != obj.end() && userIdIt->second->type == JsonValue::Type::String) {
-																redemption.user_id = userIdIt->second->stringValue;
-															}
-															auto userLoginIt = obj.find("user_login");
-															if (userLoginIt != obj.end() && userLoginIt->second->type == JsonValue::Type::String) {
-																redemption.user_login = userLoginIt->second->stringValue;
-															}
-															auto userNameIt = obj.find("user_name");
-															if (userNameIt != obj.end() && userNameIt->second->type == JsonValue::Type::String) {
-																redemption.user_name = userNameIt->second->stringValue;
-															}
-															auto channelIdIt = obj.find("broadcaster_user_id");
-															if (channelIdIt != obj.end() && channelIdIt->second->type == JsonValue::Type::String) {
-																redemption.channel_id = channelIdIt->second->stringValue;
-															}
-															auto channelLoginIt = obj.find("broadcaster_user_login");
-															if (channelLoginIt != obj.end() && channelLoginIt->second->type == JsonValue::Type::String) {
-																redemption.channel_login = channelLoginIt->second->stringValue;
-															}
-															auto channelNameIt = obj.find("broadcaster_user_name");
-															if (channelNameIt != obj.end() && channelNameIt->second->type == JsonValue::Type::String) {
-																redemption.channel_name = channelNameIt->second->stringValue;
-															}
-															auto redeemedAtIt = obj.find("redeemed_at");
-															if (redeemedAtIt != obj.end() && redeemedAtIt->second->type == JsonValue::Type::String) {
-																redemption.redeemed_at = redeemedAtIt->second->stringValue;
-															}
-															auto rewardIdIt = obj.find("reward");
-															if (rewardIdIt != obj.end() && rewardIdIt->second->type == JsonValue::Type::Object) {
-																auto rewardObj = rewardIdIt->second->objectValues;
-																auto rewardIdFieldIt = rewardObj.find("id");
-																if (rewardIdFieldIt != rewardObj.end() && rewardIdFieldIt->second->type == JsonValue::Type::String) {
-																	redemption.reward_id = rewardIdFieldIt->second->stringValue;
-																}
-																auto rewardTitleFieldIt = rewardObj.find("title");
-																if (rewardTitleFieldIt != rewardObj.end() && rewardTitleFieldIt->second->type == JsonValue::Type::String) {
-																	redemption.reward_title = rewardTitleFieldIt->second->stringValue;
-																}
-																auto rewardCostFieldIt = rewardObj.find("cost");
-																if (rewardCostFieldIt != rewardObj.end() && rewardCostFieldIt->second->type == JsonValue::Type::Number) {
-																	redemption.reward_cost = std::to_string(static_cast<int32_t>(rewardCostFieldIt->second->numberValue));
-																}
-																auto promptIt = rewardObj.find("prompt");
-																if (promptIt != rewardObj.end() && promptIt->second->type == JsonValue::Type::String) {
-																	redemption.prompt = promptIt->second->stringValue;
-																}
-															}
-															auto statusIt = obj.find("status");
-															if (statusIt != obj.end() && statusIt->second->type == JsonValue::Type::String) {
-																redemption.status = statusIt->second->stringValue;
-															}
-															// user_input is optional
-															auto userInputIt = obj.find("user_input");
-															if (userInputIt != obj.end() && userInputIt->second->type == JsonValue::Type::String) {
-																try {
-																	redemption.user_input = userInputIt->second->stringValue;
-																}
-																catch (const std::exception&) {
-																	redemption.user_input = "";
-																}
-															}
-															else {
-																redemption.user_input = ""; // Default value if not provided
-															}
-														}
-														subIt->second->callback(redemption);
-														ImGuiLogManager::AddLog("TwitchAPI", "Invoked callback for event type: " + eventType, LogSeverity::Info);
-													}
-													else {
-														ImGuiLogManager::AddLog("TwitchAPI", "No callback registered for event type: " + eventType, LogSeverity::Warning);
-													}
-												}
-												else {
-													ImGuiLogManager::AddLog("TwitchAPI", "Type field missing or not a string in subscription object.", LogSeverity::Error);
-												}
-											}
-											else {
-												ImGuiLogManager::AddLog("TwitchAPI", "Subscription field missing or not an object in payload.", LogSeverity::Error);
-											}
-										}
-										else {
-											ImGuiLogManager::AddLog("TwitchAPI", "Event field missing or not an object in payload.", LogSeverity::Error);
-										}
-									}
-									else {
-										ImGuiLogManager::AddLog("TwitchAPI", "Payload field missing or not an object in WebSocket message.", LogSeverity::Error);
-									}
-								}
-								else if (messageType == "revocation") {
-									// Handle revocation
-									ImGuiLogManager::AddLog("TwitchAPI", "WebSocket revocation received.", LogSeverity::Warning);
-								}
-								else if (messageType == "keepalive" || messageType == "session_keepalive") {
-									// Handle keepalive
-									ImGuiLogManager::AddLog("TwitchAPI", "WebSocket keepalive received.", LogSeverity::Info);
-								}
-								else {
-									ImGuiLogManager::AddLog("TwitchAPI", "Unknown WebSocket message type: " + messageType, LogSeverity::Warning);
-								}
-							}
-							else {
-								ImGuiLogManager::AddLog("TwitchAPI", "message_type field missing or not a string in metadata.", LogSeverity::Error);
-							}
-						}
-						else {
-							ImGuiLogManager::AddLog("TwitchAPI", "metadata field missing or not an object in WebSocket message.", LogSeverity::Error);
-						}
-					}
-					else {
-						ImGuiLogManager::AddLog("TwitchAPI", "Expected JSON object at root of WebSocket message.", LogSeverity::Error);
-					}
-				}
-				else {
-					ImGuiLogManager::AddLog("TwitchAPI", "Failed to parse WebSocket message as JSON.", LogSeverity::Error);
-					std::string hex;
-					for (size_t i = 0; i < strlen(message); ++i)
-						hex += " " + std::to_string((unsigned char)message[i]);
-					ImGuiLogManager::AddLog("WebSocket", "Raw WebSocket frame (hex):" + hex, LogSeverity::Info);
-				}
-				// Clean up
-				delete[] message;
+		if (!m_IsWebSocketEnabled || m_FollowingReconnect.exchange(true))
+			co_return 0;
+		ImGuiLogManager::AddLog("TwitchAPI", "Following the EventSub reconnect of channel " + m_Config.name + " to " + endpoint.host + ":" + std::to_string(endpoint.port), LogSeverity::Info);
+		int result = co_await m_NextWebSocket->ConnectWebSocketAsync(m_Services, endpoint.host, endpoint.port, endpoint.useTls, path);
+		MetricsRegistry::GetCounter("nom_eventsub_connects_total", "EventSub WebSocket connection attempts, every one after the first is a reconnect.",
+			MetricLabel("result", result < 0 ? "failed" : "ok"))->Add();
+
+		// Everything from here resumes on the reader, so these frames never interleave with the old session's.
+		// The welcome comes first, whatever follows it stays buffered for the reader.
+		if (result == 0)
+			m_ConnectCounter->Add();
+		std::string message;
+		bool welcomed = false;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WelcomeTimeoutMs);
+		while (result == 0 && !welcomed && m_IsWebSocketEnabled) {
+			if (m_NextWebSocket->ReadAvailable() < 0 && !m_NextWebSocket->HasBufferedFrame()) {
+				result = -1;
+				break;
+			}
+			int frame = 0;
+			while (!welcomed && (frame = m_NextWebSocket->NextFrame(message)) == 1) {
+				RecordFrame(message);
+				uint64_t welcomes = m_WelcomeCount;
+				HandleWebSocketMessage(message.c_str());
+				welcomed = m_WelcomeCount != welcomes;
+			}
+			m_NextWebSocket->FlushWrites();
+			if (welcomed)
+				break;
+			auto remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (frame < 0 || remainingMs <= 0) {
+				result = -1;
+				break;
+			}
+			// In slices, so a disable doesn't wait out the whole timeout
+			if (co_await m_Services.WaitReadable(m_NextWebSocket->GetSocketName(), static_cast<int>(std::min<long long>(remainingMs, 200))) < 0)
+				result = -1;
+		}
+
+		if (welcomed && m_Services.SwitchReader(this) == 0) {
+			// m_NextWebSocket is the old session now
+			m_NextWebSocket->Close();
+			m_FollowingReconnect = false;
+			ImGuiLogManager::AddLog("TwitchAPI", "EventSub session of channel " + m_Config.name + " moved to its reconnect_url.", LogSeverity::Info);
+			co_return 0;
+		}
+		m_NextWebSocket->Close();
+		if (!m_IsWebSocketEnabled) {
+			// Disabled meanwhile, DropWebSocket took care of the old session
+			m_FollowingReconnect = false;
+			co_return -1;
+		}
+		// The old session closes soon anyway, start over at the usual endpoint
+		ImGuiLogManager::AddLog("TwitchAPI", "Failed to follow the EventSub reconnect of channel " + m_Config.name + ", reconnecting.", LogSeverity::Warning);
+		DropWebSocket();
+		m_FollowingReconnect = false;
+		m_DisconnectCounter->Add();
+		ScheduleReconnect();
+		co_return -1;
+	}
+
+	void TwitchAPI::SwapWebSockets()
+	{
+		std::swap(m_WebSocket, m_NextWebSocket);
+		m_WebSocketName = m_WebSocket->GetSocketName();
+	}
+
+	int TwitchAPI::StartCapture(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(m_CaptureMutex);
+		int result = m_Capture.Open(path);
+		m_Capturing = result == 0;
+		return result;
+	}
+
+	void TwitchAPI::StopCapture()
+	{
+		std::lock_guard<std::mutex> lock(m_CaptureMutex);
+		m_Capturing = false;
+		m_Capture.Close();
+	}
+
+	int TwitchAPI::ReplayCapture(const std::string& path, double speed, EventSubReplayStats* stats, std::stop_token stop)
+	{
+		// The worker pool takes a single producer, the live reader and a replay can't both feed it
+		if (m_IsWebSocketEnabled || !m_Services.BeginReplay()) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Cannot replay a capture while a WebSocket is enabled or another replay runs.", LogSeverity::Error);
+			return -1;
+		}
+		EventSubCaptureReader reader;
+		if (reader.Open(path) != 0) {
+			m_Services.EndReplay();
+			return -1;
+		}
+		m_Replaying = true;
+		EventSubWorkerPool& workers = m_Services.GetEventWorkers();
+		bool workersWereRunning = workers.IsRunning();
+		workers.Start();
+		// Replaying the same file again must dispatch again
+		m_Services.ResetDedupe();
+		ImGuiLogManager::AddLog("TwitchAPI", "Replaying " + path, LogSeverity::Info);
+
+		auto started = std::chrono::steady_clock::now();
+		EventSubCaptureFrame frame;
+		size_t frames = 0;
+		int result = 0;
+		// Waits on the stop token rather than sleeping, so closing the app during a 1x replay doesn't wait it out
+		std::mutex waitMutex;
+		std::condition_variable_any wake;
+		while (!stop.stop_requested() && (result = reader.Next(frame)) == 0) {
+			if (speed > 0) {
+				std::unique_lock<std::mutex> lock(waitMutex);
+				wake.wait_until(lock, stop, started + std::chrono::microseconds(static_cast<int64_t>(frame.offsetMicros / speed)), [] { return false; });
+				if (stop.stop_requested())
+					break;
 			}
-			if (m_WebSocketSessionID)
-				SubscribetoUnSubscribedEvents();
-			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			HandleWebSocketMessage(frame.payload.c_str());
+			++frames;
+		}
+		bool stopped = stop.stop_requested();
+		// Stop drains the queues, so the time below includes every handler
+		workers.Stop();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		if (workersWereRunning)
+			workers.Start();
+		m_Replaying = false;
+		m_Services.EndReplay();
+
+		if (result < 0)
+			ImGuiLogManager::AddLog("TwitchAPI", "Capture " + path + " is truncated after " + std::to_string(frames) + " frames.", LogSeverity::Warning);
+		ImGuiLogManager::AddLog("TwitchAPI", std::string(stopped ? "Replay stopped after " : "Replayed ") + std::to_string(frames) + " frames in " + std::to_string(seconds) + "s.", LogSeverity::Info);
+		if (stats) {
+			stats->frames = frames;
+			stats->seconds = seconds;
+			stats->stopped = stopped;
 		}
+		return result < 0 ? -1 : 0;
 	}
 
-    int TwitchAPI::SubscribetoUnSubscribedEvents()
-    {
-		for (auto& [type, subscription] : m_Subscriptions) {
-			if (!subscription->Subscibed) {
-				if (!m_WebSocketSessionID) {
-					ImGuiLogManager::AddLog("TwitchAPI", "WebSocket session ID is not set. Cannot subscribe to events.", LogSeverity::Error);
-					return -1;
+	void TwitchAPI::HandleEvent(EventSubType type, const std::shared_ptr<JsonValue>& event)
+	{
+		int handled = 0;
+		{
+			NOM_TRACE_SCOPE("Callback");
+			handled = m_Dispatcher.Dispatch(type, event) + m_Services.GetDispatcher().Dispatch(type, event);
+		}
+		if (handled > 0) {
+			GetEventSubMetrics().dispatched[static_cast<int>(type)]->Add();
+			m_HandledCounter->Add();
+		}
+		else
+			NOM_LOG_WARNING("TwitchAPI", "No handler registered for event type: {}", GetEventSubTypeInfo(type).type);
+	}
+
+	void TwitchAPI::HandleWebSocketMessage(const char* message)
+	{
+		const EventSubMetrics& metrics = GetEventSubMetrics();
+		NOM_LOG_INFO("WebSocket", "Received WebSocket message: {}", message);
+		size_t pos = 0;
+		std::shared_ptr<JsonValue> json;
+		{
+			NOM_TRACE_SCOPE("JSON parse");
+			auto parseStarted = std::chrono::steady_clock::now();
+			json = JsonParser::Parse(message, pos);
+			metrics.parseTime->ObserveMicros(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parseStarted).count());
+		}
+		if (!json) {
+			metrics.parseErrors->Add();
+			NOM_LOG_ERROR("TwitchAPI", "Failed to parse WebSocket message as JSON.");
+			NOM_LOG_INFO("WebSocket", "Raw WebSocket frame (hex): {}", LogBytes{ message, strlen(message) });
+			return;
+		}
+		NOM_TRACE_SCOPE("Dispatch");
+		if (NOM_LOG_SAMPLE(LogSeverity::Info, "JsonDump", "EventSub message dump"))
+			json->DumpToLog();
+		if (json->type != JsonValue::Type::Object) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Expected JSON object at root of WebSocket message.", LogSeverity::Error);
+			return;
+		}
+		const JsonValue* metadata = FindJsonField(json.get(), "metadata", JsonValue::Type::Object);
+		if (!metadata) {
+			ImGuiLogManager::AddLog("TwitchAPI", "metadata field missing or not an object in WebSocket message.", LogSeverity::Error);
+			return;
+		}
+		const JsonValue* messageType = FindJsonField(metadata, "message_type", JsonValue::Type::String);
+		if (!messageType) {
+			ImGuiLogManager::AddLog("TwitchAPI", "message_type field missing or not a string in metadata.", LogSeverity::Error);
+			return;
+		}
+		NOM_LOG_INFO("TwitchAPI", "WebSocket message type: {}", messageType->stringValue);
+		const JsonValue* payload = FindJsonField(json.get(), "payload", JsonValue::Type::Object);
+
+		switch (EventSubHash(messageType->stringValue)) {
+		case EventSubHash("notification"): {
+			metrics.messages[MessageNotification]->Add();
+			// Delivery is at least once, redeliveries around reconnects reuse the message_id
+			const JsonValue* messageId = FindJsonField(metadata, "message_id", JsonValue::Type::String);
+			if (messageId && !m_Services.GetDedupe().Insert(messageId->stringValue)) {
+				metrics.duplicates->Add();
+				NOM_LOG_INFO("TwitchAPI", "Skipping duplicate EventSub notification {}", messageId->stringValue);
+				return;
+			}
+			const JsonValue* subscription = FindJsonField(payload, "subscription", JsonValue::Type::Object);
+			const JsonValue* subscriptionType = FindJsonField(subscription, "type", JsonValue::Type::String);
+			std::shared_ptr<JsonValue> event;
+			if (payload) {
+				auto eventIt = payload->objectValues.find("event");
+				if (eventIt != payload->objectValues.end() && eventIt->second && eventIt->second->type == JsonValue::Type::Object)
+					event = eventIt->second;
+			}
+			if (!event) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Event field missing or not an object in payload.", LogSeverity::Error);
+				return;
+			}
+			if (!subscriptionType) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Type field missing or not a string in subscription object.", LogSeverity::Error);
+				return;
+			}
+			EventSubType type = FindEventSubType(subscriptionType->stringValue);
+			metrics.received[static_cast<int>(type)]->Add();
+			if (type == EventSubType::Unknown) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Unknown event type: " + subscriptionType->stringValue, LogSeverity::Warning);
+				return;
+			}
+			NOM_LOG_INFO("TwitchAPI", "Event type: {}", subscriptionType->stringValue);
+			m_NotificationCounter->Add();
+			m_Services.GetEventWorkers().Push(this, type, event);
+			break;
+		}
+		case EventSubHash("session_keepalive"):
+		case EventSubHash("keepalive"):
+			metrics.messages[MessageKeepalive]->Add();
+			NOM_LOG_INFO("TwitchAPI", "WebSocket keepalive received.");
+			break;
+		case EventSubHash("session_welcome"): {
+			metrics.messages[MessageWelcome]->Add();
+			ImGuiLogManager::AddLog("TwitchAPI", "WebSocket session welcome received.", LogSeverity::Info);
+			const JsonValue* session = FindJsonField(payload, "session", JsonValue::Type::Object);
+			const JsonValue* id = FindJsonField(session, "id", JsonValue::Type::String);
+			if (!payload)
+				ImGuiLogManager::AddLog("TwitchAPI", "Payload field missing or not an object in WebSocket message.", LogSeverity::Error);
+			else if (!session)
+				ImGuiLogManager::AddLog("TwitchAPI", "Session field missing or not an object in WebSocket welcome message.", LogSeverity::Error);
+			else if (!id)
+				ImGuiLogManager::AddLog("TwitchAPI", "Session ID field missing or not a string in WebSocket welcome message.", LogSeverity::Error);
+			else if (m_Replaying)
+				break;
+			else {
+				{
+					std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+					AssignCString(m_WebSocketSessionID, id->stringValue);
 				}
-				if (!m_ChannelID) {
-					ImGuiLogManager::AddLog("TwitchAPI", "Channel ID is not set. Cannot subscribe to events.", LogSeverity::Error);
-					return -1;
+				ImGuiLogManager::AddLog("TwitchAPI", "WebSocket session ID: " + id->stringValue, LogSeverity::Info);
+				++m_WelcomeCount;
+				{
+					std::lock_guard<std::mutex> lock(m_ThreadMutex);
+					m_ReconnectBackoff = InitialReconnectBackoff;
 				}
-				std::string header;
-				std::string body;
-
-				ImGuiLogManager::AddLog("TwitchAPI", "Subscribing to event: " + type, LogSeverity::Info);
-				if (type == "automod.message.hold") {
-					body = "{"
-						"\"type\": \"automod.message.hold\","
-						"\"version\": \"1\","
-						"\"condition\": {"
-						"\"broadcaster_user_id\": \"" + std::string(m_ChannelID) + "\","
-						"\"moderator_user_id\": \"" + std::string(m_ChannelID) + "\""
-						"},"
-						"\"transport\": {"
-						"\"method\": \"websocket\","
-						"\"session_id\": \"" + m_WebSocketSessionID + "\""
-						"}"
-						"}";
-					header = "POST /helix/eventsub/subscriptions HTTP/1.1\r\n"
-						"Host: api.twitch.tv\r\n"
-						"Client-ID: " + std::string(m_ClientID) + "\r\n"
-						"Authorization: Bearer " + std::string(m_AccessToken) + "\r\n"
-						"Content-Type: application/json\r\n"
-						"Content-Length: " + std::to_string(body.length()) + "\r\n"
-						"\r\n";
+				const JsonValue* keepalive = FindJsonField(session, "keepalive_timeout_seconds", JsonValue::Type::Number);
+				if (keepalive && keepalive->numberValue > 0) {
+					int timeoutMs = static_cast<int>(keepalive->numberValue * 1000) + KeepaliveGraceMs;
+					m_KeepaliveTimeoutMs = timeoutMs;
+					ArmKeepalive(std::chrono::milliseconds(timeoutMs));
 				}
+				// A new session starts with no subscriptions, AutomodMessageHold among them keeps it from being closed
+				ReconcileSubscriptions();
+			}
+			break;
+		}
+		case EventSubHash("session_reconnect"): {
+			metrics.messages[MessageReconnect]->Add();
+			ImGuiLogManager::AddLog("TwitchAPI", "WebSocket reconnect requested.", LogSeverity::Warning);
+			const JsonValue* session = FindJsonField(payload, "session", JsonValue::Type::Object);
+			const JsonValue* url = FindJsonField(session, "reconnect_url", JsonValue::Type::String);
+			if (m_Replaying)
+				break;
+			if (!url) {
+				ImGuiLogManager::AddLog("TwitchAPI", "reconnect_url field missing or not a string in WebSocket reconnect message.", LogSeverity::Error);
+				break;
+			}
+			// The old session keeps delivering until the new one is welcomed
+			FollowReconnect(url->stringValue);
+			break;
+		}
+		case EventSubHash("revocation"): {
+			metrics.messages[MessageRevocation]->Add();
+			const JsonValue* subscription = FindJsonField(payload, "subscription", JsonValue::Type::Object);
+			const JsonValue* type = FindJsonField(subscription, "type", JsonValue::Type::String);
+			const JsonValue* status = FindJsonField(subscription, "status", JsonValue::Type::String);
+			ImGuiLogManager::AddLog("TwitchAPI", "WebSocket revocation received for " + (type ? type->stringValue : std::string("unknown type")) +
+				" (" + (status ? status->stringValue : std::string("no status")) + ").", LogSeverity::Warning);
+			if (m_Replaying)
+				break;
+			if (type) {
+				std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+				auto it = m_Subscriptions.find(type->stringValue);
+				if (it != m_Subscriptions.end())
+					it->second->Subscibed = false;
+			}
+			// Recreated if still wanted, a revocation that sticks keeps failing and backs off
+			ReconcileSubscriptions();
+			break;
+		}
+		default:
+			metrics.messages[MessageUnknown]->Add();
+			ImGuiLogManager::AddLog("TwitchAPI", "Unknown WebSocket message type: " + messageType->stringValue, LogSeverity::Warning);
+			break;
+		}
+	}
 
-				if (type == "channel.channel_points_custom_reward_redemption.add") {
-					body = "{"
-						"\"type\": \"channel.channel_points_custom_reward_redemption.add\","
-						"\"version\": \"1\","
-						"\"condition\": {"
-						"\"broadcaster_user_id\": \"" + std::string(m_ChannelID) + "\""
-						"},"
-						"\"transport\": {"
-						"\"method\": \"websocket\","
-						"\"session_id\": \"" + m_WebSocketSessionID + "\""
-						"}"
-						"}";
-					header = "POST /helix/eventsub/subscriptions HTTP/1.1\r\n"
-						"Host: api.twitch.tv\r\n"
-						"Client-ID: " + std::string(m_ClientID) + "\r\n"
-						"Authorization: Bearer " + std::string(m_AccessToken) + "\r\n"
-						"Content-Type: application/json\r\n"
-						"Content-Length: " + std::to_string(body.length()) + "\r\n"
-						"\r\n";
-				}
-				std::string request = header + body;
-				if (!m_SocketManager->GetSocketStatus("Client"))
-					m_SocketManager->ConnectSocket("Client", "api.twitch.tv", 443, true);
-
-				
-				int result = m_SocketManager->SendData("Client", request.c_str(), request.length(), true);
-				if (result < 0) {
-					ImGuiLogManager::AddLog("TwitchAPI", "Failed to send subscription request for event: " + type, LogSeverity::Error);
-					return -1;
+	std::string TwitchAPI::BuildSubscriptionBody(const EventSubSubscription& subscription, const std::string& sessionId) const
+	{
+		std::string channel = m_ChannelID;
+		std::string condition;
+		switch (GetEventSubTypeInfo(subscription.kind).condition) {
+		case EventSubCondition::Broadcaster:
+			condition = "\"broadcaster_user_id\": \"" + channel + "\"";
+			break;
+		case EventSubCondition::BroadcasterAndModerator:
+			condition = "\"broadcaster_user_id\": \"" + channel + "\", \"moderator_user_id\": \"" + channel + "\"";
+			break;
+		case EventSubCondition::BroadcasterAndUser:
+			condition = "\"broadcaster_user_id\": \"" + channel + "\", \"user_id\": \"" + channel + "\"";
+			break;
+		case EventSubCondition::ToBroadcaster:
+			condition = "\"to_broadcaster_user_id\": \"" + channel + "\"";
+			break;
+		}
+		return "{"
+			"\"type\": \"" + subscription.type + "\","
+			"\"version\": \"" + subscription.version + "\","
+			"\"condition\": {" + condition + "},"
+			"\"transport\": {"
+			"\"method\": \"websocket\","
+			"\"session_id\": \"" + sessionId + "\""
+			"}"
+			"}";
+	}
+
+	void TwitchAPI::ReconcileSubscriptions()
+	{
+		m_Services.GetReconciler().Trigger(m_ReconcileId);
+	}
+
+	int TwitchAPI::FetchSubscriptions(const std::string& accessToken, std::vector<EventSubRemoteSubscription>& out)
+	{
+		std::string cursor;
+		do {
+			HttpRequest request;
+			request.method = "GET";
+			SetEndpoint(request, m_Services.GetEndpoints().helix);
+			request.path = "/helix/eventsub/subscriptions" + (cursor.empty() ? std::string() : "?after=" + cursor);
+			request.headers = {
+				{ "Client-ID", m_Services.GetClientID() },
+				{ "Authorization", "Bearer " + accessToken },
+			};
+			HttpResponse response;
+			if (m_Services.GetHelixScheduler().SendAndWait(request, HelixPriority::SubscriptionManagement, response) != 0) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive the EventSub subscription list.", LogSeverity::Error);
+				return -1;
+			}
+			if (response.GetStatusCode() != 200 || ParseEventSubSubscriptionList(std::string(response.GetBody()), out, cursor) != 0) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Listing EventSub subscriptions failed with status " + std::to_string(response.GetStatusCode()) + ": " + std::string(response.GetBody()), LogSeverity::Error);
+				return -1;
+			}
+		} while (!cursor.empty());
+		return 0;
+	}
+
+	int TwitchAPI::RunReconcilePass()
+	{
+		// The reader may move to a new session meanwhile, its welcome triggers another pass
+		std::set<std::string> desired;
+		std::string sessionId;
+		// Every request of the pass uses this one, a refresh meanwhile only affects the next pass
+		std::shared_ptr<const TwitchToken> token = GetToken();
+		if (!token)
+			return 0;
+		const std::string& accessToken = token->accessToken;
+		{
+			std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+			if (!m_WebSocketSessionID || !m_ChannelID)
+				return 0; // No session to subscribe on yet
+			sessionId = m_WebSocketSessionID;
+			for (const auto& [type, subscription] : m_Subscriptions) {
+				// Tokens from an older sign in may lack it, creating would fail with 403 on every pass. No
+				// scopes at all means the token response didn't list them.
+				const char* scope = GetEventSubTypeInfo(subscription->kind).scope;
+				if (*scope != '\0' && !token->scopes.empty() && std::find(token->scopes.begin(), token->scopes.end(), scope) == token->scopes.end()) {
+					if (!subscription->MissingScope)
+						ImGuiLogManager::AddLog("TwitchAPI", "Channel " + m_Config.name + " can't subscribe to " + type + ", its token lacks the " + scope + " scope. Sign in again to grant it.", LogSeverity::Error);
+					subscription->MissingScope = true;
+					continue;
 				}
-				char response[4096] = { 0 };
-				int bytesReceived = m_SocketManager->ReceiveData("Client", response, sizeof(response) - 1, true);
-				if (bytesReceived <= 0) {
-					ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive response for subscription request for event: " + type, LogSeverity::Error);
-					return -1;
+				subscription->MissingScope = false;
+				desired.insert(type);
+			}
+		}
+		std::vector<EventSubRemoteSubscription> actual;
+		if (FetchSubscriptions(accessToken, actual) != 0)
+			return -1;
+		EventSubReconcilePlan plan = PlanEventSubReconcile(desired, actual, sessionId);
+
+		std::vector<std::pair<std::string, HttpRequest>> creates;
+		{
+			std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+			for (auto& [type, subscription] : m_Subscriptions) {
+				auto kept = plan.kept.find(type);
+				subscription->Subscibed = kept != plan.kept.end();
+				subscription->Pending = false;
+				if (kept != plan.kept.end())
+					subscription->id = kept->second;
+			}
+			for (const auto& type : plan.creates) {
+				auto it = m_Subscriptions.find(type);
+				if (it == m_Subscriptions.end())
+					continue; // Removed since the snapshot
+				HttpRequest request;
+				request.method = "POST";
+				SetEndpoint(request, m_Services.GetEndpoints().helix);
+				request.path = "/helix/eventsub/subscriptions";
+				request.headers = {
+					{ "Client-ID", m_Services.GetClientID() },
+					{ "Authorization", "Bearer " + accessToken },
+					{ "Content-Type", "application/json" },
+				};
+				request.body = BuildSubscriptionBody(*it->second, sessionId);
+				it->second->Pending = true;
+				creates.emplace_back(type, std::move(request));
+			}
+		}
+		if (creates.empty() && plan.deletes.empty())
+			return 0;
+		ImGuiLogManager::AddLog("TwitchAPI", "Reconciling EventSub subscriptions: " + std::to_string(creates.size()) + " to create, " +
+			std::to_string(plan.deletes.size()) + " to delete.", LogSeverity::Info);
+
+		// Everything is submitted at once, the scheduler spreads it over its workers within the rate limit
+		struct Outstanding {
+			std::mutex mutex;
+			std::condition_variable done;
+			size_t remaining = 0;
+			bool failed = false;
+		};
+		auto outstanding = std::make_shared<Outstanding>();
+		outstanding->remaining = creates.size() + plan.deletes.size();
+		auto finish = [outstanding](bool ok) {
+			std::lock_guard<std::mutex> lock(outstanding->mutex);
+			if (!ok)
+				outstanding->failed = true;
+			if (--outstanding->remaining == 0)
+				outstanding->done.notify_all();
+		};
+
+		for (auto& [type, request] : creates) {
+			m_Services.GetHelixScheduler().Submit(std::move(request), HelixPriority::SubscriptionManagement, [this, type = type, finish](int result, HttpResponse& response) {
+				int status = result == 0 ? response.GetStatusCode() : 0;
+				// 409 means this session already has it, the next pass picks up its id
+				bool ok = status == 202 || status == 409;
+				std::vector<EventSubRemoteSubscription> created;
+				std::string cursor;
+				if (status == 202)
+					ParseEventSubSubscriptionList(std::string(response.GetBody()), created, cursor);
+				{
+					std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+					auto it = m_Subscriptions.find(type);
+					if (it != m_Subscriptions.end()) {
+						it->second->Pending = false;
+						it->second->Subscibed = ok;
+						if (!created.empty())
+							it->second->id = created.front().id;
+					}
 				}
-				response[bytesReceived] = '\0';
-				m_SocketManager->CloseSocket("Client");
-				ImGuiLogManager::AddLog("TwitchAPI", std::string("Received response for subscription request:\n") + response, LogSeverity::Info);
-				
-				// Mark as subscribed if we got a 202 Accepted response
-				if (strstr(response, "202 Accepted")) {
-					subscription->Subscibed = true;
+				if (ok)
 					ImGuiLogManager::AddLog("TwitchAPI", "Successfully subscribed to event: " + type, LogSeverity::Info);
-					return 0;
-				} else {
-					ImGuiLogManager::AddLog("TwitchAPI", "Failed to subscribe to event: " + type, LogSeverity::Error);
-					return -1;
-				}
-			}
+				else
+					ImGuiLogManager::AddLog("TwitchAPI", "Failed to subscribe to event: " + type + " (" + std::to_string(status) + ") " + std::string(response.GetBody()), LogSeverity::Error);
+				finish(ok);
+			});
 		}
-		return 0;
-    }
+		for (const auto& id : plan.deletes) {
+			HttpRequest request;
+			request.method = "DELETE";
+			SetEndpoint(request, m_Services.GetEndpoints().helix);
+			request.path = "/helix/eventsub/subscriptions?id=" + id;
+			request.headers = {
+				{ "Client-ID", m_Services.GetClientID() },
+				{ "Authorization", "Bearer " + accessToken },
+			};
+			m_Services.GetHelixScheduler().Submit(std::move(request), HelixPriority::SubscriptionManagement, [id, finish](int result, HttpResponse& response) {
+				int status = result == 0 ? response.GetStatusCode() : 0;
+				// 404 is someone else deleting it first, which is just as good
+				bool ok = status == 204 || status == 404;
+				if (!ok)
+					ImGuiLogManager::AddLog("TwitchAPI", "Failed to delete EventSub subscription " + id + " (" + std::to_string(status) + ")", LogSeverity::Error);
+				finish(ok);
+			});
+		}
+
+		std::unique_lock<std::mutex> lock(outstanding->mutex);
+		outstanding->done.wait(lock, [&outstanding] { return outstanding->remaining == 0; });
+		return outstanding->failed ? -1 : 0;
+	}
 
 	int TwitchAPI::IsSubscribedToEvent(SubscriptionType type)
 	{
 		std::string typeStr = SubscriptionTypeToString(type);
+		std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
 		auto it = m_Subscriptions.find(typeStr);
 		if (it != m_Subscriptions.end()) {
 			return it->second->Subscibed ? 1 : 0;
@@ -368,73 +970,41 @@ namespace NomBotCore {
 		});
 	}
 
-	int TwitchAPI::Initialize()
+	Task<int> TwitchAPI::ReceiveAuthorizationCodeAsync()
 	{
-		m_SocketManager = new NomSocketManager();
-		m_SocketManager->CreateSocket("Client", 1, 1);
-		m_SocketManager->CreateSocket("Listener", 1, 1);
-
-		m_SocketManager->BindSocket("Listener", "127.0.0.1", 3000);
-		m_SocketManager->Listen("Listener", SOMAXCONN);
-
-		m_WebSocket = new NomWebSocket(*m_SocketManager);
-
-		// Get Client-ID from environment variable
-		char* clientId = nullptr;
-		size_t clientIdLen = 0;
-		if (_dupenv_s(&clientId, &clientIdLen, "CLIENT_ID") != 0 || clientId == nullptr) {
-			ImGuiLogManager::AddLog("TwitchAPI", "Environment variable CLIENT_ID not found!", LogSeverity::Error);
-			m_SocketManager->CloseAllSockets();
-			delete m_SocketManager;
-			return 1;
+		const TwitchEndpoint& auth = m_Services.GetEndpoints().auth;
+		std::string link = std::string(auth.useTls ? "https://" : "http://") + auth.host + ((auth.port == 443 && auth.useTls) ? "" : ":" + std::to_string(auth.port)) +
+			"/oauth2/authorize?response_type=code&client_id=" + m_Services.GetClientID() + "&redirect_uri=http://localhost:3000&scope=" + m_ScopesString;
+		// Only bound for the sign in, so hosted channels and later sign ins don't hold the port
+		m_Services.GetSocketManager().CreateSocket("Listener", 1, 1);
+		if (m_Services.GetSocketManager().BindSocket("Listener", "127.0.0.1", 3000) != 0 || m_Services.GetSocketManager().Listen("Listener", SOMAXCONN) != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Cannot listen on localhost:3000 for the OAuth redirect.", LogSeverity::Error);
+			m_Services.GetSocketManager().RemoveSocket("Listener");
+			co_return 1;
 		}
-		else {
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("ClientID: ") + clientId, LogSeverity::Info);
-			m_ClientID = new char[strlen(clientId) + 1];
-			strcpy_s(m_ClientID, strlen(clientId) + 1, clientId);
-		}
-		free(clientId);
-
-		// Get Client-Secret from environment variable
-		char* clientSecret = nullptr;
-		size_t clientSecretLen = 0;
-		if (_dupenv_s(&clientSecret, &clientSecretLen, "CLIENT_SECRET") != 0 || clientSecret == nullptr) {
-			ImGuiLogManager::AddLog("TwitchAPI", "Environment variable CLIENT_SECRET not found!", LogSeverity::Error);
-			m_SocketManager->CloseAllSockets();
-			delete m_SocketManager;
-			delete[] m_ClientID; // Clean up
-			return 1;
-		}
-		else {
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("ClientSecret: ") + std::string(clientSecret).substr(0, 4) + "****", LogSeverity::Info);
-			m_ClientSecret = new char[strlen(clientSecret) + 1];
-			strcpy_s(m_ClientSecret, strlen(clientSecret) + 1, clientSecret);
-		}
-		free(clientSecret);
-		return 0;
-	}
-
-	int TwitchAPI::Authenticate()
-	{
-		char link[256];
-		sprintf_s(link, "https://id.twitch.tv/oauth2/authorize?response_type=code&client_id=%s&redirect_uri=http://localhost:3000&scope=%s", m_ClientID, m_ScopesString);
-		ShellExecuteA(NULL, "open", link, NULL, NULL, SW_SHOWNORMAL);
+		ShellExecuteA(NULL, "open", link.c_str(), NULL, NULL, SW_SHOWNORMAL);
 
-		char clientAddress[INET_ADDRSTRLEN];
+		// Waits on the reader instead of in accept, so stopping doesn't hang on a browser that never redirects
+		if (co_await m_Services.WaitReadable("Listener", AuthorizationTimeoutMs) <= 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No OAuth redirect arrived, sign in of channel " + m_Config.name + " given up.", LogSeverity::Error);
+			m_Services.GetSocketManager().RemoveSocket("Listener");
+			co_return 1;
+		}
+		char clientAddress[INET6_ADDRSTRLEN];
 		int clientPort = 0;
-		m_SocketManager->AcceptConnection("Listener", clientAddress, &clientPort);
+		m_Services.GetSocketManager().AcceptConnection("Listener", clientAddress, &clientPort);
 		ImGuiLogManager::AddLog("TwitchAPI", std::string("Accepted connection from ") + clientAddress + ":" + std::to_string(clientPort), LogSeverity::Info);
 
 		char buffer[4096] = { 0 };
-		int bytesReceived = m_SocketManager->ReceiveData(ACCEPTED_CONNECTION, buffer, sizeof(buffer) - 1);
-		while (bytesReceived < 0) {
-			int bytesReceived = m_SocketManager->ReceiveData(ACCEPTED_CONNECTION, buffer, sizeof(buffer) - 1);
-			Sleep(100);
-		}
+		int bytesReceived = -1;
+		if (co_await m_Services.WaitReadable(ACCEPTED_CONNECTION, 5000) > 0)
+			bytesReceived = m_Services.GetSocketManager().ReceiveData(ACCEPTED_CONNECTION, buffer, sizeof(buffer) - 1);
 
 		if (bytesReceived > 0) {
 			buffer[bytesReceived] = '\0'; // Null-terminate the received data
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("Received data: ") + buffer, LogSeverity::Info);
+			// The redirect carries the OAuth code, like every other payload it is only logged on request and redacted
+			if (m_Services.GetSocketManager().IsPayloadLoggingEnabled())
+				ImGuiLogManager::AddLog("TwitchAPI", "Received data: " + NomSocketManager::RedactPayload(buffer, bytesReceived), LogSeverity::Info);
 			char* getLine = strstr(buffer, "GET /?code=");
 			if (getLine) {
 				char* codeStart = getLine + strlen("GET /?code=");
@@ -447,7 +1017,7 @@ namespace NomBotCore {
 						code[codeLen] = '\0';
 						m_AuthCode = new char[strlen(code) + 1];
 						strcpy_s(m_AuthCode, strlen(code) + 1, code);
-						ImGuiLogManager::AddLog("TwitchAPI", std::string("Extracted OAuth code: ") + m_AuthCode, LogSeverity::Info);
+						ImGuiLogManager::AddLog("TwitchAPI", "Extracted the OAuth code.", LogSeverity::Info);
 					}
 				}
 				else {
@@ -459,16 +1029,21 @@ namespace NomBotCore {
 							code[codeLen] = '\0';
 							m_AuthCode = new char[strlen(code) + 1];
 							strcpy_s(m_AuthCode, strlen(code) + 1, code);
-							ImGuiLogManager::AddLog("TwitchAPI", std::string("Extracted OAuth code: ") + m_AuthCode, LogSeverity::Info);
+							ImGuiLogManager::AddLog("TwitchAPI", "Extracted the OAuth code.", LogSeverity::Info);
 						}
 					}
 				}
 			}
 			else {
 				ImGuiLogManager::AddLog("TwitchAPI", "No OAuth code found in the request!", LogSeverity::Error);
-				return 1;
+				m_Services.GetSocketManager().RemoveSocket(ACCEPTED_CONNECTION);
+				m_Services.GetSocketManager().RemoveSocket("Listener");
+				co_return 1;
 			}
 		}
+		else {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive the OAuth redirect request!", LogSeverity::Error);
+		}
 
 		const char* httpResponse =
 			"HTTP/1.1 200 OK\r\n"
@@ -476,440 +1051,247 @@ namespace NomBotCore {
 			"Connection: close\r\n"
 			"\r\n"
 			"<html><body><h1>You can now close this window.</h1></body></html>";
-		m_SocketManager->SendData(ACCEPTED_CONNECTION, httpResponse, strlen(httpResponse));
-		m_SocketManager->RemoveSocket(ACCEPTED_CONNECTION);
-		if (m_AuthCode != nullptr) {
-			GetAccessToken();
-		} else {
-			ImGuiLogManager::AddLog("TwitchAPI", "Authorization code is null, cannot get access token!", LogSeverity::Error);
-			return 1;
-		}
+		m_Services.GetSocketManager().SendData(ACCEPTED_CONNECTION, httpResponse, strlen(httpResponse));
+		m_Services.GetSocketManager().RemoveSocket(ACCEPTED_CONNECTION);
+		m_Services.GetSocketManager().RemoveSocket("Listener");
+		co_return 0;
+	}
 
-		// Get Channel ID
-		m_SocketManager->ConnectSocket("Client", "api.twitch.tv", 443, true);
-		char httpRequest[1024];
-		sprintf_s(httpRequest,
-			"GET /helix/users HTTP/1.1\r\n"
-			"Host: api.twitch.tv\r\n"
-			"Client-ID: %s\r\n"
-			"Authorization: Bearer %s\r\n"
-			"User-Agent: NomBotCore/1.0\r\n"
-			"Connection: close\r\n"
-			"\r\n",
-			m_ClientID, m_AccessToken);
-		m_SocketManager->SendData("Client", httpRequest, strlen(httpRequest), true);
-		char userBuffer[8192] = { 0 };
-		int userBytesReceived = m_SocketManager->ReceiveData("Client", userBuffer, sizeof(userBuffer) - 1, true);
-		while (userBytesReceived < 0) {
-			int userBytesReceived = m_SocketManager->ReceiveData("Client", userBuffer, sizeof(userBuffer) - 1, true);
-			Sleep(100);
-		}
-		if (userBytesReceived > 0) {
-			userBuffer[userBytesReceived] = '\0'; // Null-terminate the received data
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("Received user data: ") + userBuffer, LogSeverity::Info);
-			// Parse JSON response to extract id
-			const char* idKey = "\"id\":\"";
-			char* idStart = strstr(userBuffer, idKey);
-			if (idStart) {
-				idStart += strlen(idKey);
-				char* idEnd = strchr(idStart, '"');
-				if (idEnd) {
-					size_t idLen = idEnd - idStart;
-					char* id = new char[idLen + 1];
-					strncpy_s(id, idLen + 1, idStart, idLen);
-					id[idLen] = '\0';
-					m_ChannelID = new char[strlen(id) + 1];
-					strcpy_s(m_ChannelID, strlen(id) + 1, id);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Channel ID: ") + std::string(id), LogSeverity::Info);
-					delete[] id;
-				}
+	Task<int> TwitchAPI::AuthenticateAsync()
+	{
+		// Hosted channels were authorized beforehand and only keep their refresh token
+		if (!m_Config.refreshToken.empty()) {
+			if (co_await RefreshAccessTokenAsync() != 0)
+				co_return 1;
+		}
+		else {
+			// Headless runs, e.g. against MockTwitch, pass the code in and skip the browser
+			char* authCode = nullptr;
+			size_t authCodeLen = 0;
+			if (_dupenv_s(&authCode, &authCodeLen, "NOM_AUTH_CODE") == 0 && authCode != nullptr) {
+				AssignCString(m_AuthCode, authCode);
+				free(authCode);
 			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No channel ID found in response.", LogSeverity::Error);
-				return 1;
+			else if (co_await ReceiveAuthorizationCodeAsync() != 0) {
+				co_return 1;
 			}
+			if (m_AuthCode == nullptr) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Authorization code is null, cannot get access token!", LogSeverity::Error);
+				co_return 1;
+			}
+			if (co_await GetAccessTokenAsync() != 0)
+				co_return 1;
 		}
-		else {
+
+		// Get Channel ID
+		HttpRequest request;
+		request.method = "GET";
+		SetEndpoint(request, m_Services.GetEndpoints().helix);
+		request.path = "/helix/users";
+		request.headers = {
+			{ "Client-ID", m_Services.GetClientID() },
+			{ "Authorization", "Bearer " + GetToken()->accessToken },
+			{ "User-Agent", "NomBotCore/1.0" },
+		};
+		auto [result, response] = co_await m_Services.GetHelixScheduler().SendAsync(std::move(request), HelixPriority::BulkLookup);
+		if (result != 0) {
 			ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive user data.", LogSeverity::Error);
-			return 1;
+			co_return 1;
 		}
-
-		m_SocketManager->CloseSocket("Client");
-
-		return 0;
+		std::string body(response.GetBody());
+		ImGuiLogManager::AddLog("TwitchAPI", std::string("Received user data: ") + body, LogSeverity::Info);
+		if (response.GetStatusCode() != 200) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Get users request failed with status " + std::to_string(response.GetStatusCode()), LogSeverity::Error);
+			co_return 1;
+		}
+		size_t pos = 0;
+		std::shared_ptr<JsonValue> json = JsonParser::Parse(body, pos);
+		const JsonValue* data = FindJsonField(json.get(), "data", JsonValue::Type::Array);
+		const JsonValue* id = nullptr;
+		if (data && !data->arrayValues.empty())
+			id = FindJsonField(data->arrayValues[0].get(), "id", JsonValue::Type::String);
+		if (!id) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No channel ID found in response.", LogSeverity::Error);
+			co_return 1;
+		}
+		AssignCString(m_ChannelID, id->stringValue);
+		ImGuiLogManager::AddLog("TwitchAPI", std::string("Channel ID: ") + m_ChannelID, LogSeverity::Info);
+		co_return 0;
 	}
 
-	int TwitchAPI::GetAccessToken()
+	Task<int> TwitchAPI::GetAccessTokenAsync()
 	{
 		// Exchange the authorization code for an access token
-		const char* host = "id.twitch.tv";
-		char postData[512] = { 0 };
 		if (m_AuthCode == nullptr) {
 			ImGuiLogManager::AddLog("TwitchAPI", "Authorization code is null, cannot get access token!", LogSeverity::Error);
-			return 1;
+			co_return 1;
 		}
-		sprintf_s(postData, "client_id=%s&client_secret=%s&code=%s&grant_type=authorization_code&redirect_uri=http://localhost:3000", m_ClientID, m_ClientSecret, m_AuthCode);
-		char httpRequest[1024];
-		sprintf_s(httpRequest,
-			"POST /oauth2/token HTTP/1.1\r\n"
-			"Host: %s\r\n"
-			"Content-Type: application/x-www-form-urlencoded\r\n"
-			"Content-Length: %zu\r\n"
-			"Connection: close\r\n"
-			"\r\n"
-			"%s",
-			host, strlen(postData), postData);
-		m_SocketManager->ConnectSocket("Client", host, 443, true);
-		m_SocketManager->SendData("Client", httpRequest, strlen(httpRequest), true);
-		char buffer[8192] = { 0 };
-		int bytesReceived = m_SocketManager->ReceiveData("Client", buffer, sizeof(buffer) - 1, true);
-		while (bytesReceived < 0) {
-			int bytesReceived = m_SocketManager->ReceiveData("Client", buffer, sizeof(buffer) - 1, true);
-			Sleep(100);
+		HttpRequest request;
+		request.method = "POST";
+		SetEndpoint(request, m_Services.GetEndpoints().auth);
+		request.path = "/oauth2/token";
+		request.headers = { { "Content-Type", "application/x-www-form-urlencoded" } };
+		request.body = std::string("client_id=") + m_Services.GetClientID() + "&client_secret=" + m_Services.GetClientSecret() + "&code=" + m_AuthCode +
+			"&grant_type=authorization_code&redirect_uri=http://localhost:3000";
+		auto [result, response] = co_await m_Services.GetHelixScheduler().SendAsync(std::move(request), HelixPriority::TokenRefresh);
+		if (result != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive access token response.", LogSeverity::Error);
+			co_return 1;
 		}
-		if (bytesReceived > 0) {
-			buffer[bytesReceived] = '\0'; // Null-terminate the received data
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("Received data: ") + buffer, LogSeverity::Info);
-			// Parse JSON response to extract access_token
-			const char* accessTokenKey = "\"access_token\":\"";
-			char* accessTokenStart = strstr(buffer, accessTokenKey);
-			if (accessTokenStart) {
-				accessTokenStart += strlen(accessTokenKey);
-				char* accessTokenEnd = strchr(accessTokenStart, '"');
-				if (accessTokenEnd) {
-					size_t accessTokenLen = accessTokenEnd - accessTokenStart;
-					char* accessToken = new char[accessTokenLen + 1];
-					strncpy_s(accessToken, accessTokenLen + 1, accessTokenStart, accessTokenLen);
-					accessToken[accessTokenLen] = '\0';
-					m_AccessToken = new char[strlen(accessToken) + 1];
-					strcpy_s(m_AccessToken, strlen(accessToken) + 1, accessToken);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Access Token: ") + std::string(accessToken).substr(0, 4) + "****", LogSeverity::Info);
-					delete[] accessToken;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No access token found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract expires_in
-			const char* refreshToken = "\"refresh_token\":\"";
-			char* refreshTokenStart = strstr(buffer, refreshToken);
-			if (refreshTokenStart) {
-				refreshTokenStart += strlen(refreshToken);
-				char* refreshTokenEnd = strchr(refreshTokenStart, '"');
-				if (refreshTokenEnd) {
-					size_t refreshTokenLen = refreshTokenEnd - refreshTokenStart;
-					char* refresh_Token = new char[refreshTokenLen + 1];
-					strncpy_s(refresh_Token, refreshTokenLen + 1, refreshTokenStart, refreshTokenLen);
-					refresh_Token[refreshTokenLen] = '\0';
-					m_RefreshToken = new char[strlen(refresh_Token) + 1];
-					strcpy_s(m_RefreshToken, strlen(refresh_Token) + 1, refresh_Token);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Refresh Token: ") + std::string(refresh_Token).substr(0, 4) + "****", LogSeverity::Info);
-					delete[] refresh_Token;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No refresh token found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract expires_in
-			const char* expiresInKey = "\"expires_in\":";
-			char* expiresInStart = strstr(buffer, expiresInKey);
-			if (expiresInStart) {
-				expiresInStart += strlen(expiresInKey);
-				char* expiresInEnd = strchr(expiresInStart, ',');
-				if (expiresInEnd) {
-					size_t expiresInLen = expiresInEnd - expiresInStart;
-					char* expiresInStr = new char[expiresInLen + 1];
-					strncpy_s(expiresInStr, expiresInLen + 1, expiresInStart, expiresInLen);
-					expiresInStr[expiresInLen] = '\0';
-					int expiresIn = atoi(expiresInStr);
-					m_ExpiresIn = expiresIn;
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Expires In: ") + std::to_string(expiresIn) + " seconds", LogSeverity::Info);
-					delete[] expiresInStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No expires_in found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract scope
-			const char* scopeKey = "\"scope\":[";
-			char* scopeStart = strstr(buffer, scopeKey);
-			if (scopeStart) {
-				scopeStart += strlen(scopeKey);
-				char* scopeEnd = strchr(scopeStart, ']');
-				if (scopeEnd) {
-					size_t scopeLen = scopeEnd - scopeStart;
-					char* scopeStr = new char[scopeLen + 1];
-					strncpy_s(scopeStr, scopeLen + 1, scopeStart, scopeLen);
-					scopeStr[scopeLen] = '\0';
-					char* p = scopeStr;
-					while (*p) {
-						char* quoteStart = strchr(p, '"');
-						if (!quoteStart) break;
-						char* quoteEnd = strchr(quoteStart + 1, '"');
-						if (!quoteEnd) break;
-						size_t len = quoteEnd - quoteStart - 1;
-						char* scopeItem = new char[len + 1];
-						strncpy_s(scopeItem, len + 1, quoteStart + 1, len);	
-						scopeItem[len] = '\0';
-						m_Scopes.push_back(scopeItem);
-						p = quoteEnd + 1;
-					}
-					ImGuiLogManager::AddLog("TwitchAPI", "Scopes:", LogSeverity::Info);
-					for (const char* s : m_Scopes) ImGuiLogManager::AddLog("TwitchAPI", std::string(" - ") + s, LogSeverity::Info);
-					delete[] scopeStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No scope found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract token_type
-			const char* tokenTypeKey = "\"token_type\":\"";
-			char* tokenTypeStart = strstr(buffer, tokenTypeKey);
-			if (tokenTypeStart) {
-				tokenTypeStart += strlen(tokenTypeKey);
-				char* tokenTypeEnd = strchr(tokenTypeStart, '"');
-				if (tokenTypeEnd) {
-					size_t tokenTypeLen = tokenTypeEnd - tokenTypeStart;
-					char* tokenTypeStr = new char[tokenTypeLen + 1];
-					strncpy_s(tokenTypeStr, tokenTypeLen + 1, tokenTypeStart, tokenTypeLen);
-					tokenTypeStr[tokenTypeLen] = '\0';
-					m_TokenType = new char[strlen(tokenTypeStr) + 1];
-					strcpy_s(m_TokenType, strlen(tokenTypeStr) + 1, tokenTypeStr);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Token Type: ") + m_TokenType, LogSeverity::Info);
-					delete[] tokenTypeStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No token_type found in response.", LogSeverity::Error);
-				return 1;
-			}
-			m_SocketManager->CloseSocket("Client");
-			if (m_AuthCode != nullptr) {
-				delete[] m_AuthCode;
-				m_AuthCode = nullptr;
-			}
+		if (response.GetStatusCode() != 200) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Access token request failed with status " + std::to_string(response.GetStatusCode()) + ": " + std::string(response.GetBody()), LogSeverity::Error);
+			co_return 1;
 		}
-
-		return 0;
+		int parsed = ParseTokenResponse(std::string(response.GetBody()), true);
+		if (parsed == 0 && m_AuthCode != nullptr) {
+			delete[] m_AuthCode;
+			m_AuthCode = nullptr;
+		}
+		co_return parsed;
 	}
 
-	int TwitchAPI::RefreshAccessToken()
+	Task<int> TwitchAPI::RefreshAccessTokenAsync()
 	{
-		// Refresh the access token using the refresh token
-		if (m_RefreshToken == nullptr) {
+		// Refresh the access token using the refresh token, hosted channels start out with the one they were configured with
+		std::shared_ptr<const TwitchToken> token = GetToken();
+		std::string refreshToken = token ? token->refreshToken : m_Config.refreshToken;
+		if (refreshToken.empty()) {
 			ImGuiLogManager::AddLog("TwitchAPI", "Refresh token is null, cannot refresh access token!", LogSeverity::Error);
+			co_return 1;
+		}
+		HttpRequest request;
+		request.method = "POST";
+		SetEndpoint(request, m_Services.GetEndpoints().auth);
+		request.path = "/oauth2/token";
+		request.headers = { { "Content-Type", "application/x-www-form-urlencoded" } };
+		request.body = std::string("client_id=") + m_Services.GetClientID() + "&client_secret=" + m_Services.GetClientSecret() + "&refresh_token=" + refreshToken + "&grant_type=refresh_token";
+		auto [result, response] = co_await m_Services.GetHelixScheduler().SendAsync(std::move(request), HelixPriority::TokenRefresh);
+		if (result != 0) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Failed to receive refresh token response.", LogSeverity::Error);
+			co_return 1;
+		}
+		if (response.GetStatusCode() != 200) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Refresh token request failed with status " + std::to_string(response.GetStatusCode()) + ": " + std::string(response.GetBody()), LogSeverity::Error);
+			co_return 1;
+		}
+		// Twitch may or may not rotate the refresh token, keep the old one if it is absent
+		co_return ParseTokenResponse(std::string(response.GetBody()), false);
+	}
+
+	int TwitchAPI::ParseTokenResponse(const std::string& body, bool requireRefreshToken)
+	{
+		size_t pos = 0;
+		std::shared_ptr<JsonValue> json = JsonParser::Parse(body, pos);
+		const JsonValue* accessToken = FindJsonField(json.get(), "access_token", JsonValue::Type::String);
+		const JsonValue* refreshToken = FindJsonField(json.get(), "refresh_token", JsonValue::Type::String);
+		const JsonValue* expiresIn = FindJsonField(json.get(), "expires_in", JsonValue::Type::Number);
+		const JsonValue* scope = FindJsonField(json.get(), "scope", JsonValue::Type::Array);
+		const JsonValue* tokenType = FindJsonField(json.get(), "token_type", JsonValue::Type::String);
+		if (!accessToken) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No access token found in response.", LogSeverity::Error);
+			return 1;
+		}
+		if (!refreshToken && requireRefreshToken) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No refresh token found in response.", LogSeverity::Error);
+			return 1;
+		}
+		if (!expiresIn) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No expires_in found in response.", LogSeverity::Error);
+			return 1;
+		}
+		if (!tokenType) {
+			ImGuiLogManager::AddLog("TwitchAPI", "No token_type found in response.", LogSeverity::Error);
 			return 1;
 		}
-		const char* host = "id.twitch.tv";
-		char postData[512] = { 0 };
-		sprintf_s(postData, "client_id=%s&client_secret=%s&refresh_token=%s&grant_type=refresh_token", m_ClientID, m_ClientSecret, m_RefreshToken);
-		char httpRequest[1024];
-		sprintf_s(httpRequest,
-			"POST /oauth2/token HTTP/1.1\r\n"
-			"Host: %s\r\n"
-			"Content-Type: application/x-www-form-urlencoded\r\n"
-			"Content-Length: %zu\r\n"
-			"Connection: close\r\n"
-			"\r\n"
-			"%s",
-			host, strlen(postData), postData);
-		m_SocketManager->ConnectSocket("Client", host, 443, true);
-		m_SocketManager->SendData("Client", httpRequest, strlen(httpRequest), true);
-		char buffer[8192] = { 0 };
-		int bytesReceived = m_SocketManager->ReceiveData("Client", buffer, sizeof(buffer) - 1, true);
-		while (bytesReceived < 0) {
-			int bytesReceived = m_SocketManager->ReceiveData("Client", buffer, sizeof(buffer) - 1, true);
-			Sleep(100);
-		}
-		// Removes old data from previous token
-		if (m_AccessToken != nullptr) {
-			delete[] m_AccessToken;
-			m_AccessToken = nullptr;
-		}
-		if (m_RefreshToken != nullptr) {
-			delete[] m_RefreshToken;
-			m_RefreshToken = nullptr;
-		}
-		if (m_TokenType != nullptr) {
-			delete[] m_TokenType;
-			m_TokenType = nullptr;
-		}
-		for (char* s : m_Scopes) {
-			delete[] s;
-		}
-		m_Scopes.clear();
-		m_ExpiresIn = 0;
 
-		if (bytesReceived > 0) {
-			buffer[bytesReceived] = '\0'; // Null-terminate the received data
-			ImGuiLogManager::AddLog("TwitchAPI", std::string("Received data: ") + buffer, LogSeverity::Info);
-			// Parse JSON response to extract access_token
-			const char* accessTokenKey = "\"access_token\":\"";
-			char* accessTokenStart = strstr(buffer, accessTokenKey);
-			if (accessTokenStart) {
-				accessTokenStart += strlen(accessTokenKey);
-				char* accessTokenEnd = strchr(accessTokenStart, '"');
-				if (accessTokenEnd) {
-					size_t accessTokenLen = accessTokenEnd - accessTokenStart;
-					char* accessToken = new char[accessTokenLen + 1];
-					strncpy_s(accessToken, accessTokenLen + 1, accessTokenStart, accessTokenLen);
-					accessToken[accessTokenLen] = '\0';
-					if (m_AccessToken != nullptr) {
-						delete[] m_AccessToken;
-					}
-					m_AccessToken = new char[strlen(accessToken) + 1];
-					strcpy_s(m_AccessToken, strlen(accessToken) + 1, accessToken);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Access Token: ") + std::string(accessToken).substr(0, 4) + "****", LogSeverity::Info);
-					delete[] accessToken;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No access token found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract expires_in
-			const char* expiresInKey = "\"expires_in\":";
-			char* expiresInStart = strstr(buffer, expiresInKey);
-			if (expiresInStart) {
-				expiresInStart += strlen(expiresInKey);
-				char* expiresInEnd = strchr(expiresInStart, ',');
-				if (expiresInEnd) {
-					size_t expiresInLen = expiresInEnd - expiresInStart;
-					char* expiresInStr = new char[expiresInLen + 1];
-					strncpy_s(expiresInStr, expiresInLen + 1, expiresInStart, expiresInLen);
-					expiresInStr[expiresInLen] = '\0';
-					int expiresIn = atoi(expiresInStr);
-					m_ExpiresIn = expiresIn;
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Expires In: ") + std::to_string(expiresIn) + " seconds", LogSeverity::Info);
-					delete[] expiresInStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No expires_in found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract scope
-			const char* scopeKey = "\"scope\":[";
-			char* scopeStart = strstr(buffer, scopeKey);
-			if (scopeStart) {
-				scopeStart += strlen(scopeKey);
-				char* scopeEnd = strchr(scopeStart, ']');
-				if (scopeEnd) {
-					size_t scopeLen = scopeEnd - scopeStart;
-					char* scopeStr = new char[scopeLen + 1];
-					strncpy_s(scopeStr, scopeLen + 1, scopeStart, scopeLen);
-					scopeStr[scopeLen] = '\0';
-					// Clear existing scopes
-					for (char* s : m_Scopes) {
-						delete[] s;
-					}
-					m_Scopes.clear();
-					char* p = scopeStr;
-					while (*p) {
-						char* quoteStart = strchr(p, '"');
-						if (!quoteStart) break;
-						char* quoteEnd = strchr(quoteStart + 1, '"');
-						if (!quoteEnd) break;
-						size_t len = quoteEnd - quoteStart - 1;
-						char* scopeItem = new char[len + 1];
-						strncpy_s(scopeItem, len + 1, quoteStart + 1, len);
-						scopeItem[len] = '\0';
-						m_Scopes.push_back(scopeItem);
-						p = quoteEnd + 1;
-					}
-					ImGuiLogManager::AddLog("TwitchAPI", "Scopes:", LogSeverity::Info);
-					for (const char* s : m_Scopes) ImGuiLogManager::AddLog("TwitchAPI", std::string(" - ") + s, LogSeverity::Info);
-					delete[] scopeStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No scope found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Parse JSON response to extract token_type
-			const char* tokenTypeKey = "\"token_type\":\"";
-			char* tokenTypeStart = strstr(buffer, tokenTypeKey);
-			if (tokenTypeStart) {
-				tokenTypeStart += strlen(tokenTypeKey);
-				char* tokenTypeEnd = strchr(tokenTypeStart, '"');
-				if (tokenTypeEnd) {
-					size_t tokenTypeLen = tokenTypeEnd - tokenTypeStart;
-					char* tokenTypeStr = new char[tokenTypeLen + 1];
-					strncpy_s(tokenTypeStr, tokenTypeLen + 1, tokenTypeStart, tokenTypeLen);
-					tokenTypeStr[tokenTypeLen] = '\0';
-					if (m_TokenType != nullptr) {
-						delete[] m_TokenType;
-					}
-					m_TokenType = new char[strlen(tokenTypeStr) + 1];
-					strcpy_s(m_TokenType, strlen(tokenTypeStr) + 1, tokenTypeStr);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Token Type: ") + m_TokenType, LogSeverity::Info);
-					delete[] tokenTypeStr;
-				}
-			}
-			else {
-				ImGuiLogManager::AddLog("TwitchAPI", "No token_type found in response.", LogSeverity::Error);
-				return 1;
-			}
-			// Note: Twitch may return a new refresh token; handle it if present
-			const char* refreshTokenKey = "\"refresh_token\":\"";
-			char* refreshTokenStart = strstr(buffer, refreshTokenKey);
-			if (refreshTokenStart) {
-				refreshTokenStart += strlen(refreshTokenKey);
-				char* refreshTokenEnd = strchr(refreshTokenStart, '"');
-				if (refreshTokenEnd) {
-					size_t refreshTokenLen = refreshTokenEnd - refreshTokenStart;
-					char* refresh_Token = new char[refreshTokenLen + 1];
-					strncpy_s(refresh_Token, refreshTokenLen + 1, refreshTokenStart, refreshTokenLen);
-					refresh_Token[refreshTokenLen] = '\0';
-					if (m_RefreshToken != nullptr) {
-						delete[] m_RefreshToken;
-					}
-					m_RefreshToken = new char[strlen(refresh_Token) + 1];
-					strcpy_s(m_RefreshToken, strlen(refresh_Token) + 1, refresh_Token);
-					ImGuiLogManager::AddLog("TwitchAPI", std::string("Refresh Token: ") + std::string(refresh_Token).substr(0, 4) + "****", LogSeverity::Info);
-					delete[] refresh_Token;
-				}
+		auto token = std::make_shared<TwitchToken>();
+		token->accessToken = accessToken->stringValue;
+		ImGuiLogManager::AddLog("TwitchAPI", std::string("Access Token: ") + accessToken->stringValue.substr(0, 4) + "****", LogSeverity::Info);
+		if (refreshToken) {
+			token->refreshToken = refreshToken->stringValue;
+			ImGuiLogManager::AddLog("TwitchAPI", std::string("Refresh Token: ") + refreshToken->stringValue.substr(0, 4) + "****", LogSeverity::Info);
+		}
+		else {
+			std::shared_ptr<const TwitchToken> previous = GetToken();
+			token->refreshToken = previous ? previous->refreshToken : m_Config.refreshToken;
+		}
+		token->lifetime = std::chrono::seconds(static_cast<int64_t>(expiresIn->numberValue));
+		token->expiresAt = std::chrono::steady_clock::now() + token->lifetime;
+		ImGuiLogManager::AddLog("TwitchAPI", std::string("Expires In: ") + std::to_string(token->lifetime.count()) + " seconds", LogSeverity::Info);
+		token->tokenType = tokenType->stringValue;
+		ImGuiLogManager::AddLog("TwitchAPI", std::string("Token Type: ") + token->tokenType, LogSeverity::Info);
+		if (scope) {
+			for (const auto& item : scope->arrayValues) {
+				if (item && item->type == JsonValue::Type::String)
+					token->scopes.push_back(item->stringValue);
 			}
 		}
-		m_SocketManager->CloseSocket("Client");
+		ImGuiLogManager::AddLog("TwitchAPI", "Scopes:", LogSeverity::Info);
+		for (const auto& s : token->scopes) ImGuiLogManager::AddLog("TwitchAPI", " - " + s, LogSeverity::Info);
+		// Requests that loaded the old token finish with it, everything after sees this one
+		m_Token.store(std::move(token), std::memory_order_release);
+		return 0;
 	}
 
 	int TwitchAPI::EnableWebSocket(bool enable)
 	{
-		//Start new internal thread if (enable) else stop thread
-		if (m_AccessToken == nullptr) {
+		if (!enable) {
+			TimerWheel::TimerId keepalive = 0;
+			TimerWheel::TimerId reconnect = 0;
+			{
+				std::lock_guard<std::mutex> lock(m_ThreadMutex);
+				m_WebSocketWanted = false;
+				keepalive = std::exchange(m_KeepaliveTimer, 0);
+				reconnect = std::exchange(m_ReconnectTimer, 0);
+			}
+			m_Services.GetTimers().Cancel(keepalive);
+			m_Services.GetTimers().Cancel(reconnect);
+			if (m_WebSocket)
+				DropWebSocket();
+			else
+				m_IsWebSocketEnabled = false;
+			return 0;
+		}
+		if (!GetToken() || m_WebSocket == nullptr) {
 			ImGuiLogManager::AddLog("TwitchAPI", "Access token is null, cannot enable WebSocket!", LogSeverity::Error);
 			return 1;
 		}
-		m_IsWebSocketEnabled = enable;
-		if (enable) {
-			std::atomic<bool>* running = new std::atomic<bool>(true);
-			m_WebSocketRunning = running;
-			internalThreads.emplace_back(&TwitchAPI::WebSocketThreadFunc, this, std::ref(*running));
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			m_WebSocketWanted = true;
+			m_ReconnectBackoff = InitialReconnectBackoff;
 		}
-		else {
-			if (m_WebSocketRunning) {
-				*m_WebSocketRunning = false;
-				delete m_WebSocketRunning;
-				m_WebSocketRunning = nullptr;
-			}
+		OpenWebSocket();
+		return 0;
+	}
+
+	int TwitchAPI::OpenWebSocket()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			// Checked under the lock, a disable meanwhile clears m_WebSocketWanted before it waits for the reconnect timer
+			if (!m_WebSocketWanted || m_IsWebSocketEnabled.exchange(true))
+				return 0;
+			// The deadline of the old session doesn't apply while connecting, the next welcome sets a new one
+			m_KeepaliveTimeoutMs = 0;
+			// Counted before the lock drops, so a Stop that starts waiting before Spawn runs still waits for the connect
+			++m_RunningTasks;
 		}
+		// Runs here until the connect first waits, everything after that, the TLS handshake included, waits on the
+		// shared reader instead of holding a thread
+		Spawn(ConnectEventSubAsync(), std::function<void(int)>([this](int) { EndTrackedTask(); }));
 		return 0;
 	}
 
 	int TwitchAPI::ConnectWebSocket()
 	{
-		const char* wsAddress = "wss://eventsub.wss.twitch.tv";
-		int wsPort = 443;
+		const char* wsAddress = m_Services.GetEndpoints().eventSub.host.c_str();
+		int wsPort = m_Services.GetEndpoints().eventSub.port;
 		if (m_WebSocket == nullptr) {
 			ImGuiLogManager::AddLog("TwitchAPI", "WebSocket is not initialized!", LogSeverity::Error);
 			return -1;
 		}
-		int result = m_WebSocket->ConnectWebSocket(wsAddress, wsPort, true);
+		int result = m_WebSocket->ConnectWebSocket(wsAddress, wsPort, m_Services.GetEndpoints().eventSub.useTls);
 		if (result < 0) {
 			ImGuiLogManager::AddLog("TwitchAPI", "Failed to connect to WebSocket " + std::string(wsAddress) + ":" + std::to_string(wsPort), LogSeverity::Error);
 			return -1;
@@ -918,42 +1300,36 @@ namespace NomBotCore {
 		return 0;
 	}
 
-	int TwitchAPI::CheckIfRefreshNeeded()
+	int TwitchAPI::AddEventSubSubscription(SubscriptionType type)
 	{
-		if (m_ExpiresIn < 300) { 
-			ImGuiLogManager::AddLog("TwitchAPI", "Access token is about to expire, refreshing...", LogSeverity::Warning);
-			RefreshAccessToken();
+		if (type == SubscriptionType::Unknown) {
+			ImGuiLogManager::AddLog("TwitchAPI", "Cannot subscribe to an unknown event type.", LogSeverity::Error);
+			return 1;
 		}
-		return 0;
-	}
-
-	int TwitchAPI::AddEventSubSubscription(SubscriptionType type, std::function<void(const ChannelPointRewardRedemption&)> callback)
-	{
-		// Placeholder for adding EventSub subscription
+		const EventSubTypeInfo& info = GetEventSubTypeInfo(type);
+		std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
+		if (m_Subscriptions.find(info.type) != m_Subscriptions.end())
+			return 0; // Already created or on its way
 		EventSubSubscription* sub = new EventSubSubscription();
-		switch (type) {
-		case SubscriptionType::AutomodMessageHold:
-				sub->type = "automod.message.hold";
-				sub->version = "1";
-				break;
-		case SubscriptionType::ChannelPointsCustomRewardRedemptionAdd:
-				sub->type = "channel.channel_points_custom_reward_redemption.add";
-				sub->version = "1";
-				break;
-		}
-		sub->callback = callback;
-		m_Subscriptions[SubscriptionTypeToString(type)] = sub;
+		sub->kind = type;
+		sub->type = info.type;
+		sub->version = info.version;
+		m_Subscriptions[info.type] = sub;
 		ImGuiLogManager::AddLog("TwitchAPI", "Adding EventSub subscription of type: " + SubscriptionTypeToString(type), LogSeverity::Info);
+		ReconcileSubscriptions();
 		return 0;
 	}
 
 	int TwitchAPI::RemoveEventSubSubscription(SubscriptionType type)
 	{
+		std::lock_guard<std::mutex> lock(m_SubscriptionMutex);
 		auto it = m_Subscriptions.find(SubscriptionTypeToString(type));
 		if (it != m_Subscriptions.end()) {
 			delete it->second;
 			m_Subscriptions.erase(it);
 			ImGuiLogManager::AddLog("TwitchAPI", "Removed EventSub subscription of type: " + SubscriptionTypeToString(type), LogSeverity::Info);
+			// Deleted on Helix by the next pass
+			ReconcileSubscriptions();
 			return 0;
 		}
 		ImGuiLogManager::AddLog("TwitchAPI", "No subscription found for type: " + SubscriptionTypeToString(type), LogSeverity::Warning);
@@ -1,36 +1,58 @@
 #ifndef __TWITCHAPI_H__
 #define __TWITCHAPI_H__
 
-#include "../Networking/NomSocketManager.h"
 #include "../Networking/NomWebSocket.h"
-#include "../TwitchAPI/ChannelPointRewardRedemption.h"
+#include "TwitchServices.h"
+#include "EventSubCapture.h"
+#include "../Core/Async/Task.h"
 #include <atomic>
 #include <thread>
+#include <condition_variable>
 #include <memory>
 #include <map>
 #include <functional>
 #include <chrono>
+#include <stop_token>
 
 namespace NomBotCore {
+	struct TwitchChannelConfig {
+		// Unique per process, names the channel in logs, metrics and its WebSocket, e.g. the channel login
+		std::string name = "bot";
+		// Hosted channels sign in with a refresh token of their own. Without one the channel goes through the
+		// browser or NOM_AUTH_CODE instead, and NOM_CAPTURE_FILE records it, so only one channel should.
+		std::string refreshToken;
+	};
+
+	// An access token and what came with it. A refresh publishes a new one whole, so a request that already
+	// loaded one keeps a consistent token while the next is swapped in.
+	struct TwitchToken {
+		std::string accessToken;
+		std::string refreshToken;
+		std::string tokenType;
+		std::vector<std::string> scopes;
+		std::chrono::seconds lifetime{ 0 }; // expires_in
+		std::chrono::steady_clock::time_point expiresAt;
+	};
+
+	struct TwitchChannelStats {
+		uint64_t notifications = 0; // Duplicates left out
+		uint64_t handled = 0; // Reached at least one handler
+		uint64_t connects = 0;
+		uint64_t disconnects = 0;
+	};
+
+	// One channel context: its tokens, channel id, subscriptions, handlers and EventSub session. Everything
+	// else, sockets and the threads included, comes from the TwitchServices it was created with.
 	class TwitchAPI {
 	public:
 
-		std::string SubscriptionTypeToString(int type) {
-			switch (type) {
-			case SubscriptionType::ChannelPointsCustomRewardRedemptionAdd:
-				return "channel.channel_points_custom_reward_redemption.add";
-			case SubscriptionType::AutomodMessageHold:
-				return "automod.message.hold";
-			default:
-				return "unknown";
-			}
-		}
+		// Every type in EventSubEventList.h. AutomodMessageHold is subscribed when the websocket connects so
+		// the session doesn't end, it is never handled otherwise.
+		using SubscriptionType = EventSubType;
 
-		enum SubscriptionType {
-			ChannelPointsCustomRewardRedemptionAdd,
-			// This exsist so that when websocket connects it can subscribe to this so the session dosent end, it will never be used otherwise
-			AutomodMessageHold
-		};
+		std::string SubscriptionTypeToString(SubscriptionType type) {
+			return GetEventSubTypeInfo(type).type;
+		}
 
 		struct EventSubSubscription {
 			std::string id;
@@ -39,51 +61,166 @@ namespace NomBotCore {
 			std::string version;
 			std::string condition;
 			std::string created_at;
-			std::function<void(const ChannelPointRewardRedemption)> callback;
+			SubscriptionType kind;
 			bool Subscibed = false;
+			bool Pending = false; // Create request queued or in flight
+			bool MissingScope = false; // Left out of reconciling until a token with the scope arrives
 
-			EventSubSubscription() : id(""), status(""), type(""), version("1"), condition(""), created_at(""), callback(nullptr), Subscibed(false) {}
+			EventSubSubscription() : id(""), status(""), type(""), version("1"), condition(""), created_at(""), kind(SubscriptionType::Unknown), Subscibed(false), Pending(false) {}
 		};
 
-		TwitchAPI();
+		TwitchAPI(TwitchServices& services, const TwitchChannelConfig& config = TwitchChannelConfig());
 		~TwitchAPI();
 
-		void Run(std::atomic<bool>& running);
-		void WebSocketThreadFunc(std::atomic<bool>& running);
+		// Signs in and learns the channel id without waiting for it, services must be initialized. Every wait is a
+		// co_await on the Helix scheduler or the EventSub reader, so channels signing in don't hold a thread each.
+		// Once signed in, the token is refreshed on a timer ahead of its expiry.
+		void BeginStart();
+		// Disables the WebSocket, cancels the channel's timers and waits for the threads and tasks it started
+		void Stop();
+		bool IsStarted() const { return m_Started.load(); }
+		const std::string& GetName() const { return m_Config.name; }
+		const std::string& GetWebSocketName() const { return m_WebSocketName; }
+		TwitchChannelStats GetStats() const;
+		// Called by the TwitchServices reader once the WebSocket is readable, non-zero when the connection is gone
+		// On the reader: takes what arrived and handles every complete frame in it, never waits on the socket.
+		// Returns -1 once the session is gone.
+		int ReadWebSocketFrames();
+		bool HasBufferedFrames() const { return m_WebSocket && m_WebSocket->HasBufferedFrame(); }
+		bool HasPendingWrites() const { return m_WebSocket && m_WebSocket->HasPendingWrites(); }
+		void FlushWebSocketWrites() { m_WebSocket->FlushWrites(); }
+		void HandleWebSocketMessage(const char* message);
 
-		int Initialize();
-		int Authenticate();
-		int GetAccessToken();
-		int RefreshAccessToken();
+		Task<int> AuthenticateAsync();
+		// Opens the authorize page in the browser and waits up to AuthorizationTimeoutMs for its redirect to localhost:3000
+		Task<int> ReceiveAuthorizationCodeAsync();
+		Task<int> GetAccessTokenAsync();
+		Task<int> RefreshAccessTokenAsync();
+		// Blocking versions of the above, see SyncWait for the threads they must not run on
+		int Authenticate() { return SyncWait(AuthenticateAsync()); }
+		int ReceiveAuthorizationCode() { return SyncWait(ReceiveAuthorizationCodeAsync()); }
+		int GetAccessToken() { return SyncWait(GetAccessTokenAsync()); }
+		int RefreshAccessToken() { return SyncWait(RefreshAccessTokenAsync()); }
+		// Publishes the token on success
+		int ParseTokenResponse(const std::string& body, bool requireRefreshToken);
+		// Null before the first sign in. One atomic load, safe from any thread.
+		std::shared_ptr<const TwitchToken> GetToken() const { return m_Token.load(std::memory_order_acquire); }
 		int EnableWebSocket(bool enable);
 		int IsWebSocketEnabled() const { return m_IsWebSocketEnabled; }
 		int ConnectWebSocket();
-		int CheckIfRefreshNeeded();
-		int AddEventSubSubscription(SubscriptionType type, std::function<void(const ChannelPointRewardRedemption&)> callback = nullptr);
+		int AddEventSubSubscription(SubscriptionType type);
+		// Handlers stay registered across subscribe and unsubscribe, returns an id for RemoveEventHandler.
+		// These only see this channel, handlers on TwitchServices see every channel.
+		template<typename Event>
+		int AddEventHandler(std::function<void(const Event&)> handler) { return m_Dispatcher.AddHandler<Event>(std::move(handler)); }
+		void RemoveEventHandler(int id) { m_Dispatcher.RemoveHandler(id); }
+		// Writes every received frame, with its receive time, to path until StopCapture
+		int StartCapture(const std::string& path);
+		void StopCapture();
+		// Feeds a capture through parsing, dedupe, the worker pool and the handlers without touching the network.
+		// speed 1 keeps the captured timing, 4 plays four times as fast and 0 as fast as possible.
+		// Returns once every handler has run, and fails while any channel has its WebSocket enabled. A stop request
+		// ends it before the next frame, even in the middle of waiting for one.
+		int ReplayCapture(const std::string& path, double speed, EventSubReplayStats* stats = nullptr, std::stop_token stop = {});
 		int RemoveEventSubSubscription(SubscriptionType type);
-		int SubscribetoUnSubscribedEvents();
+		// Brings the Helix subscriptions for this session in line with m_Subscriptions on the reconciler thread
+		void ReconcileSubscriptions();
 		int IsSubscribedToEvent(SubscriptionType type);
 	private:
-		NomSocketManager* m_SocketManager = nullptr;
-		NomWebSocket* m_WebSocket = nullptr;
-		char* m_ClientID = nullptr;
-		char* m_ClientSecret = nullptr;
-		std::atomic<bool>* m_WebSocketRunning;
+		friend class TwitchServices;
+
+		TwitchServices& m_Services;
+		TwitchChannelConfig m_Config;
+		NomWebSocket* m_WebSocket = nullptr; // Created by Start, the socket manager only exists once services are initialized
+		NomWebSocket* m_NextWebSocket = nullptr; // Opened at a reconnect_url, swapped with m_WebSocket once it is welcomed
+		std::string m_WebSocketName; // Of m_WebSocket, the reader's key for the channel
 		std::vector<std::thread> internalThreads;
+		std::mutex m_ThreadMutex;
 		void StartInternalThread();
-		bool m_IsWebSocketEnabled = false;
+		std::atomic<bool> m_IsWebSocketEnabled{ false };
+		std::atomic<bool> m_Started{ false };
+		std::atomic<std::shared_ptr<const TwitchToken>> m_Token;
+		// All under m_ThreadMutex. Stop closes the timers, nothing is scheduled on them after that.
+		bool m_Starting = false;
+		int m_RunningTasks = 0;
+		std::condition_variable m_TasksDone;
+		bool m_TimersClosed = true;
+		TimerWheel::TimerId m_RefreshTimer = 0;
+		TimerWheel::TimerId m_KeepaliveTimer = 0;
+		TimerWheel::TimerId m_ReconnectTimer = 0;
+		std::chrono::milliseconds m_RefreshBackoff = InitialRefreshBackoff;
+		std::chrono::milliseconds m_ReconnectBackoff = InitialReconnectBackoff;
+		bool m_WebSocketWanted = false; // Between EnableWebSocket(true) and (false), a lost session is reconnected meanwhile
+		// Keepalive deadline of the session, read and written by the reader and the timers
+		std::atomic<int64_t> m_LastFrameAt{ 0 }; // steady_clock ticks
+		std::atomic<int> m_KeepaliveTimeoutMs{ 0 }; // 0 until a welcome names it
+		std::string m_FrameBuffer; // Reused by the reader for every message of this channel
+		uint64_t m_WelcomeCount = 0; // Welcomes handled, on the reader only
+		std::atomic<bool> m_FollowingReconnect{ false }; // From connecting to the reconnect_url until the reader moved over
 		char* m_ChannelID = nullptr;
 
 		std::map<std::string, EventSubSubscription*> m_Subscriptions;
+		std::mutex m_SubscriptionMutex;
+		EventSubDispatcher m_Dispatcher;
+		int m_ReconcileId = 0;
+		std::mutex m_CaptureMutex;
+		EventSubCaptureWriter m_Capture;
+		std::atomic<bool> m_Capturing{ false };
+		std::atomic<bool> m_Replaying{ false }; // Session messages change no state while set
+		MetricCounter* m_NotificationCounter = nullptr;
+		MetricCounter* m_HandledCounter = nullptr;
+		MetricCounter* m_ConnectCounter = nullptr;
+		MetricCounter* m_DisconnectCounter = nullptr;
+
+		// Connects waiting on the shared reader only, then hands the WebSocket to it
+		Task<int> ConnectEventSubAsync();
+		// Starts a connect unless one is running or the WebSocket is no longer wanted
+		int OpenWebSocket();
+		// Takes the session away from the reader and closes it, the socket stays registered for the next connect
+		void DropWebSocket();
+		void ScheduleReconnect();
+		// Connects to a session_reconnect's reconnect_url next to the live session, which is only dropped once
+		// the new one is welcomed. Falls back to a fresh connect if the new session doesn't come up.
+		void FollowReconnect(const std::string& url);
+		Task<int> FollowReconnectAsync(std::string url);
+		// Under the reader's lock, see TwitchServices::SwitchReader
+		void SwapWebSockets();
+		// Receive time for the keepalive check, and the capture if one is open
+		void RecordFrame(const std::string& message);
+
+		Task<int> StartAsync();
+		// Counts the task until it finishes, Stop waits for the count to reach zero
+		void SpawnTracked(Task<int> task, std::function<void(int)> done = nullptr);
+		// Takes one off the count, SpawnTracked does it for its tasks
+		void EndTrackedTask();
+		void ScheduleTokenRefresh(std::chrono::milliseconds delay);
+		void OnTokenRefreshed(int result);
+		// Somewhere between 75 and 85 percent of the token's lifetime, so channels signed in together don't all refresh at once
+		static std::chrono::milliseconds NextRefreshDelay(const TwitchToken& token);
+		void ArmKeepalive(std::chrono::milliseconds delay);
+		// On the timer thread, closes a session that went quiet past its keepalive timeout
+		void CheckKeepalive();
+
+		// Runs the handlers for one notification, on an EventSub worker
+		void HandleEvent(EventSubType type, const std::shared_ptr<JsonValue>& event);
+
+		// One reconciler pass: list, diff, then every create and delete at once through the Helix scheduler
+		int RunReconcilePass();
+		int FetchSubscriptions(const std::string& accessToken, std::vector<EventSubRemoteSubscription>& out);
+
+		std::string BuildSubscriptionBody(const EventSubSubscription& subscription, const std::string& sessionId) const;
+
+		static constexpr int AuthorizationTimeoutMs = 5 * 60 * 1000;
+		static constexpr std::chrono::milliseconds InitialRefreshBackoff{ 5000 };
+		static constexpr std::chrono::milliseconds MaxRefreshBackoff{ 300000 };
+		static constexpr std::chrono::milliseconds InitialReconnectBackoff{ 1000 };
+		static constexpr std::chrono::milliseconds MaxReconnectBackoff{ 120000 };
+		static constexpr int KeepaliveGraceMs = 1000; // On top of keepalive_timeout_seconds, for network jitter
+		static constexpr int WelcomeTimeoutMs = 10000; // For a session at a reconnect_url, after its handshake
 	protected:
-		char* m_AuthCode;
-		char* m_AccessToken = nullptr;
-		char* m_RefreshToken;
-		int m_ExpiresIn;
-		std::vector<char*> m_Scopes;
-		char* m_TokenType;
+		char* m_AuthCode = nullptr;
 		char* m_WebSocketSessionID = nullptr;
-		char* m_ScopesString = nullptr;
+		std::string m_ScopesString;
 	};
 }
 
@@ -0,0 +1,349 @@
+#include "nompch.h"
+#include "TwitchServices.h"
+#include "TwitchAPI.h"
+#include "../Networking/DnsResolver.h"
+#include "../Core/Logging/ImGuiLog.h"
+#include "../Core/Logging/StructuredLog.h"
+#include "../Core/Tracing/Trace.h"
+#include <algorithm>
+
+namespace NomBotCore {
+	namespace {
+		// Empty when the variable isn't set
+		std::string ReadEnvironment(const char* name)
+		{
+			char* value = nullptr;
+			size_t valueLen = 0;
+			if (_dupenv_s(&value, &valueLen, name) != 0 || value == nullptr)
+				return "";
+			std::string result = value;
+			free(value);
+			return result;
+		}
+	}
+
+	TwitchServices::TwitchServices()
+		: m_Reconciler(m_Timers)
+	{
+	}
+
+	TwitchServices::~TwitchServices()
+	{
+		Shutdown();
+		if (m_EventWorkers) {
+			delete m_EventWorkers;
+			m_EventWorkers = nullptr;
+		}
+		if (m_HelixScheduler) {
+			delete m_HelixScheduler;
+			m_HelixScheduler = nullptr;
+		}
+		if (m_HttpClient) {
+			delete m_HttpClient;
+			m_HttpClient = nullptr;
+		}
+		if (m_SocketManager) {
+			m_SocketManager->CloseAllSockets();
+			delete m_SocketManager;
+			m_SocketManager = nullptr;
+		}
+	}
+
+	NomSocketManager& TwitchServices::OpenSocketManager()
+	{
+		std::lock_guard<std::mutex> lock(m_InitMutex);
+		if (!m_SocketManager)
+			m_SocketManager = new NomSocketManager(m_SocketLimit);
+		return *m_SocketManager;
+	}
+
+	int TwitchServices::Initialize()
+	{
+		std::lock_guard<std::mutex> lock(m_InitMutex);
+		if (m_Initialized)
+			return 0;
+		if (!m_HttpClient) {
+			if (!m_SocketManager)
+				m_SocketManager = new NomSocketManager(m_SocketLimit);
+
+			// Optional hosts-file style overrides, e.g. to point the bot at a local test server
+			std::string hostsFile = ReadEnvironment("NOM_HOSTS_FILE");
+			if (!hostsFile.empty())
+				m_SocketManager->GetResolver().LoadHostsFile(hostsFile.c_str());
+			// Payload logging is for debugging only, secrets are redacted but bodies still end up in the log files
+			m_SocketManager->SetPayloadLogging(ReadEnvironment("NOM_LOG_PAYLOADS") == "1");
+			// Sends everything to one plain HTTP/WebSocket server instead of Twitch, e.g. MockTwitch at 127.0.0.1:8080
+			std::string address = ReadEnvironment("NOM_TWITCH_ENDPOINT");
+			if (!address.empty()) {
+				size_t colon = address.rfind(':');
+				if (colon == std::string::npos || colon == 0) {
+					ImGuiLogManager::AddLog("TwitchAPI", "NOM_TWITCH_ENDPOINT must be host:port, ignoring " + address, LogSeverity::Error);
+				}
+				else {
+					TwitchEndpoint local = { address.substr(0, colon), atoi(address.c_str() + colon + 1), false };
+					m_Endpoints.auth = local;
+					m_Endpoints.helix = local;
+					m_Endpoints.eventSub = local;
+					ImGuiLogManager::AddLog("TwitchAPI", "Using " + address + " for every Twitch endpoint, without TLS.", LogSeverity::Warning);
+				}
+			}
+			// Tracing can also be switched on from the Trace window, this is for catching startup
+			std::string trace = ReadEnvironment("NOM_TRACE");
+			if (!trace.empty())
+				Trace::SetEnabled(trace == "1");
+			// Per call site limits for the lines that fire on every frame, keepalive or message
+			LogRateLimiter::SetCategoryLimit("Socket", { 5, 20, 1 });
+			LogRateLimiter::SetCategoryLimit("WebSocket", { 5, 20, 1 });
+			LogRateLimiter::SetCategoryLimit("TwitchAPI", { 5, 20, 1 });
+			LogRateLimiter::SetCategoryLimit("JsonDump", { 0.2, 2, 1 });
+			m_SocketManager->GetResolver().Prefetch(m_Endpoints.auth.host);
+			m_SocketManager->GetResolver().Prefetch(m_Endpoints.helix.host);
+			m_SocketManager->GetResolver().Prefetch(m_Endpoints.eventSub.host);
+
+			// Sized for the config set by now, nothing has been read yet
+			m_Dedupe = EventSubDedupe(m_DedupeConfig);
+			m_HttpClient = new HttpClient(*m_SocketManager);
+			m_HelixScheduler = new HelixScheduler(*m_HttpClient, *this);
+		}
+
+		if (m_ClientID.empty()) {
+			m_ClientID = ReadEnvironment("CLIENT_ID");
+			if (m_ClientID.empty()) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Environment variable CLIENT_ID not found!", LogSeverity::Error);
+				return 1;
+			}
+			ImGuiLogManager::AddLog("TwitchAPI", "ClientID: " + m_ClientID, LogSeverity::Info);
+		}
+		if (m_ClientSecret.empty()) {
+			m_ClientSecret = ReadEnvironment("CLIENT_SECRET");
+			if (m_ClientSecret.empty()) {
+				ImGuiLogManager::AddLog("TwitchAPI", "Environment variable CLIENT_SECRET not found!", LogSeverity::Error);
+				return 1;
+			}
+			ImGuiLogManager::AddLog("TwitchAPI", "ClientSecret: " + m_ClientSecret.substr(0, 4) + "****", LogSeverity::Info);
+		}
+
+		GetEventWorkers().Start();
+		m_Timers.Start();
+		m_Reconciler.Start();
+		{
+			std::lock_guard<std::mutex> readerLock(m_ReaderMutex);
+			m_AcceptWaits = true;
+		}
+		m_ReaderRunning = true;
+		m_ReaderThread = std::thread(&TwitchServices::ReaderThreadFunc, this);
+		m_Initialized = true;
+		return 0;
+	}
+
+	void TwitchServices::Shutdown()
+	{
+		std::lock_guard<std::mutex> lock(m_InitMutex);
+		if (!m_Initialized)
+			return;
+		CancelWaits();
+		m_ReaderRunning = false;
+		if (m_ReaderThread.joinable())
+			m_ReaderThread.join();
+		// A pass waits on the scheduler, which keeps running until the destructor
+		m_Reconciler.Stop();
+		if (m_EventWorkers)
+			m_EventWorkers->Stop();
+		// Timers still pending, e.g. a reconcile retry, fire once Initialize runs again
+		m_Timers.Stop();
+		m_Initialized = false;
+	}
+
+	EventSubWorkerPool& TwitchServices::GetEventWorkers()
+	{
+		if (!m_EventWorkers) {
+			m_EventWorkers = new EventSubWorkerPool([](void* context, EventSubType type, const std::shared_ptr<JsonValue>& event) {
+				static_cast<TwitchAPI*>(context)->HandleEvent(type, event);
+			}, m_EventWorkerConfig);
+		}
+		return *m_EventWorkers;
+	}
+
+	int TwitchServices::AddReader(TwitchAPI* channel)
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		// Checked under the lock, so a channel disabled meanwhile is either never added or removed again
+		if (m_Replaying || !channel->IsWebSocketEnabled())
+			return -1;
+		m_Readers[channel->GetWebSocketName()] = channel;
+		return 0;
+	}
+
+	bool TwitchServices::RemoveReader(TwitchAPI* channel)
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		auto it = m_Readers.find(channel->GetWebSocketName());
+		if (it == m_Readers.end() || it->second != channel)
+			return false;
+		m_Readers.erase(it);
+		return true;
+	}
+
+	int TwitchServices::SwitchReader(TwitchAPI* channel)
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		// A disable clears the flag before it removes the reader, which then closes whichever socket it finds
+		if (m_Replaying || !channel->IsWebSocketEnabled())
+			return -1;
+		auto it = m_Readers.find(channel->GetWebSocketName());
+		if (it != m_Readers.end() && it->second == channel)
+			m_Readers.erase(it);
+		channel->SwapWebSockets();
+		m_Readers[channel->GetWebSocketName()] = channel;
+		return 0;
+	}
+
+	bool TwitchServices::BeginReplay()
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		if (m_Replaying || !m_Readers.empty())
+			return false;
+		m_Replaying = true;
+		return true;
+	}
+
+	void TwitchServices::EndReplay()
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		m_Replaying = false;
+	}
+
+	bool TwitchServices::ReadableAwaiter::await_suspend(std::coroutine_handle<> handle)
+	{
+		// Resumes right away with -1 if refused
+		return m_Services.AddWaiter({ 0, m_SocketName, {}, std::chrono::steady_clock::now() + std::chrono::milliseconds(m_TimeoutMs), handle, &m_Result });
+	}
+
+	bool TwitchServices::AddSocketWait(std::vector<SocketWait> sockets, int timeoutMs, std::coroutine_handle<> handle, int* result)
+	{
+		*result = -1;
+		return AddWaiter({ 0, std::string(), std::move(sockets), std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs), handle, result });
+	}
+
+	bool TwitchServices::AddWaiter(SocketWaiter waiter)
+	{
+		std::lock_guard<std::mutex> lock(m_ReaderMutex);
+		if (!m_AcceptWaits)
+			return false;
+		waiter.id = ++m_NextWaiterId;
+		m_Waiters.push_back(std::move(waiter));
+		return true;
+	}
+
+	void TwitchServices::CancelWaits()
+	{
+		std::vector<SocketWaiter> waiters;
+		{
+			std::lock_guard<std::mutex> lock(m_ReaderMutex);
+			m_AcceptWaits = false;
+			waiters.swap(m_Waiters);
+		}
+		for (auto& waiter : waiters) {
+			*waiter.result = -1;
+			waiter.handle.resume();
+		}
+	}
+
+	void TwitchServices::ReaderThreadFunc()
+	{
+		Trace::SetThreadName("EventSub reader");
+		std::vector<std::string> names;
+		std::vector<std::string> ready;
+		std::vector<std::string> buffered;
+		std::vector<SocketWait> raw;
+		std::vector<std::pair<uint64_t, size_t>> rawOwners; // Waiter id and index for every entry of raw
+		std::vector<size_t> rawReady;
+		std::map<uint64_t, size_t> readyWaits;
+		std::vector<SocketWaiter> resumed;
+		while (m_ReaderRunning) {
+			names.clear();
+			ready.clear();
+			buffered.clear();
+			raw.clear();
+			rawOwners.clear();
+			rawReady.clear();
+			readyWaits.clear();
+			auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+			{
+				std::lock_guard<std::mutex> lock(m_ReaderMutex);
+				for (const auto& [name, channel] : m_Readers) {
+					names.push_back(name);
+					// e.g. the welcome, which may come in one read with the handshake answer, or what was left
+					// behind when a round hit the read limit
+					if (channel->HasBufferedFrames())
+						buffered.push_back(name);
+					else if (channel->HasPendingWrites())
+						channel->FlushWebSocketWrites();
+				}
+				for (const auto& waiter : m_Waiters) {
+					if (!waiter.socketName.empty())
+						names.push_back(waiter.socketName);
+					for (size_t i = 0; i < waiter.sockets.size(); ++i) {
+						raw.push_back(waiter.sockets[i]);
+						rawOwners.push_back({ waiter.id, i });
+					}
+					wake = std::min(wake, waiter.deadline);
+				}
+			}
+			// With nothing to watch this just waits out the timeout
+			int timeoutMs = 0;
+			if (buffered.empty()) {
+				auto untilWake = std::chrono::duration_cast<std::chrono::microseconds>(wake - std::chrono::steady_clock::now()).count();
+				timeoutMs = static_cast<int>(std::max<long long>(0, (untilWake + 999) / 1000));
+			}
+			int result = m_SocketManager->WaitSockets(names, raw, timeoutMs, ready, rawReady);
+			if (result < 0 && buffered.empty())
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			for (const auto& name : buffered) {
+				if (std::find(ready.begin(), ready.end(), name) == ready.end())
+					ready.push_back(name);
+			}
+			for (size_t index : rawReady)
+				readyWaits.emplace(rawOwners[index].first, rawOwners[index].second);
+			{
+				std::lock_guard<std::mutex> lock(m_ReaderMutex);
+				for (const auto& name : ready) {
+					auto it = m_Readers.find(name);
+					if (it == m_Readers.end())
+						continue; // Removed during the wait, or a waiter's socket
+					// Reads never wait, a frame that is still incomplete stays buffered on the channel until the
+					// rest arrives, so RemoveReader only ever waits for frames that are already here
+					if (it->second->ReadWebSocketFrames() != 0)
+						m_Readers.erase(it);
+				}
+				auto now = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < m_Waiters.size();) {
+					SocketWaiter& waiter = m_Waiters[i];
+					int waitResult = 0;
+					if (!waiter.socketName.empty()) {
+						if (std::find(ready.begin(), ready.end(), waiter.socketName) != ready.end())
+							waitResult = 1;
+					}
+					else {
+						auto found = readyWaits.find(waiter.id);
+						if (found != readyWaits.end())
+							waitResult = static_cast<int>(found->second) + 1;
+					}
+					if (waitResult == 0 && waiter.deadline > now) {
+						++i;
+						continue;
+					}
+					*waiter.result = waitResult;
+					resumed.push_back(std::move(waiter));
+					if (i + 1 != m_Waiters.size())
+						m_Waiters[i] = std::move(m_Waiters.back());
+					m_Waiters.pop_back();
+				}
+			}
+			// Outside the lock, the coroutine may add a reader or wait again
+			for (auto& waiter : resumed)
+				waiter.handle.resume();
+			resumed.clear();
+		}
+	}
+}
@@ -0,0 +1,153 @@
+#ifndef __TWITCHSERVICES_H__
+#define __TWITCHSERVICES_H__
+
+#include "../Networking/NomSocketManager.h"
+#include "../Networking/HttpClient.h"
+#include "HelixScheduler.h"
+#include "EventSubDispatcher.h"
+#include "EventSubWorkerPool.h"
+#include "EventSubDedupe.h"
+#include "EventSubReconciler.h"
+#include "../Core/Timers/TimerWheel.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <coroutine>
+
+namespace NomBotCore {
+	struct TwitchEndpoint {
+		std::string host;
+		int port = 443;
+		bool useTls = true;
+	};
+
+	// Where TwitchAPI connects, point all three at a local server such as MockTwitch to run offline
+	struct TwitchEndpoints {
+		TwitchEndpoint auth = { "id.twitch.tv" };
+		TwitchEndpoint helix = { "api.twitch.tv" };
+		TwitchEndpoint eventSub = { "eventsub.wss.twitch.tv" };
+	};
+
+	class TwitchAPI;
+
+	// What every channel context in the process shares: one socket manager with its TLS context and DNS
+	// cache, the Helix connection pools and scheduler, a single EventSub reader with its dedupe, the handler
+	// workers, the reconciler, the timers, handlers that run for every channel, and the app's client id and secret.
+	// Tokens, subscriptions and stats stay with each TwitchAPI. The reader is also the socket loop every
+	// non-blocking connect, Helix request and WaitReadable waits on.
+	class TwitchServices : public SocketEventLoop {
+	public:
+		TwitchServices();
+		~TwitchServices() override;
+
+		// Reads the environment and starts the shared threads, returns 0 right away once that succeeded
+		int Initialize();
+		// Stops the reader, the reconciler, the workers and the timers, queued events still run. Initialize starts them again.
+		void Shutdown();
+		bool IsInitialized() const { return m_Initialized.load(); }
+
+		// These take effect the next time Initialize runs, NOM_TWITCH_ENDPOINT overrides the endpoints
+		void SetEndpoints(const TwitchEndpoints& endpoints) { m_Endpoints = endpoints; }
+		void SetEventWorkerConfig(const EventSubWorkerPoolConfig& config) { m_EventWorkerConfig = config; }
+		void SetDedupeConfig(const EventSubDedupeConfig& config) { m_DedupeConfig = config; }
+		// One WebSocket per channel plus the pooled Helix connections, select caps it at FD_SETSIZE
+		void SetSocketLimit(int limit) { m_SocketLimit = limit; }
+
+		NomSocketManager& GetSocketManager() { return *m_SocketManager; }
+		// Creates the manager ahead of Initialize for something that shares it, e.g. the metrics exporter.
+		// SetSocketLimit has no effect after that.
+		NomSocketManager& OpenSocketManager();
+		HelixScheduler& GetHelixScheduler() { return *m_HelixScheduler; }
+		EventSubReconciler& GetReconciler() { return m_Reconciler; }
+		// Token refreshes, keepalive deadlines and reconcile retries of every channel
+		TimerWheel& GetTimers() { return m_Timers; }
+		EventSubDispatcher& GetDispatcher() { return m_Dispatcher; }
+		// Message ids are unique across sessions, so one dedupe covers every channel. Reader thread only.
+		EventSubDedupe& GetDedupe() { return m_Dedupe; }
+		// Forgets every message id, e.g. so replaying a capture again dispatches again
+		void ResetDedupe() { m_Dedupe = EventSubDedupe(m_DedupeConfig); }
+		// Created on first use with the worker config set at that point
+		EventSubWorkerPool& GetEventWorkers();
+		const TwitchEndpoints& GetEndpoints() const { return m_Endpoints; }
+		const std::string& GetClientID() const { return m_ClientID; }
+		const std::string& GetClientSecret() const { return m_ClientSecret; }
+
+		// The reader waits on the WebSockets of every added channel at once and reads whichever is ready.
+		// Add fails while a replay runs, Remove returns once the reader is done with the channel, true if it had it.
+		int AddReader(TwitchAPI* channel);
+		bool RemoveReader(TwitchAPI* channel);
+		// Moves the channel over to the WebSocket it opened at a reconnect_url, whether or not the reader still
+		// has the old one. Fails once the channel was disabled.
+		int SwitchReader(TwitchAPI* channel);
+		// A replay pushes into the worker pool from its own thread, which is only safe while no reader is added
+		bool BeginReplay();
+		void EndReplay();
+
+		// co_await WaitReadable(name, timeoutMs) gives 1 once the socket has data or a connection to accept, 0
+		// after the timeout and -1 once the services stop. The coroutine resumes on the reader thread, so what
+		// follows must not block until its next co_await, every channel's EventSub frames wait on it.
+		class ReadableAwaiter {
+		public:
+			ReadableAwaiter(TwitchServices& services, std::string socketName, int timeoutMs)
+				: m_Services(services), m_SocketName(std::move(socketName)), m_TimeoutMs(timeoutMs) {}
+			bool await_ready() const noexcept { return false; }
+			bool await_suspend(std::coroutine_handle<> handle);
+			int await_resume() const { return m_Result; }
+		private:
+			TwitchServices& m_Services;
+			std::string m_SocketName;
+			int m_TimeoutMs;
+			int m_Result = -1;
+		};
+		ReadableAwaiter WaitReadable(const std::string& socketName, int timeoutMs) { return ReadableAwaiter(*this, socketName, timeoutMs); }
+		bool AddSocketWait(std::vector<SocketWait> sockets, int timeoutMs, std::coroutine_handle<> handle, int* result) override;
+		// Resumes every pending wait with -1, and later ones return -1 right away until Initialize
+		void CancelWaits();
+	private:
+		struct SocketWaiter {
+			uint64_t id;
+			std::string socketName; // Waits for it to be readable, or when empty for the raw sockets
+			std::vector<SocketWait> sockets;
+			std::chrono::steady_clock::time_point deadline;
+			std::coroutine_handle<> handle;
+			int* result;
+		};
+
+		bool AddWaiter(SocketWaiter waiter);
+
+		void ReaderThreadFunc();
+
+		NomSocketManager* m_SocketManager = nullptr;
+		HttpClient* m_HttpClient = nullptr;
+		HelixScheduler* m_HelixScheduler = nullptr;
+		EventSubWorkerPool* m_EventWorkers = nullptr;
+		EventSubWorkerPoolConfig m_EventWorkerConfig;
+		TimerWheel m_Timers; // Before the reconciler, which schedules its retries on it
+		EventSubReconciler m_Reconciler;
+		EventSubDispatcher m_Dispatcher;
+		EventSubDedupeConfig m_DedupeConfig;
+		EventSubDedupe m_Dedupe{ m_DedupeConfig };
+		TwitchEndpoints m_Endpoints;
+		std::string m_ClientID;
+		std::string m_ClientSecret;
+		int m_SocketLimit = 1024;
+		std::atomic<bool> m_Initialized{ false };
+		std::mutex m_InitMutex;
+
+		std::thread m_ReaderThread;
+		std::atomic<bool> m_ReaderRunning{ false };
+		std::mutex m_ReaderMutex; // Held while the reader reads, so RemoveReader can't pull a channel out from under it
+		std::map<std::string, TwitchAPI*> m_Readers; // By WebSocket name
+		bool m_Replaying = false;
+		std::vector<SocketWaiter> m_Waiters; // Under m_ReaderMutex, resumed by the reader
+		uint64_t m_NextWaiterId = 0;
+		bool m_AcceptWaits = false;
+	};
+}
+
+#endif
@@ -4,6 +4,10 @@
 #include <iostream>
 
 #ifdef NOM_PLATFORM_WINDOWS
+// NomSocketManager::WaitReadable selects over every channel's WebSocket, Winsock's default is 64
+#ifndef FD_SETSIZE
+#define FD_SETSIZE 1024
+#endif
 #include <ws2tcpip.h>
 #include <windows.h>
 #include <stdlib.h>
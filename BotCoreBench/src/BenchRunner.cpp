@@ -0,0 +1,75 @@
+#include "BenchRunner.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// BotCoreBench [--quick] [name ...]
+// Runs every benchmark whose name contains one of the arguments, or all of them, and prints what each measured.
+// Build it in Release, the numbers of a Debug build say little about the bot.
+namespace NomBotBench {
+	namespace {
+		double s_Scale = 1.0;
+		thread_local uint64_t t_AllocatedBytes = 0;
+	}
+
+	std::vector<Benchmark>& Benchmarks()
+	{
+		static std::vector<Benchmark> benchmarks;
+		return benchmarks;
+	}
+
+	void Report(const std::string& what, double value, const char* unit)
+	{
+		printf("  %-56s %12.1f %s\n", what.c_str(), value, unit);
+	}
+
+	double Scale()
+	{
+		return s_Scale;
+	}
+
+	uint64_t AllocatedBytes()
+	{
+		return t_AllocatedBytes;
+	}
+}
+
+void* operator new(size_t size)
+{
+	NomBotBench::t_AllocatedBytes += size;
+	if (void* memory = malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<const char*> filters;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--quick") == 0)
+			NomBotBench::s_Scale = 0.1;
+		else
+			filters.push_back(argv[i]);
+	}
+	for (const auto& benchmark : NomBotBench::Benchmarks()) {
+		bool selected = filters.empty();
+		for (const char* filter : filters)
+			selected = selected || strstr(benchmark.name, filter) != nullptr;
+		if (!selected)
+			continue;
+		printf("%s\n", benchmark.name);
+		benchmark.run();
+	}
+	return 0;
+}
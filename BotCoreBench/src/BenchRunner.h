@@ -0,0 +1,53 @@
+#ifndef __BENCHRUNNER_H__
+#define __BENCHRUNNER_H__
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NomBotBench {
+	struct Benchmark {
+		const char* name;
+		void (*run)();
+	};
+
+	std::vector<Benchmark>& Benchmarks();
+	// One line under the running benchmark, e.g. Report("4 threads, AddLog", 31.2, "ns/op")
+	void Report(const std::string& what, double value, const char* unit);
+	// Iteration counts are multiplied by this, 0.1 with --quick so every benchmark can run as a smoke check
+	double Scale();
+	inline int Iterations(int count) { return count * Scale() >= 1 ? static_cast<int>(count * Scale()) : 1; }
+	// Bytes operator new handed out on the calling thread, for footprints that live on the heap
+	uint64_t AllocatedBytes();
+
+	struct BenchmarkRegistration {
+		BenchmarkRegistration(const char* name, void (*run)()) { Benchmarks().push_back({ name, run }); }
+	};
+
+	template<typename Function>
+	double NanosPerCall(int iterations, Function&& function)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+			function(i);
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+	}
+
+	// Latencies must be sorted
+	template<typename Value>
+	Value Percentile(const std::vector<Value>& sorted, double fraction)
+	{
+		if (sorted.empty())
+			return Value();
+		size_t index = static_cast<size_t>(fraction * sorted.size());
+		return sorted[index < sorted.size() ? index : sorted.size() - 1];
+	}
+}
+
+// NOM_BENCHMARK(DedupeThroughput) { ... } registers a benchmark under that name
+#define NOM_BENCHMARK(Name) \
+	static void Name(); \
+	static NomBotBench::BenchmarkRegistration Name##Registration(#Name, &Name); \
+	static void Name()
+
+#endif
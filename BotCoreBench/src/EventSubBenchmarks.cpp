@@ -0,0 +1,257 @@
+#include "BenchRunner.h"
+#include <BotCore/Core/JSONParser/JsonParser.h>
+#include <BotCore/TwitchAPI/EventSubDedupe.h>
+#include <BotCore/TwitchAPI/EventSubDispatcher.h>
+#include <BotCore/TwitchAPI/EventSubWorkerPool.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_set>
+
+using namespace NomBotCore;
+using namespace NomBotBench;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	std::string RedemptionJson(int sequence, int user)
+	{
+		char json[512];
+		snprintf(json, sizeof(json), "{\"id\":\"%d\",\"user_id\":\"%d\",\"user_login\":\"viewer%d\",\"user_name\":\"Viewer%d\","
+			"\"broadcaster_user_id\":\"1234\",\"broadcaster_user_login\":\"nom\",\"broadcaster_user_name\":\"Nom\","
+			"\"reward\":{\"id\":\"r%d\",\"title\":\"Hydrate\",\"cost\":100,\"prompt\":\"Drink some water\"},"
+			"\"status\":\"UNFULFILLED\",\"user_input\":\"\",\"redeemed_at\":\"2024-05-01T12:00:00.123456Z\"}", sequence, user, user, user, sequence % 5);
+		return json;
+	}
+
+	std::shared_ptr<JsonValue> ParseJson(const std::string& json)
+	{
+		size_t position = 0;
+		return JsonParser::Parse(json, position);
+	}
+
+	struct PoolRun {
+		double seconds = 0;
+		size_t handled = 0;
+		uint64_t dropped = 0;
+		double p50Us = 0;
+		double p99Us = 0;
+		double readerMaxUs = 0; // Longest the generator was held up handing one event over
+		int orderErrors = 0;
+	};
+
+	// Generates redemptions from 64 users at rate per second, parses each like the reader does and hands it to the
+	// pool, or runs the handler right there when inlineHandlers is set. Every stallEvery-th handler sleeps 20 ms.
+	PoolRun RunPool(int rate, int total, int stallEvery, const EventSubWorkerPoolConfig& config, bool inlineHandlers)
+	{
+		const int users = 64;
+		std::vector<Clock::time_point> receivedAt(total);
+		std::vector<std::atomic<int>> lastSequence(users);
+		for (auto& last : lastSequence)
+			last = -1;
+		std::atomic<int> orderErrors{ 0 };
+		std::atomic<size_t> handled{ 0 };
+		std::mutex latencyMutex;
+		std::vector<double> latenciesUs;
+		latenciesUs.reserve(total);
+
+		EventSubDispatcher dispatcher;
+		dispatcher.AddHandler<ChannelPointRewardRedemption>([&](const ChannelPointRewardRedemption& redemption) {
+			int user = std::atoi(redemption.user_id.c_str());
+			int sequence = std::atoi(redemption.id.c_str());
+			if (lastSequence[user].exchange(sequence) > sequence)
+				++orderErrors;
+			if (stallEvery && sequence % stallEvery == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			double latencyUs = std::chrono::duration<double, std::micro>(Clock::now() - receivedAt[sequence]).count();
+			{
+				std::lock_guard<std::mutex> lock(latencyMutex);
+				latenciesUs.push_back(latencyUs);
+			}
+			++handled;
+		});
+		EventSubWorkerPool pool([&dispatcher](void*, EventSubType type, const std::shared_ptr<JsonValue>& event) { dispatcher.Dispatch(type, event); }, config);
+		if (!inlineHandlers)
+			pool.Start();
+
+		PoolRun run;
+		auto start = Clock::now();
+		for (int i = 0; i < total; ++i) {
+			auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(1e9 / rate * i));
+			while (Clock::now() < due)
+				std::this_thread::yield();
+			receivedAt[i] = Clock::now();
+			std::shared_ptr<JsonValue> event = ParseJson(RedemptionJson(i, i % users));
+			auto handOver = Clock::now();
+			if (inlineHandlers)
+				dispatcher.Dispatch(EventSubType::ChannelPointsCustomRewardRedemptionAdd, event);
+			else
+				pool.Push(nullptr, EventSubType::ChannelPointsCustomRewardRedemptionAdd, event);
+			run.readerMaxUs = std::max(run.readerMaxUs, std::chrono::duration<double, std::micro>(Clock::now() - handOver).count());
+		}
+		pool.Stop();
+		run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		run.handled = handled.load();
+		run.dropped = pool.GetDroppedCount();
+		run.orderErrors = orderErrors.load();
+		std::sort(latenciesUs.begin(), latenciesUs.end());
+		run.p50Us = Percentile(latenciesUs, 0.5);
+		run.p99Us = Percentile(latenciesUs, 0.99);
+		return run;
+	}
+
+	void ReportPool(const std::string& label, const PoolRun& run)
+	{
+		Report(label + ", events/s", run.handled / run.seconds, "/s");
+		Report(label + ", dropped", static_cast<double>(run.dropped), "events");
+		Report(label + ", end to end p50", run.p50Us, "us");
+		Report(label + ", end to end p99", run.p99Us, "us");
+		Report(label + ", longest reader hand over", run.readerMaxUs, "us");
+		Report(label + ", out of order", run.orderErrors, "events");
+	}
+
+	std::string MessageId(uint32_t i)
+	{
+		char id[64];
+		snprintf(id, sizeof(id), "%08x-1c2d-4e5f-8a9b-%012u", i * 2654435761u, i);
+		return id;
+	}
+
+	// ChannelPointRewardRedemption before the typed events: every field a std::string, the cost and time unparsed
+	struct StringRedemption {
+		std::string id;
+		std::string user_id;
+		std::string user_login;
+		std::string user_name;
+		std::string channel_id;
+		std::string channel_login;
+		std::string channel_name;
+		std::string redeemed_at;
+		std::string reward_id;
+		std::string reward_title;
+		std::string reward_cost;
+		std::string prompt;
+		std::string status;
+		std::string user_input;
+	};
+
+	std::string Field(const JsonValue& object, const char* name)
+	{
+		auto found = object.objectValues.find(name);
+		if (found == object.objectValues.end() || !found->second)
+			return "";
+		if (found->second->type == JsonValue::Type::Number)
+			return std::to_string(static_cast<int64_t>(found->second->numberValue));
+		return found->second->stringValue;
+	}
+
+	void DecodeStrings(const JsonValue& event, StringRedemption& out)
+	{
+		out.id = Field(event, "id");
+		out.user_id = Field(event, "user_id");
+		out.user_login = Field(event, "user_login");
+		out.user_name = Field(event, "user_name");
+		out.channel_id = Field(event, "broadcaster_user_id");
+		out.channel_login = Field(event, "broadcaster_user_login");
+		out.channel_name = Field(event, "broadcaster_user_name");
+		out.redeemed_at = Field(event, "redeemed_at");
+		const JsonValue& reward = *event.objectValues.find("reward")->second;
+		out.reward_id = Field(reward, "id");
+		out.reward_title = Field(reward, "title");
+		out.reward_cost = Field(reward, "cost");
+		out.prompt = Field(reward, "prompt");
+		out.status = Field(event, "status");
+		out.user_input = Field(event, "user_input");
+	}
+
+	// Decodes an event, then keeps copies of it in a ring of recentCount, like an overlay showing the latest ones
+	template<typename Event, typename Decode>
+	void ReportFootprint(const char* label, const std::shared_ptr<JsonValue>& json, Decode&& decode)
+	{
+		const int count = Iterations(200000);
+		const int recentCount = 1000;
+		Event decoded;
+		Report(std::string(label) + ", decode", NanosPerCall(count, [&](int) { decode(json, decoded); }), "ns/event");
+		std::vector<Event> recent(recentCount);
+		uint64_t allocatedBefore = AllocatedBytes();
+		for (auto& kept : recent)
+			kept = decoded;
+		uint64_t heapBytes = (AllocatedBytes() - allocatedBefore) / recentCount;
+		Report(std::string(label) + ", bytes per kept event", static_cast<double>(sizeof(Event) + heapBytes), "bytes");
+		Report(std::string(label) + ", copy into recent events", NanosPerCall(count, [&](int i) { recent[i % recentCount] = decoded; }), "ns/event");
+	}
+}
+
+// Redemptions at 10k/s from a local generator, handled on the reader against handed to the worker pool
+NOM_BENCHMARK(WorkerPoolThroughput)
+{
+	const int rate = 10000;
+	EventSubWorkerPoolConfig config;
+	config.workerCount = 2;
+	ReportPool("inline", RunPool(rate, Iterations(50000), 0, config, true));
+	ReportPool("pool, 2 workers", RunPool(rate, Iterations(50000), 0, config, false));
+	// A handler that stalls like a TTS call or an external HTTP request now and then
+	ReportPool("inline, 20 ms stall per 1000", RunPool(rate, Iterations(20000), 1000, config, true));
+	ReportPool("pool drop, 20 ms stall per 1000", RunPool(rate, Iterations(20000), 1000, config, false));
+	config.overflowPolicy = EventSubOverflowPolicy::Block;
+	config.queueCapacity = 64;
+	ReportPool("pool block 64, 20 ms stall per 1000", RunPool(rate, Iterations(20000), 1000, config, false));
+}
+
+// Message ids at rates well past a busy channel, 10% of them redelivered, against an unbounded set of strings
+NOM_BENCHMARK(DedupeThroughput)
+{
+	const int count = Iterations(1000000);
+	std::mt19937 random(1);
+	std::vector<std::string> ids;
+	ids.reserve(count + count / 10);
+	for (int i = 0; i < count; ++i) {
+		ids.push_back(MessageId(i));
+		if (random() % 10 == 0)
+			ids.push_back(MessageId(i - std::min<uint32_t>(i, random() % 1000)));
+	}
+	uint64_t allocatedBefore = AllocatedBytes();
+	EventSubDedupe dedupe;
+	double dedupeKb = (AllocatedBytes() - allocatedBefore) / 1024.0;
+	size_t fresh = 0;
+	double dedupeNs = NanosPerCall(static_cast<int>(ids.size()), [&](int i) { fresh += dedupe.Insert(ids[i]); });
+	std::unordered_set<std::string> seen;
+	size_t freshInSet = 0;
+	allocatedBefore = AllocatedBytes();
+	double setNs = NanosPerCall(static_cast<int>(ids.size()), [&](int i) { freshInSet += seen.insert(ids[i]).second; });
+	Report("EventSubDedupe::Insert", dedupeNs, "ns/op");
+	Report("unordered_set<std::string>::insert", setNs, "ns/op");
+	Report("redeliveries let through", static_cast<double>(fresh - freshInSet), "ids");
+	Report("EventSubDedupe memory, fixed", dedupeKb, "KB");
+	Report("unordered_set memory, unbounded", (AllocatedBytes() - allocatedBefore) / 1024.0, "KB");
+
+	// Spread over simulated time at a given rate the sets rotate on age, or early once the rate passes peakPerSecond
+	for (double perSecond : { 200.0, 2000.0 }) {
+		EventSubDedupe timed;
+		auto now = Clock::now();
+		for (int i = 0; i < count; ++i)
+			timed.Insert(ids[i], now + std::chrono::microseconds(static_cast<int64_t>(i * 1e6 / perSecond)));
+		char label[64];
+		snprintf(label, sizeof(label), "early rotations at %.0f ids/s", perSecond);
+		Report(label, static_cast<double>(timed.GetEarlyRotations()), "rotations");
+	}
+}
+
+// A redemption decoded into the typed event against the std::string fields it replaced
+NOM_BENCHMARK(EventFootprint)
+{
+	std::shared_ptr<JsonValue> json = ParseJson(RedemptionJson(1, 7));
+	json->objectValues["id"]->stringValue = "1b2c3d4e-5f60-7182-93a4-b5c6d7e8f901";
+	json->objectValues["reward"]->objectValues["id"]->stringValue = "9f8e7d6c-5b4a-3928-1706-f5e4d3c2b1a0";
+	ReportFootprint<StringRedemption>("std::string fields", json, [](const std::shared_ptr<JsonValue>& event, StringRedemption& out) {
+		DecodeStrings(*event, out);
+	});
+	// Kept events drop raw, as the struct asks, or every copy would hold the whole JSON tree
+	ReportFootprint<ChannelPointRewardRedemption>("typed event", json, [](const std::shared_ptr<JsonValue>& event, ChannelPointRewardRedemption& out) {
+		DecodeEventSub(event, out);
+		out.raw.reset();
+	});
+}
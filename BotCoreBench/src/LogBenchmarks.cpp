@@ -0,0 +1,168 @@
+#include "BenchRunner.h"
+#include <BotCore/Core/Logging/ImGuiLog.h>
+#include <BotCore/Core/Logging/StructuredLog.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace NomBotCore;
+using namespace NomBotBench;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// How AddLog stored entries before the rings: one lock and a vector per category that only ever grows
+	class MutexLog {
+	public:
+		void Add(const std::string& logName, const std::string& message)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Logs[logName].push_back({ message, LogSeverity::Info });
+		}
+	private:
+		std::mutex m_Mutex;
+		std::map<std::string, std::vector<ImGuiLogEntry>> m_Logs;
+	};
+
+	// Starts threadCount threads together, each calling append(thread, i) count times, and returns the wall time
+	template<typename Append>
+	double RunThreads(int threadCount, int count, Append&& append)
+	{
+		std::atomic<int> ready{ 0 };
+		std::atomic<bool> go{ false };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; ++t) {
+			threads.emplace_back([&, t] {
+				++ready;
+				while (!go.load())
+					std::this_thread::yield();
+				for (int i = 0; i < count; ++i)
+					append(t, i);
+			});
+		}
+		while (ready.load() < threadCount)
+			std::this_thread::yield();
+		auto start = Clock::now();
+		go = true;
+		for (auto& thread : threads)
+			thread.join();
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	// Publishes staged entries every 16 ms like the UI frame does, until the frame goes out of scope
+	class FrameThread {
+	public:
+		FrameThread() : m_Thread([this] {
+			while (m_Running.load()) {
+				ImGuiLogManager::PublishStaged();
+				std::this_thread::sleep_for(std::chrono::milliseconds(16));
+			}
+		}) {}
+		~FrameThread()
+		{
+			m_Running = false;
+			m_Thread.join();
+		}
+	private:
+		std::atomic<bool> m_Running{ true };
+		std::thread m_Thread;
+	};
+
+	const char* ThreadCategory(int thread)
+	{
+		return thread % 2 ? "Socket" : "WebSocket";
+	}
+}
+
+// Appends from several I/O threads at once, against the single mutex the rings replaced
+NOM_BENCHMARK(LogAppendThreads)
+{
+	const std::string message = "Sent 123 bytes on socket 'HttpClient/0'";
+	for (int threadCount : { 1, 4, 8, 16 }) {
+		const int total = Iterations(1600000);
+		const int count = total / threadCount;
+		auto ring = std::make_unique<LogRing>();
+		double ringNs = RunThreads(threadCount, count, [&](int, int) { ring->Append(message.data(), message.size(), LogSeverity::Info); });
+		double addLogNs;
+		{
+			FrameThread frame;
+			addLogNs = RunThreads(threadCount, count, [&](int t, int) { ImGuiLogManager::AddLog(ThreadCategory(t), message); });
+		}
+		auto mutexLog = std::make_unique<MutexLog>();
+		double mutexNs = RunThreads(threadCount, count, [&](int t, int) { mutexLog->Add(ThreadCategory(t), message); });
+		std::string threads = std::to_string(threadCount) + (threadCount == 1 ? " thread, " : " threads, ");
+		Report(threads + "LogRing::Append", ringNs / (count * threadCount), "ns/op");
+		Report(threads + "AddLog", addLogNs / (count * threadCount), "ns/op");
+		Report(threads + "mutex + vector", mutexNs / (count * threadCount), "ns/op");
+	}
+	Report("memory per category ring", sizeof(LogRing) / 1024.0, "KB");
+}
+
+// One call on the receive path, formatting the text up front against recording a structured entry
+NOM_BENCHMARK(LogCallCost)
+{
+	FrameThread frame;
+	const int count = Iterations(1000000);
+	std::string payload = "{\"metadata\":{\"message_id\":\"" + std::string(360, 'x') + "\"}}";
+	const char* message = payload.c_str();
+	Report("message, eager AddLog", NanosPerCall(count, [&](int) {
+		ImGuiLogManager::AddLog("WebSocket", std::string("Received WebSocket message: ") + message, LogSeverity::Info);
+	}), "ns/call");
+	Report("message, NOM_LOG_INFO", NanosPerCall(count, [&](int) {
+		NOM_LOG_INFO("WebSocket", "Received WebSocket message: {}", message);
+	}), "ns/call");
+	Report("frame size, eager AddLog", NanosPerCall(count, [&](int i) {
+		ImGuiLogManager::AddLog("WebSocket", "Sent WebSocket frame with " + std::to_string(312 + i) + " bytes.", LogSeverity::Info);
+	}), "ns/call");
+	Report("frame size, NOM_LOG_INFO", NanosPerCall(count, [&](int i) {
+		NOM_LOG_INFO("WebSocket", "Sent WebSocket frame with {} bytes.", 312 + i);
+	}), "ns/call");
+	// A 64 byte frame, dumped the way ReceiveWebSocketFrame failures used to be
+	std::string frameBytes(64, '\x81');
+	Report("64 byte dump, eager decimal +=", NanosPerCall(count / 10, [&](int) {
+		std::string hex;
+		for (size_t i = 0; i < frameBytes.size(); ++i)
+			hex += " " + std::to_string(static_cast<unsigned char>(frameBytes[i]));
+		ImGuiLogManager::AddLog("WebSocket", "Raw WebSocket frame (hex):" + hex, LogSeverity::Info);
+	}), "ns/call");
+	Report("64 byte dump, LogBytes", NanosPerCall(count / 10, [&](int) {
+		NOM_LOG_INFO("WebSocket", "Raw WebSocket frame (hex): {}", LogBytes{ frameBytes.data(), frameBytes.size() });
+	}), "ns/call");
+}
+
+// How long one AddLog holds its producer up, with the UI frame publishing staged entries meanwhile
+NOM_BENCHMARK(LogProducerLatency)
+{
+	const std::string message = "Received frame of 512 bytes from EventSub websocket";
+	for (int threadCount : { 1, 4, 16 }) {
+		const int count = Iterations(200000);
+		auto mutexLog = std::make_unique<MutexLog>();
+		for (int staged = 1; staged >= 0; --staged) {
+			std::vector<std::vector<uint32_t>> latencies(threadCount);
+			for (auto& latency : latencies)
+				latency.reserve(count);
+			{
+				FrameThread frame;
+				RunThreads(threadCount, count, [&](int t, int) {
+					auto start = Clock::now();
+					if (staged)
+						ImGuiLogManager::AddLog("Bench", message);
+					else
+						mutexLog->Add("Bench", message);
+					latencies[t].push_back(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+				});
+			}
+			std::vector<uint32_t> all;
+			for (const auto& latency : latencies)
+				all.insert(all.end(), latency.begin(), latency.end());
+			std::sort(all.begin(), all.end());
+			std::string label = std::to_string(threadCount) + (threadCount == 1 ? " producer, " : " producers, ") + (staged ? "AddLog" : "mutex + vector");
+			Report(label + " p50", Percentile(all, 0.5), "ns");
+			Report(label + " p99", Percentile(all, 0.99), "ns");
+			Report(label + " p99.9", Percentile(all, 0.999), "ns");
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#include "TestRunner.h"
+#include "LoopbackBlackhole.h"
+#include "StandInHttpServer.h"
+#include "TestEventLoop.h"
+#include <BotCore/Networking/DnsResolver.h>
+#include <BotCore/Networking/NomSocketManager.h>
+#include <chrono>
+#include <future>
+#include <thread>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	long long MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+	}
+
+	// Connections are accepted on the server's thread, give it a moment to count one
+	bool WaitForConnection(const StandInHttpServer& server, int timeoutMs)
+	{
+		auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (server.GetConnectionCount() == 0 && Clock::now() < deadline)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return server.GetConnectionCount() > 0;
+	}
+}
+
+NOM_TEST(ConnectFallsBackFromABlackholedAddress)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) { reply.hang = true; });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	LoopbackBlackhole blackhole("127.0.0.2", server.GetPort());
+	if (blackhole.Start() != 0)
+		return SkipTest("connects to a full backlog are refused here instead of dropped");
+	NomSocketManager socketManager;
+	socketManager.GetResolver().SetHostOverride("edge.test", { "127.0.0.2", "127.0.0.1" });
+	socketManager.SetConnectTimeouts(5000, 10000);
+	NOM_CHECK(socketManager.CreateSocket("edge", 1, 0) >= 0);
+	auto start = Clock::now();
+	NOM_CHECK_EQUAL(socketManager.ConnectSocket("edge", "edge.test", server.GetPort()), 0);
+	// The live address starts after one stagger instead of waiting out the attempt timeout
+	NOM_CHECK(MillisecondsSince(start) < 1500);
+	NOM_CHECK(WaitForConnection(server, 1000));
+	socketManager.CloseSocket("edge");
+}
+
+NOM_TEST(ConnectGivesUpAtTheTotalDeadline)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) { reply.hang = true; });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	LoopbackBlackhole first("127.0.0.2", server.GetPort());
+	LoopbackBlackhole second("127.0.0.3", server.GetPort());
+	if (first.Start() != 0 || second.Start() != 0)
+		return SkipTest("connects to a full backlog are refused here instead of dropped");
+	NomSocketManager socketManager;
+	socketManager.GetResolver().SetHostOverride("edge.test", { "127.0.0.2", "127.0.0.3" });
+	socketManager.SetConnectTimeouts(5000, 700);
+	NOM_CHECK(socketManager.CreateSocket("edge", 1, 0) >= 0);
+	auto start = Clock::now();
+	NOM_CHECK(socketManager.ConnectSocket("edge", "edge.test", server.GetPort()) != 0);
+	long long elapsed = MillisecondsSince(start);
+	NOM_CHECK(elapsed >= 650);
+	NOM_CHECK(elapsed < 2000);
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 0);
+}
+
+NOM_TEST(ConnectMovesOnFromARefusedAddress)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) { reply.hang = true; });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	// Nothing listens on 127.0.0.4
+	socketManager.GetResolver().SetHostOverride("edge.test", { "127.0.0.4", "127.0.0.1" });
+	socketManager.SetConnectTimeouts(5000, 10000);
+	NOM_CHECK(socketManager.CreateSocket("edge", 1, 0) >= 0);
+	auto start = Clock::now();
+	NOM_CHECK_EQUAL(socketManager.ConnectSocket("edge", "edge.test", server.GetPort()), 0);
+	NOM_CHECK(MillisecondsSince(start) < 1500);
+	NOM_CHECK(WaitForConnection(server, 1000));
+	socketManager.CloseSocket("edge");
+}
+
+NOM_TEST(ConnectAsyncFallsBackWithoutStallingTheLoop)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) { reply.hang = true; });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	LoopbackBlackhole blackhole("127.0.0.2", server.GetPort());
+	if (blackhole.Start() != 0)
+		return SkipTest("connects to a full backlog are refused here instead of dropped");
+	NomSocketManager socketManager;
+	socketManager.GetResolver().SetHostOverride("edge.test", { "127.0.0.2", "127.0.0.1" });
+	socketManager.SetConnectTimeouts(5000, 10000);
+	NOM_CHECK(socketManager.CreateSocket("edge", 1, 0) >= 0);
+	TestEventLoop loop(socketManager);
+	std::promise<int> connected;
+	std::promise<long long> timerFired;
+	auto start = Clock::now();
+	Spawn(socketManager.ConnectSocketAsync(loop, "edge", "edge.test", server.GetPort()), std::function<void(int)>([&connected](int result) { connected.set_value(result); }));
+	// Another wait on the same loop still fires on time while the connect is racing
+	auto timer = [&loop, start]() -> Task<long long> {
+		co_await WaitForSockets(loop, std::vector<SocketWait>(), 100);
+		co_return MillisecondsSince(start);
+	};
+	Spawn(timer(), std::function<void(long long)>([&timerFired](long long elapsed) { timerFired.set_value(elapsed); }));
+	std::future<int> connectResult = connected.get_future();
+	std::future<long long> timerResult = timerFired.get_future();
+	NOM_CHECK(connectResult.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+	NOM_CHECK(timerResult.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+	if (connectResult.valid() && connectResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+		NOM_CHECK_EQUAL(connectResult.get(), 0);
+		NOM_CHECK(MillisecondsSince(start) < 1500);
+	}
+	if (timerResult.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		NOM_CHECK(timerResult.get() < 250);
+	NOM_CHECK(WaitForConnection(server, 1000));
+	loop.Stop();
+	socketManager.CloseSocket("edge");
+}
@@ -0,0 +1,219 @@
+#include "TestRunner.h"
+#include "StandInHttpServer.h"
+#include "TestEventLoop.h"
+#include <BotCore/Networking/DnsResolver.h>
+#include <ws2tcpip.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	std::string AddressText(const SocketAddress& address)
+	{
+		char text[INET6_ADDRSTRLEN] = {};
+		if (address.storage.ss_family == AF_INET6)
+			inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&address.storage)->sin6_addr, text, sizeof(text));
+		else
+			inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&address.storage)->sin_addr, text, sizeof(text));
+		return text;
+	}
+
+	// Answers names from a fixed table, counting lookups and holding them while closed so callers pile up
+	class StubResolver {
+	public:
+		StubResolver() = default;
+		StubResolver(const std::string& host, const std::string& address) { m_Names[host] = address; }
+
+		DnsResolver::LookupFunction Lookup()
+		{
+			return [this](const std::string& host, int family, std::vector<SocketAddress>& addresses) {
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				++m_Lookups;
+				m_Condition.wait(lock, [this] { return m_Open; });
+				auto found = m_Names.find(host);
+				SocketAddress address;
+				if (found == m_Names.end() || DnsResolver::ParseAddress(found->second, address) != 0)
+					return -1;
+				addresses.push_back(address);
+				return 0;
+			};
+		}
+
+		void SetOpen(bool open)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Open = open;
+			}
+			m_Condition.notify_all();
+		}
+
+		int GetLookups()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Lookups;
+		}
+	private:
+		std::map<std::string, std::string> m_Names;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_Open = true;
+		int m_Lookups = 0;
+	};
+}
+
+NOM_TEST(DnsResolverCoalescesConcurrentLookups)
+{
+	StubResolver stub("irc.stub.test", "127.0.0.1");
+	DnsResolver resolver;
+	resolver.SetLookupFunction(stub.Lookup());
+	stub.SetOpen(false);
+	const int callers = 8;
+	std::atomic<int> answered{ 0 };
+	std::atomic<int> succeeded{ 0 };
+	for (int i = 0; i < callers; ++i) {
+		resolver.ResolveAsync("irc.stub.test", 0, [&](int result, const std::vector<SocketAddress>& addresses) {
+			if (result == 0 && addresses.size() == 1 && AddressText(addresses[0]) == "127.0.0.1")
+				++succeeded;
+			++answered;
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	NOM_CHECK_EQUAL(answered.load(), 0);
+	stub.SetOpen(true);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (answered < callers && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	NOM_CHECK_EQUAL(succeeded.load(), callers);
+	NOM_CHECK_EQUAL(stub.GetLookups(), 1);
+}
+
+NOM_TEST(DnsResolverCachesAnswersAndFailures)
+{
+	StubResolver stub("irc.stub.test", "127.0.0.1");
+	DnsResolver resolver;
+	resolver.SetLookupFunction(stub.Lookup());
+	std::vector<SocketAddress> addresses;
+	NOM_CHECK_EQUAL(resolver.Resolve("irc.stub.test", 0, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(resolver.Resolve("IRC.Stub.Test", 0, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(addresses.size(), 1u);
+	NOM_CHECK_EQUAL(stub.GetLookups(), 1);
+	// A name that doesn't resolve is remembered too, so a reconnect storm doesn't hammer the resolver
+	NOM_CHECK_EQUAL(resolver.Resolve("missing.stub.test", 0, addresses, 2000), -1);
+	NOM_CHECK_EQUAL(resolver.Resolve("missing.stub.test", 0, addresses, 2000), -1);
+	NOM_CHECK_EQUAL(stub.GetLookups(), 2);
+	resolver.FlushCache();
+	NOM_CHECK_EQUAL(resolver.Resolve("irc.stub.test", 0, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(stub.GetLookups(), 3);
+}
+
+NOM_TEST(DnsResolverPrefersOverridesPerFamily)
+{
+	StubResolver stub("dual.stub.test", "127.0.0.9");
+	DnsResolver resolver;
+	resolver.SetLookupFunction(stub.Lookup());
+	resolver.SetHostOverride("dual.stub.test", { "::1", "127.0.0.1", "not an address" });
+	std::vector<SocketAddress> addresses;
+	NOM_CHECK_EQUAL(resolver.Resolve("dual.stub.test", 1, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(addresses.size(), 1u);
+	if (addresses.size() == 1)
+		NOM_CHECK(AddressText(addresses[0]) == "127.0.0.1");
+	NOM_CHECK_EQUAL(resolver.Resolve("dual.stub.test", 2, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(addresses.size(), 1u);
+	if (addresses.size() == 1)
+		NOM_CHECK(AddressText(addresses[0]) == "::1");
+	NOM_CHECK_EQUAL(resolver.Resolve("dual.stub.test", 0, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(addresses.size(), 2u);
+	NOM_CHECK_EQUAL(stub.GetLookups(), 0);
+	// Without the override the lookup function answers again
+	resolver.ClearHostOverrides();
+	NOM_CHECK_EQUAL(resolver.Resolve("dual.stub.test", 0, addresses, 2000), 0);
+	if (addresses.size() == 1)
+		NOM_CHECK(AddressText(addresses[0]) == "127.0.0.9");
+	NOM_CHECK_EQUAL(stub.GetLookups(), 1);
+}
+
+NOM_TEST(DnsResolverLoadsAHostsFile)
+{
+	std::string path = (std::filesystem::temp_directory_path() / "nombot-hosts-test.txt").string();
+	{
+		std::ofstream hosts(path);
+		hosts << "# Local Twitch stand-ins\n"
+			<< "127.0.0.1\tirc.stub.test eventsub.stub.test # both on the mock\n"
+			<< "\n"
+			<< "nonsense helix.stub.test\n"
+			<< "::1 Helix.Stub.Test\n";
+	}
+	StubResolver stub;
+	DnsResolver resolver;
+	resolver.SetLookupFunction(stub.Lookup());
+	NOM_CHECK_EQUAL(resolver.LoadHostsFile(path.c_str()), 0);
+	std::remove(path.c_str());
+	std::vector<SocketAddress> addresses;
+	NOM_CHECK_EQUAL(resolver.Resolve("eventsub.stub.test", 0, addresses, 2000), 0);
+	if (addresses.size() == 1)
+		NOM_CHECK(AddressText(addresses[0]) == "127.0.0.1");
+	NOM_CHECK_EQUAL(resolver.Resolve("helix.stub.test", 0, addresses, 2000), 0);
+	NOM_CHECK_EQUAL(addresses.size(), 1u);
+	if (addresses.size() == 1)
+		NOM_CHECK(AddressText(addresses[0]) == "::1");
+	NOM_CHECK_EQUAL(stub.GetLookups(), 0);
+	NOM_CHECK_EQUAL(resolver.LoadHostsFile("no/such/hosts"), -1);
+}
+
+NOM_TEST(ConnectResolvesThroughTheStub)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) { reply.hang = true; });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	StubResolver stub("irc.stub.test", "127.0.0.1");
+	NomSocketManager socketManager;
+	socketManager.GetResolver().SetLookupFunction(stub.Lookup());
+	NOM_CHECK(socketManager.CreateSocket("first", 1, 0) >= 0);
+	NOM_CHECK(socketManager.CreateSocket("second", 1, 0) >= 0);
+	NOM_CHECK_EQUAL(socketManager.ConnectSocket("first", "irc.stub.test", server.GetPort()), 0);
+	NOM_CHECK_EQUAL(socketManager.ConnectSocket("second", "irc.stub.test", server.GetPort()), 0);
+	// The second connect is served from the cache
+	NOM_CHECK_EQUAL(stub.GetLookups(), 1);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (server.GetConnectionCount() < 2 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 2);
+	NOM_CHECK(socketManager.CreateSocket("missing", 1, 0) >= 0);
+	NOM_CHECK(socketManager.ConnectSocket("missing", "missing.stub.test", server.GetPort()) != 0);
+	socketManager.CloseSocket("first");
+	socketManager.CloseSocket("second");
+}
+
+NOM_TEST(ConnectAsyncResumesOnTheLoopAfterALookup)
+{
+	StubResolver stub;
+	NomSocketManager socketManager;
+	socketManager.GetResolver().SetLookupFunction(stub.Lookup());
+	NOM_CHECK(socketManager.CreateSocket("missing", 1, 0) >= 0);
+	TestEventLoop loop(socketManager);
+	std::promise<std::thread::id> loopThread;
+	auto whereAmI = [&loop]() -> Task<std::thread::id> {
+		co_await WaitForSockets(loop, std::vector<SocketWait>(), 0);
+		co_return std::this_thread::get_id();
+	};
+	Spawn(whereAmI(), std::function<void(std::thread::id)>([&loopThread](std::thread::id id) { loopThread.set_value(id); }));
+	// The lookup fails on a resolver worker, and the connect gives up without waiting on any socket
+	std::promise<std::thread::id> doneThread;
+	Spawn(socketManager.ConnectSocketAsync(loop, "missing", "missing.stub.test", 80), std::function<void(int)>([&doneThread](int) { doneThread.set_value(std::this_thread::get_id()); }));
+	std::future<std::thread::id> done = doneThread.get_future();
+	NOM_CHECK(done.wait_for(std::chrono::seconds(3)) == std::future_status::ready);
+	if (done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		NOM_CHECK(done.get() == loopThread.get_future().get());
+	NOM_CHECK_EQUAL(stub.GetLookups(), 1);
+	loop.Stop();
+}
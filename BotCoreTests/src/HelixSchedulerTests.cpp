@@ -0,0 +1,213 @@
+#include "TestRunner.h"
+#include "StandInHttpServer.h"
+#include "TestEventLoop.h"
+#include <BotCore/TwitchAPI/HelixScheduler.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// Twitch's Helix bucket in small: one per Authorization header, refilled continuously, a 429 once it is empty
+	class StandInBucket {
+	public:
+		StandInBucket(double limit, double refillPerSecond) : m_Limit(limit), m_RefillPerSecond(refillPerSecond) {}
+
+		void Answer(const StandInRequest& request, StandInReply& reply)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			auto now = Clock::now();
+			auto found = m_Buckets.find(request.GetHeader("Authorization"));
+			if (found == m_Buckets.end())
+				found = m_Buckets.emplace(request.GetHeader("Authorization"), Bucket{ m_Limit, now }).first;
+			Bucket& bucket = found->second;
+			bucket.tokens = std::min(m_Limit, bucket.tokens + std::chrono::duration<double>(now - bucket.lastRefill).count() * m_RefillPerSecond);
+			bucket.lastRefill = now;
+			bool allowed = bucket.tokens >= 1.0;
+			if (allowed)
+				bucket.tokens -= 1.0;
+			else
+				++m_RateLimited;
+			// Whole seconds like Twitch, rounded up so a client pacing by them never runs early
+			long long reset = static_cast<long long>(std::time(nullptr)) + 1 + static_cast<long long>(std::ceil((m_Limit - bucket.tokens) / m_RefillPerSecond));
+			std::string headers = "Ratelimit-Limit: " + std::to_string(static_cast<int>(m_Limit)) + "\r\nRatelimit-Remaining: "
+				+ std::to_string(static_cast<int>(bucket.tokens)) + "\r\nRatelimit-Reset: " + std::to_string(reset) + "\r\n";
+			reply.pieces = { StandInHttpServer::Response(allowed ? 200 : 429, request.path, headers) };
+		}
+
+		int GetRateLimited()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_RateLimited;
+		}
+	private:
+		struct Bucket {
+			double tokens;
+			Clock::time_point lastRefill;
+		};
+
+		std::mutex m_Mutex;
+		double m_Limit;
+		double m_RefillPerSecond;
+		std::map<std::string, Bucket> m_Buckets;
+		int m_RateLimited = 0;
+	};
+
+	HttpRequest HelixRequest(const StandInHttpServer& server, const std::string& path, const std::string& token = "Bearer one")
+	{
+		HttpRequest request;
+		request.host = "127.0.0.1";
+		request.port = server.GetPort();
+		request.useTls = false;
+		request.path = path;
+		request.headers.push_back({ "Authorization", token });
+		return request;
+	}
+
+	// The callbacks run on the loop, the test thread waits for all of them here
+	class Completions {
+	public:
+		HelixScheduler::Callback Track(const std::string& name)
+		{
+			return [this, name](int result, HttpResponse& response) {
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Order.push_back(name);
+				m_Times[name] = Clock::now();
+				if (result == 0 && response.GetStatusCode() == 200)
+					++m_Succeeded;
+				m_Condition.notify_all();
+			};
+		}
+
+		bool WaitFor(size_t count, int timeoutMs)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			return m_Condition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return m_Order.size() >= count; });
+		}
+
+		size_t IndexOf(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return std::find(m_Order.begin(), m_Order.end(), name) - m_Order.begin();
+		}
+
+		Clock::time_point TimeOf(const std::string& name)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Times[name];
+		}
+
+		int GetSucceeded()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Succeeded;
+		}
+	private:
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		std::vector<std::string> m_Order;
+		std::map<std::string, Clock::time_point> m_Times;
+		int m_Succeeded = 0;
+	};
+}
+
+NOM_TEST(HelixSchedulerStaysInsideTheBucket)
+{
+	StandInBucket bucket(20, 10);
+	StandInHttpServer server([&bucket](const StandInRequest& request, StandInReply& reply) { bucket.Answer(request, reply); });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	TestEventLoop loop(socketManager);
+	HttpClient client(socketManager);
+	HelixScheduler scheduler(client, loop);
+	Completions completions;
+	const int count = 40;
+	for (int i = 0; i < count; ++i)
+		scheduler.Submit(HelixRequest(server, "/helix/users?id=" + std::to_string(i)), HelixPriority::BulkLookup, completions.Track(std::to_string(i)));
+	NOM_CHECK(completions.WaitFor(count, 20000));
+	NOM_CHECK_EQUAL(completions.GetSucceeded(), count);
+	NOM_CHECK_EQUAL(bucket.GetRateLimited(), 0);
+	HelixScheduler::BucketState state = scheduler.GetBucketState(HelixScheduler::BucketKey(HelixRequest(server, "/")));
+	NOM_CHECK(state.learned);
+	NOM_CHECK_EQUAL(state.limit, 20);
+	scheduler.Stop();
+}
+
+NOM_TEST(HelixSchedulerRunsHigherPrioritiesFirst)
+{
+	StandInBucket bucket(4, 4);
+	StandInHttpServer server([&bucket](const StandInRequest& request, StandInReply& reply) { bucket.Answer(request, reply); });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	TestEventLoop loop(socketManager);
+	HttpClient client(socketManager);
+	HelixScheduler scheduler(client, loop);
+	Completions completions;
+	for (int i = 0; i < 12; ++i)
+		scheduler.Submit(HelixRequest(server, "/helix/users"), HelixPriority::BulkLookup, completions.Track("bulk" + std::to_string(i)));
+	scheduler.Submit(HelixRequest(server, "/helix/eventsub/subscriptions"), HelixPriority::SubscriptionManagement, completions.Track("subscription"));
+	scheduler.Submit(HelixRequest(server, "/oauth2/token"), HelixPriority::TokenRefresh, completions.Track("token"));
+	NOM_CHECK(completions.WaitFor(14, 20000));
+	NOM_CHECK_EQUAL(completions.GetSucceeded(), 14);
+	// Only what was already on its way may finish first
+	NOM_CHECK(completions.IndexOf("token") < 4);
+	NOM_CHECK(completions.IndexOf("subscription") < 5);
+	NOM_CHECK(completions.IndexOf("bulk11") == 13);
+	scheduler.Stop();
+}
+
+NOM_TEST(HelixSchedulerWaitsOutA429)
+{
+	int answered = 0;
+	StandInHttpServer server([&answered](const StandInRequest& request, StandInReply& reply) {
+		// A bucket drained by some other client of the same token, the first answer tells when it is back
+		long long reset = static_cast<long long>(std::time(nullptr)) + 1;
+		bool limited = answered++ == 0;
+		reply.pieces = { StandInHttpServer::Response(limited ? 429 : 200, request.path, "Ratelimit-Limit: 800\r\nRatelimit-Remaining: "
+			+ std::string(limited ? "0" : "799") + "\r\nRatelimit-Reset: " + std::to_string(reset) + "\r\n") };
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	TestEventLoop loop(socketManager);
+	HttpClient client(socketManager);
+	HelixScheduler scheduler(client, loop);
+	HttpResponse response;
+	auto start = Clock::now();
+	NOM_CHECK_EQUAL(scheduler.SendAndWait(HelixRequest(server, "/helix/users"), HelixPriority::SubscriptionManagement, response), 0);
+	NOM_CHECK_EQUAL(response.GetStatusCode(), 200);
+	NOM_CHECK_EQUAL(server.GetRequestCount(), 2);
+	NOM_CHECK(Clock::now() - start >= std::chrono::milliseconds(900));
+	scheduler.Stop();
+}
+
+NOM_TEST(HelixSchedulerKeepsABucketPerToken)
+{
+	StandInBucket bucket(1, 0.25);
+	StandInHttpServer server([&bucket](const StandInRequest& request, StandInReply& reply) { bucket.Answer(request, reply); });
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	TestEventLoop loop(socketManager);
+	HttpClient client(socketManager);
+	HelixScheduler scheduler(client, loop);
+	Completions completions;
+	scheduler.Submit(HelixRequest(server, "/a1", "Bearer a"), HelixPriority::SubscriptionManagement, completions.Track("a1"));
+	NOM_CHECK(completions.WaitFor(1, 5000));
+	// The second request of token a waits for its bucket, token b's has not been touched
+	auto submitted = Clock::now();
+	scheduler.Submit(HelixRequest(server, "/a2", "Bearer a"), HelixPriority::SubscriptionManagement, completions.Track("a2"));
+	scheduler.Submit(HelixRequest(server, "/b1", "Bearer b"), HelixPriority::SubscriptionManagement, completions.Track("b1"));
+	NOM_CHECK(completions.WaitFor(3, 20000));
+	NOM_CHECK(completions.IndexOf("b1") == 1);
+	NOM_CHECK(completions.TimeOf("b1") - submitted < std::chrono::milliseconds(1000));
+	NOM_CHECK(completions.TimeOf("a2") - submitted >= std::chrono::milliseconds(2000));
+	NOM_CHECK_EQUAL(bucket.GetRateLimited(), 0);
+	scheduler.Stop();
+}
@@ -0,0 +1,250 @@
+#include "TestRunner.h"
+#include "StandInHttpServer.h"
+#include "TestEventLoop.h"
+#include <BotCore/Networking/HttpClient.h>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	HttpRequest LocalRequest(const StandInHttpServer& server, const std::string& path)
+	{
+		HttpRequest request;
+		request.host = "127.0.0.1";
+		request.port = server.GetPort();
+		request.useTls = false;
+		request.path = path;
+		request.timeoutMs = 2000;
+		return request;
+	}
+
+	// Feeds text one byte at a time and collects every response the parser completes on the way
+	std::vector<HttpResponse> ParseByteByByte(HttpResponseParser& parser, const std::string& text)
+	{
+		std::vector<HttpResponse> responses;
+		for (char c : text) {
+			int result = parser.Feed(&c, 1);
+			while (result == 1) {
+				responses.emplace_back();
+				parser.TakeResponse(responses.back());
+				result = parser.Parse();
+			}
+			if (result < 0)
+				break;
+		}
+		return responses;
+	}
+}
+
+NOM_TEST(HttpParserSplitsPipelinedResponses)
+{
+	HttpResponseParser parser;
+	std::vector<HttpResponse> responses = ParseByteByByte(parser,
+		"HTTP/1.1 200 OK\r\nContent-Length: 5\r\nRatelimit-Remaining: 799\r\n\r\nhello"
+		"HTTP/1.1 202 Accepted\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nWiki\r\n5;ext=1\r\npedia\r\n0\r\nTrailer: x\r\n\r\n"
+		"HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 204 No Content\r\n\r\n"
+		"HTTP/1.0 404 Not Found\r\n\r\nuntil close");
+	NOM_CHECK_EQUAL(responses.size(), 3u);
+	if (responses.size() == 3) {
+		NOM_CHECK_EQUAL(responses[0].GetStatusCode(), 200);
+		NOM_CHECK(responses[0].GetBody() == "hello");
+		NOM_CHECK(responses[0].GetHeader("ratelimit-remaining") == "799");
+		NOM_CHECK_EQUAL(responses[1].GetStatusCode(), 202);
+		NOM_CHECK(responses[1].GetReason() == "Accepted");
+		NOM_CHECK(responses[1].GetBody() == "Wikipedia");
+		NOM_CHECK_EQUAL(responses[2].GetStatusCode(), 204);
+	}
+	// No length, the body ends with the connection
+	NOM_CHECK_EQUAL(parser.MarkEndOfStream(), 1);
+	HttpResponse last;
+	parser.TakeResponse(last);
+	NOM_CHECK_EQUAL(last.GetStatusCode(), 404);
+	NOM_CHECK(last.GetBody() == "until close");
+	NOM_CHECK(!last.IsKeepAlive());
+}
+
+NOM_TEST(HttpParserRejectsMalformedResponses)
+{
+	HttpResponseParser badStatus;
+	std::string status = "HTTP/1.1 OK\r\n\r\n";
+	NOM_CHECK_EQUAL(badStatus.Feed(status.data(), status.size()), -1);
+	HttpResponseParser badChunk;
+	std::string chunk = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+	NOM_CHECK_EQUAL(badChunk.Feed(chunk.data(), chunk.size()), -1);
+	HttpResponseParser truncated;
+	std::string body = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort";
+	NOM_CHECK_EQUAL(truncated.Feed(body.data(), body.size()), 0);
+	NOM_CHECK_EQUAL(truncated.MarkEndOfStream(), -1);
+}
+
+NOM_TEST(HttpClientReadsResponsesInPieces)
+{
+	StandInHttpServer server([](const StandInRequest& request, StandInReply& reply) {
+		reply.pieceDelayMs = 20;
+		if (request.path == "/chunked") {
+			reply.pieces = { "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n6", "\r\nstr", "eam", "\r\n0\r\n", "\r\n" };
+			return;
+		}
+		std::string response = StandInHttpServer::Response(200, std::string(100000, 'x'), "Ratelimit-Remaining: 42\r\n");
+		// The status line and a header cut in half, then the body in two unequal parts
+		reply.pieces = { response.substr(0, 9), response.substr(9, 40), response.substr(49, 30000), response.substr(30049) };
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager);
+	HttpResponse response;
+	NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/large"), response), 0);
+	NOM_CHECK_EQUAL(response.GetStatusCode(), 200);
+	NOM_CHECK_EQUAL(response.GetBody().size(), 100000u);
+	NOM_CHECK(response.GetHeader("RATELIMIT-REMAINING") == "42");
+	NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/chunked"), response), 0);
+	NOM_CHECK(response.GetBody() == "stream");
+}
+
+NOM_TEST(HttpClientReusesConnections)
+{
+	StandInHttpServer server([](const StandInRequest& request, StandInReply& reply) {
+		reply.pieces = { StandInHttpServer::Response(200, request.path) };
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager);
+	for (int i = 0; i < 5; ++i) {
+		HttpResponse response;
+		NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/" + std::to_string(i)), response), 0);
+		NOM_CHECK(response.GetBody() == "/" + std::to_string(i));
+	}
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 1);
+	NOM_CHECK_EQUAL(server.GetRequestCount(), 5);
+}
+
+NOM_TEST(HttpClientPipelinesOnOneConnection)
+{
+	StandInHttpServer server([](const StandInRequest& request, StandInReply& reply) {
+		reply.pieces = { StandInHttpServer::Response(200, request.method + " " + request.path + " " + request.body) };
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager);
+	std::vector<HttpRequest> requests = { LocalRequest(server, "/1"), LocalRequest(server, "/2"), LocalRequest(server, "/3") };
+	requests[1].method = "POST";
+	requests[1].body = "body";
+	std::vector<HttpResponse> responses;
+	NOM_CHECK_EQUAL(client.SendPipelined(requests, responses), 3);
+	if (responses.size() == 3) {
+		NOM_CHECK(responses[0].GetBody() == "GET /1 ");
+		NOM_CHECK(responses[1].GetBody() == "POST /2 body");
+		NOM_CHECK(responses[2].GetBody() == "GET /3 ");
+	}
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 1);
+}
+
+NOM_TEST(HttpClientTimesOutOnASilentServer)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) {
+		reply.hang = true;
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager);
+	HttpRequest request = LocalRequest(server, "/silent");
+	request.timeoutMs = 300;
+	HttpResponse response;
+	auto start = std::chrono::steady_clock::now();
+	NOM_CHECK(client.Send(request, response) != 0);
+	auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	NOM_CHECK(elapsedMs >= 250);
+	NOM_CHECK(elapsedMs < 1500);
+}
+
+NOM_TEST(HttpClientSendsThePortInHost)
+{
+	// Written on the server's connection thread
+	std::mutex hostMutex;
+	std::string host;
+	StandInHttpServer server([&](const StandInRequest& request, StandInReply& reply) {
+		{
+			std::lock_guard<std::mutex> lock(hostMutex);
+			host = request.GetHeader("Host");
+		}
+		reply.pieces = { StandInHttpServer::Response(200, "") };
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager);
+	HttpResponse response;
+	NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/"), response), 0);
+	std::lock_guard<std::mutex> lock(hostMutex);
+	NOM_CHECK_EQUAL(host, "127.0.0.1:" + std::to_string(server.GetPort()));
+}
+
+NOM_TEST(HttpClientOnlyRetriesIdempotentRequests)
+{
+	// Promises keep-alive, then closes anyway, like a server timing out an idle connection as the next request leaves
+	StandInHttpServer server([](const StandInRequest& request, StandInReply& reply) {
+		reply.pieces = { StandInHttpServer::Response(200, request.method) };
+		reply.closeAfter = true;
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager, 1);
+	HttpResponse response;
+	NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/warm"), response), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	NOM_CHECK_EQUAL(client.Send(LocalRequest(server, "/get"), response), 0);
+	NOM_CHECK(response.GetBody() == "GET");
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 2);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	HttpRequest post = LocalRequest(server, "/token");
+	post.method = "POST";
+	post.body = "code=once";
+	NOM_CHECK(client.Send(post, response) != 0);
+	// Sent into the closed connection and not again
+	NOM_CHECK_EQUAL(server.GetConnectionCount(), 2);
+	NOM_CHECK_EQUAL(server.GetRequestCount(), 2);
+}
+
+NOM_TEST(HttpClientHandsPooledConnectionsBackToTheLoop)
+{
+	StandInHttpServer server([](const StandInRequest&, StandInReply& reply) {
+		std::string response = StandInHttpServer::Response(200, "slow");
+		reply.pieces = { response.substr(0, 10), response.substr(10) };
+		reply.pieceDelayMs = 300;
+	});
+	NOM_CHECK_EQUAL(server.Start(), 0);
+	NomSocketManager socketManager;
+	HttpClient client(socketManager, 1);
+	TestEventLoop loop(socketManager);
+	std::promise<std::thread::id> loopThread;
+	auto whereAmI = [&loop]() -> Task<std::thread::id> {
+		co_await WaitForSockets(loop, std::vector<SocketWait>(), 0);
+		co_return std::this_thread::get_id();
+	};
+	Spawn(whereAmI(), std::function<void(std::thread::id)>([&loopThread](std::thread::id id) { loopThread.set_value(id); }));
+
+	// A blocking Send holds the only connection while SendAsync waits for it
+	std::thread sender([&client, &server]() {
+		HttpResponse response;
+		client.Send(LocalRequest(server, "/held"), response);
+	});
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+	while (server.GetRequestCount() < 1 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	// Timed out by the time it gets the connection, so it finishes right where it was resumed
+	HttpRequest request = LocalRequest(server, "/waiting");
+	request.timeoutMs = 50;
+	HttpResponse asyncResponse;
+	std::promise<std::thread::id> doneThread;
+	Spawn(client.SendAsync(loop, request, asyncResponse), std::function<void(int)>([&doneThread](int) { doneThread.set_value(std::this_thread::get_id()); }));
+	std::future<std::thread::id> done = doneThread.get_future();
+	NOM_CHECK(done.wait_for(std::chrono::seconds(3)) == std::future_status::ready);
+	if (done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		NOM_CHECK(done.get() == loopThread.get_future().get());
+	sender.join();
+	loop.Stop();
+}
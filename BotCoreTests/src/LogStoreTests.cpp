@@ -0,0 +1,130 @@
+#include "TestRunner.h"
+#include <BotCore/Core/Logging/LogStore.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	// A fresh store directory per test, removed again when the test ends
+	class StoreDirectory {
+	public:
+		explicit StoreDirectory(const std::string& name)
+			: m_Path((std::filesystem::temp_directory_path() / ("nombot-" + name)).string())
+		{
+			std::filesystem::remove_all(m_Path);
+		}
+		~StoreDirectory() { std::filesystem::remove_all(m_Path); }
+
+		LogStoreConfig Config(size_t segmentBytes = 256 * 1024) const
+		{
+			LogStoreConfig config;
+			config.directory = m_Path + "/Store";
+			config.segmentBytes = segmentBytes;
+			return config;
+		}
+	private:
+		std::string m_Path;
+	};
+
+	ImGuiLogEntry Entry(const std::string& message)
+	{
+		ImGuiLogEntry entry;
+		entry.message = message;
+		entry.timestampUs = 1700000000000000;
+		return entry;
+	}
+
+	std::vector<uint64_t> Sequences(LogStore& store, const std::string& category)
+	{
+		std::vector<LogStoreRecord> records;
+		store.QuerySequence(category, 0, 1000, records);
+		std::vector<uint64_t> sequences;
+		for (const auto& record : records)
+			sequences.push_back(record.sequence);
+		return sequences;
+	}
+}
+
+NOM_TEST(LogStoreKeepsOddCategoriesInsideTheStore)
+{
+	StoreDirectory directory("logstore-names");
+	const std::vector<std::string> categories = { "../Escaped", "C:\\Windows", "Twitch.API/v2", "100%", "NUL" };
+	{
+		LogStore store(directory.Config());
+		NOM_CHECK_EQUAL(store.Open(), 0);
+		for (const auto& category : categories)
+			NOM_CHECK_EQUAL(store.Append(category, Entry("from " + category)), 0);
+	}
+	// Every segment is a plain file right in the store directory
+	int files = 0;
+	for (const auto& file : std::filesystem::recursive_directory_iterator(std::filesystem::path(directory.Config().directory).parent_path())) {
+		NOM_CHECK(file.path().parent_path() == std::filesystem::path(directory.Config().directory) || file.is_directory());
+		files += file.is_regular_file() ? 1 : 0;
+	}
+	NOM_CHECK_EQUAL(files, static_cast<int>(categories.size()));
+
+	LogStore reopened(directory.Config());
+	NOM_CHECK_EQUAL(reopened.Open(), 0);
+	std::vector<std::string> found = reopened.GetCategories();
+	NOM_CHECK_EQUAL(found.size(), categories.size());
+	for (const auto& category : categories) {
+		NOM_CHECK(std::find(found.begin(), found.end(), category) != found.end());
+		std::vector<LogStoreRecord> records;
+		NOM_CHECK_EQUAL(reopened.QuerySequence(category, 0, 10, records), 1);
+		if (records.size() == 1)
+			NOM_CHECK(records[0].message == "from " + category);
+	}
+}
+
+NOM_TEST(LogStoreContinuesSequencesAfterReopening)
+{
+	StoreDirectory directory("logstore-reopen");
+	{
+		LogStore store(directory.Config());
+		NOM_CHECK_EQUAL(store.Open(), 0);
+		for (int i = 0; i < 10; ++i)
+			store.Append("Bot", Entry("line " + std::to_string(i)));
+	}
+	LogStore store(directory.Config());
+	NOM_CHECK_EQUAL(store.Open(), 0);
+	NOM_CHECK_EQUAL(store.Append("Bot", Entry("after the restart")), 0);
+	std::vector<uint64_t> sequences = Sequences(store, "Bot");
+	NOM_CHECK_EQUAL(sequences.size(), 11u);
+	if (!sequences.empty())
+		NOM_CHECK_EQUAL(sequences.back(), 10u);
+}
+
+NOM_TEST(LogStoreNeverReusesSequencesOfAnUnreadableSegment)
+{
+	StoreDirectory directory("logstore-corrupt");
+	std::string lastSegment;
+	{
+		LogStore store(directory.Config());
+		NOM_CHECK_EQUAL(store.Open(), 0);
+		for (int i = 0; i < 10; ++i)
+			store.Append("Bot", Entry("line " + std::to_string(i)));
+	}
+	for (const auto& file : std::filesystem::directory_iterator(directory.Config().directory))
+		lastSegment = file.path().string();
+	{
+		// Breaks the header, the records behind it can't be counted any more
+		std::fstream segment(lastSegment, std::ios::in | std::ios::out | std::ios::binary);
+		segment.write("BROKEN!!", 8);
+	}
+	LogStore store(directory.Config());
+	NOM_CHECK_EQUAL(store.Open(), 0);
+	NOM_CHECK_EQUAL(store.Append("Bot", Entry("after the restart")), 0);
+	NOM_CHECK_EQUAL(store.Append("Bot", Entry("and another")), 0);
+	std::vector<uint64_t> sequences = Sequences(store, "Bot");
+	NOM_CHECK_EQUAL(sequences.size(), 2u);
+	if (sequences.size() == 2) {
+		NOM_CHECK(sequences[0] >= 10);
+		NOM_CHECK_EQUAL(sequences[1], sequences[0] + 1);
+	}
+	// A query from past the broken segment starts in the new one
+	std::vector<LogStoreRecord> records;
+	NOM_CHECK_EQUAL(store.QuerySequence("Bot", sequences.empty() ? 0 : sequences[0], 10, records), 2);
+}
@@ -0,0 +1,69 @@
+#include "LoopbackBlackhole.h"
+#include <ws2tcpip.h>
+
+namespace NomBotTests {
+	namespace {
+		bool MakeAddress(const std::string& text, int port, sockaddr_in& address)
+		{
+			address = {};
+			address.sin_family = AF_INET;
+			address.sin_port = htons(static_cast<u_short>(port));
+			return inet_pton(AF_INET, text.c_str(), &address.sin_addr) == 1;
+		}
+	}
+
+	LoopbackBlackhole::LoopbackBlackhole(const std::string& address, int port)
+		: m_Address(address), m_Port(port)
+	{
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+	}
+
+	LoopbackBlackhole::~LoopbackBlackhole()
+	{
+		for (SOCKET filler : m_Fillers)
+			closesocket(filler);
+		if (m_Listener != INVALID_SOCKET)
+			closesocket(m_Listener);
+		WSACleanup();
+	}
+
+	int LoopbackBlackhole::Start()
+	{
+		sockaddr_in address;
+		if (!MakeAddress(m_Address, m_Port, address))
+			return -1;
+		m_Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (m_Listener == INVALID_SOCKET
+			|| bind(m_Listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| listen(m_Listener, 0) != 0)
+			return -1;
+		// Every filler completes its handshake into the backlog, until one is left waiting
+		for (int i = 0; i < MaxFillers; ++i) {
+			SOCKET filler = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			if (filler == INVALID_SOCKET)
+				return -1;
+			u_long nonBlocking = 1;
+			ioctlsocket(filler, FIONBIO, &nonBlocking);
+			m_Fillers.push_back(filler);
+			if (connect(filler, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+				continue;
+			fd_set writeSet;
+			fd_set exceptSet;
+			FD_ZERO(&writeSet);
+			FD_ZERO(&exceptSet);
+			FD_SET(filler, &writeSet);
+			FD_SET(filler, &exceptSet);
+			timeval timeout = { 0, HangMs * 1000 };
+			int ready = select(static_cast<int>(filler) + 1, nullptr, &writeSet, &exceptSet, &timeout);
+			if (ready == 0)
+				return 0;
+			int soError = 0;
+			int length = sizeof(soError);
+			getsockopt(filler, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&soError), &length);
+			if (ready < 0 || soError != 0)
+				return -1; // Refused once the backlog is full, e.g. Winsock answering with a reset
+		}
+		return -1;
+	}
+}
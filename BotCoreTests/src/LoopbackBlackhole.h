@@ -0,0 +1,30 @@
+#ifndef __LOOPBACKBLACKHOLE_H__
+#define __LOOPBACKBLACKHOLE_H__
+#define WIN32_LEAN_AND_MEAN
+#include <WinSock2.h>
+#include <string>
+#include <vector>
+
+namespace NomBotTests {
+	// Makes a loopback address swallow connection attempts like a route that drops packets: a listener that never
+	// accepts, with its backlog filled until new handshakes go unanswered. All of 127.0.0.0/8 is loopback, so
+	// blackholed, refusing and live addresses can sit side by side on one port.
+	class LoopbackBlackhole {
+	public:
+		LoopbackBlackhole(const std::string& address, int port);
+		~LoopbackBlackhole();
+
+		// Returns 0 once connects to the address hang, -1 when the system refuses them instead of dropping them
+		int Start();
+	private:
+		std::string m_Address;
+		int m_Port;
+		SOCKET m_Listener = INVALID_SOCKET;
+		std::vector<SOCKET> m_Fillers;
+
+		static constexpr int MaxFillers = 64;
+		static constexpr int HangMs = 200; // A connect still pending after this counts as swallowed
+	};
+}
+
+#endif
@@ -0,0 +1,138 @@
+#include "TestRunner.h"
+#include <BotCore/TwitchAPI/TwitchAPI.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace NomBotCore;
+using namespace NomBotTests;
+
+namespace {
+	// data/raid.nomcap, recorded from MockTwitch/scripts/capture-raid.txt: chat around a raid, a wall of follows and
+	// redemptions, and 9 notifications delivered twice
+	const char* RaidCapture = "raid.nomcap";
+
+	// What reached the handlers, as "type id" so two replays can be compared whatever order the workers ran in
+	class ReplayLog {
+	public:
+		void Track(TwitchAPI& channel)
+		{
+			channel.AddEventHandler<ChannelChatMessageEvent>([this](const ChannelChatMessageEvent& event) { Add("chat", event.message_id.View()); });
+			channel.AddEventHandler<ChannelRaidEvent>([this](const ChannelRaidEvent& event) { Add("raid", event.from_broadcaster_user_id.View()); });
+			channel.AddEventHandler<ChannelFollowEvent>([this](const ChannelFollowEvent& event) { Add("follow", event.user_id.View()); });
+			channel.AddEventHandler<ChannelPointRewardRedemption>([this](const ChannelPointRewardRedemption& event) { Add("redemption", event.id.View()); });
+		}
+
+		// Sorted, and cleared for the next replay
+		std::vector<std::string> Take()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			std::vector<std::string> entries;
+			entries.swap(m_Entries);
+			std::sort(entries.begin(), entries.end());
+			return entries;
+		}
+	private:
+		void Add(const char* type, std::string_view id)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Entries.push_back(std::string(type) + " " + std::string(id));
+		}
+
+		std::mutex m_Mutex;
+		std::vector<std::string> m_Entries;
+	};
+
+	std::map<std::string, int> CountTypes(const std::vector<std::string>& entries)
+	{
+		std::map<std::string, int> counts;
+		for (const auto& entry : entries)
+			++counts[entry.substr(0, entry.find(' '))];
+		return counts;
+	}
+
+	int64_t LastFrameOffsetMicros(const std::string& path)
+	{
+		EventSubCaptureReader reader;
+		EventSubCaptureFrame frame;
+		int64_t last = 0;
+		if (reader.Open(path) != 0)
+			return -1;
+		while (reader.Next(frame) == 0)
+			last = frame.offsetMicros;
+		return last;
+	}
+}
+
+NOM_TEST(ReplayDispatchesTheRaidCapture)
+{
+	TwitchServices services;
+	TwitchAPI channel(services);
+	ReplayLog log;
+	log.Track(channel);
+	EventSubReplayStats stats;
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath(RaidCapture), 0, &stats), 0);
+	NOM_CHECK_EQUAL(stats.frames, 101u); // The welcome and 100 notifications
+	std::vector<std::string> handled = log.Take();
+	std::map<std::string, int> counts = CountTypes(handled);
+	NOM_CHECK_EQUAL(counts["chat"], 30);
+	NOM_CHECK_EQUAL(counts["raid"], 1);
+	NOM_CHECK_EQUAL(counts["follow"], 40);
+	NOM_CHECK_EQUAL(counts["redemption"], 20);
+	// Redelivered notifications are dropped by dedupe, every id arrives once
+	NOM_CHECK(std::adjacent_find(handled.begin(), handled.end()) == handled.end());
+	TwitchChannelStats channelStats = channel.GetStats();
+	NOM_CHECK_EQUAL(channelStats.notifications, 91u);
+	NOM_CHECK_EQUAL(channelStats.handled, 91u);
+
+	// The same file dispatches the same events again
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath(RaidCapture), 0, &stats), 0);
+	NOM_CHECK(log.Take() == handled);
+}
+
+NOM_TEST(ReplayKeepsTheCapturedTiming)
+{
+	int64_t lastOffsetMicros = LastFrameOffsetMicros(TestDataPath(RaidCapture));
+	NOM_CHECK(lastOffsetMicros > 1000000);
+	TwitchServices services;
+	TwitchAPI channel(services);
+	EventSubReplayStats stats;
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath(RaidCapture), 4, &stats), 0);
+	double expected = lastOffsetMicros / 4 / 1e6;
+	NOM_CHECK(stats.seconds >= expected);
+	NOM_CHECK(stats.seconds < expected + 1.0);
+}
+
+NOM_TEST(ReplayStopsWhenAsked)
+{
+	TwitchServices services;
+	TwitchAPI channel(services);
+	ReplayLog log;
+	log.Track(channel);
+	std::stop_source stopSource;
+	std::thread stopper([&stopSource]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		stopSource.request_stop();
+	});
+	// At a quarter speed the capture runs for well over ten seconds, the stop has to cut into a wait
+	EventSubReplayStats stats;
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath(RaidCapture), 0.25, &stats, stopSource.get_token()), 0);
+	stopper.join();
+	NOM_CHECK(stats.stopped);
+	NOM_CHECK(stats.frames < 101u);
+	NOM_CHECK(stats.seconds < 2.0);
+	log.Take();
+
+	// The replay still cleaned up, so the next one runs to the end
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath(RaidCapture), 0, &stats), 0);
+	NOM_CHECK(!stats.stopped);
+	NOM_CHECK_EQUAL(stats.frames, 101u);
+}
+
+NOM_TEST(ReplayRejectsAMissingCapture)
+{
+	TwitchServices services;
+	TwitchAPI channel(services);
+	NOM_CHECK_EQUAL(channel.ReplayCapture(TestDataPath("missing.nomcap"), 0), -1);
+}
@@ -0,0 +1,183 @@
+#include "StandInHttpServer.h"
+#include <ws2tcpip.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+
+namespace NomBotTests {
+	std::string StandInRequest::GetHeader(const std::string& name) const
+	{
+		size_t lineStart = head.find("\r\n");
+		while (lineStart != std::string::npos && lineStart + 2 < head.size()) {
+			lineStart += 2;
+			size_t lineEnd = head.find("\r\n", lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = head.size();
+			size_t colon = head.find(':', lineStart);
+			if (colon != std::string::npos && colon < lineEnd && colon - lineStart == name.size()
+				&& std::equal(name.begin(), name.end(), head.begin() + lineStart, [](char a, char b) { return tolower(a) == tolower(b); })) {
+				size_t valueStart = head.find_first_not_of(' ', colon + 1);
+				return valueStart < lineEnd ? head.substr(valueStart, lineEnd - valueStart) : std::string();
+			}
+			lineStart = lineEnd;
+		}
+		return std::string();
+	}
+
+	StandInHttpServer::StandInHttpServer(Handler handler)
+		: m_Handler(std::move(handler))
+	{
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+	}
+
+	StandInHttpServer::~StandInHttpServer()
+	{
+		Stop();
+		WSACleanup();
+	}
+
+	int StandInHttpServer::Start()
+	{
+		m_Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (m_Listener == INVALID_SOCKET)
+			return -1;
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = 0;
+		inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+		int length = sizeof(address);
+		if (bind(m_Listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| listen(m_Listener, SOMAXCONN) != 0
+			|| getsockname(m_Listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+			closesocket(m_Listener);
+			m_Listener = INVALID_SOCKET;
+			return -1;
+		}
+		m_Port = ntohs(address.sin_port);
+		m_Running = true;
+		m_AcceptThread = std::thread(&StandInHttpServer::AcceptLoop, this);
+		return 0;
+	}
+
+	void StandInHttpServer::Stop()
+	{
+		if (!m_Running.exchange(false))
+			return;
+		m_AcceptThread.join();
+		closesocket(m_Listener);
+		m_Listener = INVALID_SOCKET;
+		std::lock_guard<std::mutex> lock(m_ThreadMutex);
+		for (auto& thread : m_ConnectionThreads)
+			thread.join();
+		m_ConnectionThreads.clear();
+	}
+
+	std::string StandInHttpServer::Response(int status, const std::string& body, const std::string& extraHeaders)
+	{
+		const char* reason = status == 200 ? "OK" : status == 404 ? "Not Found" : status == 429 ? "Too Many Requests" : "Status";
+		return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n"
+			+ extraHeaders + "\r\n" + body;
+	}
+
+	bool StandInHttpServer::WaitReadable(SOCKET socket, bool& readable)
+	{
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(socket, &readSet);
+		timeval timeout = { 0, PollMs * 1000 };
+		readable = select(static_cast<int>(socket) + 1, &readSet, nullptr, nullptr, &timeout) > 0;
+		return m_Running;
+	}
+
+	void StandInHttpServer::AcceptLoop()
+	{
+		bool readable = false;
+		while (WaitReadable(m_Listener, readable)) {
+			if (!readable)
+				continue;
+			SOCKET client = accept(m_Listener, nullptr, nullptr);
+			if (client == INVALID_SOCKET)
+				continue;
+			int connection = ++m_Connections;
+			std::lock_guard<std::mutex> lock(m_ThreadMutex);
+			m_ConnectionThreads.emplace_back(&StandInHttpServer::ServeConnection, this, client, connection);
+		}
+	}
+
+	void StandInHttpServer::ServeConnection(SOCKET socket, int connection)
+	{
+		std::string buffer;
+		char chunk[4096];
+		bool open = true;
+		while (open) {
+			size_t headEnd = buffer.find("\r\n\r\n");
+			if (headEnd == std::string::npos) {
+				bool readable = false;
+				if (!WaitReadable(socket, readable))
+					break;
+				if (!readable)
+					continue;
+				int received = recv(socket, chunk, sizeof(chunk), 0);
+				if (received <= 0)
+					break;
+				buffer.append(chunk, received);
+				continue;
+			}
+			StandInRequest request;
+			request.head = buffer.substr(0, headEnd + 2);
+			request.connection = connection;
+			size_t methodEnd = request.head.find(' ');
+			size_t pathEnd = request.head.find(' ', methodEnd + 1);
+			request.method = request.head.substr(0, methodEnd);
+			request.path = request.head.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+			size_t bodyLength = static_cast<size_t>(atoi(request.GetHeader("Content-Length").c_str()));
+			while (buffer.size() < headEnd + 4 + bodyLength && open) {
+				bool readable = false;
+				if (!WaitReadable(socket, readable)) {
+					open = false;
+					break;
+				}
+				int received = readable ? recv(socket, chunk, sizeof(chunk), 0) : 0;
+				if (readable && received <= 0)
+					open = false;
+				else if (received > 0)
+					buffer.append(chunk, received);
+			}
+			if (!open)
+				break;
+			request.body = buffer.substr(headEnd + 4, bodyLength);
+			buffer.erase(0, headEnd + 4 + bodyLength);
+			++m_Requests;
+
+			StandInReply reply;
+			m_Handler(request, reply);
+			if (reply.hang) {
+				// Until the client gives up and closes its end
+				bool readable = false;
+				while (WaitReadable(socket, readable)) {
+					if (readable && recv(socket, chunk, sizeof(chunk), 0) <= 0)
+						break;
+				}
+				break;
+			}
+			for (size_t i = 0; i < reply.pieces.size() && open; ++i) {
+				if (i > 0 && reply.pieceDelayMs > 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(reply.pieceDelayMs));
+				size_t sent = 0;
+				while (sent < reply.pieces[i].size()) {
+					int bytes = send(socket, reply.pieces[i].data() + sent, static_cast<int>(reply.pieces[i].size() - sent), 0);
+					if (bytes <= 0) {
+						open = false;
+						break;
+					}
+					sent += bytes;
+				}
+			}
+			if (reply.closeAfter)
+				break;
+		}
+		closesocket(socket);
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef __STANDINHTTPSERVER_H__
+#define __STANDINHTTPSERVER_H__
+#define WIN32_LEAN_AND_MEAN
+#include <WinSock2.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace NomBotTests {
+	struct StandInRequest {
+		std::string method;
+		std::string path;
+		std::string head; // Request line and headers as they arrived
+		std::string body;
+		int connection = 0; // Which accepted connection it came in on, counting from 1
+
+		// Case insensitive, empty when missing
+		std::string GetHeader(const std::string& name) const;
+	};
+
+	struct StandInReply {
+		std::vector<std::string> pieces; // Sent in order, pieceDelayMs apart
+		int pieceDelayMs = 0;
+		bool closeAfter = false; // Closes the connection once sent, whatever the headers promised
+		bool hang = false; // Sends nothing and holds the connection open until the client or Stop closes it
+	};
+
+	// Plain HTTP/1.1 on a free loopback port, one thread per connection. It is written against Winsock directly
+	// so nothing under test serves its own requests. The handler picks the exact bytes and their timing, so tests
+	// can split, delay or cut a response anywhere.
+	class StandInHttpServer {
+	public:
+		using Handler = std::function<void(const StandInRequest&, StandInReply&)>;
+
+		explicit StandInHttpServer(Handler handler);
+		~StandInHttpServer();
+
+		int Start();
+		void Stop();
+		int GetPort() const { return m_Port; }
+		int GetConnectionCount() const { return m_Connections.load(); }
+		int GetRequestCount() const { return m_Requests.load(); }
+
+		// A complete response with Content-Length, extraHeaders end in \r\n each
+		static std::string Response(int status, const std::string& body, const std::string& extraHeaders = "");
+	private:
+		void AcceptLoop();
+		void ServeConnection(SOCKET socket, int connection);
+		// Waits up to PollMs for socket to be readable, false once the server stops
+		bool WaitReadable(SOCKET socket, bool& readable);
+
+		Handler m_Handler;
+		SOCKET m_Listener = INVALID_SOCKET;
+		int m_Port = 0;
+		std::atomic<bool> m_Running{ false };
+		std::atomic<int> m_Connections{ 0 };
+		std::atomic<int> m_Requests{ 0 };
+		std::thread m_AcceptThread;
+		std::mutex m_ThreadMutex;
+		std::vector<std::thread> m_ConnectionThreads;
+
+		static constexpr int PollMs = 20;
+	};
+}
+
+#endif
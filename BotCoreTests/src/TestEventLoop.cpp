@@ -0,0 +1,94 @@
+#include "TestEventLoop.h"
+#include <algorithm>
+
+namespace NomBotTests {
+	using namespace NomBotCore;
+
+	TestEventLoop::TestEventLoop(NomSocketManager& socketManager)
+		: m_SocketManager(socketManager)
+	{
+		m_Thread = std::thread(&TestEventLoop::ThreadFunc, this);
+	}
+
+	TestEventLoop::~TestEventLoop()
+	{
+		Stop();
+	}
+
+	void TestEventLoop::Stop()
+	{
+		if (!m_Running.exchange(false))
+			return;
+		m_Thread.join();
+		std::vector<Waiter> waiters;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			waiters.swap(m_Waiters);
+		}
+		for (auto& waiter : waiters) {
+			*waiter.result = -1;
+			waiter.handle.resume();
+		}
+	}
+
+	bool TestEventLoop::AddSocketWait(std::vector<SocketWait> sockets, int timeoutMs, std::coroutine_handle<> handle, int* result)
+	{
+		*result = -1;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_Running)
+			return false;
+		m_Waiters.push_back({ std::move(sockets), std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs), handle, result });
+		return true;
+	}
+
+	void TestEventLoop::ThreadFunc()
+	{
+		std::vector<SocketWait> raw;
+		std::vector<size_t> owners; // Index into m_Waiters for every entry of raw
+		std::vector<std::string> names;
+		std::vector<std::string> ready;
+		std::vector<size_t> rawReady;
+		std::vector<Waiter> resumed;
+		while (m_Running) {
+			raw.clear();
+			owners.clear();
+			ready.clear();
+			rawReady.clear();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				for (size_t i = 0; i < m_Waiters.size(); ++i) {
+					for (const auto& wait : m_Waiters[i].sockets) {
+						raw.push_back(wait);
+						owners.push_back(i);
+					}
+				}
+			}
+			// Waiters only ever get appended outside this thread, so the indices in owners still hold afterwards
+			m_SocketManager.WaitSockets(names, raw, PollMs, ready, rawReady);
+			auto now = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				// A waiter's result counts from its own first socket
+				std::vector<int> results(m_Waiters.size(), 0);
+				std::vector<size_t> firstRaw(m_Waiters.size(), 0);
+				for (size_t i = owners.size(); i-- > 0;)
+					firstRaw[owners[i]] = i;
+				for (size_t index : rawReady) {
+					int& result = results[owners[index]];
+					if (result == 0)
+						result = static_cast<int>(index - firstRaw[owners[index]]) + 1;
+				}
+				for (size_t i = m_Waiters.size(); i-- > 0;) {
+					if (results[i] == 0 && m_Waiters[i].deadline > now)
+						continue;
+					*m_Waiters[i].result = results[i];
+					resumed.push_back(std::move(m_Waiters[i]));
+					m_Waiters.erase(m_Waiters.begin() + i);
+				}
+			}
+			for (auto& waiter : resumed)
+				waiter.handle.resume();
+			resumed.clear();
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef __TESTEVENTLOOP_H__
+#define __TESTEVENTLOOP_H__
+#include <BotCore/Networking/NomSocketManager.h>
+#include <BotCore/Networking/SocketEventLoop.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NomBotTests {
+	// What TwitchServices' reader does for socket waits, without the EventSub sessions around it. Coroutines under
+	// test resume on its thread.
+	class TestEventLoop : public NomBotCore::SocketEventLoop {
+	public:
+		explicit TestEventLoop(NomBotCore::NomSocketManager& socketManager);
+		~TestEventLoop() override;
+
+		// Resumes every pending wait with -1 and refuses new ones
+		void Stop();
+		bool AddSocketWait(std::vector<NomBotCore::SocketWait> sockets, int timeoutMs, std::coroutine_handle<> handle, int* result) override;
+	private:
+		struct Waiter {
+			std::vector<NomBotCore::SocketWait> sockets;
+			std::chrono::steady_clock::time_point deadline;
+			std::coroutine_handle<> handle;
+			int* result;
+		};
+
+		void ThreadFunc();
+
+		NomBotCore::NomSocketManager& m_SocketManager;
+		std::mutex m_Mutex;
+		std::vector<Waiter> m_Waiters;
+		std::atomic<bool> m_Running{ true };
+		std::thread m_Thread;
+
+		static constexpr int PollMs = 10; // A wait added during a select is picked up after this
+	};
+}
+
+#endif
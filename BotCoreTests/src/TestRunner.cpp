@@ -0,0 +1,78 @@
+#include "TestRunner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// BotCoreTests [name ...]
+// Runs every test whose name contains one of the arguments, or all of them, and exits with 1 if any check failed.
+// Checked in captures are read from data/ under the working directory, or from NOM_TEST_DATA when set.
+namespace NomBotTests {
+	namespace {
+		int s_Failures = 0;
+		std::string s_SkipReason;
+	}
+
+	std::vector<TestCase>& TestCases()
+	{
+		static std::vector<TestCase> cases;
+		return cases;
+	}
+
+	void ReportFailure(const char* file, int line, const std::string& what)
+	{
+		printf("  %s:%d: %s\n", file, line, what.c_str());
+		++s_Failures;
+	}
+
+	void SkipTest(const std::string& reason)
+	{
+		s_SkipReason = reason;
+	}
+
+	std::string TestDataPath(const std::string& name)
+	{
+		char* dataDir = nullptr;
+		size_t dataDirLen = 0;
+		std::string path = "data/";
+		if (_dupenv_s(&dataDir, &dataDirLen, "NOM_TEST_DATA") == 0 && dataDir != nullptr) {
+			path = std::string(dataDir) + "/";
+			free(dataDir);
+		}
+		return path + name;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<const char*> filters(argv + 1, argv + argc);
+	int passed = 0;
+	int failed = 0;
+	int skipped = 0;
+	for (const auto& test : NomBotTests::TestCases()) {
+		bool selected = filters.empty();
+		for (const char* filter : filters)
+			selected = selected || strstr(test.name, filter) != nullptr;
+		if (!selected)
+			continue;
+		int failuresBefore = NomBotTests::s_Failures;
+		NomBotTests::s_SkipReason.clear();
+		auto start = std::chrono::steady_clock::now();
+		test.run();
+		long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (NomBotTests::s_Failures != failuresBefore) {
+			printf("[FAIL] %s (%lld ms)\n", test.name, ms);
+			++failed;
+		}
+		else if (!NomBotTests::s_SkipReason.empty()) {
+			printf("[SKIP] %s: %s\n", test.name, NomBotTests::s_SkipReason.c_str());
+			++skipped;
+		}
+		else {
+			printf("[ OK ] %s (%lld ms)\n", test.name, ms);
+			++passed;
+		}
+	}
+	printf("%d passed, %d failed, %d skipped\n", passed, failed, skipped);
+	return failed == 0 ? 0 : 1;
+}
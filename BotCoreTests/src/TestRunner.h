@@ -0,0 +1,47 @@
+#ifndef __TESTRUNNER_H__
+#define __TESTRUNNER_H__
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace NomBotTests {
+	struct TestCase {
+		const char* name;
+		void (*run)();
+	};
+
+	std::vector<TestCase>& TestCases();
+	// Records the failure and lets the test carry on, so one run reports every broken check
+	void ReportFailure(const char* file, int line, const std::string& what);
+	// Ends up in the summary instead of a pass, e.g. when the machine can't simulate what the test needs
+	void SkipTest(const std::string& reason);
+	// Files checked in under BotCoreTests/data, found through NOM_TEST_DATA or the working directory
+	std::string TestDataPath(const std::string& name);
+
+	struct TestRegistration {
+		TestRegistration(const char* name, void (*run)()) { TestCases().push_back({ name, run }); }
+	};
+
+	template<typename Actual, typename Expected>
+	void CheckEqual(const Actual& actual, const Expected& expected, const char* actualText, const char* expectedText, const char* file, int line)
+	{
+		if (actual == expected)
+			return;
+		std::ostringstream what;
+		what << actualText << " == " << expectedText << ", got " << actual << " instead of " << expected;
+		ReportFailure(file, line, what.str());
+	}
+}
+
+// NOM_TEST(HttpClientReusesConnections) { ... } registers a test under that name
+#define NOM_TEST(Name) \
+	static void Name(); \
+	static NomBotTests::TestRegistration Name##Registration(#Name, &Name); \
+	static void Name()
+
+#define NOM_CHECK(Condition) \
+	do { if (!(Condition)) NomBotTests::ReportFailure(__FILE__, __LINE__, #Condition); } while (0)
+
+#define NOM_CHECK_EQUAL(Actual, Expected) NomBotTests::CheckEqual((Actual), (Expected), #Actual, #Expected, __FILE__, __LINE__)
+
+#endif
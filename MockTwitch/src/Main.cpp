@@ -0,0 +1,238 @@
+#include "MockTwitchServer.h"
+#include <BotCore/Core/Core.h>
+#include <BotCore/Core/Logging/LogFileSink.h>
+#include <BotCore/Core/Metrics/Metrics.h>
+#include <BotCore/Core/Tracing/Trace.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// MockTwitch [--port N] [--soak] [--channels N] [--latency ms] <script>
+// Serves the scenario until it ends. With --soak the bot runs in this process against the mock, subscribed to
+// every type the script sends, and the run ends with delivery counts and end-to-end latency. --channels hosts
+// that many channels in the bot, the mock spreads the notifications over them. --latency holds every HTTP answer
+// back, so sign ins and subscription calls take about as long as against Twitch. Exits with 1 when an expect in the
+// script fails, or with --soak when a notification went unhandled or a channel ended without a session.
+namespace {
+	struct SoakResults {
+		std::mutex mutex;
+		std::vector<int64_t> latenciesUs;
+	};
+
+	int64_t NowMicros()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	template<typename Event>
+	void AddLatencyHandler(NomBotCore::BotCore& botCore, SoakResults& results)
+	{
+		botCore.AddEventHandler<Event>([&results](const Event& event) {
+			int64_t handledAt = NowMicros();
+			if (!event.raw)
+				return;
+			auto sent = event.raw->objectValues.find("mock_sent_us");
+			if (sent == event.raw->objectValues.end() || !sent->second)
+				return;
+			std::lock_guard<std::mutex> lock(results.mutex);
+			results.latenciesUs.push_back(handledAt - static_cast<int64_t>(sent->second->numberValue));
+		});
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double fraction)
+	{
+		if (sorted.empty())
+			return 0;
+		size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+		return sorted[index];
+	}
+
+	std::map<std::string, double> ServerResults(const NomMockTwitch::MockServerStats& stats)
+	{
+		return {
+			{ "sent", static_cast<double>(stats.notificationsSent.load()) },
+			{ "duplicates", static_cast<double>(stats.duplicatesSent.load()) },
+			{ "unsubscribed", static_cast<double>(stats.notificationsUnsubscribed.load()) },
+			{ "helix", static_cast<double>(stats.helixRequests.load()) },
+			{ "ratelimited", static_cast<double>(stats.rateLimited.load()) },
+			{ "subscriptions", static_cast<double>(stats.subscriptionsCreated.load()) },
+			{ "sessions", static_cast<double>(stats.webSocketSessions.load()) },
+		};
+	}
+
+	std::set<NomBotCore::EventSubType> ScenarioTypes(const NomMockTwitch::MockScenario& scenario)
+	{
+		std::set<NomBotCore::EventSubType> types;
+		for (const auto& command : scenario.commands) {
+			if (command.eventType != NomBotCore::EventSubType::Unknown)
+				types.insert(command.eventType);
+		}
+		return types;
+	}
+
+	int RunSoak(NomMockTwitch::MockTwitchServer& server, const NomMockTwitch::MockScenario& scenario, const NomMockTwitch::MockServerConfig& config, int channelCount)
+	{
+		// Everything TwitchAPI would ask the user or the environment for points at the mock
+		std::string endpoint = config.address + ":" + std::to_string(config.port);
+		_putenv_s("NOM_TWITCH_ENDPOINT", endpoint.c_str());
+		_putenv_s("NOM_AUTH_CODE", "mock-code");
+		_putenv_s("CLIENT_ID", "mock-client");
+		_putenv_s("CLIENT_SECRET", "mock-secret");
+
+		SoakResults results;
+		uint64_t handled = 0;
+		bool lostSession = false;
+		{
+			NomBotCore::BotCore botCore;
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) AddLatencyHandler<NomBotCore::Struct>(botCore, results);
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include <BotCore/TwitchAPI/EventSubEventList.h>
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+			// The mock takes any refresh token, hosted channels differ only by name
+			for (int i = 1; i < channelCount; ++i)
+				botCore.AddChannel({ "hosted-" + std::to_string(i), "mock-refresh-" + std::to_string(i) });
+			for (NomBotCore::TwitchAPI* channel : botCore.GetChannels()) {
+				for (auto type : ScenarioTypes(scenario))
+					channel->AddEventSubSubscription(type);
+			}
+
+			botCore.StartTwitchAPI();
+			// EnableWebSocket refuses until the token exchange is done
+			auto startedAt = std::chrono::steady_clock::now();
+			auto deadline = startedAt + std::chrono::seconds(30);
+			size_t connected = 0;
+			while (connected < static_cast<size_t>(channelCount) && std::chrono::steady_clock::now() < deadline) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				connected = 0;
+				for (NomBotCore::TwitchAPI* channel : botCore.GetChannels()) {
+					if (channel->IsStarted() && !channel->IsWebSocketEnabled())
+						channel->EnableWebSocket(true);
+					connected += channel->IsWebSocketEnabled() ? 1 : 0;
+				}
+			}
+			if (connected < static_cast<size_t>(channelCount)) {
+				printf("Only %zu of %d channels connected to the mock, see Logs/ for why\n", connected, channelCount);
+				server.Stop();
+				return 1;
+			}
+			printf("%d channels connected after %lld ms\n", channelCount,
+				static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startedAt).count()));
+			while (!server.IsScenarioDone())
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			// Lets the reader and the workers catch up with the tail of the scenario
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+			// A dropped or stalled session must have been replaced by now
+			for (NomBotCore::TwitchAPI* channel : botCore.GetChannels()) {
+				if (!channel->IsWebSocketEnabled()) {
+					printf("Channel %s has no WebSocket session at the end of the scenario\n", channel->GetName().c_str());
+					lostSession = true;
+				}
+			}
+			if (channelCount > 1) {
+				uint64_t fewest = UINT64_MAX;
+				uint64_t most = 0;
+				for (NomBotCore::TwitchAPI* channel : botCore.GetChannels()) {
+					uint64_t handledHere = channel->GetStats().handled;
+					fewest = std::min(fewest, handledHere);
+					most = std::max(most, handledHere);
+				}
+				printf("%d channels, %llu to %llu notifications handled each\n", channelCount,
+					static_cast<unsigned long long>(fewest), static_cast<unsigned long long>(most));
+			}
+			botCore.StopTwitchAPI();
+			server.Stop();
+		}
+
+		std::vector<int64_t> latencies;
+		{
+			std::lock_guard<std::mutex> lock(results.mutex);
+			latencies = results.latenciesUs;
+		}
+		handled = latencies.size();
+		std::sort(latencies.begin(), latencies.end());
+		const NomMockTwitch::MockServerStats& stats = server.GetStats();
+		uint64_t duplicatesSkipped = NomBotCore::MetricsRegistry::GetCounter("nom_eventsub_duplicates_total",
+			"EventSub notifications skipped because their message_id was already handled.")->Read();
+		uint64_t dropped = NomBotCore::MetricsRegistry::GetCounter("nom_eventsub_events_dropped_total",
+			"EventSub notifications dropped because their worker queue was full.")->Read();
+		printf("sent %llu (+%llu duplicates), handled %llu, duplicates skipped %llu, dropped %llu\n",
+			static_cast<unsigned long long>(stats.notificationsSent.load()), static_cast<unsigned long long>(stats.duplicatesSent.load()),
+			static_cast<unsigned long long>(handled), static_cast<unsigned long long>(duplicatesSkipped), static_cast<unsigned long long>(dropped));
+		printf("latency p50 %lld us, p99 %lld us, max %lld us\n", static_cast<long long>(Percentile(latencies, 0.5)),
+			static_cast<long long>(Percentile(latencies, 0.99)), static_cast<long long>(latencies.empty() ? 0 : latencies.back()));
+		std::map<std::string, double> measured = ServerResults(stats);
+		measured["handled"] = static_cast<double>(handled);
+		measured["skipped"] = static_cast<double>(duplicatesSkipped);
+		measured["dropped"] = static_cast<double>(dropped);
+		measured["p99_ms"] = Percentile(latencies, 0.99) / 1000.0;
+		int failedExpectations = scenario.CheckExpectations(measured);
+		return handled == stats.notificationsSent.load() && !lostSession && failedExpectations == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	NomMockTwitch::MockServerConfig config;
+	bool soak = false;
+	int channelCount = 1;
+	const char* scriptPath = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+			config.port = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--soak") == 0)
+			soak = true;
+		else if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc)
+			channelCount = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+			config.responseDelayMs = std::max(0, atoi(argv[++i]));
+		else
+			scriptPath = argv[i];
+	}
+	if (!scriptPath) {
+		printf("Usage: MockTwitch [--port N] [--soak] [--channels N] [--latency ms] <script>\n");
+		return 1;
+	}
+	NomBotCore::LogFileSink logSink;
+	logSink.Start();
+	NomBotCore::Trace::SetThreadName("Main");
+
+	NomMockTwitch::MockScenario scenario;
+	std::string error;
+	if (scenario.Load(scriptPath, error) != 0) {
+		printf("%s\n", error.c_str());
+		return 1;
+	}
+	if (soak) {
+		// Every channel holds AutomodMessageHold on top of whatever the script sends
+		std::set<NomBotCore::EventSubType> types = ScenarioTypes(scenario);
+		types.insert(NomBotCore::EventSubType::AutomodMessageHold);
+		config.waitForSubscriptions = types.size() * channelCount;
+	}
+	NomMockTwitch::MockTwitchServer server(config);
+	if (server.Start(scenario) != 0) {
+		printf("Could not listen on %s:%d\n", config.address.c_str(), config.port);
+		return 1;
+	}
+	printf("Mock Twitch on http://%s:%d, set NOM_TWITCH_ENDPOINT=%s:%d to point the bot at it\n",
+		config.address.c_str(), config.port, config.address.c_str(), config.port);
+	if (soak)
+		return RunSoak(server, scenario, config, channelCount);
+
+	while (!server.IsScenarioDone())
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	server.Stop();
+	const NomMockTwitch::MockServerStats& stats = server.GetStats();
+	printf("sent %llu (+%llu duplicates), %llu without a subscriber, %llu Helix requests (%llu rate limited), %llu sessions\n",
+		static_cast<unsigned long long>(stats.notificationsSent.load()), static_cast<unsigned long long>(stats.duplicatesSent.load()),
+		static_cast<unsigned long long>(stats.notificationsUnsubscribed.load()), static_cast<unsigned long long>(stats.helixRequests.load()),
+		static_cast<unsigned long long>(stats.rateLimited.load()), static_cast<unsigned long long>(stats.webSocketSessions.load()));
+	return scenario.CheckExpectations(ServerResults(stats)) == 0 ? 0 : 1;
+}
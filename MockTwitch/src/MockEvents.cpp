@@ -0,0 +1,187 @@
+#include "MockEvents.h"
+#include <chrono>
+#include <ctime>
+#include <map>
+#include <cstring>
+
+namespace NomMockTwitch {
+	using NomBotCore::EventSubType;
+	// EventSubEventList.h names its field types unqualified
+	using NomBotCore::InternedString;
+	using NomBotCore::EventSubText;
+	using NomBotCore::EventSubTime;
+
+	namespace {
+		enum class FieldKind {
+			String,
+			Integer,
+			Number,
+			Boolean
+		};
+
+		template<typename T> constexpr FieldKind KindOf();
+		template<> constexpr FieldKind KindOf<std::string>() { return FieldKind::String; }
+		template<> constexpr FieldKind KindOf<InternedString>() { return FieldKind::String; }
+		template<> constexpr FieldKind KindOf<EventSubText>() { return FieldKind::String; }
+		template<> constexpr FieldKind KindOf<EventSubTime>() { return FieldKind::String; }
+		template<> constexpr FieldKind KindOf<int64_t>() { return FieldKind::Integer; }
+		template<> constexpr FieldKind KindOf<double>() { return FieldKind::Number; }
+		template<> constexpr FieldKind KindOf<bool>() { return FieldKind::Boolean; }
+
+		struct MockField {
+			const char* path;
+			FieldKind kind;
+		};
+
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) const MockField Id##Fields[] = {
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path) { Path, KindOf<FieldType>() },
+#define NOM_EVENTSUB_END(Struct) { nullptr, FieldKind::String } };
+#include <BotCore/TwitchAPI/EventSubEventList.h>
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+
+		const MockField* g_Fields[NomBotCore::EventSubTypeCount] = {
+#define NOM_EVENTSUB_EVENT(Id, Struct, Type, Version, Condition, Scope) Id##Fields,
+#define NOM_EVENTSUB_FIELD(FieldType, Member, Path)
+#define NOM_EVENTSUB_END(Struct)
+#include <BotCore/TwitchAPI/EventSubEventList.h>
+#undef NOM_EVENTSUB_EVENT
+#undef NOM_EVENTSUB_FIELD
+#undef NOM_EVENTSUB_END
+		};
+
+		// Nested objects from the dotted paths, values are already JSON
+		struct JsonNode {
+			std::string value;
+			std::map<std::string, JsonNode> children;
+		};
+
+		void AppendString(std::string& out, const std::string& text)
+		{
+			out += '"';
+			for (char c : text) {
+				if (c == '"' || c == '\\')
+					out += '\\';
+				out += c;
+			}
+			out += '"';
+		}
+
+		void AppendNode(std::string& out, const JsonNode& node)
+		{
+			if (node.children.empty()) {
+				out += node.value;
+				return;
+			}
+			out += '{';
+			bool first = true;
+			for (const auto& [key, child] : node.children) {
+				if (!first)
+					out += ',';
+				first = false;
+				AppendString(out, key);
+				out += ':';
+				AppendNode(out, child);
+			}
+			out += '}';
+		}
+
+		bool EndsWith(const std::string& text, const char* suffix)
+		{
+			size_t length = strlen(suffix);
+			return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+		}
+
+		bool StartsWith(const std::string& text, const char* prefix)
+		{
+			return text.compare(0, strlen(prefix), prefix) == 0;
+		}
+
+		// Twitch sends these as numbers even where the bot reads them into strings
+		bool IsCount(const std::string& name)
+		{
+			return name == "cost" || name == "bits" || name == "viewers" || name == "total" || name == "level";
+		}
+
+		std::string MockValue(const std::string& path, FieldKind kind, uint64_t seq, const MockEventContext& context)
+		{
+			size_t dot = path.rfind('.');
+			std::string name = dot == std::string::npos ? path : path.substr(dot + 1);
+			std::string parent = dot == std::string::npos ? "" : path.substr(0, dot);
+			// Spreads seq over the viewers, consecutive events come from different ones
+			uint64_t viewer = (seq * 2654435761ull) % static_cast<uint64_t>(context.users > 0 ? context.users : 1);
+			std::string json;
+			if (StartsWith(name, "broadcaster_user") || StartsWith(name, "to_broadcaster_user") || StartsWith(name, "moderator_user")) {
+				if (EndsWith(name, "_id"))
+					AppendString(json, context.channelId);
+				else
+					AppendString(json, context.channelLogin);
+			}
+			else if (EndsWith(name, "user_id")) {
+				AppendString(json, std::to_string(100000 + viewer));
+			}
+			else if (EndsWith(name, "user_login") || EndsWith(name, "user_name")) {
+				AppendString(json, "viewer" + std::to_string(viewer));
+			}
+			else if (kind == FieldKind::Integer || IsCount(name)) {
+				json = std::to_string(seq % 1000 + 1);
+			}
+			else if (kind == FieldKind::Number) {
+				json = "1.5";
+			}
+			else if (kind == FieldKind::Boolean) {
+				json = "false";
+			}
+			else if (EndsWith(name, "_at")) {
+				AppendString(json, MockTimestamp());
+			}
+			else if (name == "id" && !parent.empty()) {
+				// A handful of rewards, polls and the like, so per reward ordering has something to order
+				AppendString(json, parent + "-" + std::to_string(seq % 4));
+			}
+			else if (name == "id") {
+				AppendString(json, "mock-" + std::to_string(seq));
+			}
+			else {
+				AppendString(json, name + " " + std::to_string(seq));
+			}
+			return json;
+		}
+	}
+
+	std::string MockTimestamp()
+	{
+		std::time_t now = std::time(nullptr);
+		std::tm utc = {};
+		gmtime_s(&utc, &now);
+		char text[32];
+		std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+		return text;
+	}
+
+	std::string BuildMockEvent(EventSubType type, uint64_t seq, const MockEventContext& context)
+	{
+		int index = static_cast<int>(type);
+		if (index < 0 || index >= NomBotCore::EventSubTypeCount)
+			return "{}";
+		JsonNode root;
+		for (const MockField* field = g_Fields[index]; field->path; ++field) {
+			JsonNode* node = &root;
+			std::string path = field->path;
+			size_t start = 0;
+			size_t dot;
+			while ((dot = path.find('.', start)) != std::string::npos) {
+				node = &node->children[path.substr(start, dot - start)];
+				start = dot + 1;
+			}
+			node->children[path.substr(start)].value = MockValue(path, field->kind, seq, context);
+		}
+		int64_t sentAt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		root.children["mock_sent_us"].value = std::to_string(sentAt);
+		std::string json;
+		json.reserve(512);
+		AppendNode(json, root);
+		return json;
+	}
+}
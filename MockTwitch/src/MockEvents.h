@@ -0,0 +1,22 @@
+#ifndef __MOCKEVENTS_H__
+#define __MOCKEVENTS_H__
+#include <BotCore/TwitchAPI/EventSubEvents.h>
+#include <string>
+#include <cstdint>
+
+namespace NomMockTwitch {
+	struct MockEventContext {
+		std::string channelId;
+		std::string channelLogin;
+		int users = 1000;
+	};
+
+	// Builds a payload.event object carrying every field EventSubEventList.h declares for type. The broadcaster
+	// fields name the mock channel, other user fields one of context.users viewers picked from seq, and
+	// "mock_sent_us" holds the steady clock send time for measuring end-to-end latency in process.
+	std::string BuildMockEvent(NomBotCore::EventSubType type, uint64_t seq, const MockEventContext& context);
+	// Current UTC time the way Twitch formats it in metadata and _at fields
+	std::string MockTimestamp();
+}
+
+#endif
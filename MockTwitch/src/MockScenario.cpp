@@ -0,0 +1,137 @@
+#include "MockScenario.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <set>
+
+namespace NomMockTwitch {
+	namespace {
+		struct CommandSpec {
+			MockCommandType type;
+			bool takesEventType;
+			bool takesValue;
+		};
+
+		const std::map<std::string, CommandSpec>& CommandSpecs()
+		{
+			static const std::map<std::string, CommandSpec> specs = {
+				{ "rate", { MockCommandType::Rate, true, true } },
+				{ "burst", { MockCommandType::Burst, true, true } },
+				{ "wait", { MockCommandType::Wait, false, true } },
+				{ "users", { MockCommandType::Users, false, true } },
+				{ "duplicates", { MockCommandType::Duplicates, false, true } },
+				{ "keepalive", { MockCommandType::Keepalive, false, true } },
+				{ "ratelimit", { MockCommandType::RateLimit, false, true } },
+				{ "reconnect", { MockCommandType::Reconnect, false, false } },
+				{ "disconnect", { MockCommandType::Disconnect, false, false } },
+				{ "stall", { MockCommandType::Stall, false, false } },
+				{ "split", { MockCommandType::Split, false, true } },
+				{ "revoke", { MockCommandType::Revoke, true, false } },
+				{ "tokenexpiry", { MockCommandType::TokenExpiry, false, true } },
+				{ "expect", { MockCommandType::Expect, false, false } },
+				{ "exit", { MockCommandType::Exit, false, false } },
+			};
+			return specs;
+		}
+
+		const std::set<std::string>& ExpectStats()
+		{
+			static const std::set<std::string> stats = {
+				"sent", "duplicates", "unsubscribed", "helix", "ratelimited", "subscriptions", "sessions",
+				"handled", "skipped", "dropped", "p99_ms",
+			};
+			return stats;
+		}
+	}
+
+	int MockScenario::Load(const std::string& path, std::string& error)
+	{
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			error = "Could not open " + path;
+			return -1;
+		}
+		std::stringstream text;
+		text << file.rdbuf();
+		return Parse(text.str(), error);
+	}
+
+	int MockScenario::Parse(const std::string& text, std::string& error)
+	{
+		commands.clear();
+		std::istringstream lines(text);
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(lines, line)) {
+			++lineNumber;
+			size_t comment = line.find('#');
+			if (comment != std::string::npos)
+				line.erase(comment);
+			std::istringstream fields(line);
+			std::string name;
+			if (!(fields >> name))
+				continue;
+			auto spec = CommandSpecs().find(name);
+			if (spec == CommandSpecs().end()) {
+				error = "Line " + std::to_string(lineNumber) + ": unknown command " + name;
+				return -1;
+			}
+			MockCommand command;
+			command.type = spec->second.type;
+			command.line = lineNumber;
+			if (spec->second.takesEventType) {
+				std::string eventType;
+				fields >> eventType;
+				command.eventType = NomBotCore::FindEventSubType(eventType);
+				if (command.eventType == NomBotCore::EventSubType::Unknown) {
+					error = "Line " + std::to_string(lineNumber) + ": unknown event type " + eventType;
+					return -1;
+				}
+			}
+			if (command.type == MockCommandType::Expect) {
+				if (!(fields >> command.stat >> command.comparison >> command.value)) {
+					error = "Line " + std::to_string(lineNumber) + ": expect needs a stat, a comparison and a number";
+					return -1;
+				}
+				if (ExpectStats().count(command.stat) == 0) {
+					error = "Line " + std::to_string(lineNumber) + ": unknown stat " + command.stat;
+					return -1;
+				}
+				if (command.comparison != ">=" && command.comparison != "<=" && command.comparison != "==") {
+					error = "Line " + std::to_string(lineNumber) + ": expect compares with >=, <= or ==, not " + command.comparison;
+					return -1;
+				}
+			}
+			if (spec->second.takesValue && !(fields >> command.value)) {
+				error = "Line " + std::to_string(lineNumber) + ": " + name + " needs a number";
+				return -1;
+			}
+			commands.push_back(command);
+		}
+		return 0;
+	}
+
+	int MockScenario::CheckExpectations(const std::map<std::string, double>& results) const
+	{
+		int failed = 0;
+		for (const auto& command : commands) {
+			if (command.type != MockCommandType::Expect)
+				continue;
+			auto result = results.find(command.stat);
+			if (result == results.end()) {
+				printf("Line %d: expect %s failed, it is only measured with --soak\n", command.line, command.stat.c_str());
+				++failed;
+				continue;
+			}
+			bool passed = command.comparison == ">=" ? result->second >= command.value
+				: command.comparison == "<=" ? result->second <= command.value
+				: result->second == command.value;
+			if (!passed) {
+				printf("Line %d: expect %s %s %g failed, it was %g\n", command.line, command.stat.c_str(), command.comparison.c_str(), command.value, result->second);
+				++failed;
+			}
+		}
+		return failed;
+	}
+}
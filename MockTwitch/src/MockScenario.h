@@ -0,0 +1,66 @@
+#ifndef __MOCKSCENARIO_H__
+#define __MOCKSCENARIO_H__
+#include <BotCore/TwitchAPI/EventSubEvents.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace NomMockTwitch {
+	// One line of a scenario script. Scripts run top to bottom, only wait takes time:
+	//   rate <event type> <per second>   Keep sending notifications of that type, 0 stops
+	//   burst <event type> <count>       Send count notifications at once
+	//   wait <seconds>
+	//   users <count>                    Distinct viewers the generated events come from
+	//   duplicates <fraction>            Share of notifications sent a second time with the same message_id
+	//   keepalive <seconds>              Idle time before a session_keepalive, 0 sends none
+	//   ratelimit <count>                Answer the next count Helix requests with 429
+	//   reconnect                        Send session_reconnect, subscriptions follow the new connection
+	//   disconnect                       Drop every WebSocket without a close frame
+	//   stall                            Stop writing to every WebSocket but keep it open, like a route that went dead
+	//   split <bytes>                    Send WebSocket frames in pieces of this size, one piece per client and loop round, 0 sends them whole
+	//   revoke <event type>              Send a revocation and drop the subscription
+	//   tokenexpiry <seconds>            expires_in for tokens issued from now on
+	//   expect <stat> <op> <value>       Checked once the run is over, op is >=, <= or ==. A failed one makes
+	//                                    MockTwitch exit with 1, so a script doubles as a regression test.
+	//   exit                             End the scenario
+	// Anything after a # is a comment. Stats for expect are sent, duplicates, unsubscribed, helix,
+	// ratelimited, subscriptions and sessions, plus handled, skipped, dropped and p99_ms with --soak.
+	enum class MockCommandType {
+		Rate,
+		Burst,
+		Wait,
+		Users,
+		Duplicates,
+		Keepalive,
+		RateLimit,
+		Reconnect,
+		Disconnect,
+		Stall,
+		Split,
+		Revoke,
+		TokenExpiry,
+		Expect,
+		Exit
+	};
+
+	struct MockCommand {
+		MockCommandType type = MockCommandType::Exit;
+		NomBotCore::EventSubType eventType = NomBotCore::EventSubType::Unknown;
+		double value = 0;
+		int line = 0;
+		std::string stat; // expect only
+		std::string comparison;
+	};
+
+	struct MockScenario {
+		std::vector<MockCommand> commands;
+
+		// Returns 0 on success, otherwise error names the offending line
+		int Load(const std::string& path, std::string& error);
+		int Parse(const std::string& text, std::string& error);
+		// Prints every failed expect, a stat missing from results fails as well. Returns how many failed.
+		int CheckExpectations(const std::map<std::string, double>& results) const;
+	};
+}
+
+#endif
@@ -0,0 +1,716 @@
+#include "MockTwitchServer.h"
+#include <BotCore/Networking/NomWebSocket.h>
+#include <BotCore/Core/JSONParser/JsonParser.h>
+#include <BotCore/Core/Logging/ImGuiLog.h>
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+
+namespace NomMockTwitch {
+	using namespace NomBotCore;
+	using Clock = std::chrono::steady_clock;
+
+	namespace {
+		const char* ListenerName = "MockListener";
+		constexpr size_t MaxRequestBytes = 1024 * 1024;
+		// Twitch keeps the old connection open this long after a session_reconnect
+		constexpr int ReconnectGraceSeconds = 30;
+
+		const JsonValue* FindField(const JsonValue* object, const char* key, JsonValue::Type type)
+		{
+			if (!object || object->type != JsonValue::Type::Object)
+				return nullptr;
+			auto it = object->objectValues.find(key);
+			if (it == object->objectValues.end() || !it->second || it->second->type != type)
+				return nullptr;
+			return it->second.get();
+		}
+
+		std::string QueryValue(const std::string& query, const std::string& key)
+		{
+			size_t start = 0;
+			while (start < query.size()) {
+				size_t end = query.find('&', start);
+				if (end == std::string::npos)
+					end = query.size();
+				size_t equals = query.find('=', start);
+				if (equals != std::string::npos && equals < end && query.compare(start, equals - start, key) == 0)
+					return query.substr(equals + 1, end - equals - 1);
+				start = end + 1;
+			}
+			return "";
+		}
+
+		std::string JsonString(const std::string& text)
+		{
+			return "\"" + text + "\"";
+		}
+	}
+
+	MockTwitchServer::MockTwitchServer(const MockServerConfig& config)
+		: m_Config(config)
+	{
+	}
+
+	MockTwitchServer::~MockTwitchServer()
+	{
+		Stop();
+	}
+
+	int MockTwitchServer::Start(const MockScenario& scenario)
+	{
+		if (m_Running)
+			return 0;
+		m_SocketManager = new NomSocketManager(1024); // A WebSocket per hosted channel on top of the Helix connections
+		if (m_SocketManager->CreateSocket(ListenerName, 1, 1) != 0
+			|| m_SocketManager->BindSocket(ListenerName, m_Config.address.c_str(), m_Config.port) != 0
+			|| m_SocketManager->Listen(ListenerName, SOMAXCONN) != 0) {
+			ImGuiLogManager::AddLog("MockTwitch", "Failed to listen on " + m_Config.address + ":" + std::to_string(m_Config.port), LogSeverity::Error);
+			delete m_SocketManager;
+			m_SocketManager = nullptr;
+			return -1;
+		}
+		m_Scenario = scenario;
+		m_NextCommand = 0;
+		m_ScenarioDone = false;
+		m_KeepaliveSeconds = m_Config.keepaliveSeconds;
+		m_TokenExpiresIn = m_Config.tokenExpiresIn;
+		m_EventContext.channelId = m_Config.channelId;
+		m_EventContext.channelLogin = m_Config.channelLogin;
+		m_HelixBuckets.clear();
+		auto now = Clock::now();
+		m_WaitUntil = now;
+		m_LastGenerated = now;
+		ImGuiLogManager::AddLog("MockTwitch", "Mock Twitch listening on " + m_Config.address + ":" + std::to_string(m_Config.port), LogSeverity::Info);
+		m_Running = true;
+		m_Thread = std::thread(&MockTwitchServer::ThreadFunc, this);
+		return 0;
+	}
+
+	void MockTwitchServer::Stop()
+	{
+		if (!m_Running)
+			return;
+		m_Running = false;
+		if (m_Thread.joinable())
+			m_Thread.join();
+		m_Clients.clear();
+		m_Subscriptions.clear();
+		m_SocketManager->CloseAllSockets();
+		delete m_SocketManager;
+		m_SocketManager = nullptr;
+	}
+
+	void MockTwitchServer::ThreadFunc()
+	{
+		std::vector<std::string> watched;
+		std::vector<std::string> ready;
+		while (m_Running) {
+			watched.clear();
+			ready.clear();
+			watched.push_back(ListenerName);
+			for (const auto& client : m_Clients)
+				watched.push_back(client.name);
+			// Short timeout, the scenario generates events on this thread too
+			if (m_SocketManager->WaitReadable(watched, 1, ready) > 0) {
+				for (const auto& name : ready) {
+					if (name == ListenerName) {
+						AcceptClient();
+						continue;
+					}
+					for (auto& client : m_Clients) {
+						if (client.name == name && !client.closed) {
+							ReadClient(client);
+							break;
+						}
+					}
+				}
+			}
+
+			auto now = Clock::now();
+			SendDelayed(now);
+			RunScenario(now);
+			GenerateEvents(now);
+			for (auto& client : m_Clients) {
+				if (client.closed)
+					continue;
+				if (now >= client.closeAt)
+					CloseClient(client);
+			}
+			SendKeepalives(now);
+			SendPieces();
+			m_Clients.erase(std::remove_if(m_Clients.begin(), m_Clients.end(), [](const Client& client) { return client.closed; }), m_Clients.end());
+		}
+	}
+
+	void MockTwitchServer::AcceptClient()
+	{
+		Client client;
+		client.name = "MockClient" + std::to_string(m_NextClient++);
+		char clientAddress[INET6_ADDRSTRLEN];
+		int clientPort = 0;
+		if (m_SocketManager->AcceptConnection(ListenerName, client.name.c_str(), clientAddress, &clientPort) != 0)
+			return;
+		client.lastSent = Clock::now();
+		m_Clients.push_back(std::move(client));
+	}
+
+	void MockTwitchServer::ReadClient(Client& client)
+	{
+		char buffer[16 * 1024];
+		int bytesReceived = m_SocketManager->ReceiveData(client.name.c_str(), buffer, sizeof(buffer));
+		if (bytesReceived <= 0) {
+			CloseClient(client);
+			return;
+		}
+		client.buffer.append(buffer, bytesReceived);
+		if (client.webSocket) {
+			ReadWebSocketFrames(client);
+			return;
+		}
+		HttpRequestData request;
+		while (!client.closed && !client.webSocket && TakeRequest(client, request))
+			HandleRequest(client, request);
+		if (!client.closed && client.buffer.size() > MaxRequestBytes) {
+			Respond(client, "431 Request Header Fields Too Large", "", "Connection: close\r\n");
+			CloseClient(client);
+		}
+	}
+
+	bool MockTwitchServer::TakeRequest(Client& client, HttpRequestData& request)
+	{
+		size_t headerEnd = client.buffer.find("\r\n\r\n");
+		if (headerEnd == std::string::npos)
+			return false;
+		request = HttpRequestData();
+		size_t lineEnd = client.buffer.find("\r\n");
+		std::string requestLine = client.buffer.substr(0, lineEnd);
+		size_t methodEnd = requestLine.find(' ');
+		size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+		if (methodEnd == std::string::npos || targetEnd == std::string::npos) {
+			CloseClient(client);
+			return false;
+		}
+		request.method = requestLine.substr(0, methodEnd);
+		std::string target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+		size_t question = target.find('?');
+		request.path = target.substr(0, question);
+		if (question != std::string::npos)
+			request.query = target.substr(question + 1);
+
+		size_t pos = lineEnd + 2;
+		while (pos < headerEnd) {
+			size_t end = client.buffer.find("\r\n", pos);
+			size_t colon = client.buffer.find(':', pos);
+			if (colon != std::string::npos && colon < end) {
+				std::string name = client.buffer.substr(pos, colon - pos);
+				std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+				size_t valueStart = client.buffer.find_first_not_of(' ', colon + 1);
+				request.headers[name] = client.buffer.substr(valueStart, end - valueStart);
+			}
+			pos = end + 2;
+		}
+
+		size_t bodyLength = 0;
+		auto contentLength = request.headers.find("content-length");
+		if (contentLength != request.headers.end())
+			bodyLength = static_cast<size_t>(std::strtoull(contentLength->second.c_str(), nullptr, 10));
+		size_t bodyStart = headerEnd + 4;
+		if (client.buffer.size() < bodyStart + bodyLength)
+			return false;
+		request.body = client.buffer.substr(bodyStart, bodyLength);
+		client.buffer.erase(0, bodyStart + bodyLength);
+		return true;
+	}
+
+	void MockTwitchServer::HandleRequest(Client& client, const HttpRequestData& request)
+	{
+		if (request.method == "GET" && request.path == "/ws") {
+			UpgradeWebSocket(client, request);
+			return;
+		}
+		if (request.method == "POST" && request.path == "/oauth2/token") {
+			// Any code or refresh token is accepted, the tokens only have to differ between grants. Every scope the
+			// bot asks for is granted, as the user would on the consent page.
+			std::string id = std::to_string(m_NextId++);
+			std::string scopes = "\"" + NomBotCore::GetEventSubScopes() + "\"";
+			for (size_t plus = scopes.find('+'); plus != std::string::npos; plus = scopes.find('+', plus))
+				scopes.replace(plus, 1, "\",\"");
+			Respond(client, "200 OK", "{\"access_token\":\"mock-access-" + id + "\",\"refresh_token\":\"mock-refresh-" + id + "\","
+				"\"expires_in\":" + std::to_string(m_TokenExpiresIn) + ",\"scope\":[" + scopes + "],\"token_type\":\"bearer\"}");
+			return;
+		}
+		if (request.path.compare(0, 7, "/helix/") == 0) {
+			HandleHelix(client, request);
+			return;
+		}
+		Respond(client, "404 Not Found", "{\"error\":\"Not Found\",\"status\":404,\"message\":\"\"}");
+	}
+
+	void MockTwitchServer::HandleHelix(Client& client, const HttpRequestData& request)
+	{
+		auto now = Clock::now();
+		m_Stats.helixRequests++;
+		auto authorization = request.headers.find("authorization");
+		HelixBucket& bucket = m_HelixBuckets[authorization != request.headers.end() ? authorization->second : ""];
+		if (m_RateLimitNext > 0 || !TakeHelixPoint(bucket, now)) {
+			if (m_RateLimitNext > 0)
+				--m_RateLimitNext;
+			m_Stats.rateLimited++;
+			// Reset a second out, a forced 429 shouldn't stall a soak run for the rest of the minute
+			Respond(client, "429 Too Many Requests", "{\"error\":\"Too Many Requests\",\"status\":429,\"message\":\"\"}",
+				"Ratelimit-Limit: " + std::to_string(m_Config.helixPointsPerMinute) + "\r\nRatelimit-Remaining: 0\r\n"
+				"Ratelimit-Reset: " + std::to_string(std::time(nullptr) + 1) + "\r\n");
+			return;
+		}
+		std::string rateHeaders = RatelimitHeaders(bucket, now);
+
+		if (request.path == "/helix/users") {
+			Respond(client, "200 OK", "{\"data\":[{\"id\":" + JsonString(m_Config.channelId) + ",\"login\":" + JsonString(m_Config.channelLogin) +
+				",\"display_name\":" + JsonString(m_Config.channelLogin) + ",\"type\":\"\",\"broadcaster_type\":\"affiliate\"}]}", rateHeaders);
+			return;
+		}
+		if (request.path != "/helix/eventsub/subscriptions") {
+			Respond(client, "404 Not Found", "{\"error\":\"Not Found\",\"status\":404,\"message\":\"\"}", rateHeaders);
+			return;
+		}
+
+		if (request.method == "POST") {
+			size_t pos = 0;
+			std::shared_ptr<JsonValue> json = JsonParser::Parse(request.body, pos);
+			const JsonValue* type = FindField(json.get(), "type", JsonValue::Type::String);
+			const JsonValue* version = FindField(json.get(), "version", JsonValue::Type::String);
+			const JsonValue* transport = FindField(json.get(), "transport", JsonValue::Type::Object);
+			const JsonValue* sessionId = FindField(transport, "session_id", JsonValue::Type::String);
+			EventSubType kind = type ? FindEventSubType(type->stringValue) : EventSubType::Unknown;
+			if (kind == EventSubType::Unknown || !sessionId) {
+				Respond(client, "400 Bad Request", "{\"error\":\"Bad Request\",\"status\":400,\"message\":\"invalid subscription\"}", rateHeaders);
+				return;
+			}
+			if (!FindSession(sessionId->stringValue)) {
+				Respond(client, "400 Bad Request", "{\"error\":\"Bad Request\",\"status\":400,\"message\":\"websocket transport session does not exist or has already disconnected\"}", rateHeaders);
+				return;
+			}
+			for (const auto& [id, existing] : m_Subscriptions) {
+				if (existing.type == kind && existing.sessionId == sessionId->stringValue) {
+					Respond(client, "409 Conflict", "{\"error\":\"Conflict\",\"status\":409,\"message\":\"subscription already exists\"}", rateHeaders);
+					return;
+				}
+			}
+			Subscription subscription;
+			subscription.id = NextId("sub");
+			subscription.type = kind;
+			subscription.version = version ? version->stringValue : GetEventSubTypeInfo(kind).version;
+			subscription.sessionId = sessionId->stringValue;
+			subscription.createdAt = MockTimestamp();
+			m_Subscriptions[subscription.id] = subscription;
+			m_Stats.subscriptionsCreated++;
+			Respond(client, "202 Accepted", "{\"data\":[" + SubscriptionJson(subscription, "enabled") + "],\"total\":" + std::to_string(m_Subscriptions.size()) +
+				",\"total_cost\":0,\"max_total_cost\":10}", rateHeaders);
+		}
+		else if (request.method == "DELETE") {
+			auto it = m_Subscriptions.find(QueryValue(request.query, "id"));
+			if (it == m_Subscriptions.end()) {
+				Respond(client, "404 Not Found", "{\"error\":\"Not Found\",\"status\":404,\"message\":\"subscription not found\"}", rateHeaders);
+				return;
+			}
+			m_Subscriptions.erase(it);
+			Respond(client, "204 No Content", "", rateHeaders);
+		}
+		else if (request.method == "GET") {
+			std::string body = "{\"data\":[";
+			bool first = true;
+			for (const auto& [id, subscription] : m_Subscriptions) {
+				if (!first)
+					body += ',';
+				first = false;
+				body += SubscriptionJson(subscription, "enabled");
+			}
+			body += "],\"total\":" + std::to_string(m_Subscriptions.size()) + ",\"total_cost\":0,\"max_total_cost\":10,\"pagination\":{}}";
+			Respond(client, "200 OK", body, rateHeaders);
+		}
+		else {
+			Respond(client, "405 Method Not Allowed", "", rateHeaders);
+		}
+	}
+
+	void MockTwitchServer::UpgradeWebSocket(Client& client, const HttpRequestData& request)
+	{
+		auto key = request.headers.find("sec-websocket-key");
+		if (key == request.headers.end()) {
+			Respond(client, "400 Bad Request", "", "Connection: close\r\n");
+			CloseClient(client);
+			return;
+		}
+		std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: " + generateWebSocketAcceptKey(key->second) + "\r\n\r\n";
+		if (!SendAll(client, response))
+			return;
+		client.webSocket = true;
+		client.sessionId = NextId("session");
+		m_Stats.webSocketSessions++;
+		// Right behind the handshake answer, like Twitch, so the bot has to keep what follows the headers
+		SendSessionMessage(client, "session_welcome", "{\"session\":{\"id\":" + JsonString(client.sessionId) + ",\"status\":\"connected\","
+			"\"connected_at\":" + JsonString(MockTimestamp()) + ",\"keepalive_timeout_seconds\":" + std::to_string(m_KeepaliveSeconds) + ",\"reconnect_url\":null}}");
+
+		// Following a reconnect_url carries the subscriptions over, the old connection closes once this one is up
+		std::string previous = QueryValue(request.query, "reconnect");
+		if (Client* old = previous.empty() ? nullptr : FindSession(previous)) {
+			for (auto& [id, subscription] : m_Subscriptions) {
+				if (subscription.sessionId == previous)
+					subscription.sessionId = client.sessionId;
+			}
+			old->closeAt = Clock::now();
+		}
+		ImGuiLogManager::AddLog("MockTwitch", "WebSocket session " + client.sessionId + " opened", LogSeverity::Info);
+	}
+
+	void MockTwitchServer::ReadWebSocketFrames(Client& client)
+	{
+		// Client frames are masked, only close matters here
+		while (client.buffer.size() >= 2) {
+			const unsigned char* data = reinterpret_cast<const unsigned char*>(client.buffer.data());
+			unsigned char opcode = data[0] & 0x0F;
+			uint64_t length = data[1] & 0x7F;
+			size_t headerLength = 2;
+			if (length == 126)
+				headerLength += 2;
+			else if (length == 127)
+				headerLength += 8;
+			if (data[1] & 0x80)
+				headerLength += 4;
+			if (client.buffer.size() < headerLength)
+				return;
+			if (length == 126) {
+				length = (data[2] << 8) | data[3];
+			}
+			else if (length == 127) {
+				length = 0;
+				for (int i = 0; i < 8; ++i)
+					length = (length << 8) | data[2 + i];
+			}
+			if (client.buffer.size() < headerLength + length)
+				return;
+			client.buffer.erase(0, headerLength + static_cast<size_t>(length));
+			if (opcode == 0x8) {
+				CloseClient(client);
+				return;
+			}
+		}
+	}
+
+	void MockTwitchServer::Respond(Client& client, const char* status, const std::string& body, const std::string& extraHeaders)
+	{
+		std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+			"Content-Type: application/json\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n" + extraHeaders + "\r\n" + body;
+		// Answers that close the connection go out right away, the client is gone by the time a delayed one is due
+		if (m_Config.responseDelayMs > 0 && extraHeaders.find("Connection: close") == std::string::npos) {
+			m_Delayed.push_back({ client.name, std::move(response), Clock::now() + std::chrono::milliseconds(m_Config.responseDelayMs) });
+			return;
+		}
+		SendAll(client, response);
+	}
+
+	void MockTwitchServer::SendDelayed(Clock::time_point now)
+	{
+		while (!m_Delayed.empty() && m_Delayed.front().sendAt <= now) {
+			for (auto& client : m_Clients) {
+				if (client.name == m_Delayed.front().clientName && !client.closed) {
+					SendAll(client, m_Delayed.front().data);
+					break;
+				}
+			}
+			m_Delayed.pop_front();
+		}
+	}
+
+	bool MockTwitchServer::SendAll(Client& client, const std::string& data)
+	{
+		size_t sent = 0;
+		while (sent < data.size()) {
+			int bytesSent = m_SocketManager->SendData(client.name.c_str(), data.data() + sent, static_cast<int>(data.size() - sent));
+			if (bytesSent <= 0) {
+				CloseClient(client);
+				return false;
+			}
+			sent += bytesSent;
+		}
+		client.lastSent = Clock::now();
+		return true;
+	}
+
+	void MockTwitchServer::SendWebSocketText(Client& client, const std::string& text)
+	{
+		// Server frames go out unmasked
+		std::string frame;
+		frame.reserve(text.size() + 10);
+		frame += static_cast<char>(0x81);
+		if (text.size() <= 125) {
+			frame += static_cast<char>(text.size());
+		}
+		else if (text.size() <= 65535) {
+			frame += static_cast<char>(126);
+			frame += static_cast<char>((text.size() >> 8) & 0xFF);
+			frame += static_cast<char>(text.size() & 0xFF);
+		}
+		else {
+			frame += static_cast<char>(127);
+			for (int i = 7; i >= 0; --i)
+				frame += static_cast<char>((static_cast<uint64_t>(text.size()) >> (8 * i)) & 0xFF);
+		}
+		frame += text;
+		// Once pieces are queued everything after them has to queue too, or frames would interleave
+		if (m_SplitBytes > 0 || !client.unsent.empty())
+			client.unsent += frame;
+		else
+			SendAll(client, frame);
+	}
+
+	void MockTwitchServer::SendPieces()
+	{
+		for (auto& client : m_Clients) {
+			if (client.closed || client.unsent.empty())
+				continue;
+			size_t length = m_SplitBytes > 0 ? std::min(client.unsent.size(), static_cast<size_t>(m_SplitBytes)) : client.unsent.size();
+			if (!SendAll(client, client.unsent.substr(0, length)))
+				continue;
+			client.unsent.erase(0, length);
+		}
+	}
+
+	void MockTwitchServer::SendSessionMessage(Client& client, const char* messageType, const std::string& payload, const std::string& messageId)
+	{
+		std::string message = "{\"metadata\":{\"message_id\":" + JsonString(messageId.empty() ? NextId("msg") : messageId) +
+			",\"message_type\":" + JsonString(messageType) + ",\"message_timestamp\":" + JsonString(MockTimestamp()) + "},\"payload\":" + payload + "}";
+		SendWebSocketText(client, message);
+	}
+
+	void MockTwitchServer::CloseClient(Client& client)
+	{
+		if (client.closed)
+			return;
+		client.closed = true;
+		m_SocketManager->RemoveSocket(client.name.c_str());
+		if (!client.webSocket)
+			return;
+		// Like Twitch, a session's subscriptions go away with its connection
+		for (auto it = m_Subscriptions.begin(); it != m_Subscriptions.end();) {
+			if (it->second.sessionId == client.sessionId)
+				it = m_Subscriptions.erase(it);
+			else
+				++it;
+		}
+		ImGuiLogManager::AddLog("MockTwitch", "WebSocket session " + client.sessionId + " closed", LogSeverity::Info);
+	}
+
+	void MockTwitchServer::RunScenario(Clock::time_point now)
+	{
+		if (m_NextCommand == 0 && m_Subscriptions.size() < m_Config.waitForSubscriptions)
+			return;
+		while (!m_ScenarioDone && now >= m_WaitUntil) {
+			if (m_NextCommand >= m_Scenario.commands.size()) {
+				m_ScenarioDone = true;
+				break;
+			}
+			const MockCommand& command = m_Scenario.commands[m_NextCommand++];
+			int type = static_cast<int>(command.eventType);
+			switch (command.type) {
+			case MockCommandType::Rate:
+				m_Rates[type] = command.value;
+				m_Owed[type] = 0;
+				break;
+			case MockCommandType::Burst:
+				for (int i = 0; i < static_cast<int>(command.value); ++i)
+					SendNotification(command.eventType);
+				break;
+			case MockCommandType::Wait:
+				m_WaitUntil = now + std::chrono::microseconds(static_cast<int64_t>(command.value * 1000000));
+				break;
+			case MockCommandType::Users:
+				m_EventContext.users = static_cast<int>(command.value);
+				break;
+			case MockCommandType::Duplicates:
+				m_DuplicateFraction = command.value;
+				break;
+			case MockCommandType::Keepalive:
+				m_KeepaliveSeconds = static_cast<int>(command.value);
+				break;
+			case MockCommandType::RateLimit:
+				m_RateLimitNext = static_cast<int>(command.value);
+				break;
+			case MockCommandType::Split:
+				m_SplitBytes = static_cast<int>(command.value);
+				break;
+			case MockCommandType::Reconnect:
+				for (auto& client : m_Clients) {
+					if (!client.webSocket || client.closed || client.stalled)
+						continue;
+					std::string url = "ws://" + m_Config.address + ":" + std::to_string(m_Config.port) + "/ws?reconnect=" + client.sessionId;
+					SendSessionMessage(client, "session_reconnect", "{\"session\":{\"id\":" + JsonString(client.sessionId) + ",\"status\":\"reconnecting\","
+						"\"keepalive_timeout_seconds\":null,\"reconnect_url\":" + JsonString(url) + ",\"connected_at\":" + JsonString(MockTimestamp()) + "}}");
+					client.closeAt = std::min(client.closeAt, now + std::chrono::seconds(ReconnectGraceSeconds));
+				}
+				break;
+			case MockCommandType::Disconnect:
+				for (auto& client : m_Clients) {
+					if (client.webSocket)
+						CloseClient(client);
+				}
+				break;
+			case MockCommandType::Stall:
+				for (auto& client : m_Clients) {
+					if (!client.webSocket || client.closed)
+						continue;
+					client.stalled = true;
+					// Twitch gives up on the session as well, its subscriptions go
+					for (auto it = m_Subscriptions.begin(); it != m_Subscriptions.end();) {
+						if (it->second.sessionId == client.sessionId)
+							it = m_Subscriptions.erase(it);
+						else
+							++it;
+					}
+				}
+				break;
+			case MockCommandType::Revoke: {
+				// Collected first, a failed send closes the client and erases its subscriptions under the loop
+				std::vector<std::pair<std::string, std::string>> revocations;
+				for (auto it = m_Subscriptions.begin(); it != m_Subscriptions.end();) {
+					if (it->second.type != command.eventType) {
+						++it;
+						continue;
+					}
+					revocations.emplace_back(it->second.sessionId, "{\"subscription\":" + SubscriptionJson(it->second, "authorization_revoked") + "}");
+					it = m_Subscriptions.erase(it);
+				}
+				for (const auto& [sessionId, revocation] : revocations) {
+					if (Client* client = FindSession(sessionId))
+						SendSessionMessage(*client, "revocation", revocation);
+				}
+				break;
+			}
+			case MockCommandType::TokenExpiry:
+				m_TokenExpiresIn = static_cast<int>(command.value);
+				break;
+			case MockCommandType::Expect:
+				break; // Main checks these once the run is over
+			case MockCommandType::Exit:
+				m_ScenarioDone = true;
+				break;
+			}
+		}
+	}
+
+	void MockTwitchServer::GenerateEvents(Clock::time_point now)
+	{
+		double elapsed = std::chrono::duration<double>(now - m_LastGenerated).count();
+		m_LastGenerated = now;
+		if (m_ScenarioDone)
+			return;
+		for (int i = 0; i < EventSubTypeCount; ++i) {
+			if (m_Rates[i] <= 0)
+				continue;
+			// Fractional events carry over, low rates still come out right over time
+			m_Owed[i] += m_Rates[i] * elapsed;
+			while (m_Owed[i] >= 1) {
+				m_Owed[i] -= 1;
+				SendNotification(static_cast<EventSubType>(i));
+			}
+		}
+	}
+
+	void MockTwitchServer::SendNotification(EventSubType type)
+	{
+		uint64_t seq = m_NextId++;
+		// Several sessions holding the type, one per hosted channel, take turns
+		std::vector<std::pair<const Subscription*, Client*>> subscribers;
+		for (const auto& [id, candidate] : m_Subscriptions) {
+			Client* session = candidate.type == type ? FindSession(candidate.sessionId) : nullptr;
+			if (session)
+				subscribers.push_back({ &candidate, session });
+		}
+		if (subscribers.empty()) {
+			m_Stats.notificationsUnsubscribed++;
+			return;
+		}
+		const auto& [subscription, client] = subscribers[m_NextSubscriber++ % subscribers.size()];
+		std::string payload = "{\"subscription\":" + SubscriptionJson(*subscription, "enabled") + ",\"event\":" + BuildMockEvent(type, seq, m_EventContext) + "}";
+		std::string messageId = "msg-" + std::to_string(seq);
+		SendSessionMessage(*client, "notification", payload, messageId);
+		m_Stats.notificationsSent++;
+		m_DuplicateOwed += m_DuplicateFraction;
+		if (m_DuplicateOwed >= 1 && !client->closed) {
+			m_DuplicateOwed -= 1;
+			SendSessionMessage(*client, "notification", payload, messageId);
+			m_Stats.duplicatesSent++;
+		}
+	}
+
+	void MockTwitchServer::SendKeepalives(Clock::time_point now)
+	{
+		if (m_KeepaliveSeconds <= 0)
+			return;
+		for (auto& client : m_Clients) {
+			// A keepalive is only due after keepalive_timeout_seconds of silence
+			if (!client.webSocket || client.closed || client.stalled)
+				continue;
+			if (now - client.lastSent >= std::chrono::seconds(m_KeepaliveSeconds))
+				SendSessionMessage(client, "session_keepalive", "{}");
+		}
+	}
+
+	MockTwitchServer::Client* MockTwitchServer::FindSession(const std::string& sessionId)
+	{
+		for (auto& client : m_Clients) {
+			if (client.webSocket && !client.closed && !client.stalled && client.sessionId == sessionId)
+				return &client;
+		}
+		return nullptr;
+	}
+
+	std::string MockTwitchServer::SubscriptionJson(const Subscription& subscription, const char* status) const
+	{
+		const EventSubTypeInfo& info = GetEventSubTypeInfo(subscription.type);
+		std::string condition;
+		switch (info.condition) {
+		case EventSubCondition::Broadcaster:
+			condition = "\"broadcaster_user_id\":" + JsonString(m_Config.channelId);
+			break;
+		case EventSubCondition::BroadcasterAndModerator:
+			condition = "\"broadcaster_user_id\":" + JsonString(m_Config.channelId) + ",\"moderator_user_id\":" + JsonString(m_Config.channelId);
+			break;
+		case EventSubCondition::BroadcasterAndUser:
+			condition = "\"broadcaster_user_id\":" + JsonString(m_Config.channelId) + ",\"user_id\":" + JsonString(m_Config.channelId);
+			break;
+		case EventSubCondition::ToBroadcaster:
+			condition = "\"to_broadcaster_user_id\":" + JsonString(m_Config.channelId);
+			break;
+		}
+		return "{\"id\":" + JsonString(subscription.id) + ",\"status\":" + JsonString(status) + ",\"type\":" + JsonString(info.type) +
+			",\"version\":" + JsonString(subscription.version) + ",\"cost\":0,\"condition\":{" + condition + "},"
+			"\"transport\":{\"method\":\"websocket\",\"session_id\":" + JsonString(subscription.sessionId) + "},\"created_at\":" + JsonString(subscription.createdAt) + "}";
+	}
+
+	std::string MockTwitchServer::RatelimitHeaders(const HelixBucket& bucket, Clock::time_point now)
+	{
+		auto untilReset = std::chrono::duration_cast<std::chrono::seconds>(bucket.resetAt - now).count();
+		return "Ratelimit-Limit: " + std::to_string(m_Config.helixPointsPerMinute) + "\r\n"
+			"Ratelimit-Remaining: " + std::to_string(bucket.points) + "\r\n"
+			"Ratelimit-Reset: " + std::to_string(std::time(nullptr) + std::max<long long>(1, untilReset)) + "\r\n";
+	}
+
+	bool MockTwitchServer::TakeHelixPoint(HelixBucket& bucket, Clock::time_point now)
+	{
+		// Fixed window, refilled to the limit once a minute, a new bucket starts its first window here
+		if (now >= bucket.resetAt) {
+			bucket.points = m_Config.helixPointsPerMinute;
+			bucket.resetAt = now + std::chrono::minutes(1);
+		}
+		if (bucket.points <= 0)
+			return false;
+		--bucket.points;
+		return true;
+	}
+}
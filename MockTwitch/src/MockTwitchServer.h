@@ -0,0 +1,155 @@
+#ifndef __MOCKTWITCHSERVER_H__
+#define __MOCKTWITCHSERVER_H__
+#include "MockScenario.h"
+#include "MockEvents.h"
+#include <BotCore/Networking/NomSocketManager.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <chrono>
+
+namespace NomMockTwitch {
+	struct MockServerConfig {
+		std::string address = "127.0.0.1";
+		int port = 8080;
+		std::string channelId = "1000";
+		std::string channelLogin = "mockchannel";
+		int keepaliveSeconds = 10;
+		int tokenExpiresIn = 14400;
+		int helixPointsPerMinute = 800; // Same bucket size Twitch gives an app token
+		int responseDelayMs = 0; // Holds HTTP answers back this long, like the round trip to Twitch
+		// The scenario holds off until this many subscriptions exist, so a bot that is still connecting misses nothing
+		size_t waitForSubscriptions = 0;
+	};
+
+	struct MockServerStats {
+		std::atomic<uint64_t> notificationsSent{ 0 };
+		std::atomic<uint64_t> duplicatesSent{ 0 };
+		std::atomic<uint64_t> notificationsUnsubscribed{ 0 }; // Generated while no session had the type subscribed
+		std::atomic<uint64_t> helixRequests{ 0 };
+		std::atomic<uint64_t> rateLimited{ 0 };
+		std::atomic<uint64_t> subscriptionsCreated{ 0 };
+		std::atomic<uint64_t> webSocketSessions{ 0 };
+	};
+
+	// Plain HTTP and WebSocket stand in for id.twitch.tv, api.twitch.tv and eventsub.wss.twitch.tv on one port:
+	//   POST /oauth2/token                    Any code or refresh token gets a fresh access token
+	//   GET /helix/users                      The mock channel
+	//   POST/GET/DELETE /helix/eventsub/subscriptions
+	//   GET /ws                               EventSub WebSocket, notifications only go to subscribed sessions,
+	//                                         in turn when several hold the type
+	// Helix answers carry Ratelimit-* headers from a per minute bucket of the token that was sent. Everything, the scenario included,
+	// runs on one thread, so none of the state needs a lock.
+	class MockTwitchServer {
+	public:
+		MockTwitchServer(const MockServerConfig& config = MockServerConfig());
+		~MockTwitchServer();
+
+		int Start(const MockScenario& scenario);
+		void Stop();
+		bool IsScenarioDone() const { return m_ScenarioDone.load(); }
+		const MockServerStats& GetStats() const { return m_Stats; }
+	private:
+		struct Client {
+			std::string name;
+			std::string buffer;
+			bool webSocket = false;
+			std::string sessionId;
+			std::chrono::steady_clock::time_point lastSent;
+			std::chrono::steady_clock::time_point closeAt = std::chrono::steady_clock::time_point::max();
+			bool closed = false;
+			bool stalled = false; // Nothing more is written, the bot has to notice through the keepalive timeout
+			std::string unsent; // WebSocket frames waiting to go out in pieces
+		};
+
+		struct Subscription {
+			std::string id;
+			NomBotCore::EventSubType type = NomBotCore::EventSubType::Unknown;
+			std::string version;
+			std::string sessionId;
+			std::string createdAt;
+		};
+
+		struct HttpRequestData {
+			std::string method;
+			std::string path;
+			std::string query;
+			std::map<std::string, std::string> headers; // Lower case names
+			std::string body;
+		};
+
+		void ThreadFunc();
+		void AcceptClient();
+		void ReadClient(Client& client);
+		bool TakeRequest(Client& client, HttpRequestData& request);
+		void HandleRequest(Client& client, const HttpRequestData& request);
+		void HandleHelix(Client& client, const HttpRequestData& request);
+		void UpgradeWebSocket(Client& client, const HttpRequestData& request);
+		void Respond(Client& client, const char* status, const std::string& body, const std::string& extraHeaders = "");
+		bool SendAll(Client& client, const std::string& data);
+		void SendWebSocketText(Client& client, const std::string& text);
+		void SendSessionMessage(Client& client, const char* messageType, const std::string& payload, const std::string& messageId = "");
+		void SendPieces();
+		void ReadWebSocketFrames(Client& client);
+		void CloseClient(Client& client);
+
+		void RunScenario(std::chrono::steady_clock::time_point now);
+		void GenerateEvents(std::chrono::steady_clock::time_point now);
+		void SendNotification(NomBotCore::EventSubType type);
+		void SendKeepalives(std::chrono::steady_clock::time_point now);
+		Client* FindSession(const std::string& sessionId);
+		std::string SubscriptionJson(const Subscription& subscription, const char* status) const;
+		std::string NextId(const char* prefix) { return std::string(prefix) + "-" + std::to_string(m_NextId++); }
+		struct HelixBucket {
+			int points = 0;
+			std::chrono::steady_clock::time_point resetAt;
+		};
+
+		struct DelayedResponse {
+			std::string clientName;
+			std::string data;
+			std::chrono::steady_clock::time_point sendAt;
+		};
+
+		void SendDelayed(std::chrono::steady_clock::time_point now);
+		std::string RatelimitHeaders(const HelixBucket& bucket, std::chrono::steady_clock::time_point now);
+		bool TakeHelixPoint(HelixBucket& bucket, std::chrono::steady_clock::time_point now);
+
+		MockServerConfig m_Config;
+		MockScenario m_Scenario;
+		NomBotCore::NomSocketManager* m_SocketManager = nullptr;
+		std::thread m_Thread;
+		std::atomic<bool> m_Running{ false };
+		std::atomic<bool> m_ScenarioDone{ false };
+		MockServerStats m_Stats;
+
+		std::vector<Client> m_Clients;
+		std::map<std::string, Subscription> m_Subscriptions; // By id
+		int m_NextClient = 0;
+		uint64_t m_NextId = 1;
+		size_t m_NextSubscriber = 0;
+
+		// Scenario state
+		size_t m_NextCommand = 0;
+		std::chrono::steady_clock::time_point m_WaitUntil;
+		double m_Rates[NomBotCore::EventSubTypeCount] = {};
+		double m_Owed[NomBotCore::EventSubTypeCount] = {};
+		std::chrono::steady_clock::time_point m_LastGenerated;
+		double m_DuplicateFraction = 0;
+		double m_DuplicateOwed = 0;
+		int m_RateLimitNext = 0;
+		int m_SplitBytes = 0;
+		int m_KeepaliveSeconds = 10;
+		int m_TokenExpiresIn = 14400;
+		MockEventContext m_EventContext;
+
+		// Helix buckets, one per Authorization header like Twitch keeps one per token
+		std::map<std::string, HelixBucket> m_HelixBuckets;
+		std::deque<DelayedResponse> m_Delayed; // Oldest first, every answer waits the same time
+	};
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "LogViewer.h"
+#include "imgui.h"
+#include <ctime>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+namespace NomTwitchBot {
+	namespace {
+		void DrawTimestamp(int64_t timestampUs)
+		{
+			std::time_t seconds = static_cast<std::time_t>(timestampUs / 1000000);
+			std::tm local = {};
+			localtime_s(&local, &seconds);
+			char stamp[32];
+			snprintf(stamp, sizeof(stamp), "%02d:%02d:%02d.%03d", local.tm_hour, local.tm_min, local.tm_sec, static_cast<int>((timestampUs / 1000) % 1000));
+			ImGui::TextUnformatted(stamp);
+		}
+
+		ImVec4 SeverityColor(NomBotCore::LogSeverity severity)
+		{
+			switch (severity) {
+			case NomBotCore::LogSeverity::Warning: return ImVec4(1, 1, 0, 1); // Yellow
+			case NomBotCore::LogSeverity::Error:   return ImVec4(1, 0, 0, 1); // Red
+			default:                               return ImVec4(1, 1, 1, 1); // White
+			}
+		}
+	}
+
+	LogViewer::LogViewer(NomBotCore::LogStore* store)
+		: m_Store(store)
+	{
+		ApplyFilter();
+	}
+
+	void LogViewer::Pull()
+	{
+		std::vector<std::string> names = NomBotCore::ImGuiLogManager::GetLogNames();
+		// Categories are only ever added, in the same order, so new names show up at the end
+		for (size_t i = m_Sources.size(); i < names.size(); ++i)
+			m_Sources.push_back({ names[i], 0 });
+		for (size_t category = 0; category < m_Sources.size(); ++category) {
+			Source& source = m_Sources[category];
+			m_Pulled.clear();
+			source.cursor = NomBotCore::ImGuiLogManager::ReadSince(source.name, source.cursor, m_Pulled);
+			for (const auto& entry : m_Pulled)
+				m_Index.Add(entry, static_cast<uint8_t>(category));
+		}
+	}
+
+	void LogViewer::ApplyFilter()
+	{
+		uint8_t severityMask = 0;
+		if (m_ShowInfo) severityMask |= 1 << static_cast<int>(NomBotCore::LogSeverity::Info);
+		if (m_ShowWarning) severityMask |= 1 << static_cast<int>(NomBotCore::LogSeverity::Warning);
+		if (m_ShowError) severityMask |= 1 << static_cast<int>(NomBotCore::LogSeverity::Error);
+		m_Index.SetFilter(m_Query, severityMask, m_CategoryMask);
+	}
+
+	void LogViewer::Draw()
+	{
+		Pull();
+
+		ImGui::Begin("Application Logs:");
+		bool filterChanged = false;
+		ImGui::SetNextItemWidth(300);
+		filterChanged |= ImGui::InputTextWithHint("##LogSearch", "Search", m_Query, sizeof(m_Query));
+		ImGui::SameLine();
+		filterChanged |= ImGui::Checkbox("Info", &m_ShowInfo);
+		ImGui::SameLine();
+		filterChanged |= ImGui::Checkbox("Warning", &m_ShowWarning);
+		ImGui::SameLine();
+		filterChanged |= ImGui::Checkbox("Error", &m_ShowError);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(200);
+		if (ImGui::BeginCombo("Categories", m_CategoryMask == ~0ull ? "All" : "Some")) {
+			for (size_t category = 0; category < m_Sources.size(); ++category) {
+				bool shown = (m_CategoryMask >> category) & 1;
+				if (ImGui::Checkbox(m_Sources[category].name.c_str(), &shown)) {
+					m_CategoryMask ^= 1ull << category;
+					filterChanged = true;
+				}
+			}
+			ImGui::EndCombo();
+		}
+		if (filterChanged)
+			ApplyFilter();
+
+		bool caughtUp = m_Index.Update(FilterRowsPerFrame);
+		size_t matchCount = m_Index.GetMatchCount();
+		ImGui::Text("%zu of %zu entries%s", matchCount, m_Index.GetRowCount(), caughtUp ? "" : " (searching...)");
+
+		ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_Resizable;
+		if (ImGui::BeginTable("LogEntries", 3, flags)) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Time", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+			ImGui::TableSetupColumn("Category", ImGuiTableColumnFlags_WidthFixed, 140.0f);
+			ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+
+			// Stick to the newest entry only while the view is already at the bottom
+			bool atBottom = ImGui::GetScrollY() >= ImGui::GetScrollMaxY();
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(matchCount));
+			while (clipper.Step()) {
+				for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+					NomBotCore::LogSearchIndex::RowView entry = m_Index.GetMatch(row);
+					ImGui::TableNextRow();
+
+					ImGui::TableNextColumn();
+					DrawTimestamp(entry.timestampUs);
+
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(entry.category < m_Sources.size() ? m_Sources[entry.category].name.c_str() : "");
+
+					ImGui::TableNextColumn();
+					ImGui::PushStyleColor(ImGuiCol_Text, SeverityColor(entry.severity));
+					ImGui::TextUnformatted(entry.text, entry.text + entry.length);
+					ImGui::PopStyleColor();
+				}
+			}
+			if (atBottom)
+				ImGui::SetScrollHereY(1.0f);
+			ImGui::EndTable();
+		}
+		ImGui::End();
+
+		if (m_Store)
+			DrawHistory();
+	}
+
+	void LogViewer::DrawHistory()
+	{
+		ImGui::Begin("Log History");
+		if (ImGui::Button("Refresh Categories") || m_HistoryCategories.empty())
+			m_HistoryCategories = m_Store->GetCategories();
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(200);
+		const char* preview = m_HistoryCategory < static_cast<int>(m_HistoryCategories.size()) ? m_HistoryCategories[m_HistoryCategory].c_str() : "";
+		if (ImGui::BeginCombo("##HistoryCategory", preview)) {
+			for (int i = 0; i < static_cast<int>(m_HistoryCategories.size()); ++i) {
+				if (ImGui::Selectable(m_HistoryCategories[i].c_str(), i == m_HistoryCategory))
+					m_HistoryCategory = i;
+			}
+			ImGui::EndCombo();
+		}
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(120);
+		ImGui::InputInt("Minutes back", &m_HistoryMinutes);
+		ImGui::SameLine();
+		if (ImGui::Button("Load") && m_HistoryCategory < static_cast<int>(m_HistoryCategories.size())) {
+			int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			int64_t fromUs = nowUs - static_cast<int64_t>(std::max(m_HistoryMinutes, 1)) * 60 * 1000000;
+			m_History.clear();
+			m_Store->QueryRange(m_HistoryCategories[m_HistoryCategory], fromUs, nowUs, MaxHistoryRecords, m_History);
+		}
+		ImGui::Text("%zu entries%s", m_History.size(), m_History.size() >= MaxHistoryRecords ? " (limit reached)" : "");
+
+		if (ImGui::BeginTable("HistoryEntries", 2, ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_Resizable)) {
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Time", ImGuiTableColumnFlags_WidthFixed, 90.0f);
+			ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
+			ImGui::TableHeadersRow();
+			ImGuiListClipper clipper;
+			clipper.Begin(static_cast<int>(m_History.size()));
+			while (clipper.Step()) {
+				for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+					const NomBotCore::LogStoreRecord& record = m_History[row];
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					DrawTimestamp(record.timestampUs);
+					ImGui::TableNextColumn();
+					ImGui::PushStyleColor(ImGuiCol_Text, SeverityColor(record.severity));
+					ImGui::TextUnformatted(record.message.c_str(), record.message.c_str() + record.message.size());
+					ImGui::PopStyleColor();
+				}
+			}
+			ImGui::EndTable();
+		}
+		ImGui::End();
+	}
+} // namespace NomTwitchBot
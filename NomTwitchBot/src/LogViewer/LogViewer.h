@@ -0,0 +1,49 @@
+#ifndef __LOGVIEWER_H__
+#define __LOGVIEWER_H__
+#include <BotCore/Core/Logging/ImGuiLog.h>
+#include <BotCore/Core/Logging/LogSearchIndex.h>
+#include <BotCore/Core/Logging/LogStore.h>
+#include <string>
+#include <vector>
+
+namespace NomTwitchBot {
+	// The "Application Logs" window. Every category is merged into one LogSearchIndex and only the rows
+	// on screen are drawn, so a frame costs the same with a hundred entries or a few million.
+	class LogViewer {
+	public:
+		// store backs the "Log History" window, which is left out when it is nullptr
+		LogViewer(NomBotCore::LogStore* store = nullptr);
+		void Draw();
+	private:
+		struct Source {
+			std::string name;
+			uint64_t cursor = 0;
+		};
+
+		// Pulls what every category appended since last frame, collapsed or filtered out ones too
+		void Pull();
+		void ApplyFilter();
+		// Range queries against the persistent store, for what happened before this run
+		void DrawHistory();
+
+		std::vector<Source> m_Sources; // Index is the category id given to the index
+		std::vector<NomBotCore::ImGuiLogEntry> m_Pulled; // Reused scratch buffer for ReadSince
+		NomBotCore::LogSearchIndex m_Index;
+		char m_Query[256] = {};
+		bool m_ShowInfo = true;
+		bool m_ShowWarning = true;
+		bool m_ShowError = true;
+		uint64_t m_CategoryMask = ~0ull;
+
+		NomBotCore::LogStore* m_Store;
+		std::vector<std::string> m_HistoryCategories;
+		int m_HistoryCategory = 0;
+		int m_HistoryMinutes = 60;
+		std::vector<NomBotCore::LogStoreRecord> m_History;
+
+		static constexpr size_t FilterRowsPerFrame = 200000; // Rescan budget after a filter change
+		static constexpr size_t MaxHistoryRecords = 200000;
+	};
+} // namespace NomTwitchBot
+
+#endif
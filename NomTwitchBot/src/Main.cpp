@@ -4,12 +4,15 @@
 #include <string.h>
 #include <stdio.h>
 #include <sstream>
+#include <map>
 #include <d3d11.h>
 #include "imgui.h"
 #include "backends/imgui_impl_win32.h"
 #include "backends/imgui_impl_dx11.h"
 
 #include "SubscriptionFunctions/ChannelPointRewardRedemption.h"
+#include "LogViewer/LogViewer.h"
+#include "TraceViewer/TraceViewer.h"
 
 extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND, UINT, WPARAM, LPARAM);
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
@@ -65,6 +68,14 @@ bool CreateDeviceD3D(HWND hWnd) {
 HWND hwnd;
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
+	// Keeps searchable history across restarts, declared first so it outlives the sink that feeds it
+	NomBotCore::LogStore logStore;
+	logStore.Open();
+	// Streams logs to Logs/ while the app runs, the destructor writes out the rest on every exit path
+	NomBotCore::LogFileSinkConfig sinkConfig;
+	sinkConfig.store = &logStore;
+	NomBotCore::LogFileSink logSink(sinkConfig);
+	logSink.Start();
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -91,6 +102,43 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 
 	bool IsTwitchAPIEnabled = false;
 	NomBotCore::BotCore botCore;
+	// Prometheus endpoint for headless runs, only served when NOM_METRICS_PORT is set
+	NomBotCore::MetricsExporterConfig metricsConfig;
+	char* metricsPort = nullptr;
+	size_t metricsPortLen = 0;
+	bool serveMetrics = _dupenv_s(&metricsPort, &metricsPortLen, "NOM_METRICS_PORT") == 0 && metricsPort != nullptr;
+	if (serveMetrics) {
+		metricsConfig.port = atoi(metricsPort);
+		free(metricsPort);
+	}
+	// Declared after botCore, it shares the bot's socket manager and has to stop first
+	NomBotCore::MetricsExporter metricsExporter(botCore.GetSocketManager(), metricsConfig);
+	if (serveMetrics)
+		metricsExporter.Start();
+	botCore.AddEventHandler<NomBotCore::ChannelPointRewardRedemption>([](const NomBotCore::ChannelPointRewardRedemption& redemption) {
+		NomTwitchBot::ChannelPointRewardRedemption::ProcessRedemption(redemption);
+	});
+	// Plays a capture recorded with NOM_CAPTURE_FILE through the handlers instead of a live channel. NOM_REPLAY_SPEED is a
+	// multiplier, 0 replays as fast as possible. Closing the window stops it.
+	std::jthread replayThread;
+	char* replayFile = nullptr;
+	size_t replayFileLen = 0;
+	if (_dupenv_s(&replayFile, &replayFileLen, "NOM_REPLAY_FILE") == 0 && replayFile != nullptr) {
+		double replaySpeed = 1;
+		char* speed = nullptr;
+		size_t speedLen = 0;
+		if (_dupenv_s(&speed, &speedLen, "NOM_REPLAY_SPEED") == 0 && speed != nullptr) {
+			replaySpeed = atof(speed);
+			free(speed);
+		}
+		replayThread = std::jthread([&botCore, path = std::string(replayFile), replaySpeed](std::stop_token stop) {
+			botCore.ReplayCapture(path, replaySpeed, nullptr, stop);
+		});
+		free(replayFile);
+	}
+	NomTwitchBot::LogViewer logViewer(&logStore);
+	NomTwitchBot::TraceViewer traceViewer;
+	NomBotCore::Trace::SetThreadName("UI");
 	MSG msg;
 	while (true) {
 		while (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE)) {
@@ -99,6 +147,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 			if (msg.message == WM_QUIT)
 				break;
 		}
+		// Everything logged during the last frame shows up in this one
+		NomBotCore::ImGuiLogManager::PublishStaged();
 		// Start ImGui frame
 		ImGui_ImplDX11_NewFrame();
 		ImGui_ImplWin32_NewFrame();
@@ -150,12 +200,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 			}
 			else {
 				if (ImGui::Button("Subscribe")) {
-					botCore.SubscrubeToEvent(
-						NomBotCore::TwitchAPI::SubscriptionType::ChannelPointsCustomRewardRedemptionAdd,
-						[](const NomBotCore::ChannelPointRewardRedemption& redemption) {
-							NomTwitchBot::ChannelPointRewardRedemption::ProcessRedemption(redemption);
-						}
-					);
+					botCore.SubscrubeToEvent(NomBotCore::TwitchAPI::SubscriptionType::ChannelPointsCustomRewardRedemptionAdd);
 				}
 				ImGui::SameLine();
 				ImGui::Text("Not Subscribed");
@@ -163,37 +208,45 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 			ImGui::EndChild();
 			ImGui::End();
 		}
-		ImGui::Begin("Application Logs:");
-		for (const auto& logName : NomBotCore::ImGuiLogManager::GetLogNames()) {
-			if (ImGui::CollapsingHeader(logName.c_str())) {
-				const auto& entries = NomBotCore::ImGuiLogManager::GetLog(logName);
-				ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.1f, 0.1f, 0.1f, 1.0f));
-				ImGui::BeginChild(logName.c_str(), ImVec2(0, 300), false, ImGuiWindowFlags_HorizontalScrollbar);
-				for (const auto& entry : entries) {
-					ImVec4 color;
-					switch (entry.severity) {
-					case NomBotCore::LogSeverity::Info:    color = ImVec4(1, 1, 1, 1); break; // White
-					case NomBotCore::LogSeverity::Warning: color = ImVec4(1, 1, 0, 1); break; // Yellow
-					case NomBotCore::LogSeverity::Error:   color = ImVec4(1, 0, 0, 1); break; // Red
+		ImGui::Begin("Network");
+		{
+			std::vector<NomBotCore::SocketStatsSnapshot> socketStats;
+			NomBotCore::SocketStatsRegistry::Snapshot(socketStats);
+			NomBotCore::SocketStatsSnapshot totals;
+			NomBotCore::SocketStatsRegistry::SnapshotTotals(totals);
+			socketStats.push_back(totals);
+			if (ImGui::BeginTable("SocketStats", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+				ImGui::TableSetupColumn("Socket");
+				ImGui::TableSetupColumn("Sent");
+				ImGui::TableSetupColumn("Received");
+				ImGui::TableSetupColumn("Calls out/in");
+				ImGui::TableSetupColumn("Connects/TLS");
+				ImGui::TableSetupColumn("Errors");
+				ImGui::TableSetupColumn("Timeouts");
+				ImGui::TableHeadersRow();
+				for (const auto& stats : socketStats) {
+					uint64_t errors = 0;
+					for (int i = 0; i < static_cast<int>(NomBotCore::SocketErrorType::Count); ++i) {
+						if (i != static_cast<int>(NomBotCore::SocketErrorType::Timeout))
+							errors += stats.errors[i];
 					}
-					ImGui::PushStyleColor(ImGuiCol_Text, color);
-					ImGui::TextUnformatted(entry.message.c_str());
-					ImGui::PopStyleColor();
-				}
-				if (NomBotCore::ImGuiLogManager::GetScrollToBottom()) {
-					ImGui::SetScrollHereY(1.0f);
-					NomBotCore::ImGuiLogManager::AddLog("NomBot", "Rendered log: " + logName, NomBotCore::LogSeverity::Info);
-					NomBotCore::ImGuiLogManager::AddLog("NomBot", "m_ScrollToBottom value: " + NomBotCore::ImGuiLogManager::GetScrollToBottom() ? "true" : "false", NomBotCore::LogSeverity::Info);
-					NomBotCore::ImGuiLogManager::AddLog("NomBot", "Auto-scrolling to bottom of log.", NomBotCore::LogSeverity::Info);
-					NomBotCore::ImGuiLogManager::SetScrollToBottom(false);
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn(); ImGui::TextUnformatted(stats.name.c_str());
+					ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.bytesSent);
+					ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.bytesReceived);
+					ImGui::TableNextColumn(); ImGui::Text("%llu/%llu", (unsigned long long)stats.sendCalls, (unsigned long long)stats.receiveCalls);
+					ImGui::TableNextColumn(); ImGui::Text("%llu/%llu", (unsigned long long)stats.connects, (unsigned long long)stats.tlsHandshakes);
+					ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)errors);
+					ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)stats.errors[static_cast<int>(NomBotCore::SocketErrorType::Timeout)]);
 				}
-				ImGui::EndChild();
-				ImGui::PopStyleColor();
+				ImGui::EndTable();
 			}
-			ImGui::Separator();
 		}
 		ImGui::End();
 
+		logViewer.Draw();
+		traceViewer.Draw();
+
 		// Rendering
 		ImGui::Render();
 		const float clear_color[4] = { 0.45f, 0.55f, 0.60f, 1.00f };
@@ -212,8 +265,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
 	CleanupDeviceD3D();
 	DestroyWindow(hwnd);
 	UnregisterClass(wc.lpszClassName, wc.hInstance);
-	NomBotCore::ImGuiLogManager::AddLog("NomBot", "Application exiting, dumping logs to file.", NomBotCore::LogSeverity::Info);
-	NomBotCore::ImGuiLogManager::DumpAllLogsToFile("Logs");
+	if (replayThread.joinable()) {
+		replayThread.request_stop();
+		replayThread.join();
+	}
+	NomBotCore::ImGuiLogManager::AddLog("NomBot", "Application exiting, flushing logs to file.", NomBotCore::LogSeverity::Info);
+	logSink.Stop();
 	return 0;
 }
 
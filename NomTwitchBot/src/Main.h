@@ -5,6 +5,9 @@
 #include <BotCore/Networking/NomSocketManager.h>
 #include <BotCore/TwitchAPI/TwitchAPI.h>
 #include <BotCore/Core/Logging/ImGuiLog.h>
+#include <BotCore/Core/Logging/LogFileSink.h>
+#include <BotCore/Core/Logging/LogStore.h>
+#include <BotCore/Core/Metrics/MetricsExporter.h>
 #include <BotCore/TwitchAPI/ChannelPointRewardRedemption.h>
 
 #endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "TraceViewer.h"
+#include "imgui.h"
+#include <ctime>
+#include <cstdio>
+#include <algorithm>
+#include <filesystem>
+
+namespace NomTwitchBot {
+	namespace {
+		ImU32 SpanColor(const char* name)
+		{
+			// Span names are literals, so the pointer is enough to give each one a stable color
+			uint32_t hash = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(name) >> 3) * 2654435761u;
+			return IM_COL32(80 + (hash & 0x7F), 80 + ((hash >> 8) & 0x7F), 80 + ((hash >> 16) & 0x7F), 255);
+		}
+	}
+
+	void TraceViewer::Draw()
+	{
+		ImGui::Begin("Trace");
+		bool enabled = NomBotCore::Trace::IsEnabled();
+		if (ImGui::Checkbox("Record", &enabled))
+			NomBotCore::Trace::SetEnabled(enabled);
+		ImGui::SameLine();
+		ImGui::Checkbox("Pause", &m_Paused);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(200);
+		ImGui::SliderFloat("Window (ms)", &m_WindowMs, 1.0f, 5000.0f, "%.0f");
+		ImGui::SameLine();
+		if (ImGui::Button("Export")) {
+			std::time_t now = std::time(nullptr);
+			std::tm local = {};
+			localtime_s(&local, &now);
+			char path[64];
+			snprintf(path, sizeof(path), "Logs/trace-%04d%02d%02d-%02d%02d%02d.json",
+				local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+			std::error_code error;
+			std::filesystem::create_directories("Logs", error);
+			NomBotCore::Trace::ExportChromeJson(path);
+		}
+
+		if (!m_Paused) {
+			m_Threads.clear();
+			NomBotCore::Trace::Snapshot(m_Threads);
+		}
+		DrawTimeline();
+		ImGui::End();
+	}
+
+	void TraceViewer::DrawTimeline()
+	{
+		int64_t endNs = 0;
+		for (const auto& thread : m_Threads) {
+			for (const auto& event : thread.events)
+				endNs = std::max(endNs, event.startNs + event.durationNs);
+		}
+		if (endNs == 0) {
+			ImGui::Text("No spans recorded%s", NomBotCore::Trace::IsEnabled() ? " yet" : ", tick Record to start");
+			return;
+		}
+		int64_t windowNs = static_cast<int64_t>(m_WindowMs * 1000000.0f);
+		int64_t startNs = endNs - windowNs;
+
+		ImGui::BeginChild("TraceTimeline");
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+		const float labelWidth = 120.0f;
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		float width = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+		float nsToPixels = width / static_cast<float>(windowNs);
+		float y = origin.y;
+		for (const auto& thread : m_Threads) {
+			drawList->AddText(ImVec2(origin.x, y), IM_COL32(255, 255, 255, 255), thread.name.c_str());
+			int rows = 1;
+			for (const auto& event : thread.events)
+				rows = std::max(rows, static_cast<int>(std::min<uint32_t>(event.depth, MaxDepth - 1)) + 1);
+			float laneLeft = origin.x + labelWidth;
+			drawList->PushClipRect(ImVec2(laneLeft, y), ImVec2(laneLeft + width, y + rows * rowHeight), true);
+			for (const auto& event : thread.events) {
+				int64_t eventEnd = event.startNs + event.durationNs;
+				if (eventEnd < startNs)
+					continue;
+				float row = static_cast<float>(std::min<uint32_t>(event.depth, MaxDepth - 1));
+				// Spans shorter than a pixel still get one so bursts stay visible
+				ImVec2 min(laneLeft + (event.startNs - startNs) * nsToPixels, y + row * rowHeight);
+				ImVec2 max(std::max(laneLeft + (eventEnd - startNs) * nsToPixels, min.x + 1.0f), min.y + rowHeight - 1.0f);
+				drawList->AddRectFilled(min, max, SpanColor(event.name));
+				if (max.x - min.x > ImGui::CalcTextSize(event.name).x + 4.0f)
+					drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32(0, 0, 0, 255), event.name);
+				if (ImGui::IsMouseHoveringRect(min, max)) {
+					ImGui::BeginTooltip();
+					ImGui::Text("%s", event.name);
+					ImGui::Text("%.3f us", event.durationNs / 1000.0);
+					ImGui::Text("%.3f ms ago", (endNs - event.startNs) / 1000000.0);
+					ImGui::EndTooltip();
+				}
+			}
+			drawList->PopClipRect();
+			y += rows * rowHeight + 4.0f;
+			drawList->AddLine(ImVec2(origin.x, y - 2.0f), ImVec2(laneLeft + width, y - 2.0f), IM_COL32(90, 90, 90, 255));
+		}
+		ImGui::Dummy(ImVec2(labelWidth + width, y - origin.y));
+		ImGui::EndChild();
+	}
+} // namespace NomTwitchBot
@@ -0,0 +1,23 @@
+#ifndef __TRACEVIEWER_H__
+#define __TRACEVIEWER_H__
+#include <BotCore/Core/Tracing/Trace.h>
+#include <vector>
+
+namespace NomTwitchBot {
+	// The "Trace" window. Shows the last few hundred milliseconds of spans as one lane per thread, nested
+	// spans stacked under their parent, and writes everything still buffered to a Chrome trace file.
+	class TraceViewer {
+	public:
+		void Draw();
+	private:
+		void DrawTimeline();
+
+		std::vector<NomBotCore::TraceThreadSnapshot> m_Threads;
+		bool m_Paused = false;
+		float m_WindowMs = 250.0f;
+
+		static constexpr int MaxDepth = 8; // Deeper spans are drawn on the last row
+	};
+} // namespace NomTwitchBot
+
+#endif
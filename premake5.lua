@@ -33,6 +33,9 @@ group ""
 
 group "Tools"
     include "NomTwitchBot"
+    include "MockTwitch"
+    include "BotCoreTests"
+    include "BotCoreBench"
 group ""
 
 group "Misc"